@@ -21,6 +21,8 @@
 #include "Lua/lua.hpp"
 #include "LuaBridge/LuaBridge.h"
 #include "LightComponent.h"
+#include "TransformComponent.h"
+#include "ParticleSystemComponent.h"
 
 class Actor : public std::enable_shared_from_this<Actor> {
 public:
@@ -51,13 +53,24 @@ public:
         (*component->componentRef)["actor"] = this;
     }
 
+    // C++ components go to Lua as their class, script components as their table
+    static luabridge::LuaRef ComponentToLua(const std::shared_ptr<Component>& component) {
+        if(component->isLC) {
+            return luabridge::LuaRef(ComponentManager::lua_state, std::static_pointer_cast<LightComponent>(component).get());
+        }
+        if(component->isTransform) {
+            return luabridge::LuaRef(ComponentManager::lua_state, std::static_pointer_cast<TransformComponent>(component).get());
+        }
+        if(component->isParticleSystem) {
+            return luabridge::LuaRef(ComponentManager::lua_state, std::static_pointer_cast<ParticleSystemComponent>(component).get());
+        }
+        return *(component->componentRef);
+    }
+
     luabridge::LuaRef GetComponentByKey(const std::string& key) {
         auto it = components.find(key);
         if(it != components.end()) {
-            if(it->second->isLC) {
-                return luabridge::LuaRef(ComponentManager::lua_state, std::static_pointer_cast<LightComponent>(it->second).get());
-            }
-            return *(it->second->componentRef);
+            return ComponentToLua(it->second);
         }
         return luabridge::LuaRef(ComponentManager::lua_state);
     }
@@ -65,10 +78,7 @@ public:
     luabridge::LuaRef GetComponent(const std::string& type) {
         auto it = componentsByType.find(type);
         if (it != componentsByType.end() && !it->second.empty()) {
-            if(it->second.front()->isLC) {
-                return luabridge::LuaRef(ComponentManager::lua_state, std::static_pointer_cast<LightComponent>(it->second.front()).get());
-            }
-            return *(it->second.front()->componentRef);
+            return ComponentToLua(it->second.front());
         }
         return luabridge::LuaRef(ComponentManager::lua_state);
     }
@@ -79,11 +89,7 @@ public:
             luabridge::LuaRef returnTable = luabridge::newTable(ComponentManager::lua_state);
             int idx = 1;
             for (const auto& component : it->second) {
-                if(component->isLC) {
-                    returnTable[idx++] = luabridge::LuaRef(ComponentManager::lua_state, std::static_pointer_cast<LightComponent>(component).get());
-                } else {
-                    returnTable[idx++] = *(component->componentRef);
-                }
+                returnTable[idx++] = ComponentToLua(component);
             }
             return returnTable;
         }
@@ -105,6 +111,12 @@ public:
             lightComponent->type = "Light";
             newComponent = lightComponent;
             LightComponent::RegisterLight(lightComponent);
+        } else if(type_name == "Transform") {
+            newComponent = std::make_shared<TransformComponent>();
+            newComponent->key = key;
+        } else if(type_name == "ParticleSystem") {
+            newComponent = std::make_shared<ParticleSystemComponent>();
+            newComponent->key = key;
         } else {
             // Create the new component.
             std::shared_ptr<Component> baseComponent = ComponentDB::AddComponent(type_name);
@@ -137,11 +149,7 @@ public:
         ComponentManager::num_runtime_components++;
 
         // return the luaref of the newly created component
-        if(newComponent->isLC) {
-            return luabridge::LuaRef(ComponentManager::lua_state, std::static_pointer_cast<LightComponent>(newComponent).get());
-        } else {
-            return componentInstance;
-        }
+        return ComponentToLua(newComponent);
     }
 
     void RemoveComponent(luabridge::LuaRef component) {
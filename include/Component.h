@@ -14,20 +14,24 @@ class Component {
 public:
   explicit Component() 
   : componentRef(std::make_shared<luabridge::LuaRef>(luabridge::LuaRef(ComponentManager::lua_state))), 
-    type(""), 
-    hasStart(false), 
-    hasUpdate(false), 
+    type(""),
+    key(""),
+    hasStart(false),
+    hasUpdate(false),
     hasLateUpdate(false),
+    hasFixedUpdate(false),
+    hasDestroy(false),
     enabled(true),
     added(false),
     callOnStart(false),
     destroyed(false),
-    key(""),
     addedStart(false),
     addedUpdate(false),
     addedLate(false),
-    hasDestroy(false),
-    isLC(false) {}
+    addedFixedUpdate(false),
+    isLC(false),
+    isTransform(false),
+    isParticleSystem(false) {}
 
   bool IsEnabled();
 
@@ -41,6 +45,7 @@ public:
   bool hasStart;
   bool hasUpdate;
   bool hasLateUpdate;
+  bool hasFixedUpdate;
   bool hasDestroy;
   bool enabled;
   bool added;
@@ -49,7 +54,10 @@ public:
   bool addedStart;
   bool addedUpdate;
   bool addedLate;
+  bool addedFixedUpdate;
   bool isLC;
+  bool isTransform;
+  bool isParticleSystem;
 };
 
 #endif
@@ -0,0 +1,67 @@
+#ifndef DEBUGDRAW_H
+#define DEBUGDRAW_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "StreamBuffer.h"
+
+class GameObject;
+struct ShaderLight;
+
+// A frame's debug lines: 2 vertices per line (x, y, z, packed RGBA8), the
+// depth tested ones first and the ones drawn on top after them
+struct DebugFrame {
+  std::vector<float> vertices;
+  int depthTestedVertices = 0;
+};
+
+// Immediate mode debug shapes, drawn as lines in the scene for one frame.
+// Everything queued in a frame goes out in at most two draws from a single
+// streamed vertex buffer, one depth tested and one on top. Main thread only.
+class DebugDraw {
+public:
+  // Needs a current context
+  static void Init(bool bounds, bool lights);
+  static void Shutdown();
+
+  // Colors are 0-1; overlay shapes aren't hidden by the scene
+  static void Line(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color, bool overlay = false);
+  static void Box(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color, bool overlay = false);
+  static void Sphere(const glm::vec3& center, float radius, const glm::vec4& color, bool overlay = false);
+  // Circle of the given radius facing along normal
+  static void Circle(const glm::vec3& center, const glm::vec3& normal, float radius, const glm::vec4& color, bool overlay = false);
+  static void Cone(const glm::vec3& apex, const glm::vec3& direction, float length, float angleDegrees, const glm::vec4& color, bool overlay = false);
+  // The volume a view projection matrix sees
+  static void Frustum(const glm::mat4& viewProjection, const glm::vec4& color, bool overlay = false);
+  // How far the light reaches, or where it points for directional lights
+  static void Light(const ShaderLight& light, bool overlay = false);
+
+  static void SetBoundsEnabled(bool enabled) { drawBounds = enabled; }
+  static void SetLightsEnabled(bool enabled) { drawLights = enabled; }
+
+  // Adds the bounds and lights overlays if they're on, then hands over
+  // everything queued this frame
+  static void BuildFrame(DebugFrame& frame, const std::vector<std::shared_ptr<GameObject>>& objects, const std::vector<ShaderLight>& lights);
+  // Render thread, into the scene target with its depth
+  static void Render(const DebugFrame& frame, const glm::mat4& view, const glm::mat4& projection);
+private:
+  static std::vector<float>& LinesFor(bool overlay) { return overlay ? overlayLines : depthTestedLines; }
+
+  static bool drawBounds;
+  static bool drawLights;
+  static std::vector<float> depthTestedLines;
+  static std::vector<float> overlayLines;
+
+  // Render thread
+  static std::shared_ptr<Shader> shader;
+  static GLuint vao;
+  static std::unique_ptr<StreamBuffer> stream;
+};
+
+#endif // DEBUGDRAW_H
@@ -37,20 +37,97 @@ struct RenderingSettings {
     int colorG = 255;
     int colorB = 255;
     float zoomFactor=1.0f;
+
+    // Shader program binary cache
+    bool shaderCache = true;
+    std::string shaderCacheDir = "shader_cache";
+    bool shaderWarmup = false;
+
+    bool occlusionCulling = false;
+
+    bool softwareOcclusion = false;
+    bool softwareOcclusionAsync = true;
+    int softwareOcclusionWidth = 256;
+
+    // Dynamic resolution / quality governor
+    bool dynamicResolution = false;
+    float targetFrameTimeMs = 16.67f;
+    float minRenderScale = 0.5f;
+    float maxRenderScale = 1.0f;
+    float renderScale = 1.0f;
+
+    bool gpuProfiler = false;
+
+    // Far models drawn as octahedral impostors
+    float impostorDistance = 0.0f;
+    float impostorFade = 5.0f;
+    int impostorResolution = 1024;
+    bool impostorCache = true;
+    std::string impostorCacheDir = "impostor_cache";
+
+    // Shadow maps, cached for static objects; resolution 0 turns them off
+    int shadowResolution = 0;
+    int shadowCascades = 3;
+    float shadowDistance = 50.0f;
+    int shadowFarCascadeInterval = 4;
+    int spotShadows = 2;
+
+    // Load resources/lightmaps/<initial scene>.lightmap when there is one
+    bool lightmaps = true;
+    // and resources/lightmaps/<initial scene>.probes
+    bool lightProbes = true;
+
+    // Debug line overlays
+    bool debugBounds = false;
+    bool debugLights = false;
+
+    // Frame pacing
+    std::string vsync = "on";
+    int targetFps = 0;
+
+    // Submit GL from a dedicated thread while the next frame simulates
+    bool renderThread = false;
+};
+
+// Set from the command line
+struct LaunchOptions {
+    // --headless: render offscreen without a window (see HeadlessContext)
+    bool headless = false;
+    // --null-renderer: no window and no GPU, only counts GL calls (see NullGL)
+    bool nullRenderer = false;
+    // --frames N: quit after N frames, 0 to run until closed
+    int frameLimit = 0;
+
+    // --capture FILE [--capture-start N] [--capture-frames N]: record the
+    // frames handed to the renderer (see FrameCapture)
+    std::string capturePath;
+    int captureStart = 0;
+    int captureFrames = 300;
+
+    // Set by ngine_replay: draw a capture instead of running the game
+    std::string replayPath;
+    int replayLoops = 1;
 };
 
+struct FramePacket;
+
 // Engine Class: runs the game engine
 class Engine {
 public:
-    Engine();
+    Engine(const LaunchOptions& options = LaunchOptions());
     void GameLoop();
+    // Draws every frame of launchOptions.replayPath, timing each one
+    void ReplayLoop();
     std::vector<std::string> OrderDialogue();
     void SetupInitialProps();
 
     // Game loop functions
     void UpdateGame();
+    // Draws and presents one frame; runs on whichever thread owns the context
+    void RenderFrame(FramePacket& packet);
 
     void SetupShaderUniforms();
+    void ShutdownSystems();
 
     bool are_intro_images = false;
     bool are_intro_text = false;
@@ -59,8 +136,13 @@ public:
     Scene current_scene;
 private:
     std::string game_title;
+    int tick_rate = 60;
+    int max_fixed_steps = 8;
+    std::string simd_level = "auto";
+    bool simd_benchmark = false;
     
     RenderingSettings renderingSettings;
+    LaunchOptions launchOptions;
     
     lua_State* lua_state = nullptr;
     
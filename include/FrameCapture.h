@@ -0,0 +1,47 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "RenderThread.h"
+
+// Records the frame packets handed to the renderer to a binary file, and
+// plays them back without Lua or any scene logic, so renderer changes can be
+// timed against the exact same frames. A capture holds each frame's camera,
+// lights and drawn objects (matrices, bounds, color, material), its
+// particles, sprites, text and debug lines as laid out for the renderer; the
+// first time a mesh, model or texture shows up its data is written too. Mesh
+// and model geometry goes in whole, textures by file path, so a replay still
+// needs the game's resources/ folder; the sprite and text atlases go in whole
+// with the first frame. Shadows and impostors are worked out again from the
+// objects on replay. Data is in the recording machine's byte order.
+class FrameCapture {
+public:
+  // Records frames firstFrame .. firstFrame + frameCount - 1 as they're
+  // submitted, then closes the file by itself
+  static bool StartRecording(const std::string& path, int firstFrame, int frameCount, int width, int height);
+  static void StopRecording();
+  static bool IsRecording();
+  // Main thread, once the packet's objects have their world matrices
+  static void Record(const FramePacket& packet);
+
+  // Called as textures are loaded, so materials can be saved by file
+  static void NoteTexture(unsigned int id, const std::string& directory, const std::string& path);
+
+  // Reads a capture without touching GL
+  static bool Load(const std::string& path);
+  // Uploads the capture's meshes and textures; needs a current context
+  static void CreateResources();
+  static void ReleaseResources();
+
+  static int GetFrameCount();
+  static int GetWidth();
+  static int GetHeight();
+
+  // Fills a packet for one of the loaded frames, ready for RenderFrame
+  static void BuildPacket(int frame, FramePacket& packet);
+};
+
+#endif // FRAMECAPTURE_H
@@ -0,0 +1,75 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <SDL2/SDL.h>
+
+// Controls when frames are presented: the swap interval (vsync off, on or
+// adaptive) and an optional FPS cap. The cap waits on the high resolution
+// counter by sleeping while there is comfortably enough time left and spinning
+// for the rest, with the sleep overshoot estimated as it runs. Present
+// intervals are tracked so frames that miss their slot can be counted.
+// Settings can be changed from any thread; a new swap interval is applied by
+// the thread that presents, right before its next swap.
+class FramePacer {
+public:
+  enum class VsyncMode {
+    Off,
+    On,
+    Adaptive
+  };
+
+  struct Stats {
+    float lastIntervalMs = 0.0f;
+    float averageIntervalMs = 0.0f;
+    float expectedIntervalMs = 0.0f;
+    int missedFrames = 0;
+  };
+
+  static void Init(const std::string& vsync, int targetFps);
+
+  // Call right before and right after SwapBuffers
+  static void WaitForNextFrame();
+  static void OnPresent();
+
+  static void SetVsyncMode(VsyncMode mode);
+  static VsyncMode GetVsyncMode();
+
+  static Stats GetStats();
+
+  // Lua accessors (through Application)
+  static void SetVsync(const std::string& vsync);
+  static std::string GetVsync();
+  static void SetTargetFps(int fps);
+  static int GetTargetFps();
+  static float GetFrameInterval();
+  static float GetFps();
+  static int GetMissedFrames();
+private:
+  static void PreciseSleep(double seconds);
+  static double GetRefreshInterval();
+  static void ApplyVsyncMode();
+
+  static std::atomic<VsyncMode> vsyncMode;
+  static std::atomic<bool> vsyncChanged;
+  static std::atomic<int> targetFps;
+  static int pacedFps;
+
+  static Uint64 nextFrameTicks;
+  static Uint64 lastPresentTicks;
+
+  // Running estimate of how long a 1ms sleep really takes
+  static double sleepEstimate;
+  static double sleepMean;
+  static double sleepM2;
+  static int64_t sleepSamples;
+
+  static Stats stats;
+  static std::mutex statsMutex;
+};
+
+#endif // FRAMEPACER_H
@@ -0,0 +1,61 @@
+#ifndef GLEXTENSIONS_H
+#define GLEXTENSIONS_H
+
+#include <string>
+#include <glad/glad.h>
+
+// The bundled glad loader only covers the GL 3.3 core profile. Entry points
+// and enums from newer versions / ARB extensions that the engine can take
+// advantage of when the driver exposes them are loaded here instead.
+
+// ARB_get_program_binary (core in 4.1)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// ARB_ES3_compatibility (core in 4.3)
+#ifndef GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+#define GL_ANY_SAMPLES_PASSED_CONSERVATIVE 0x8D6A
+#endif
+
+// ARB_buffer_storage (core in 4.4)
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
+typedef void (APIENTRYP PFN_glGetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFN_glProgramBinary)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFN_glProgramParameteri)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFN_glBufferStorage)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+class GLExtensions {
+public:
+  // Must be called once a context is current and glad has been loaded
+  static void Load(GLADloadproc loader);
+
+  static bool HasExtension(const std::string& name);
+  static bool IsVersionAtLeast(int major, int minor);
+
+  static bool programBinary;
+  static bool conservativeOcclusion;
+  static bool bufferStorage;
+
+  static PFN_glGetProgramBinary GetProgramBinary;
+  static PFN_glProgramBinary ProgramBinary;
+  static PFN_glProgramParameteri ProgramParameteri;
+  static PFN_glBufferStorage BufferStorage;
+};
+
+#endif // GLEXTENSIONS_H
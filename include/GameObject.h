@@ -4,8 +4,10 @@
 #include <glm/glm.hpp>
 #include <memory>
 #include <string>
+#include <vector>
 #include "Mesh.h"
 #include "Model.h"
+#include "TransformSystem.h"
 
 class GameObject {
 public:
@@ -21,7 +23,7 @@ public:
 
   // Core properties
   glm::vec3 position;
-  glm::vec3 rotation;  // In radians
+  glm::vec3 rotation;  // In degrees
   glm::vec3 scale;
   glm::vec3 color;
   bool isActive = true;
@@ -31,12 +33,27 @@ public:
 
   Material material;
 
+  // When set, position/rotation/scale are relative to this transform
+  TransformSystem::Handle parentTransform = TransformSystem::INVALID;
+
   // Core methods
   void Draw(GLuint shaderProgram, GLint modelLoc);
   virtual void Update(float deltaTime);
 
   // Transformation helpers
+  // Local matrix from position, rotation and scale
   glm::mat4 GetModelMatrix() const;
+  // Caches the world matrix, normal matrix and world bounds everything
+  // downstream draws and culls with, for a whole frame's objects at once;
+  // called as the render queue is handed over
+  static void UpdateWorldMatrices(const std::vector<std::shared_ptr<GameObject>>& objects);
+
+  // Axis-aligned bounds of the drawn geometry, in object and world space
+  void GetLocalBounds(glm::vec3& outMin, glm::vec3& outMax) const;
+  void GetWorldBounds(glm::vec3& outMin, glm::vec3& outMax) const {
+    outMin = worldBoundsMin;
+    outMax = worldBoundsMax;
+  }
 
   // Factory methods for easy creation
   static std::shared_ptr<GameObject> CreateCube(float size = 1.0f);
@@ -84,7 +101,32 @@ public:
   }
 
   bool isModel = false;
+
+  // Rasterized into the software occlusion buffer (model must have occluder triangles)
+  bool isOccluder = false;
+
+  // Won't move, so its shadows can be kept between frames (see ShadowSystem)
+  bool isStatic = false;
+
+  // Share of the object dithered away this frame, 0 to 1, while its
+  // impostor fades in; set by ImpostorSystem::BuildFrame
+  float fadeOut = 0.0f;
+
+  // Where the object's square sits in the lightmap atlas, uv * xy + zw; all
+  // zero when it isn't lightmapped. Set by Lightmaps::BuildFrame.
+  glm::vec4 lightmapRect = glm::vec4(0.0f);
+
+  // The cached world and normal matrices
+  const glm::mat4& GetDrawMatrix() const { return worldMatrix; }
+  const glm::mat3& GetNormalMatrix() const { return normalMatrix; }
 private:
+  // Replays restore the caches below as they were captured
+  friend class FrameCapture;
+
+  glm::mat4 worldMatrix = glm::mat4(1.0f);
+  glm::mat3 normalMatrix = glm::mat3(1.0f);
+  glm::vec3 worldBoundsMin = glm::vec3(0.0f);
+  glm::vec3 worldBoundsMax = glm::vec3(0.0f);
 };
 
 #endif // GAMEOBJECT_H
\ No newline at end of file
@@ -17,6 +17,8 @@
 #include "Mesh.h"
 #include "GameObject.h"
 
+class TransformComponent;
+
 class GameObjectDB {
 public:
   static void Init();
@@ -29,18 +31,40 @@ public:
   static std::shared_ptr<GameObject> CreatePlane(float width = 1.0f, float length = 1.0f, const glm::vec3& color = glm::vec3(1.0f), const glm::vec3& position = glm::vec3(0.0f));
   static std::shared_ptr<GameObject> CreateTexturedPlane(const std::string& texturePath,float width = 1.0f, float length = 1.0f, const glm::vec3& color = glm::vec3(1.0f), const glm::vec3& position = glm::vec3(0.0f));
 
+  // Make a drawn object's position, rotation and scale relative to a transform
+  static void Attach(std::shared_ptr<GameObject> gameObject, TransformComponent* transform);
+  // Static objects' shadows are cached until one of them moves
+  static void SetStatic(std::shared_ptr<GameObject> gameObject, bool isStatic);
+
   // Queue an object for rendering
   static void QueueForRendering(const std::shared_ptr<GameObject>& gameObject);
 
   // Render all queued objects and clear the queue
   static void RenderAndClearObjects(GLuint shaderProgram, GLint modelLoc);
+
+  // RenderAndClearObjects in two steps, so the queue can be handed to the
+  // render thread: take the frame's objects (main thread), draw them (GL thread)
+  static std::vector<std::shared_ptr<GameObject>> TakeRenderQueue();
+  static void RenderObjects(const std::vector<std::shared_ptr<GameObject>>& queue, GLuint shaderProgram, GLint modelLoc);
   
-  // Update all game objects
-  static void UpdateAll(float deltaTime);
+  // Objects created between these calls belong to the current simulation
+  // step and are drawn interpolated against the previous step
+  static void BeginFixedStep();
+  static void EndFixedStep();
+
+  // Update all game objects; alpha is how far the frame is between the last
+  // two fixed steps
+  static void UpdateAll(float deltaTime, float alpha = 1.0f);
 private:
+  static void Track(const std::shared_ptr<GameObject>& gameObject);
+
   static std::vector<std::shared_ptr<GameObject>> allGameObjects;
   static std::vector<std::shared_ptr<GameObject>> renderQueue;
   static std::unordered_map<std::string, std::shared_ptr<GameObject>> gameObjectMap;
+
+  static std::vector<std::shared_ptr<GameObject>> currentFixedObjects;
+  static std::vector<std::shared_ptr<GameObject>> previousFixedObjects;
+  static bool inFixedStep;
 };
 
 #endif // GAMEOBJECTDB_H
\ No newline at end of file
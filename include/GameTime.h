@@ -0,0 +1,47 @@
+#ifndef GAMETIME_H
+#define GAMETIME_H
+
+#include <SDL2/SDL.h>
+
+// Frame and simulation clock on SDL's high resolution counter. Real frame
+// time is fed into an accumulator that is drained in fixed-size steps, so the
+// simulation advances at the same rate whatever the frame rate is. Long frames
+// are clamped and the steps per frame capped so a slow frame can't snowball
+// into ever more catch-up work (the "spiral of death").
+class GameTime {
+public:
+  static void Init(int tickRate, int maxStepsPerFrame);
+
+  // Measures the time since the previous frame and adds it to the accumulator
+  static void BeginFrame();
+
+  // Returns true while another fixed step is due this frame
+  static bool StepFixed();
+
+  // Time since the previous frame, in seconds
+  static float GetDeltaTime();
+  static float GetFixedDeltaTime();
+  // Seconds of simulation time (advances in fixed steps)
+  static double GetFixedTime();
+  // Seconds since Init, updated once per frame
+  static double GetTime();
+  // How far between the last two simulation states the current frame is (0-1)
+  static float GetAlpha();
+  static int GetStepsThisFrame();
+
+  static void SetTickRate(int tickRate);
+  static int GetTickRate();
+private:
+  static Uint64 startTicks;
+  static Uint64 lastTicks;
+  static double deltaTime;
+  static double time;
+  static double fixedTime;
+  static double fixedDeltaTime;
+  static double accumulator;
+  static int tickRate;
+  static int maxStepsPerFrame;
+  static int stepsThisFrame;
+};
+
+#endif // GAMETIME_H
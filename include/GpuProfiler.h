@@ -0,0 +1,107 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+// Measures GPU time per named render pass with GL_TIMESTAMP queries. Each
+// frame's queries live in one slot of a small ring and are only read once the
+// GPU reports them available (normally 2-3 frames later), so profiling never
+// stalls the CPU. Passes may nest; a pass hit several times in a frame counts
+// once with the summed time. Passes are recorded on the thread that renders;
+// the stats accessors may be called from another.
+class GpuProfiler {
+public:
+  struct PassStats {
+    std::string name;
+    float lastMs = 0.0f;
+    float averageMs = 0.0f;
+    float p50Ms = 0.0f;
+    float p95Ms = 0.0f;
+    float p99Ms = 0.0f;
+    int samples = 0;
+  };
+
+  static void Init(bool enabled);
+  static void Shutdown();
+
+  static void SetEnabled(bool enabled);
+  static bool IsEnabled();
+
+  // Bracket the whole frame; recorded as the "frame" pass
+  static void BeginFrame();
+  static void EndFrame();
+
+  static void BeginPass(const std::string& name);
+  static void EndPass();
+
+  static PassStats GetPassStats(const std::string& name);
+  static std::vector<PassStats> GetAllPassStats();
+  static int GetDroppedFrames();
+
+  // Lua accessors
+  static float GetPassTime(const std::string& name);
+  static float GetLastPassTime(const std::string& name);
+  static float GetPassPercentile(const std::string& name, float percentile);
+  static std::string GetReport();
+private:
+  static const int FRAME_RING_SIZE = 4;
+  static const int HISTORY_SIZE = 240;
+
+  struct Marker {
+    int pass;
+    GLuint beginQuery;
+    GLuint endQuery;
+  };
+
+  struct FrameSlot {
+    std::vector<GLuint> queries;
+    int queriesUsed = 0;
+    std::vector<Marker> markers;
+    bool pending = false;
+  };
+
+  struct PassHistory {
+    std::string name;
+    std::vector<float> samples;
+    int next = 0;
+    int count = 0;
+    float lastMs = 0.0f;
+  };
+
+  static int FindOrAddPass(const std::string& name);
+  static GLuint AllocateQuery(FrameSlot& slot);
+  static bool TryReadBack(FrameSlot& slot);
+  static float Percentile(const PassHistory& history, float percentile);
+  static PassStats StatsFor(const PassHistory& history);
+
+  static std::atomic<bool> enabled;
+  static bool frameActive;
+  static int frameIndex;
+  static std::atomic<int> droppedFrames;
+
+  static FrameSlot slots[FRAME_RING_SIZE];
+  static std::vector<int> openMarkers;
+
+  static std::vector<PassHistory> passes;
+  static std::unordered_map<std::string, int> passLookup;
+  // Guards passes and passLookup
+  static std::mutex historyMutex;
+};
+
+// Times everything until the end of the enclosing scope as one pass
+class GpuProfileScope {
+public:
+  explicit GpuProfileScope(const std::string& name) { GpuProfiler::BeginPass(name); }
+  ~GpuProfileScope() { GpuProfiler::EndPass(); }
+
+  GpuProfileScope(const GpuProfileScope&) = delete;
+  GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+};
+
+#endif // GPUPROFILER_H
@@ -0,0 +1,42 @@
+#ifndef HEADLESSCONTEXT_H
+#define HEADLESSCONTEXT_H
+
+#include <glad/glad.h>
+
+// An OpenGL 3.3 core context with no window, for machines without a display.
+// It comes from EGL: surfaceless where the driver allows it, otherwise a small
+// pbuffer per context (Mesa's llvmpipe does both). Without a window there's
+// no default framebuffer, so frames are drawn into an offscreen one the size
+// the window would have been. Linux builds with EGL only (NGINE_EGL); Init
+// fails elsewhere.
+class HeadlessContext {
+public:
+  // Creates the context, makes it current, loads GL and binds the framebuffer
+  static bool Init(int width, int height);
+  static void Shutdown();
+
+  // Contexts are opaque pointers, so they fit where an SDL_GLContext goes
+  static void* GetMainContext();
+  // Shares objects with the main context, like SDL_GL_SHARE_WITH_CURRENT_CONTEXT
+  static void* CreateSharedContext();
+  static void DestroyContext(void* context);
+  // nullptr releases the calling thread's context
+  static bool MakeCurrent(void* context);
+
+  // Stands in for framebuffer 0
+  static GLuint GetFramebuffer();
+
+  // Nothing paces frames like a swap would, so wait for the GPU instead -
+  // frame times then include the GPU work, as they do with a window
+  static void Present();
+
+  static void* GetProcAddress(const char* name);
+private:
+  static bool CreateFramebuffer(int width, int height);
+
+  static GLuint framebuffer;
+  static GLuint colorBuffer;
+  static GLuint depthBuffer;
+};
+
+#endif // HEADLESSCONTEXT_H
@@ -0,0 +1,114 @@
+#ifndef IMAGEDB_H
+#define IMAGEDB_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "TextureAtlas.h"
+
+// A run of sprites drawn with one texture
+struct SpriteBatch {
+  int page = 0;
+  int first = 0;
+  int count = 0;
+  bool world = false;
+};
+
+// Rows of an atlas page the render thread hasn't seen yet
+struct SpritePageUpload {
+  int page = 0;
+  int width = 0;
+  int height = 0;
+  int top = 0;
+  int rows = 0;
+  std::vector<uint8_t> pixels;
+};
+
+// A frame's sprites: 4 vertices per sprite (x, y, z, u, v, r, g, b, a), world
+// sprites first, then screen ones, each sorted by layer and texture. World
+// sprites are also sorted back to front within a layer.
+struct SpriteFrame {
+  std::vector<float> vertices;
+  std::vector<SpriteBatch> batches;
+  std::vector<SpritePageUpload> uploads;
+};
+
+// Draws images queued from Lua, either over the finished frame in window
+// pixels or as camera-facing quads in the world. Images are packed into a few
+// large atlas pages the first time they're drawn, and a frame's sprites are
+// sorted so each run sharing a page is a single draw call.
+class ImageDB {
+public:
+  // Needs a current context
+  static void Init();
+  static void Shutdown();
+
+  // x, y is the top left corner in window pixels
+  static void Draw(const std::string& image_name, float x, float y);
+  // x, y is where the pivot (0-1 across the image) goes; rotation is in
+  // degrees, colors are 0-255 and lower layers are drawn first
+  static void DrawEx(const std::string& image_name, float x, float y, float rotation, float scale_x, float scale_y, float pivot_x, float pivot_y, float r, float g, float b, float a, int layer);
+  // A quad facing the camera, centred on x, y, z and width world units wide
+  static void DrawWorld(const std::string& image_name, float x, float y, float z, float width);
+  static void DrawWorldEx(const std::string& image_name, float x, float y, float z, float width, float rotation, float r, float g, float b, float a, int layer);
+  static void DrawPixel(float x, float y, float r, float g, float b, float a);
+
+  // Main thread: sorts and lays out everything queued this frame
+  static void BuildFrame(SpriteFrame& frame, const glm::mat4& view);
+  // Main thread: every atlas page whole, as uploads, for a frame capture to
+  // start from
+  static void SnapshotPages(std::vector<SpritePageUpload>& uploads);
+  // Render thread. World sprites go in the scene pass, after the opaque
+  // objects; it runs first each frame, so it also uploads the vertices and
+  // any new atlas contents.
+  static void RenderWorld(const SpriteFrame& frame, const glm::mat4& view, const glm::mat4& projection);
+  // Screen sprites, once the scene is in the window
+  static void RenderScreen(const SpriteFrame& frame);
+private:
+  struct Image {
+    int page;
+    float width, height;
+    float u0, v0, u1, v1;
+  };
+
+  struct SpriteRequest {
+    const Image* image;
+    glm::vec3 position;
+    glm::vec2 size;
+    glm::vec2 pivot;
+    float rotation;
+    glm::vec4 color;
+    int layer;
+    bool world;
+  };
+
+  static const Image* GetImage(const std::string& image_name);
+  // Packs tightly packed RGBA pixels into a page
+  static Image AddImage(int width, int height, const uint8_t* pixels);
+  static void DrawBatches(const SpriteFrame& frame, bool world);
+
+  static std::unordered_map<std::string, Image> images;
+  static std::vector<std::unique_ptr<TextureAtlas>> pages;
+  // The page small images are being packed into
+  static int sharedPage;
+  static std::vector<SpriteRequest> drawQueue;
+  static Image whitePixel;
+
+  // Render thread
+  static std::shared_ptr<Shader> shader;
+  static std::vector<GLuint> pageTextures;
+  static GLuint vao;
+  static std::unique_ptr<StreamBuffer> stream;
+  static GLuint ebo;
+  static int indexCapacity;
+};
+
+#endif // IMAGEDB_H
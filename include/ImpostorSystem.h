@@ -0,0 +1,101 @@
+#ifndef IMPOSTORSYSTEM_H
+#define IMPOSTORSYSTEM_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "StreamBuffer.h"
+
+class GameObject;
+class Model;
+struct ShaderLight;
+
+// A model seen from FRAMES x FRAMES directions spread over an octahedron,
+// each rendered orthographically around its bounding sphere into one cell of
+// an albedo atlas and a normal + depth atlas. Shared by every object drawing
+// the same Model.
+struct Impostor {
+  // Object space bounding sphere the views were framed on
+  glm::vec3 center = glm::vec3(0.0f);
+  float radius = 0.0f;
+
+  // Set by the render thread once the atlases are baked or loaded, and read
+  // by the main thread when it builds the next frame
+  std::atomic<bool> ready{false};
+  std::atomic<bool> failed{false};
+
+  // Render thread
+  GLuint albedo = 0;
+  GLuint normalDepth = 0;
+
+  ~Impostor();
+};
+
+// One model's impostors this frame: 12 floats per instance (world center,
+// radius, rotation quaternion, r, g, b, fade in)
+struct ImpostorBatch {
+  std::shared_ptr<Model> model;
+  std::shared_ptr<Impostor> impostor;
+  std::vector<float> instances;
+  int count = 0;
+};
+
+struct ImpostorFrame {
+  std::vector<ImpostorBatch> batches;
+};
+
+// Swaps models past a distance for camera-facing quads that sample their
+// impostor, so any number of far copies of a model cost one instanced draw.
+// Across the fade band both are drawn, dithered against each other. Atlases
+// are baked on the render thread the first time a model needs one and cached
+// on disk next to the shader cache; until one is ready the model is drawn
+// in full.
+class ImpostorSystem {
+public:
+  // distance 0 turns impostors off
+  static void Init(float distance, float fadeBand, int resolution, bool useCache, const std::string& cacheDirectory);
+  static void Shutdown();
+
+  static void SetDistance(float distance);
+  static float GetDistance();
+
+  // Main thread, once world bounds are up to date. Takes models past the
+  // fade band out of objects and queues their impostors instead; the quality
+  // governor's LOD bias pulls the distance in.
+  static void BuildFrame(ImpostorFrame& frame, std::vector<std::shared_ptr<GameObject>>& objects, const glm::mat4& viewProjection, const glm::vec3& cameraPos);
+  // Render thread, before the scene target is bound: bakes or loads at most
+  // one atlas this frame's batches are waiting on
+  static void Prepare(const ImpostorFrame& frame);
+  // Render thread, into the scene target with its depth
+  static void Render(const ImpostorFrame& frame, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos, const std::vector<ShaderLight>& lights);
+
+  static const int FRAMES = 8;
+private:
+  static bool Bake(const Model& model, Impostor& impostor);
+  static bool LoadCached(const Model& model, Impostor& impostor);
+  static void SaveCached(const Model& model, const std::vector<uint8_t>& albedo, const std::vector<uint8_t>& normalDepth);
+  static std::string CachePath(const Model& model);
+  static void CreateTextures(Impostor& impostor, const std::vector<uint8_t>& albedo, const std::vector<uint8_t>& normalDepth);
+
+  static float distance;
+  static float fadeBand;
+  static int resolution;
+  static bool useCache;
+  static std::string cacheDir;
+
+  // Render thread
+  static std::shared_ptr<Shader> bakeShader;
+  static std::shared_ptr<Shader> shader;
+  static GLuint vao;
+  static GLuint quadVBO;
+  static std::unique_ptr<StreamBuffer> instanceStream;
+};
+
+#endif // IMPOSTORSYSTEM_H
@@ -0,0 +1,54 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tracks how many jobs from one Dispatch are still outstanding
+struct JobCounter {
+  std::atomic<int> remaining{0};
+};
+
+// A small fixed pool of worker threads. Work is handed out as "run this
+// function for every index in [0, count)" and waited on with the returned
+// counter. Waiting threads (including workers waiting on nested work) run
+// queued jobs themselves instead of blocking, so jobs can dispatch more jobs.
+class JobSystem {
+public:
+  // 0 picks one worker per hardware thread, minus the main thread
+  static void Init(int numThreads = 0);
+  static void Shutdown();
+
+  static int GetWorkerCount();
+
+  static std::shared_ptr<JobCounter> Dispatch(int count, std::function<void(int)> func);
+  static void Wait(const std::shared_ptr<JobCounter>& counter);
+  static bool IsDone(const std::shared_ptr<JobCounter>& counter);
+
+  // Dispatch + Wait
+  static void ParallelFor(int count, std::function<void(int)> func);
+private:
+  struct Job {
+    std::shared_ptr<std::function<void(int)>> func;
+    int index;
+    std::shared_ptr<JobCounter> counter;
+  };
+
+  static void WorkerLoop();
+  static bool TryRunOne();
+  static void Run(Job& job);
+
+  static std::vector<std::thread> workers;
+  static std::deque<Job> queue;
+  static std::mutex queueMutex;
+  static std::condition_variable queueCondition;
+  static bool running;
+};
+
+#endif // JOBSYSTEM_H
@@ -5,6 +5,9 @@
 #include <glm/glm.hpp>
 #include <string>
 #include <memory>
+#include <vector>
+#include <atomic>
+#include <algorithm>
 
 enum class LightType {
   DIRECTIONAL, // Light comes from a direction
@@ -12,6 +15,22 @@ enum class LightType {
   SPOT         // Light emits in a cone
 };
 
+// Plain copy of one light's shader uniforms, safe to hand to another thread
+struct ShaderLight {
+  int type;
+  glm::vec3 position;
+  glm::vec3 direction;
+  glm::vec3 color;
+  float intensity;
+  float constant;
+  float linear;
+  float quadratic;
+  float innerCutoffCos;
+  float outerCutoffCos;
+  // Lightmapped objects already have this light in their lightmap
+  int baked;
+};
+
 class LightComponent : public Component {
 private:
   LightType lightType;
@@ -29,6 +48,9 @@ private:
   float innerCutoff;
   float outerCutoff;
 
+  // Baked into lightmaps by ngine_bake (see Lightmaps)
+  bool baked;
+
   std::string name;
 public:
   LightComponent() :
@@ -43,6 +65,7 @@ public:
     quadratic(0.032f),
     innerCutoff(12.5f),
     outerCutoff(17.5f),
+    baked(false),
     name("Light") {
       type = "Light";
     }
@@ -60,7 +83,25 @@ public:
 
     static void ApplyAllLightsToShader(unsigned int shaderProgram);
 
+    // The two halves of ApplyAllLightsToShader: pick the lights to shade this
+    // frame (no GL), then upload them
+    static std::vector<ShaderLight> GatherShaderLights(const glm::vec3& cameraPos);
+    static void UploadLights(unsigned int shaderProgram, const std::vector<ShaderLight>& shaderLights);
+
+    // Size of the lights[] array in the fragment shader
+    static const int MAX_SHADER_LIGHTS = 8;
+
+    // At most this many lights are shaded per frame; directional lights go
+    // first, then the rest by how strongly they reach the camera
+    static void SetLightLimit(int limit);
+    static int GetLightLimit();
+
+    // Distance at which a point or spot light falls to cutoff of full
+    // strength; infinite if it never fades
+    static float GetRange(const ShaderLight& light, float cutoff);
+
     static std::vector<std::shared_ptr<LightComponent>> lights;
+    static std::atomic<int> lightLimit;
 
     // Getters and setters
     int GetType() const { return static_cast<int>(lightType); }
@@ -94,12 +135,16 @@ public:
     
     float GetOuterCutoff() const { return outerCutoff; }
     void SetOuterCutoff(float degrees) { outerCutoff = degrees; }
+
+    bool GetBaked() const { return baked; }
+    void SetBaked(bool value) { baked = value; }
     
     std::string GetName() const { return name; }
     void SetName(const std::string& newName) { name = newName; }
     
     // Methods to apply this light to a shader
     void ApplyToShader(unsigned int shaderProgram, const std::string& uniformName) const;
+    ShaderLight ToShaderLight() const;
 };
 
 #endif // LIGHTCOMPONENT_H
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef LIGHTPROBES_H
+#define LIGHTPROBES_H
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// A regular grid of irradiance probes, as ngine_bake writes it
+struct ProbeGridData {
+  // World position of probe (0, 0, 0) and the distance between neighbours
+  glm::vec3 origin = glm::vec3(0.0f);
+  float spacing = 1.0f;
+  glm::ivec3 counts = glm::ivec3(0);
+  // COEFFICIENTS RGB coefficients per probe, x fastest then y then z. They
+  // are of irradiance, the cosine convolution already applied, in the order
+  // L00, L1-1, L10, L11, L2-2, L2-1, L20, L21, L22.
+  std::vector<float> coefficients;
+};
+
+// Bounced light for everything the lightmap doesn't cover. Each probe holds
+// L2 spherical harmonics of the light arriving at it; the scene shader blends
+// the eight around a fragment in seven trilinear fetches and evaluates them
+// along its normal. Where the grid applies it stands in for the ambient term
+// of lights marked baked.
+class LightProbes {
+public:
+  // Main thread, with a context current
+  static bool Load(const std::string& path);
+  static void Shutdown();
+  static bool IsLoaded();
+
+  static bool Save(const std::string& path, const ProbeGridData& data);
+  static bool Read(const std::string& path, ProbeGridData& data);
+
+  // Render thread, with the scene shader in use. Always sets the sampler,
+  // so it never shares a unit with a material's textures.
+  static void Apply(GLuint program);
+
+  static const int COEFFICIENTS = 9;
+  // The coefficients go up as RGBA texels stacked along z, this many blocks
+  // deep; a 3D texture is only sure to be 256 deep, hence the per-axis limit
+  static const int BLOCKS = 7;
+  static const int MAX_PROBES_PER_AXIS = 32;
+  // Texture unit the scene shader samples the grid from
+  static const int PROBE_UNIT = 8;
+private:
+  static GLuint texture;
+  static glm::vec3 origin;
+  static float spacing;
+  static glm::ivec3 counts;
+};
+
+#endif // LIGHTPROBES_H
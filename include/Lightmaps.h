@@ -0,0 +1,83 @@
+#ifndef LIGHTMAPS_H
+#define LIGHTMAPS_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class GameObject;
+class Mesh;
+
+// How one mesh is laid out in lightmap space. Charts need their own copies of
+// the vertices along their edges, so the mesh is drawn from remapped
+// vertices: new vertex i is a copy of original vertex remap[i].
+struct LightmapLayout {
+  std::vector<uint32_t> remap;
+  std::vector<uint32_t> indices;
+  // Two floats per new vertex, 0 to 1 across the object's square
+  std::vector<float> uvs;
+};
+
+// Where one placed object's square landed in the atlas: uv * scale + offset
+struct LightmapInstance {
+  uint64_t geometry;
+  uint64_t placement;
+  glm::vec4 rect;
+};
+
+// Everything ngine_bake writes for a scene
+struct LightmapData {
+  int width = 0;
+  int height = 0;
+  // Irradiance, RGB half floats
+  std::vector<uint16_t> texels;
+  // Keyed by Mesh::contentHash
+  std::unordered_map<uint64_t, LightmapLayout> layouts;
+  std::vector<LightmapInstance> instances;
+};
+
+// Baked lighting for static objects. Objects are matched to the atlas by
+// their geometry and world matrix, so a script drawing the same static
+// object in the same place every frame picks its lightmap up again; meshes
+// pick up their second UV set as they're created. Lights marked baked are
+// skipped for lightmapped objects and still shade everything else.
+class Lightmaps {
+public:
+  // Main thread, with a context current and before any mesh it covers is
+  // created
+  static bool Load(const std::string& path);
+  static void Shutdown();
+  static bool IsLoaded();
+
+  static bool Save(const std::string& path, const LightmapData& data);
+  static bool Read(const std::string& path, LightmapData& data);
+
+  // Null if the mesh isn't lightmapped, or if the layout stored for its hash
+  // doesn't fit its vertex and index counts. Safe from any thread once loaded.
+  static const LightmapLayout* FindLayout(uint64_t meshHash, size_t vertexCount, size_t indexCount);
+
+  // What a placed object is matched on: its mesh or model's contents, and
+  // its world matrix rounded off a little
+  static uint64_t GeometryHash(const GameObject& object);
+  static uint64_t PlacementHash(const glm::mat4& worldMatrix);
+
+  // Main thread, once world matrices are up to date: gives static objects
+  // their atlas rects
+  static void BuildFrame(const std::vector<std::shared_ptr<GameObject>>& objects);
+  // Render thread, with the scene shader in use
+  static void Apply(GLuint program);
+
+  // Texture unit the scene shader samples the atlas from
+  static const int LIGHTMAP_UNIT = 5;
+private:
+  static std::unordered_map<uint64_t, LightmapLayout> layouts;
+  static std::unordered_map<uint64_t, glm::vec4> rects;
+  static GLuint texture;
+};
+
+#endif // LIGHTMAPS_H
@@ -1,6 +1,7 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <glad/glad.h>
@@ -37,14 +38,28 @@ struct Material {
 class Mesh {
 private:
 public:
-  GLuint VAO, VBO, EBO;
+  mutable GLuint VAO; // created on first draw, see BindVertexArray
+  GLuint VBO, EBO;
   std::vector<float> vertices;
   std::vector<unsigned int> indices;
   std::vector<Texture> textures;
   unsigned int vertexCount, indexCount;
+  int vertexStride; // floats per vertex
   bool hasTextureCoords;
   Material material;
 
+  // Object-space bounding box of the vertex positions
+  glm::vec3 boundsMin = glm::vec3(0.0f);
+  glm::vec3 boundsMax = glm::vec3(0.0f);
+
+  // Hash of the vertices and indices as created, for matching the mesh to
+  // baked data between runs
+  uint64_t contentHash = 0;
+  // Lightmap UVs at attribute 4, when a loaded lightmap covers the mesh. The
+  // GPU buffers then hold its remapped vertices; vertices and indices above
+  // stay as created.
+  GLuint lightmapVBO = 0;
+
   Mesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices);
   Mesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures, Material material);
 
@@ -52,9 +67,19 @@ public:
 
   void Draw(unsigned int shaderProgram) const;
 
+  // The two halves of Draw, for callers that batch state changes themselves
+  void ApplyMaterial(unsigned int shaderProgram, const Material& material) const;
+  void DrawElements() const;
+  void BindVertexArray() const;
+
   // Prevent copying
   Mesh(const Mesh&) = delete;
   Mesh& operator=(const Mesh&) = delete;
+
+private:
+  void CreateBuffers();
+  void ComputeBounds(int stride);
+  void ComputeContentHash();
 };
 
 
@@ -9,6 +9,8 @@
 #include "Mesh.h"
 #include "Shader.h"
 
+struct Impostor;
+
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -22,12 +24,29 @@ public:
     stbi_set_flip_vertically_on_load(true);
     LoadModel(path);
   }
+  // Empty, for meshes that come from somewhere other than a file (replays)
+  Model() {}
   void Draw(unsigned int shaderProgram);	
   // model data
   std::vector<std::shared_ptr<Mesh>> meshes;
   std::string directory;
+  // File it was loaded from; empty for replays
+  std::string path;
   std::vector<Texture> texturesLoaded;
 
+  // Object-space bounding box of all meshes
+  glm::vec3 boundsMin = glm::vec3(0.0f);
+  glm::vec3 boundsMax = glm::vec3(0.0f);
+
+  // CPU-side triangles (3 positions each) rasterized by software occlusion
+  // culling when this model is an occluder
+  std::shared_ptr<const std::vector<glm::vec3>> occluderTriangles;
+  void LoadOccluderProxy(const std::string& path);
+  void UseMeshesAsOccluder();
+
+  // Far away stand-in, made by ImpostorSystem the first time one is needed
+  std::shared_ptr<Impostor> impostor;
+
 private:
   void LoadModel(std::string& path);
   void ProcessNode(aiNode* node, const aiScene* scene);
@@ -0,0 +1,40 @@
+#ifndef NULLGL_H
+#define NULLGL_H
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+// A stand-in OpenGL driver for measuring everything but the GPU. glad is
+// loaded with these entry points instead of a real driver's, so the engine
+// runs its usual GL code unchanged while nothing reaches a GPU: objects get
+// made-up names, shaders always compile, queries report visible and zero
+// time, and draws, uploads and state changes are only counted.
+class NullGL {
+public:
+  struct Stats {
+    uint64_t frames = 0;
+    uint64_t drawCalls = 0;
+    uint64_t indices = 0;
+    uint64_t bytesUploaded = 0;   // Buffer and texture data handed to GL
+    uint64_t stateChanges = 0;    // Binds, enables, masks, viewport...
+    uint64_t uniformUploads = 0;
+    uint64_t objectsCreated = 0;  // Buffers, textures, shaders, queries...
+  };
+
+  // Loader for gladLoadGLLoader / GLExtensions::Load. Functions the engine
+  // doesn't use come back null, as from a driver that lacks them.
+  static void* GetProcAddress(const char* name);
+
+  // Stands in for an SDL_GLContext; the calls work from any thread
+  static void* GetContext();
+
+  // Closes the frame's counters, in place of a buffer swap
+  static void EndFrame();
+
+  static Stats GetLastFrame();
+  static Stats GetTotals();
+  static void PrintReport();
+};
+
+#endif // NULLGL_H
@@ -0,0 +1,84 @@
+#ifndef OCCLUSIONCULLING_H
+#define OCCLUSIONCULLING_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <SDL2/SDL.h>
+
+#include "GameObject.h"
+#include "Shader.h"
+
+// Hardware occlusion culling in the style of CHC++ (Coherent Hierarchical
+// Culling). Visibility from previous frames is reused so the CPU never waits
+// on a query: objects that were visible are drawn and only re-tested every few
+// frames, objects that were hidden are skipped and tested with a cheap
+// bounding box query once everything visible has been drawn. Results are read
+// back whenever the GPU has them ready.
+class OcclusionCulling {
+public:
+  struct Stats {
+    int objectsTested = 0;
+    int objectsCulled = 0;
+    int queriesIssued = 0;
+    int resultsReceived = 0;
+    int queriesPending = 0;
+    float averageLatencyMs = 0.0f;
+    float averageLatencyFrames = 0.0f;
+  };
+
+  static void Init(bool enabled);
+  static void Shutdown();
+
+  static void SetEnabled(bool enabled);
+  static bool IsEnabled();
+
+  static void SetCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos);
+
+  // Draws the render queue front to back, skipping objects known to be hidden
+  static void RenderQueue(const std::vector<std::shared_ptr<GameObject>>& queue, GLuint shaderProgram, GLint modelLoc);
+
+  static const Stats& GetStats();
+
+  // Lua accessors for the last frame's stats
+  static int GetCulledCount();
+  static int GetQueryCount();
+  static float GetQueryLatency();
+private:
+  struct ObjectState {
+    bool visible = true;
+    GLuint query = 0;
+    bool queryPending = false;
+    int issuedFrame = 0;
+    Uint64 issuedTicks = 0;
+    int lastQueryFrame = -1000;
+    int lastSeenFrame = 0;
+    int jitter = 0;
+  };
+
+  static void PollResults();
+  static void BeginQuery(ObjectState& state);
+  static void EndQuery();
+  static void EvictStaleObjects();
+
+  static std::atomic<bool> enabled;
+  static int frame;
+  static GLenum queryTarget;
+
+  static glm::mat4 view;
+  static glm::mat4 projection;
+  static glm::vec3 cameraPos;
+
+  static std::shared_ptr<Shader> boundsShader;
+  static GLuint boundsVAO, boundsVBO, boundsEBO;
+
+  static std::unordered_map<uint64_t, ObjectState> objects;
+  static Stats stats;
+};
+
+#endif // OCCLUSIONCULLING_H
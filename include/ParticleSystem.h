@@ -0,0 +1,110 @@
+#ifndef PARTICLESYSTEM_H
+#define PARTICLESYSTEM_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "SimdMath.h"
+#include "StreamBuffer.h"
+
+class ParticleSystemComponent;
+
+// One component's particles as drawn this frame: 8 floats per particle
+// (x, y, z, size, r, g, b, a), copied out so the render thread owns them
+struct ParticleBatch {
+  std::vector<float> instances;
+  int count = 0;
+  bool additive = false;
+};
+
+// A GPU system's settings for one frame. Its particles live in a fixed pool
+// of capacity slots on the GPU; dead slots from spawnStart onwards
+// (wrapping) are respawned, spawnCount of them at most.
+struct GpuParticleEmitter {
+  uint64_t id = 0;
+  int capacity = 0;
+  int spawnStart = 0;
+  int spawnCount = 0;
+  int seed = 0;
+  glm::vec3 origin = glm::vec3(0.0f);
+  glm::vec3 axis = glm::vec3(0.0f, 1.0f, 0.0f);
+  glm::vec3 tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+  glm::vec3 bitangent = glm::vec3(0.0f, 0.0f, 1.0f);
+  float cosSpread = 1.0f;
+  glm::vec2 lifetime = glm::vec2(1.0f);  // min, max
+  glm::vec2 speed = glm::vec2(1.0f);     // min, max
+  ParticleParams params;
+  bool additive = false;
+};
+
+// Simulates every ParticleSystemComponent on the main thread and draws them
+// on the render thread. Big systems are split into chunks that run on the
+// JobSystem's workers; the integration itself goes through SimdMath.
+//
+// GPU systems are stepped on the render thread instead, by a vertex shader
+// whose outputs are captured with transform feedback into the other of two
+// buffers. Spawning and death happen in the same shader, so nothing is ever
+// read back.
+class ParticleSystem {
+public:
+  // Needs a current context
+  static void Init();
+  static void Shutdown();
+
+  static void Register(ParticleSystemComponent* system);
+  static void Unregister(ParticleSystemComponent* system);
+
+  // Steps every enabled CPU system and fills one batch per system with
+  // particles; GPU systems just get this frame's emitter settings
+  static void Update(float deltaTime, std::vector<ParticleBatch>& batches, std::vector<GpuParticleEmitter>& emitters);
+  // Steps the GPU systems, then draws everything. Expects the scene target
+  // bound with depth from the opaque pass.
+  static void Render(const std::vector<ParticleBatch>& batches, const std::vector<GpuParticleEmitter>& emitters, const glm::mat4& view, const glm::mat4& projection);
+private:
+  struct Chunk {
+    ParticleSystemComponent* system;
+    ParticleBatch* batch;
+    int begin;
+    int end;
+  };
+
+  // A GPU system's pool, twice over: one buffer is read while the other is
+  // written, then they swap
+  struct GpuPool {
+    GLuint buffers[2] = { 0, 0 };
+    GLuint updateVAOs[2] = { 0, 0 };
+    GLuint drawVAOs[2] = { 0, 0 };
+    int current = 0;
+    int capacity = 0;
+    int lastFrame = 0;
+  };
+
+  static void RunChunk(const Chunk& chunk, float deltaTime);
+
+  static GpuPool& GetPool(const GpuParticleEmitter& emitter);
+  static void CreatePool(GpuPool& pool, int capacity);
+  static void DestroyPool(GpuPool& pool);
+  static void SimulateGpu(const GpuParticleEmitter& emitter, GpuPool& pool);
+  static void EvictStalePools();
+
+  static std::vector<ParticleSystemComponent*> systems;
+  static std::vector<Chunk> chunks;
+  static std::shared_ptr<Shader> shader;
+  static GLuint vao;
+  static GLuint quadVBO;
+  static std::unique_ptr<StreamBuffer> instanceStream;
+
+  // Render thread only
+  static std::shared_ptr<Shader> updateShader;
+  static std::shared_ptr<Shader> gpuDrawShader;
+  static std::unordered_map<uint64_t, GpuPool> gpuPools;
+  static int frame;
+};
+
+#endif // PARTICLESYSTEM_H
@@ -0,0 +1,123 @@
+#ifndef PARTICLESYSTEMCOMPONENT_H
+#define PARTICLESYSTEMCOMPONENT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Component.h"
+
+class ParticleSystem;
+struct GpuParticleEmitter;
+
+// Emits particles from its actor's Transform (or from offset, if the actor
+// has none). Particles are simulated in C++ by ParticleSystem and drawn as
+// camera-facing quads, one instanced draw per component. Each attribute is
+// kept in its own array so the update runs several particles per instruction.
+// With gpu set, particles are simulated on the GPU instead and never come
+// back to the CPU, which suits effects with millions of them.
+class ParticleSystemComponent : public Component {
+public:
+  ParticleSystemComponent();
+  // Copies get the same settings and an empty pool
+  ParticleSystemComponent(const ParticleSystemComponent& other);
+  ParticleSystemComponent& operator=(const ParticleSystemComponent&) = delete;
+  ~ParticleSystemComponent();
+
+  // Particles per second
+  float GetRate() const { return rate; }
+  void SetRate(float value) { rate = std::max(value, 0.0f); }
+
+  int GetMaxParticles() const { return maxParticles; }
+  void SetMaxParticles(int value);
+
+  void SetLifetime(float min, float max);
+  void SetSpeed(float min, float max);
+  // Particles leave along direction (relative to the Transform), spread
+  // randomly up to spread degrees off it
+  glm::vec3 GetDirection() const { return direction; }
+  void SetDirection(const glm::vec3& value) { direction = value; }
+  float GetSpread() const { return spread; }
+  void SetSpread(float degrees) { spread = degrees; }
+
+  glm::vec3 GetGravity() const { return gravity; }
+  void SetGravity(const glm::vec3& value) { gravity = value; }
+  float GetDrag() const { return drag; }
+  void SetDrag(float value) { drag = std::max(value, 0.0f); }
+
+  // Size and color are blended from start to end over each particle's life
+  void SetSize(float start, float end);
+  void SetStartColor(float r, float g, float b, float a) { startColor = glm::vec4(r, g, b, a); }
+  void SetEndColor(float r, float g, float b, float a) { endColor = glm::vec4(r, g, b, a); }
+
+  glm::vec3 GetOffset() const { return offset; }
+  void SetOffset(const glm::vec3& value) { offset = value; }
+
+  // Additive suits fire and sparks, otherwise particles are alpha blended
+  bool IsAdditive() const { return additive; }
+  void SetAdditive(bool value) { additive = value; }
+
+  bool IsGpu() const { return gpu; }
+  void SetGpu(bool value);
+
+  // Spawns count particles on the next update, on top of the rate
+  void Emit(int count) { pendingEmit += std::max(count, 0); }
+  void Clear() { count = 0; }
+  // Always 0 for GPU systems, their particles are never read back
+  int GetParticleCount() const { return count; }
+
+  void SetEnabled(bool value) { enabled = value; }
+  bool GetEnabled() const { return enabled; }
+private:
+  friend class ParticleSystem;
+
+  // Removes dead particles and spawns this frame's new ones
+  void Spawn(float deltaTime);
+  // Fills in this frame's settings for a GPU system
+  void SpawnGpu(float deltaTime, GpuParticleEmitter& emitter);
+  // How many particles the rate and Emit() ask for this frame
+  int TakeSpawnCount(float deltaTime);
+  void Resize(int capacity);
+  // Where particles start, and the cone they leave in as an axis with two
+  // perpendicular vectors around it
+  void GetEmitterFrame(glm::vec3& origin, glm::vec3& axis, glm::vec3& tangent, glm::vec3& bitangent) const;
+
+  float rate = 100.0f;
+  int maxParticles = 10000;
+  float lifetimeMin = 1.0f;
+  float lifetimeMax = 2.0f;
+  float speedMin = 1.0f;
+  float speedMax = 2.0f;
+  glm::vec3 direction = glm::vec3(0.0f, 1.0f, 0.0f);
+  float spread = 15.0f;
+  glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+  float drag = 0.0f;
+  float startSize = 0.1f;
+  float endSize = 0.1f;
+  glm::vec4 startColor = glm::vec4(1.0f);
+  glm::vec4 endColor = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+  glm::vec3 offset = glm::vec3(0.0f);
+  bool additive = false;
+  bool gpu = false;
+
+  // Identifies the system's buffers on the render thread
+  uint64_t gpuId;
+  // Next slot of the GPU pool to spawn into
+  int gpuCursor = 0;
+
+  float emitAccumulator = 0.0f;
+  int pendingEmit = 0;
+  std::mt19937 random;
+
+  int count = 0;
+  std::vector<float> positionX, positionY, positionZ;
+  std::vector<float> velocityX, velocityY, velocityZ;
+  std::vector<float> age, invLifetime;
+  std::vector<float> size;
+  std::vector<float> colorR, colorG, colorB, colorA;
+};
+
+#endif // PARTICLESYSTEMCOMPONENT_H
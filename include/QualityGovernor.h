@@ -0,0 +1,70 @@
+#ifndef QUALITYGOVERNOR_H
+#define QUALITYGOVERNOR_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include <glad/glad.h>
+
+// Keeps GPU frame time near a target budget. The scene is rendered into an
+// offscreen target at a fraction of the window resolution; when the GPU runs
+// over budget the governor lowers that fraction first, then the number of
+// shaded lights, then raises the LOD bias. With headroom it restores them in
+// the opposite order. GPU time comes from timer queries read back a few frames
+// late so measuring never stalls the CPU. Frames are measured and adjusted on
+// the thread that renders; the Lua accessors may be called from another.
+class QualityGovernor {
+public:
+  struct Stats {
+    float gpuFrameMs = 0.0f;
+    float renderScale = 1.0f;
+    float lodBias = 0.0f;
+    int lightLimit = 0;
+    int adjustments = 0;
+    std::string lastDecision = "none";
+  };
+
+  static void Init(bool enabled, float targetFrameMs, float minScale, float maxScale, float initialScale);
+  static void Shutdown();
+
+  // Bracket everything the GPU does for a frame
+  static void BeginFrame();
+  static void EndFrame();
+
+  static void SetEnabled(bool enabled);
+  static bool IsEnabled();
+  static void SetTargetFrameTime(float ms);
+
+  static Stats GetStats();
+
+  // Lua accessors
+  static float GetGpuFrameTime();
+  static float GetRenderScale();
+  static void SetRenderScale(float scale);
+  static float GetLodBias();
+  static int GetLightLimit();
+  static std::string GetLastDecision();
+private:
+  static void ReadBackTimings();
+  static void Adjust();
+  static void Decide(const std::string& decision);
+
+  static const int QUERY_RING_SIZE = 4;
+
+  static std::atomic<bool> enabled;
+  static std::atomic<float> targetFrameMs;
+  static float minScale;
+  static float maxScale;
+
+  static GLuint queries[QUERY_RING_SIZE];
+  static bool queryIssued[QUERY_RING_SIZE];
+  static int queryIndex;
+  static bool haveTiming;
+  static int framesSinceAdjust;
+
+  static Stats stats;
+  static std::mutex statsMutex;
+};
+
+#endif // QUALITYGOVERNOR_H
@@ -0,0 +1,62 @@
+#ifndef RENDERCOMMANDQUEUE_H
+#define RENDERCOMMANDQUEUE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GameObject.h"
+
+// One mesh draw with everything resolved up front
+struct RenderCommand {
+  uint64_t sortKey;
+  glm::mat4 modelMatrix;
+  glm::mat3 normalMatrix;
+  glm::vec3 color;
+  float fadeOut;
+  glm::vec4 lightmapRect;
+  const Mesh* mesh;
+  const Material* material;
+};
+
+// Two-phase opaque rendering. Build runs on the job system: each batch of
+// objects is frustum culled and turned into commands in its own buffer, with
+// no GL calls and no shared state. Execute runs on the GL thread: it merges
+// the buffers, sorts by material contents then mesh then depth, and issues
+// the draws, skipping material and VAO changes between neighbouring commands.
+class RenderCommandQueue {
+public:
+  struct Stats {
+    int objects = 0;
+    int culled = 0;
+    int commands = 0;
+    int materialChanges = 0;
+    int meshChanges = 0;
+    int batches = 0;
+  };
+
+  static void SetCamera(const glm::mat4& viewProjection, const glm::vec3& cameraPos);
+
+  // Objects must stay alive until Execute has run
+  static void Build(const std::vector<std::shared_ptr<GameObject>>& queue);
+  static void Execute(GLuint shaderProgram, GLint modelLoc);
+
+  static const Stats& GetStats();
+private:
+  static void RecordBatch(const std::vector<std::shared_ptr<GameObject>>& queue, int begin, int end, std::vector<RenderCommand>& out, int& culled);
+
+  static glm::mat4 viewProjection;
+  static glm::vec4 frustumPlanes[6];
+  static glm::vec3 cameraPos;
+
+  static std::vector<std::vector<RenderCommand>> batchBuffers;
+  static std::vector<int> batchCulled;
+  static std::vector<RenderCommand> merged;
+
+  static Stats stats;
+};
+
+#endif // RENDERCOMMANDQUEUE_H
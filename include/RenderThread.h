@@ -0,0 +1,72 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GameObject.h"
+#include "LightComponent.h"
+#include "ParticleSystem.h"
+#include "TextDB.h"
+#include "ImageDB.h"
+#include "DebugDraw.h"
+#include "ImpostorSystem.h"
+#include "ShadowSystem.h"
+
+// Everything the renderer needs for one frame, captured at the end of that
+// frame's simulation. Once submitted the packet belongs to the render thread;
+// the main thread keeps nothing that points into it.
+struct FramePacket {
+  int frameNumber = 0;
+  glm::mat4 view = glm::mat4(1.0f);
+  glm::mat4 projection = glm::mat4(1.0f);
+  glm::vec3 cameraPos = glm::vec3(0.0f);
+  std::vector<ShaderLight> lights;
+  std::vector<std::shared_ptr<GameObject>> objects;
+  std::vector<ParticleBatch> particles;
+  std::vector<GpuParticleEmitter> gpuParticles;
+  SpriteFrame sprites;
+  TextFrame text;
+  DebugFrame debug;
+  ImpostorFrame impostors;
+  ShadowFrame shadows;
+  // Signalled once the GPU has seen every resource the main thread created
+  // up to this frame
+  GLsync uploadFence = nullptr;
+};
+
+// Runs GL submission on its own thread so frame N is drawn while the main
+// thread simulates frame N+1. The render thread owns the window's context;
+// the main thread switches to a shared upload context for any buffers or
+// textures scripts create. Packets are double buffered: one being rendered
+// and at most one waiting, so Submit blocks if the main thread gets two
+// frames ahead.
+class RenderThread {
+public:
+  // Call on the main thread with the window's context current. Returns false
+  // (and leaves everything single threaded) if no upload context can be made.
+  static bool Start(std::function<void(FramePacket&)> renderFrame);
+  // Joins the thread and makes the window's context current on the caller again
+  static void Stop();
+  static bool IsRunning();
+
+  static void Submit(FramePacket&& packet);
+private:
+  static void ThreadLoop();
+
+  static std::thread thread;
+  static std::mutex mutex;
+  static std::condition_variable condition;
+  static std::unique_ptr<FramePacket> pending;
+  static std::function<void(FramePacket&)> renderFrame;
+  static bool running;
+};
+
+#endif // RENDERTHREAD_H
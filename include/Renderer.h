@@ -7,6 +7,8 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
+#include <atomic>
+
 #include <SDL2/SDL.h>
 
 #include "glm/glm.hpp"
@@ -14,6 +16,18 @@
 
 class Renderer {
 public:
+    // Window: an SDL window and its GL context.
+    // Headless: no window or events; frames go to an offscreen framebuffer
+    // through an EGL context (see HeadlessContext).
+    // Null: no window and no GPU; GL calls are only counted (see NullGL).
+    enum class Backend { Window, Headless, Null };
+    // Set before LoadRenderer
+    static void SetBackend(Backend backend);
+    static Backend GetBackend();
+    static bool HasWindow();
+    // What the scene is finally drawn into: the window, or the headless target
+    static GLuint GetDefaultFramebuffer();
+
     static void LoadRenderer(int x_res, int y_res, int r, int g, int b, glm::vec2 cam_size, float z, glm::vec2 cam_pos);
     
     static void RenderWindow(const std::string& title);
@@ -22,6 +36,20 @@ public:
     
     static void ClearScreen();
     static void SwapBuffers();
+
+    // Scene rendering goes through an offscreen target when one exists, so it
+    // can be drawn below window resolution and upscaled in EndScene.
+    // InitSceneTarget may be called from any thread; the target itself is
+    // created by the next BeginScene, on the thread that renders.
+    static void InitSceneTarget(float maxScale);
+    static bool HasSceneTarget();
+    static void BeginScene();
+    static void EndScene();
+    static void SetRenderScale(float scale);
+    static float GetRenderScale();
+
+    // Clears to the clear color and draws a simple progress bar, then presents
+    static void DrawLoadingScreen(float progress);
     
     static void DestroyScreen();
 
@@ -55,6 +83,15 @@ public:
 
     static void Cleanup();
 
+    // Second context sharing buffers, textures and shaders with the main one,
+    // so the main thread can keep creating resources while another thread
+    // owns the main context. Must be created while the main context is
+    // current; it is left current on the calling thread.
+    static bool CreateUploadContext();
+    static void DestroyUploadContext();
+    static void MakeRenderContextCurrent();
+    static void ReleaseContext();
+
     static SDL_GLContext GetContext() { return glContext; };
 
     static SDL_Window* window;
@@ -74,6 +111,22 @@ private:
     static float cameraPitch;
 
     static SDL_GLContext glContext;
+    static SDL_GLContext uploadContext;
+    static Backend backend;
+
+    static void CreateSceneTarget();
+
+    // Offscreen scene target, allocated once at the largest scale we allow
+    static std::atomic<bool> sceneTargetRequested;
+    static GLuint sceneFBO;
+    static GLuint sceneColor;
+    static GLuint sceneDepth;
+    static int sceneTargetWidth;
+    static int sceneTargetHeight;
+    static int sceneWidth;
+    static int sceneHeight;
+    static std::atomic<float> renderScale;
+    static std::atomic<float> maxRenderScale;
 };
 
 #endif
@@ -26,12 +26,24 @@ public:
     static void LoadActorTemplate(const std::string& templateFp, const std::string& template_name);
     static void LoadComponent(const std::string& componentKey, const std::string& componentType, std::map<std::string, std::shared_ptr<Component>>& components, const rapidjson::Value& componentData, const std::shared_ptr<Actor>& actor);
     void Update();
+    void StartPendingComponents();
+    void FixedUpdate();
     static void TemplateToSpawn(const std::string& template_name);
     static luabridge::LuaRef InstantiateActor(const std::string& template_name);
     static void RemoveActor(const luabridge::LuaRef& actor);
+    static void ResolveTransformParent(const std::shared_ptr<Actor>& actor);
     static std::string GetCurrent();
 
     ~Scene() {
+        // Actors and components can outlive the scene through references to
+        // each other, so make sure nothing left behind keeps simulating
+        for (const auto& actor : scene_actors) {
+            if (actors_to_keep.find(actor) == actors_to_keep.end()) {
+                for (const auto& componentPair : actor->components) {
+                    componentPair.second->destroyed = true;
+                }
+            }
+        }
         scene_actors.clear();
         new_actors_to_add.clear();
         actors_to_remove.clear();
@@ -39,6 +51,7 @@ public:
         onStartComponents.clear();
         onUpdateComponents.clear();
         onLateUpdateComponents.clear();
+        onFixedUpdateComponents.clear();
 
         actor_name_map.clear();
 
@@ -51,6 +64,9 @@ public:
                 if (component->hasLateUpdate) {
                     onLateUpdateComponents.push_back(component);
                 }
+                if (component->hasFixedUpdate) {
+                    onFixedUpdateComponents.push_back(component);
+                }
             }
             actor_name_map[actor->name].push_back(actor);
         }
@@ -97,6 +113,7 @@ private:
     static std::vector<std::shared_ptr<Component>> onStartComponents;
     static std::vector<std::shared_ptr<Component>> onUpdateComponents;
     static std::vector<std::shared_ptr<Component>> onLateUpdateComponents;
+    static std::vector<std::shared_ptr<Component>> onFixedUpdateComponents;
     static std::vector<std::shared_ptr<Component>> onDestroyComponents;
 
     static std::unordered_map<std::string, std::vector<std::shared_ptr<Actor>>> actor_name_map;
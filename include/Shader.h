@@ -5,15 +5,21 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 class Shader {
   private:
-    GLuint ID;
+    GLuint ID = 0;
+
+    // Inserts "#define X" lines right after the #version directive
+    static std::string InjectDefines(const std::string& code, const std::vector<std::string>& defines);
+    bool CompileAndLink(const char* vShaderCode, const char* fShaderCode, const std::vector<std::string>& feedbackVaryings);
   
   public:
-    Shader(const char* vertexPath, const char* fragmentPath);
+    // feedbackVaryings are vertex outputs captured by transform feedback, interleaved in that order
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = {}, const std::vector<std::string>& feedbackVaryings = {});
     ~Shader();
     
     void Use() const;
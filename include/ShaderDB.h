@@ -0,0 +1,51 @@
+#ifndef SHADERDB_H
+#define SHADERDB_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+#include "Shader.h"
+
+// Owns every shader program the engine uses. Programs are keyed by their
+// source files plus the list of #defines (a "permutation"), and linked
+// programs are persisted to disk with glGetProgramBinary so later launches
+// can skip compiling and linking entirely.
+class ShaderDB {
+public:
+  static void Init(bool useBinaryCache, const std::string& cacheDirectory);
+  static void Shutdown();
+
+  // Returns the program for a permutation, building it on first use
+  static std::shared_ptr<Shader> GetShader(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines = {}, const std::vector<std::string>& feedbackVaryings = {});
+
+  // Permutations registered here are built up front by WarmUp()
+  static void RegisterPermutation(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines = {});
+  static void WarmUp();
+
+  // Program binary cache (used by Shader while linking)
+  static uint64_t HashProgram(const std::string& vertexCode, const std::string& fragmentCode, const std::vector<std::string>& defines, const std::vector<std::string>& feedbackVaryings = {});
+  static bool LoadProgramBinary(GLuint program, uint64_t key);
+  static void SaveProgramBinary(GLuint program, uint64_t key);
+private:
+  struct Permutation {
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> defines;
+  };
+
+  static std::string PermutationKey(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines, const std::vector<std::string>& feedbackVaryings = {});
+  static std::string BinaryPath(uint64_t key);
+
+  static bool useBinaryCache;
+  static std::string cacheDir;
+  static std::string driverSignature;
+  static std::unordered_map<std::string, std::shared_ptr<Shader>> shaders;
+  static std::vector<Permutation> permutations;
+};
+
+#endif // SHADERDB_H
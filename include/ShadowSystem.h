@@ -0,0 +1,114 @@
+#ifndef SHADOWSYSTEM_H
+#define SHADOWSYSTEM_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+
+class GameObject;
+struct ShaderLight;
+
+// One frame's shadow casters and where each shadow map wants to be
+struct ShadowFrame {
+  static const int MAX_CASCADES = 4;
+  static const int MAX_SPOT_SHADOWS = 4;
+
+  std::vector<std::shared_ptr<GameObject>> staticCasters;
+  std::vector<std::shared_ptr<GameObject>> dynamicCasters;
+  // Changes whenever a static caster is added, removed or moved
+  uint64_t staticKey = 0;
+
+  // Index into the frame's lights of the directional light the cascades
+  // belong to, -1 for none
+  int cascadeLight = -1;
+  int cascadeCount = 0;
+  glm::mat4 cascades[MAX_CASCADES];
+  // View space distance each cascade reaches out to
+  float cascadeSplits[MAX_CASCADES] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+  int spotCount = 0;
+  int spotLights[MAX_SPOT_SHADOWS] = { -1, -1, -1, -1 };
+  glm::mat4 spots[MAX_SPOT_SHADOWS];
+};
+
+// Cascaded shadow maps for the first directional light and a shadow map for
+// each of the first few spot lights.
+//
+// Objects marked static are rendered into a cached copy of each map, redone
+// only when a static object comes, goes or moves, or the map itself moves.
+// Every update starts from that copy and draws just the dynamic objects on
+// top. Cascades are placed on a grid in light space so the camera has to move
+// a fair way before one shifts, and past the first they refresh their dynamic
+// objects every few frames rather than every frame.
+class ShadowSystem {
+public:
+  // resolution 0 turns shadows off; spot maps are half the cascades' size
+  static void Init(int resolution, int cascades, float distance, int farCascadeInterval, int spotShadows);
+  static void Shutdown();
+
+  static bool IsEnabled();
+
+  // Main thread, once world bounds are up to date and before impostors take
+  // far models out of objects
+  static void BuildFrame(ShadowFrame& frame, const std::vector<std::shared_ptr<GameObject>>& objects, const std::vector<ShaderLight>& lights, const glm::mat4& view, const glm::mat4& projection);
+  // Render thread, before the scene target is bound
+  static void Render(const ShadowFrame& frame);
+  // Render thread, with the scene shader in use. Always sets the samplers,
+  // so they never share a unit with a material's textures.
+  static void Apply(GLuint program, const ShadowFrame& frame);
+
+  // Caster draws so far against what redrawing every map every frame would
+  // have cost
+  static std::string GetReport();
+
+  // Texture units the scene shader samples the maps from
+  static const int CASCADE_UNIT = 6;
+  static const int SPOT_UNIT = 7;
+private:
+  // What a map layer last held
+  struct MapState {
+    bool valid = false;
+    glm::mat4 matrix = glm::mat4(1.0f);
+    uint64_t staticKey = 0;
+    int dynamicCount = 0;
+  };
+
+  static void CreateMaps();
+  static void DeleteMaps();
+  static void UpdateMap(MapState& state, GLuint cache, GLuint map, int layer, int size, const glm::mat4& matrix, bool due, const ShadowFrame& frame);
+  static int DrawCasters(const std::vector<const GameObject*>& casters, const glm::mat4& matrix);
+
+  static int resolution;
+  static int cascadeCount;
+  static float distance;
+  static int farInterval;
+  static int spotCount;
+
+  // Render thread
+  static std::shared_ptr<Shader> shader;
+  static GLint matrixLoc;
+  static GLint modelLoc;
+  // Depth array textures: the maps sampled and the static-only copies
+  static GLuint cascadeMaps;
+  static GLuint cascadeCache;
+  static GLuint spotMaps;
+  static GLuint spotCache;
+  static GLuint fbo;
+  static GLuint copyFBO;
+  static MapState cascadeStates[ShadowFrame::MAX_CASCADES];
+  static MapState spotStates[ShadowFrame::MAX_SPOT_SHADOWS];
+  static uint64_t frameCounter;
+
+  static std::atomic<uint64_t> casterDraws;
+  static std::atomic<uint64_t> naiveDraws;
+  static std::atomic<uint64_t> staticRebuilds;
+};
+
+#endif // SHADOWSYSTEM_H
@@ -0,0 +1,114 @@
+#ifndef SIMDMATH_H
+#define SIMDMATH_H
+
+#include <string>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Position, rotation and scale of many transforms as separate float arrays,
+// one value per transform in each
+struct TransformStreams {
+  const float* positionX;
+  const float* positionY;
+  const float* positionZ;
+  const float* rotationX;  // Unit quaternion
+  const float* rotationY;
+  const float* rotationZ;
+  const float* rotationW;
+  const float* scaleX;
+  const float* scaleY;
+  const float* scaleZ;
+};
+
+// One particle pool as separate float arrays, one value per particle in each
+struct ParticleStreams {
+  float* positionX;
+  float* positionY;
+  float* positionZ;
+  float* velocityX;
+  float* velocityY;
+  float* velocityZ;
+  float* age;          // Seconds since it was emitted
+  float* invLifetime;  // 1 / lifetime in seconds
+  float* size;
+  float* colorR;
+  float* colorG;
+  float* colorB;
+  float* colorA;
+};
+
+// What IntegrateParticles applies to every particle of a pool
+struct ParticleParams {
+  float deltaTime;
+  glm::vec3 gravity;
+  float drag;  // Fraction of velocity lost per second
+  float startSize;
+  float endSize;
+  glm::vec4 startColor;
+  glm::vec4 endColor;
+};
+
+// One triangle set up for rasterizing into a depth buffer, in pixels. Its
+// edge functions a[i] * x + b[i] * y + c[i] are all positive inside and its
+// depth is zA * x + zB * y + zC.
+struct DepthTriangle {
+  float a[3];
+  float b[3];
+  float c[3];
+  float zA;
+  float zB;
+  float zC;
+};
+
+// Batched matrix math for the transform, culling and draw paths. Each kernel
+// has a scalar version and SSE4.1 / AVX2 versions that work on 4 / 8 objects
+// at a time; Init picks the best one the CPU supports. All levels give the
+// same results up to float rounding.
+class SimdMath {
+public:
+  enum class Level { Scalar, SSE41, AVX2 };
+
+  // "auto" picks the best supported level; "scalar", "sse4.1" or "avx2"
+  // force one (falling back if the CPU lacks it)
+  static void Init(const std::string& requested = "auto");
+  static Level GetLevel();
+  static const char* GetLevelName(Level level);
+
+  // out[i] = translate * rotate * scale for transform i
+  static void ComposeTRS(int count, const TransformStreams& in, glm::mat4* out);
+
+  // Inverse transpose of each matrix's upper 3x3, for transforming normals
+  static void NormalMatrices(int count, const glm::mat4* models, glm::mat3* out);
+
+  // World-space AABB of each local box under its matrix
+  static void TransformBounds(int count, const glm::mat4* models, const glm::vec3* localMin, const glm::vec3* localMax, glm::vec3* outMin, glm::vec3* outMax);
+
+  // out = a * b; out may alias a or b
+  static void Multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out);
+
+  // Moves particles [begin, end) along their velocity under gravity and
+  // drag, ages them, and sets their size and color from how far through
+  // their life they are. Takes a range so big pools can be split over jobs.
+  static void IntegrateParticles(int begin, int end, const ParticleStreams& streams, const ParticleParams& params);
+
+  // Keeps the nearer depth at every pixel center of columns [minX, maxX]
+  // and rows [minY, maxY] that the triangle covers. Kernels step a whole
+  // group of 8 / 4 pixels at a time from minX rounded down, so rows must be
+  // padded to a multiple of 8; pixels the triangle misses keep their depth.
+  // The SSE2 kernel stands in for scalar wherever the compiler targets SSE2.
+  static void RasterizeDepth(const DepthTriangle& tri, int minX, int maxX, int minY, int maxY, float* depth, int stride);
+
+  // Rotation X, then Y, then Z (as in rotateX * rotateY * rotateZ) as a quaternion
+  static glm::quat EulerToQuat(const glm::vec3& degrees);
+
+  // Times every supported level against the plain glm code it replaces and
+  // prints the results
+  static void RunBenchmarks(int count = 10000);
+private:
+  static void SelectLevel(Level level);
+
+  static Level level;
+};
+
+#endif // SIMDMATH_H
@@ -0,0 +1,97 @@
+#ifndef SOFTWAREOCCLUSION_H
+#define SOFTWAREOCCLUSION_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+#include <glm/glm.hpp>
+
+#include "GameObject.h"
+#include "JobSystem.h"
+
+// CPU occlusion culling that needs no GPU readback. Occluder models (a low
+// poly "<name>_occluder.obj" proxy next to the model, or the model itself when
+// marked from Lua) are rasterized into a small depth buffer on the worker
+// threads, eight pixels at a time with AVX2 or four with SSE2 depending on
+// the simd level (see SimdMath::RasterizeDepth). Every object in the render
+// queue is then tested against it, using a per-tile max depth to reject
+// quickly, before any draw is issued.
+//
+// In async mode the occluders queued this frame are rasterized while the next
+// frame's scripts run and that frame is tested against them, trading one frame
+// of latency for taking the work off the critical path. When the camera moves
+// more than a tile's worth on screen between the two, that frame is not
+// culled at all rather than tested against a buffer that no longer lines up.
+class SoftwareOcclusion {
+public:
+  struct Stats {
+    int occluders = 0;
+    int triangles = 0;
+    int objectsTested = 0;
+    int objectsCulled = 0;
+    float rasterMs = 0.0f;
+  };
+
+  static void Init(bool enabled, bool async, int width, int height);
+  static void Shutdown();
+
+  static void SetEnabled(bool enabled);
+  static bool IsEnabled();
+
+  // Models registered here use their own meshes as occluders
+  static void SetOccluderModel(const std::string& name);
+  static bool IsOccluderModel(const std::string& name);
+
+  static void SetCamera(const glm::mat4& viewProjection);
+
+  // Copies the objects of the queue that may be visible into outVisible
+  static void Cull(const std::vector<std::shared_ptr<GameObject>>& queue, std::vector<std::shared_ptr<GameObject>>& outVisible);
+
+  static const Stats& GetStats();
+  static int GetCulledCount();
+private:
+  struct Occluder {
+    std::shared_ptr<const std::vector<glm::vec3>> triangles;
+    glm::mat4 model;
+  };
+
+  struct ScreenTriangle {
+    glm::vec3 v[3]; // x, y in pixels, z in [0, 1]
+  };
+
+  static void GatherOccluders(const std::vector<std::shared_ptr<GameObject>>& queue);
+  static void Kick();
+  static void Rasterize();
+  static void RasterizeTriangle(const ScreenTriangle& tri, int rowBegin, int rowEnd);
+  static bool CameraMoved();
+  static bool IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& viewProjection);
+
+  static std::atomic<bool> enabled;
+  static bool async;
+  static int width;
+  static int height;
+  static int tilesX;
+  static int tilesY;
+
+  static std::vector<float> depth;
+  static std::vector<float> tileMaxDepth;
+
+  static glm::mat4 viewProjection;
+
+  // Occluders waiting to be rasterized and the camera they're rasterized with
+  static std::vector<Occluder> pendingOccluders;
+  static glm::mat4 pendingViewProjection;
+
+  // Camera the depth buffer currently holds
+  static glm::mat4 rasterViewProjection;
+  static bool hasDepth;
+
+  static std::shared_ptr<JobCounter> rasterJob;
+  static std::unordered_set<std::string> occluderModels;
+  static Stats stats;
+};
+
+#endif // SOFTWAREOCCLUSION_H
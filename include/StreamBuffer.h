@@ -0,0 +1,82 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// A GL buffer for data that's rewritten every frame, split into three
+// segments used in turn so the CPU fills one while the GPU may still be
+// reading the other two. Each segment is fenced when its frame ends and only
+// waited on when the ring comes back round to it.
+//
+// With ARB_buffer_storage the buffer is mapped once, persistently, and writes
+// are plain copies. Without it each write maps just its range unsynchronized;
+// if the GPU is still on a segment when it comes round again, the whole
+// buffer is orphaned rather than waited on.
+//
+// Render thread only, apart from GetTotals and GetReport. Created lazily on the first write, so it can be
+// declared before a context exists.
+class StreamBuffer {
+public:
+  struct Stats {
+    uint64_t bytesWritten = 0;
+    uint64_t stalls = 0;    // Times a write had to wait for the GPU
+    double stallMs = 0.0;
+    uint64_t orphans = 0;   // Times the buffer was swapped out instead
+    uint64_t grows = 0;     // Times a frame didn't fit and it was reallocated
+  };
+
+  // segmentSize is one frame's worth; it doubles whenever a frame needs more
+  StreamBuffer(GLenum target, size_t segmentSize);
+  ~StreamBuffer();
+  StreamBuffer(const StreamBuffer&) = delete;
+  StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+  // Copies data into this frame's segment and returns where it landed in
+  // GetBuffer(), a multiple of alignment. The buffer is left bound to the
+  // target. Growing replaces the buffer, so offsets from earlier in the frame
+  // are only good for draws already issued.
+  size_t Write(const void* data, size_t bytes, size_t alignment = 4);
+
+  GLuint GetBuffer() const { return buffer; }
+  bool IsPersistent() const { return mapped != nullptr; }
+  const Stats& GetStats() const { return stats; }
+
+  // Fences every buffer written this frame and moves it to its next
+  // segment. Call once the frame's draws have been issued.
+  static void EndFrame();
+  // Summed over every buffer, including ones since destroyed, as of the
+  // last EndFrame. Safe from any thread.
+  static Stats GetTotals();
+  static std::string GetReport();
+private:
+  static const int SEGMENTS = 3;
+
+  void Allocate(size_t newSegmentSize);
+  void Release();
+  void WaitForSegment();
+
+  GLenum target;
+  GLuint buffer = 0;
+  size_t segmentSize;
+  uint8_t* mapped = nullptr;
+
+  int segment = 0;
+  size_t cursor = 0;
+  bool written = false;
+  GLsync fences[SEGMENTS] = { nullptr, nullptr, nullptr };
+  Stats stats;
+
+  static std::vector<StreamBuffer*> buffers;
+  static Stats retired;
+  // Totals copied out by EndFrame for other threads to read
+  static std::mutex publishedMutex;
+  static Stats published;
+};
+
+#endif // STREAMBUFFER_H
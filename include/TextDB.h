@@ -11,31 +11,114 @@
 #include <string>
 #include <iostream>
 #include <filesystem>
+#include <memory>
 #include <unordered_map>
-#include <queue>
+#include <vector>
 #include "SDL2/SDL.h"
 #include "SDL2_ttf/SDL_ttf.h"
 
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Lua/lua.hpp"
+#include "LuaBridge/LuaBridge.h"
+
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "TextureAtlas.h"
+
+// A frame's text, ready to draw: 6 vertices per glyph (x, y, u, v, color,
+// outline color, distance scale, outline width, softness) in window pixels,
+// plus the atlas rows that changed since the last frame
+struct TextFrame {
+    std::vector<float> vertices;
+    int dirtyTop = 0;
+    int dirtyRows = 0;
+    std::vector<uint8_t> dirtyPixels;
+};
+
+// Draws text queued from Lua over the finished frame. Each glyph is
+// rasterized once per font, at a fixed base size, as a signed distance field
+// into a shared atlas texture; the shader scales it to any size and adds
+// outlines and shadows. Laid out strings are cached as long as they keep
+// being drawn, so a frame's text is one vertex buffer and one draw call.
 class TextDB {
 public:
-    static void Init(SDL_Renderer* renderer);
+    // Needs a current context
+    static void Init();
     static void Shutdown();
 
-    static void LoadFont(const std::string& font_name, const std::string& file_path, int font_size);
+    static void LoadFont(const std::string& font_name, const std::string& file_path);
+    // x, y is the top left corner in window pixels; colors are 0-255
     static void Draw(const std::string& str_content, float x, float y, const std::string& font_name, int font_size, float r, float g, float b, float a);
-    static void RenderText();
+    // Draw with a table of outline, shadow and softness settings
+    static void DrawStyled(const std::string& str_content, float x, float y, const std::string& font_name, int font_size, float r, float g, float b, float a, luabridge::LuaRef style);
+
+    // Main thread: lays out everything queued this frame
+    static void BuildFrame(TextFrame& frame);
+    // Main thread: marks the whole atlas dirty in frame, for a frame capture
+    // to start from
+    static void SnapshotAtlas(TextFrame& frame);
+    // Render thread, once the scene is in the window
+    static void Render(const TextFrame& frame);
 private:
+    // Widths and offsets are in window pixels, colors 0-1
+    struct TextStyle {
+        float outlineWidth = 0.0f;
+        glm::vec4 outlineColor = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        glm::vec2 shadowOffset = glm::vec2(0.0f);
+        float shadowSoftness = 0.0f;
+        glm::vec4 shadowColor = glm::vec4(0.0f);
+        float softness = 0.0f;
+    };
+
     struct TextDrawStruct {
         std::string str_content;
         float x, y;
         std::string font_name;
         int font_size;
         float r, g, b, a;
+        TextStyle style;
     };
 
-    static SDL_Renderer* renderer;
-    static std::unordered_map<std::string, std::unordered_map<int, TTF_Font*>> fonts;
-    static std::queue<TextDrawStruct> drawQueue;
+    // Where a glyph's quad goes relative to the pen (at the top of the
+    // line) at the base size, and where it is in the atlas
+    struct Glyph {
+        float x0, y0, x1, y1;
+        float u0, v0, u1, v1;
+        int advance;
+        bool visible;
+    };
+
+    // A laid out string at the base size: x0, y0, x1, y1, u0, v0, u1, v1 per
+    // visible glyph
+    struct ShapedText {
+        std::vector<float> quads;
+        int lastUsed;
+    };
+
+    static TTF_Font* GetFont(const std::string& font_name);
+    // nullptr if the glyph didn't fit in the atlas
+    static const Glyph* GetGlyph(TTF_Font* font, Uint32 codepoint);
+    static const ShapedText* Shape(const TextDrawStruct& request);
+    static void EvictUnusedText();
+    static void AppendQuads(std::vector<float>& vertices, const ShapedText& shaped, const TextDrawStruct& request, glm::vec2 offset, const glm::vec4& color, const glm::vec4& outlineColor, float softness);
+
+    // Every size is drawn from the same font, opened at the base size
+    static std::unordered_map<std::string, TTF_Font*> fonts;
+    static std::vector<TextDrawStruct> drawQueue;
+
+    static TextureAtlas atlas;
+    static bool atlasFull;
+    static std::unordered_map<TTF_Font*, std::unordered_map<Uint32, Glyph>> glyphs;
+    static std::unordered_map<std::string, ShapedText> shapedText;
+    static int frame;
+
+    // Render thread
+    static std::shared_ptr<Shader> shader;
+    static GLuint vao;
+    static std::unique_ptr<StreamBuffer> stream;
+    static GLuint atlasTexture;
 };
 
 #endif /* TextDB_h */
@@ -0,0 +1,49 @@
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include <cstdint>
+#include <vector>
+
+// CPU copy of an atlas texture, filled shelf by shelf: images go left to
+// right along the current row and a new row starts below the tallest one
+// when they stop fitting. Nothing is ever freed on its own; Clear() empties
+// the whole atlas. The rows touched since the last TakeDirtyRows() are
+// tracked so only those need uploading.
+class TextureAtlas {
+public:
+  TextureAtlas(int width, int height, int channels);
+
+  // Finds room for a width x height image, returning false when full
+  bool Allocate(int width, int height, int& x, int& y);
+  // Copies tightly packed pixels (channels bytes each) into place
+  void Write(int x, int y, int width, int height, const uint8_t* pixels);
+  void Clear();
+
+  // Rows [top, bottom) changed since the last call; false if none did
+  bool TakeDirtyRows(int& top, int& bottom);
+
+  int GetWidth() const { return width; }
+  int GetHeight() const { return height; }
+  int GetChannels() const { return channels; }
+  const uint8_t* GetPixels() const { return pixels.data(); }
+  // Bumped by Clear(), so anything holding coordinates knows they're stale
+  int GetGeneration() const { return generation; }
+private:
+  // Gap left around every image so filtering doesn't pick up its neighbours
+  static const int PADDING = 1;
+
+  int width;
+  int height;
+  int channels;
+  std::vector<uint8_t> pixels;
+
+  int shelfX = 0;
+  int shelfY = 0;
+  int shelfHeight = 0;
+
+  int dirtyTop;
+  int dirtyBottom;
+  int generation = 0;
+};
+
+#endif // TEXTUREATLAS_H
@@ -0,0 +1,55 @@
+#ifndef TRANSFORMCOMPONENT_H
+#define TRANSFORMCOMPONENT_H
+
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "Component.h"
+#include "TransformSystem.h"
+
+class Actor;
+
+// Gives an actor a place in the world. The values live in TransformSystem;
+// this just owns a handle to them. Position, rotation (degrees) and scale are
+// relative to the parent transform, if there is one.
+class TransformComponent : public Component {
+public:
+  TransformComponent();
+  // Copies get their own transform with the same local values and parent
+  TransformComponent(const TransformComponent& other);
+  TransformComponent& operator=(const TransformComponent&) = delete;
+  ~TransformComponent();
+
+  TransformSystem::Handle GetHandle() const { return handle; }
+
+  glm::vec3 GetPosition() const { return TransformSystem::GetLocalPosition(handle); }
+  void SetPosition(const glm::vec3& position) { TransformSystem::SetLocalPosition(handle, position); }
+
+  glm::vec3 GetRotation() const { return TransformSystem::GetLocalRotation(handle); }
+  void SetRotation(const glm::vec3& rotation) { TransformSystem::SetLocalRotation(handle, rotation); }
+
+  glm::vec3 GetScale() const { return TransformSystem::GetLocalScale(handle); }
+  void SetScale(const glm::vec3& scale) { TransformSystem::SetLocalScale(handle, scale); }
+
+  void Translate(const glm::vec3& offset) { SetPosition(GetPosition() + offset); }
+  void Rotate(const glm::vec3& degrees) { SetRotation(GetRotation() + degrees); }
+
+  const glm::mat4& GetWorldMatrix() const { return TransformSystem::GetWorldMatrix(handle); }
+  glm::vec3 GetWorldPosition() const { return glm::vec3(GetWorldMatrix()[3]); }
+
+  // nullptr detaches
+  void SetParent(TransformComponent* parent);
+  void ClearParent() { SetParent(nullptr); }
+  bool HasParent() const { return TransformSystem::GetParent(handle) != TransformSystem::INVALID; }
+
+  // Name of the parent actor from the scene file, resolved once it's loaded
+  std::string parentName;
+
+  // The actor's first Transform, or nullptr
+  static TransformComponent* FindOn(const Actor& actor);
+private:
+  TransformSystem::Handle handle;
+};
+
+#endif // TRANSFORMCOMPONENT_H
@@ -0,0 +1,88 @@
+#ifndef TRANSFORMSYSTEM_H
+#define TRANSFORMSYSTEM_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "SimdMath.h"
+
+// Every transform in the game, stored as parallel arrays (position, rotation,
+// scale, parent, world matrix...) ordered by hierarchy depth, so parents
+// always come before their children. Update walks the arrays once: a
+// transform whose local values changed, or whose parent's world matrix was
+// just recomputed, is recomputed (in SimdMath batches); everything else
+// keeps its cached matrix.
+// Handles stay valid while the arrays are reordered underneath them.
+class TransformSystem {
+public:
+  typedef int Handle;
+  static const Handle INVALID = -1;
+
+  struct Stats {
+    int transforms = 0;
+    int recomputed = 0;
+    int maxDepth = 0;
+  };
+
+  static Handle Create();
+  static void Destroy(Handle handle);
+  static bool IsValid(Handle handle);
+
+  // Returns false (and changes nothing) if the parent is a descendant of child
+  static bool SetParent(Handle child, Handle parent);
+  static Handle GetParent(Handle handle);
+
+  // Local values, relative to the parent. Rotation is Euler angles in degrees.
+  static void SetLocalPosition(Handle handle, const glm::vec3& position);
+  static void SetLocalRotation(Handle handle, const glm::vec3& rotation);
+  static void SetLocalScale(Handle handle, const glm::vec3& scale);
+  static glm::vec3 GetLocalPosition(Handle handle);
+  static glm::vec3 GetLocalRotation(Handle handle);
+  static glm::vec3 GetLocalScale(Handle handle);
+
+  // Brings world matrices up to date first if anything changed
+  static const glm::mat4& GetWorldMatrix(Handle handle);
+
+  // Recomputes the world matrices of changed transforms and their descendants
+  static void Update();
+
+  static const Stats& GetStats();
+
+  // translate * rotateX * rotateY * rotateZ * scale, with the rotations
+  // multiplied out by hand instead of three glm::rotate calls
+  static glm::mat4 Compose(const glm::vec3& position, const glm::vec3& rotationDegrees, const glm::vec3& scale);
+private:
+  static void Reorder();
+  static void RemoveSlot(int slot);
+
+  // Hands SimdMath the local values of the slots starting at first
+  static TransformStreams StreamsFrom(int first);
+
+  // Calls f on every per-slot array
+  template <typename F>
+  static void ForEachSlotArray(F f);
+
+  // Per slot, kept in depth order. Local values are split into one float
+  // array per component so SimdMath can compose them in batches.
+  static std::vector<float> positionX, positionY, positionZ;
+  static std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+  static std::vector<float> scaleX, scaleY, scaleZ;
+  static std::vector<glm::vec3> localRotations; // Euler degrees, as set
+  static std::vector<glm::mat4> worldMatrices;
+  static std::vector<int> parentSlots;
+  static std::vector<Handle> parentHandles;
+  static std::vector<Handle> slotHandles;
+  static std::vector<uint8_t> dirty;
+
+  // Per handle
+  static std::vector<int> handleSlots;
+  static std::vector<Handle> freeHandles;
+
+  static bool orderChanged;
+  static bool anyDirty;
+  static Stats stats;
+};
+
+#endif // TRANSFORMSYSTEM_H
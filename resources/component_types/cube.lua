@@ -2,8 +2,9 @@ cube = {
   -- Variables to track animation
   radius = 0.1,
   speed = 0.0003, -- rotation amount per frame
-  camMoveSpeed = 0.01,
-  camAngleSpeed = 0.07,
+  camMoveSpeed = 1.5, -- units per second
+  camAngleSpeed = 60.0, -- degrees per second
+  posSpeed = 0.3, -- units per second
   pos = Vector3(0, 0, 0),
   
   OnStart = function(self)
@@ -15,6 +16,12 @@ cube = {
     local yPos = Camera.GetPositionY()
     local zPos = Camera.GetPositionZ()
 
+    -- Scale movement by frame time so speed doesn't depend on frame rate
+    local dt = Time.GetDeltaTime()
+    local move = self.camMoveSpeed * dt
+    local turn = self.camAngleSpeed * dt
+    local nudge = self.posSpeed * dt
+
     -- Get current frame number
     local frame = Application.GetFrame()
     
@@ -28,29 +35,29 @@ cube = {
 
     -- Forward/backward movement
     if Input.GetKey("w") then
-      zPos = zPos - self.camMoveSpeed  -- Move forward (negative Z)
+      zPos = zPos - move  -- Move forward (negative Z)
     end
     
     if Input.GetKey("s") then
-      zPos = zPos + self.camMoveSpeed  -- Move backward (positive Z)
+      zPos = zPos + move  -- Move backward (positive Z)
     end
     
     -- Left/right movement
     if Input.GetKey("a") then
-      xPos = xPos - self.camMoveSpeed  -- Move left (negative X)
+      xPos = xPos - move  -- Move left (negative X)
     end
     
     if Input.GetKey("d") then
-      xPos = xPos + self.camMoveSpeed  -- Move right (positive X)
+      xPos = xPos + move  -- Move right (positive X)
     end
     
     -- Up/down movement
     if Input.GetKey("space") then
-      yPos = yPos + self.camMoveSpeed  -- Move up (positive Y)
+      yPos = yPos + move  -- Move up (positive Y)
     end
     
     if Input.GetKey("lctrl") or Input.GetKey("rctrl") then
-      yPos = yPos - self.camMoveSpeed  -- Move down (negative Y)
+      yPos = yPos - move  -- Move down (negative Y)
     end
 
     if Input.GetKey("escape") then
@@ -63,29 +70,29 @@ cube = {
     
     -- Adjust angles based on input
     if Input.GetKey("right") then
-        Camera.SetYaw(yaw + self.camAngleSpeed)
+        Camera.SetYaw(yaw + turn)
     end
     if Input.GetKey("left") then
-        Camera.SetYaw(yaw - self.camAngleSpeed)
+        Camera.SetYaw(yaw - turn)
     end
     if Input.GetKey("up") then
-        Camera.SetPitch(pitch + self.camAngleSpeed)
+        Camera.SetPitch(pitch + turn)
     end
     if Input.GetKey("down") then
-        Camera.SetPitch(pitch - self.camAngleSpeed)
+        Camera.SetPitch(pitch - turn)
     end
 
     if Input.GetKey("i") then
-      self.pos.y = self.pos.y + 0.001
+      self.pos.y = self.pos.y + nudge
     end
     if Input.GetKey("j") then
-      self.pos.x = self.pos.x - 0.001
+      self.pos.x = self.pos.x - nudge
     end
     if Input.GetKey("k") then
-      self.pos.y = self.pos.y - 0.001
+      self.pos.y = self.pos.y - nudge
     end
     if Input.GetKey("l") then
-      self.pos.x = self.pos.x + 0.001
+      self.pos.x = self.pos.x + nudge
     end
     
     -- Update camera position
@@ -2,6 +2,11 @@
 
 // Maximum number of lights
 #define MAX_LIGHTS 8
+// Must match ShadowFrame
+#define MAX_CASCADES 4
+#define MAX_SPOT_SHADOWS 4
+// Must match LightProbes
+#define PROBE_BLOCKS 7
 
 out vec4 FragColor;
 
@@ -9,6 +14,8 @@ in vec3 ourColor;
 in vec3 fragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+in float viewDepth;
+in vec2 lightmapUV;
 
 // Light types (must match the C++ enum)
 const int DIRECTIONAL_LIGHT = 0;
@@ -31,6 +38,9 @@ struct Light {
     // Spotlight properties
     float innerCutoff;
     float outerCutoff;
+
+    // Already in the lightmap for lightmapped objects
+    bool baked;
 };
 
 // Material properties
@@ -54,9 +64,106 @@ uniform int numLights;
 uniform Light lights[MAX_LIGHTS];
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
+// Dithered away while the object's impostor fades in (see ImpostorSystem)
+uniform float fadeOut;
+
+// Shadow maps (see ShadowSystem). cascadeLight and spotShadowLights index
+// lights[]; -1 casts no shadow.
+uniform int cascadeLight;
+uniform int cascadeCount;
+uniform mat4 cascadeMatrices[MAX_CASCADES];
+uniform vec4 cascadeSplits;
+uniform sampler2DArrayShadow cascadeMap;
+uniform int spotShadowLights[MAX_SPOT_SHADOWS];
+uniform mat4 spotMatrices[MAX_SPOT_SHADOWS];
+uniform sampler2DArrayShadow spotShadowMap;
+
+// Baked irradiance from lights marked baked, direct and bounced (see
+// Lightmaps). lightmapRect is all zero for objects without any.
+uniform sampler2D lightmap;
+uniform vec4 lightmapRect;
+
+// Irradiance probes for everything else (see LightProbes); zero counts when
+// none are loaded
+uniform sampler3D probeGrid;
+uniform vec3 probeOrigin;
+uniform float probeSpacing;
+uniform ivec3 probeCounts;
+
+// Compared depth is pulled toward the light by this much on top of the
+// casters' polygon offset
+const float SHADOW_BIAS = 0.0005;
+
+// 4x4 ordered dither; impostors keep the complementary pixels
+float Bayer(vec2 pixel) {
+    const float pattern[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 cell = ivec2(mod(pixel, 4.0));
+    return (pattern[cell.y * 4 + cell.x] + 0.5) / 16.0;
+}
+
+// Share of light reaching fragPos, 0 to 1, from one layer of a shadow map
+float SampleShadow(sampler2DArrayShadow map, int layer, mat4 lightViewProjection) {
+    vec4 clip = lightViewProjection * vec4(fragPos, 1.0);
+    vec3 coords = clip.xyz / clip.w * 0.5 + 0.5;
+    // Outside the map or past its far plane
+    if (coords.z > 1.0 || any(lessThan(coords.xy, vec2(0.0))) || any(greaterThan(coords.xy, vec2(1.0)))) {
+        return 1.0;
+    }
+
+    // Four hardware filtered compares, a half texel either side
+    vec2 texel = 1.0 / vec2(textureSize(map, 0).xy);
+    float lit = 0.0;
+    for (int i = 0; i < 4; i++) {
+        vec2 offset = vec2(i % 2 == 0 ? -0.5 : 0.5, i < 2 ? -0.5 : 0.5) * texel;
+        lit += texture(map, vec4(coords.xy + offset, float(layer), coords.z - SHADOW_BIAS));
+    }
+    return lit * 0.25;
+}
+
+float ShadowFactor(int lightIndex) {
+    if (lightIndex == cascadeLight) {
+        for (int c = 0; c < cascadeCount; c++) {
+            if (viewDepth < cascadeSplits[c]) {
+                return SampleShadow(cascadeMap, c, cascadeMatrices[c]);
+            }
+        }
+        return 1.0;
+    }
+    for (int s = 0; s < MAX_SPOT_SHADOWS; s++) {
+        if (spotShadowLights[s] == lightIndex) {
+            return SampleShadow(spotShadowMap, s, spotMatrices[s]);
+        }
+    }
+    return 1.0;
+}
+
+// Irradiance along the normal from the probes around fragPos
+vec3 ProbeIrradiance(vec3 n) {
+    // Clamped to the grid so each block only ever filters its own slices
+    vec3 cell = clamp((fragPos - probeOrigin) / probeSpacing, vec3(0.0), vec3(probeCounts - 1));
+    vec3 uvw = (cell + 0.5) / vec3(probeCounts);
+
+    float c[PROBE_BLOCKS * 4];
+    for (int k = 0; k < PROBE_BLOCKS; k++) {
+        vec4 texel = texture(probeGrid, vec3(uvw.xy, (float(k) + uvw.z) / float(PROBE_BLOCKS)));
+        for (int j = 0; j < 4; j++) {
+            c[k * 4 + j] = texel[j];
+        }
+    }
+
+    float basis[9] = float[9](
+        0.282095,
+        0.488603 * n.y, 0.488603 * n.z, 0.488603 * n.x,
+        1.092548 * n.x * n.y, 1.092548 * n.y * n.z, 0.315392 * (3.0 * n.z * n.z - 1.0), 1.092548 * n.x * n.z, 0.546274 * (n.x * n.x - n.y * n.y));
+    vec3 irradiance = vec3(0.0);
+    for (int i = 0; i < 9; i++) {
+        irradiance += vec3(c[i * 3], c[i * 3 + 1], c[i * 3 + 2]) * basis[i];
+    }
+    return max(irradiance, vec3(0.0));
+}
 
 // Calculate lighting for directional light
-vec3 CalcDirectionalLight(Light light, vec3 normal, vec3 viewDir, vec3 diffuseValue, vec3 specularValue) {
+vec3 CalcDirectionalLight(Light light, vec3 normal, vec3 viewDir, vec3 diffuseValue, vec3 specularValue, float shadow, float ambientWeight) {
     vec3 lightDir = normalize(-light.direction);
 
     // Diffuse shading
@@ -64,7 +171,7 @@ vec3 CalcDirectionalLight(Light light, vec3 normal, vec3 viewDir, vec3 diffuseVa
     if (NdotL <= 0.0) {
         // Surface is facing away from light - only apply ambient
         // return light.color * diffuseValue * light.intensity * 0.1;
-        return light.color * material.ambient * light.intensity;
+        return light.color * material.ambient * light.intensity * ambientWeight;
     }
 
     float diff = NdotL;
@@ -74,15 +181,16 @@ vec3 CalcDirectionalLight(Light light, vec3 normal, vec3 viewDir, vec3 diffuseVa
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
 
     // Combine results
-    vec3 ambient = light.color * material.ambient * light.intensity;
+    vec3 ambient = light.color * material.ambient * light.intensity * ambientWeight;
     vec3 diffuse = light.color * diff * diffuseValue * light.intensity;
     vec3 specular = light.color * spec * specularValue * light.intensity;
     
-    return ambient + diffuse + specular;
+    // Shadows only take away direct light
+    return ambient + (diffuse + specular) * shadow;
 }
 
 // Calculate lighting for point light with attenuation
-vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseValue, vec3 specularValue) {    
+vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseValue, vec3 specularValue, float ambientWeight) {    
     // Vector from fragment to light
     vec3 lightDir = normalize(light.position - fragPos);
 
@@ -91,7 +199,7 @@ vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 d
     if (NdotL <= 0.0) {
         // Surface is facing away from light - only apply ambient
         // return light.color * diffuseValue * light.intensity * 0.1;
-        return light.color * material.ambient * light.intensity;
+        return light.color * material.ambient * light.intensity * ambientWeight;
     }
 
     // Rest of your lighting calculation for surfaces facing the light
@@ -106,7 +214,7 @@ vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 d
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
 
     // Combine results
-    vec3 ambient = light.color * material.ambient * light.intensity;
+    vec3 ambient = light.color * material.ambient * light.intensity * ambientWeight;
     vec3 diffuse = light.color * diff * diffuseValue * light.intensity;
     vec3 specular = light.color * spec * specularValue * light.intensity;
     
@@ -119,7 +227,7 @@ vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 d
 }
 
 // Calculate lighting for spotlight
-vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseValue, vec3 specularValue) {
+vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseValue, vec3 specularValue, float shadow, float ambientWeight) {
     // Vector from fragment to light
     vec3 lightDir = normalize(light.position - fragPos);
     
@@ -128,7 +236,7 @@ vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 di
     if (NdotL <= 0.0) {
         // Surface is facing away from light - only apply ambient
         // return light.color * diffuseValue * light.intensity * 0.1;
-        return light.color * material.ambient * light.intensity;
+        return light.color * material.ambient * light.intensity * ambientWeight;
     }
 
     // Diffuse shading
@@ -149,7 +257,7 @@ vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 di
     float intensity = clamp((theta - light.outerCutoff) / epsilon, 0.0, 1.0);
 
     // Combine results
-    vec3 ambient = light.color * material.ambient * light.intensity;
+    vec3 ambient = light.color * material.ambient * light.intensity * ambientWeight;
     vec3 diffuse = light.color * diff * diffuseValue * light.intensity;
     vec3 specular = light.color * spec * specularValue * light.intensity;
 
@@ -158,11 +266,15 @@ vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 di
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
 
-    return ambient + diffuse + specular;
+    return ambient + (diffuse + specular) * shadow;
 }
 
 
 void main() {
+    if (Bayer(gl_FragCoord.xy) < fadeOut) {
+        discard;
+    }
+
     // Properties
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - fragPos);
@@ -197,20 +309,35 @@ void main() {
     }
 
     vec3 totalLighting = vec3(0.0);
+    bool lightmapped = lightmapRect.x > 0.0;
+    bool probeLit = !lightmapped && probeCounts.x > 0;
+    if (lightmapped) {
+        totalLighting += texture(lightmap, lightmapUV).rgb * diffuseValue;
+    } else if (probeLit) {
+        totalLighting += ProbeIrradiance(norm) * diffuseValue;
+    }
 
     // Process each active light
     for(int i = 0; i < numLights && i < MAX_LIGHTS; i++) {
         vec3 lightResult = vec3(0.0);
+
+        // Baked lights are in the lightmap already, its bounced light
+        // standing in for their ambient term
+        if (lightmapped && lights[i].baked) {
+            continue;
+        }
+        // Elsewhere the probes' bounced light stands in for it
+        float ambientWeight = probeLit && lights[i].baked ? 0.0 : 1.0;
         
         // Determine which lighting calculation to use based on light type
         if(lights[i].type == DIRECTIONAL_LIGHT) {
-            lightResult = CalcDirectionalLight(lights[i], norm, viewDir, diffuseValue, specularValue);
+            lightResult = CalcDirectionalLight(lights[i], norm, viewDir, diffuseValue, specularValue, ShadowFactor(i), ambientWeight);
         }
         else if(lights[i].type == POINT_LIGHT) {
-            lightResult = CalcPointLight(lights[i], norm, fragPos, viewDir, diffuseValue, specularValue);
+            lightResult = CalcPointLight(lights[i], norm, fragPos, viewDir, diffuseValue, specularValue, ambientWeight);
         }
         else if(lights[i].type == SPOT_LIGHT) {
-            lightResult = CalcSpotLight(lights[i], norm, fragPos, viewDir, diffuseValue, specularValue);
+            lightResult = CalcSpotLight(lights[i], norm, fragPos, viewDir, diffuseValue, specularValue, ShadowFactor(i), ambientWeight);
         }
 
         totalLighting += lightResult;
@@ -0,0 +1,117 @@
+#version 330 core
+
+#define MAX_LIGHTS 8
+
+out vec4 FragColor;
+
+in vec2 QuadUV;
+in vec3 WorldPos;
+flat in vec2 Frame;
+flat in vec3 ViewDir;
+flat in vec4 Rotation;
+flat in vec4 ColorFade;
+flat in float Radius;
+
+const int DIRECTIONAL_LIGHT = 0;
+const int POINT_LIGHT = 1;
+const int SPOT_LIGHT = 2;
+
+// Matches the scene shader's, so LightComponent::UploadLights works
+struct Light {
+    int type;
+    vec3 position;
+    vec3 direction;
+    vec3 color;
+    float intensity;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    float innerCutoff;
+    float outerCutoff;
+};
+
+uniform mat4 viewProjection;
+uniform float frames;
+uniform sampler2D albedoAtlas;
+uniform sampler2D normalDepthAtlas;
+uniform int numLights;
+uniform Light lights[MAX_LIGHTS];
+
+// Impostors don't keep the material's ambient color; this stands in for it
+const float AMBIENT = 0.2;
+
+vec3 Rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// 4x4 ordered dither; the scene shader discards the complementary pixels
+float Bayer(vec2 pixel) {
+    const float pattern[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 cell = ivec2(mod(pixel, 4.0));
+    return (pattern[cell.y * 4 + cell.x] + 0.5) / 16.0;
+}
+
+vec3 CalcLight(Light light, vec3 normal, vec3 position, vec3 albedo) {
+    vec3 lightDir;
+    float attenuation = 1.0;
+    if (light.type == DIRECTIONAL_LIGHT) {
+        lightDir = normalize(-light.direction);
+    } else {
+        lightDir = normalize(light.position - position);
+        float distance = length(light.position - position);
+        attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+        if (light.type == SPOT_LIGHT) {
+            float theta = dot(lightDir, normalize(-light.direction));
+            attenuation *= clamp((theta - light.outerCutoff) / (light.innerCutoff - light.outerCutoff), 0.0, 1.0);
+        }
+    }
+
+    float diffuse = max(dot(normal, lightDir), 0.0);
+    return light.color * light.intensity * attenuation * albedo * (AMBIENT + diffuse);
+}
+
+void main() {
+    if (Bayer(gl_FragCoord.xy) >= ColorFade.a) {
+        discard;
+    }
+
+    // Blend the four nearest views, weighting each by its coverage
+    vec2 first = floor(Frame);
+    vec2 last = min(first + 1.0, frames - 1.0);
+    vec2 blend = Frame - first;
+    vec2 cells[4] = vec2[4](first, vec2(last.x, first.y), vec2(first.x, last.y), last);
+    float weights[4] = float[4]((1.0 - blend.x) * (1.0 - blend.y), blend.x * (1.0 - blend.y), (1.0 - blend.x) * blend.y, blend.x * blend.y);
+
+    vec4 albedo = vec4(0.0);
+    vec4 normalDepth = vec4(0.0);
+    for (int i = 0; i < 4; ++i) {
+        vec2 uv = (cells[i] + QuadUV) / frames;
+        vec4 color = texture(albedoAtlas, uv);
+        float weight = weights[i] * color.a;
+        albedo += vec4(color.rgb * weight, weight);
+        normalDepth += texture(normalDepthAtlas, uv) * weight;
+    }
+    if (albedo.a < 0.5) {
+        discard;
+    }
+    albedo.rgb /= albedo.a;
+    normalDepth /= albedo.a;
+
+    // Push the fragment back to the surface the view saw, so impostors
+    // intersect the ground and each other properly
+    vec3 surface = WorldPos + ViewDir * (1.0 - 2.0 * normalDepth.a) * Radius;
+    vec4 clip = viewProjection * vec4(surface, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+    vec3 normal = normalize(Rotate(Rotation, normalDepth.rgb * 2.0 - 1.0));
+    vec3 result = vec3(0.0);
+    for (int i = 0; i < numLights && i < MAX_LIGHTS; i++) {
+        result += CalcLight(lights[i], normal, surface, albedo.rgb);
+    }
+    result *= ColorFade.rgb;
+
+    result = result / (result + vec3(1.0));
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,40 @@
+#version 330 core
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalDepth;
+
+in vec3 Normal;
+in vec2 TexCoords;
+
+// Same material uniforms the scene shader takes, so Mesh::ApplyMaterial works
+struct Material {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+
+    sampler2D diffuseMap;
+    sampler2D specularMap;
+    bool useTexture;
+};
+
+uniform Material material;
+uniform sampler2D texture_diffuse1;
+
+void main() {
+    // The color the scene shader multiplies diffuse light by
+    vec3 albedo = material.diffuse;
+    if (textureSize(texture_diffuse1, 0).x > 1) {
+        vec3 texel = vec3(texture(texture_diffuse1, TexCoords));
+        albedo = texel * texel;
+    } else if (material.useTexture) {
+        albedo = vec3(texture(material.diffuseMap, TexCoords));
+    }
+
+    // Leaves and other open geometry are seen from both sides
+    vec3 normal = normalize(gl_FrontFacing ? Normal : -Normal);
+
+    Albedo = vec4(albedo, 1.0);
+    // The projection is orthographic, so window depth is linear across the
+    // bounding sphere: 0 at its front, 1 at its back
+    NormalDepth = vec4(normal * 0.5 + 0.5, gl_FragCoord.z);
+}
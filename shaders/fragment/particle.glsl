@@ -0,0 +1,14 @@
+#version 330 core
+in vec2 Corner;
+in vec4 Color;
+
+out vec4 FragColor;
+
+void main() {
+    // Round particles that fade out towards the edge
+    float alpha = Color.a * (1.0 - smoothstep(0.25, 0.5, length(Corner)));
+    if (alpha < 0.004) {
+        discard;
+    }
+    FragColor = vec4(Color.rgb, alpha);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+in vec2 UV;
+in vec4 Color;
+
+uniform sampler2D image;
+
+out vec4 FragColor;
+
+void main() {
+    vec4 color = texture(image, UV) * Color;
+    // Fully clear texels would still hide whatever is drawn behind later
+    if (color.a < 0.004) {
+        discard;
+    }
+    FragColor = color;
+}
@@ -0,0 +1,28 @@
+#version 330 core
+in vec2 UV;
+in vec4 Color;
+in vec4 OutlineColor;
+in vec3 Edge;
+
+uniform sampler2D atlas;
+
+out vec4 FragColor;
+
+void main() {
+    // The atlas holds signed distances to the glyph's edge, 0.5 on it and
+    // higher inside; scaled, that's window pixels at this size
+    float distance = (texture(atlas, UV).r - 0.5) * Edge.x;
+    // Half a pixel either side of the edge keeps it smooth at any size
+    float width = 0.5 + Edge.z;
+
+    float fill = smoothstep(-width, width, distance);
+    float outline = smoothstep(-width, width, distance + Edge.y);
+
+    float fillAlpha = Color.a * fill;
+    float outlineAlpha = OutlineColor.a * (outline - fill);
+    float alpha = fillAlpha + outlineAlpha;
+    if (alpha < 0.004) {
+        discard;
+    }
+    FragColor = vec4((Color.rgb * fillAlpha + OutlineColor.rgb * outlineAlpha) / alpha, alpha);
+}
@@ -0,0 +1,55 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec4 aCenterRadius;
+layout (location = 2) in vec4 aRotation;
+layout (location = 3) in vec4 aColorFade;
+
+uniform mat4 viewProjection;
+uniform vec3 cameraPos;
+uniform float frames;
+
+out vec2 QuadUV;
+out vec3 WorldPos;
+flat out vec2 Frame;
+flat out vec3 ViewDir;
+flat out vec4 Rotation;
+flat out vec4 ColorFade;
+flat out float Radius;
+
+vec3 Rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// Direction to a point on the octahedron unfolded into the unit square, y up
+vec2 OctahedronEncode(vec3 direction) {
+    direction /= abs(direction.x) + abs(direction.y) + abs(direction.z);
+    vec2 p = direction.xz;
+    if (direction.y < 0.0) {
+        p = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return p * 0.5 + 0.5;
+}
+
+void main() {
+    vec3 center = aCenterRadius.xyz;
+    vec3 toCamera = normalize(cameraPos - center);
+    vec4 inverse = vec4(-aRotation.xyz, aRotation.w);
+    vec3 localToCamera = Rotate(inverse, toCamera);
+
+    // The same axes the baked views were rendered with (see ImpostorSystem::Bake)
+    vec3 forward = -localToCamera;
+    vec3 up = abs(forward.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(forward, up));
+    up = cross(right, forward);
+
+    vec3 offset = Rotate(aRotation, right * aCorner.x + up * aCorner.y) * aCenterRadius.w;
+    WorldPos = center + offset;
+    QuadUV = aCorner * 0.5 + 0.5;
+    // Views sit at cell centers, so the four around this direction are blended
+    Frame = clamp(OctahedronEncode(localToCamera) * frames - 0.5, 0.0, frames - 1.0);
+    ViewDir = toCamera;
+    Rotation = aRotation;
+    ColorFade = aColorFade;
+    Radius = aCenterRadius.w;
+    gl_Position = viewProjection * vec4(WorldPos, 1.0);
+}
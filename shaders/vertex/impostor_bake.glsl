@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec3 aNormal;
+layout (location = 3) in vec2 aTexCoords;
+
+// One view of the model, in object space
+uniform mat4 viewProjection;
+
+out vec3 Normal;
+out vec2 TexCoords;
+
+void main() {
+    gl_Position = viewProjection * vec4(aPos, 1.0);
+    Normal = aNormal;
+    TexCoords = aTexCoords;
+}
@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec4 aCenterSize;
+layout (location = 2) in vec4 aColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec2 Corner;
+out vec4 Color;
+
+void main() {
+    // The view matrix's rows are the camera's right and up axes
+    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+    vec3 position = aCenterSize.xyz + (right * aCorner.x + up * aCorner.y) * aCenterSize.w;
+
+    Corner = aCorner;
+    Color = aColor;
+    gl_Position = projection * view * vec4(position, 1.0);
+}
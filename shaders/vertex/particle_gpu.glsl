@@ -0,0 +1,34 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec4 aPositionAge;
+layout (location = 2) in vec4 aVelocityLifetime;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec2 size;  // start, end
+uniform vec4 startColor;
+uniform vec4 endColor;
+
+out vec2 Corner;
+out vec4 Color;
+
+void main() {
+    Corner = aCorner;
+
+    // Dead slots collapse outside the clip volume
+    float age = aPositionAge.w;
+    float lifetime = aVelocityLifetime.w;
+    if (age >= lifetime) {
+        Color = vec4(0.0);
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+
+    float t = age / lifetime;
+    Color = mix(startColor, endColor, t);
+
+    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+    vec3 position = aPositionAge.xyz + (right * aCorner.x + up * aCorner.y) * mix(size.x, size.y, t);
+    gl_Position = projection * view * vec4(position, 1.0);
+}
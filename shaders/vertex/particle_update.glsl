@@ -0,0 +1,71 @@
+#version 330 core
+// One particle per vertex; the outputs are captured into the other buffer
+layout (location = 0) in vec4 aPositionAge;
+layout (location = 1) in vec4 aVelocityLifetime;
+
+out vec4 outPositionAge;
+out vec4 outVelocityLifetime;
+
+uniform float deltaTime;
+uniform vec3 gravity;
+uniform float damping;
+
+// Dead particles in [spawnStart, spawnStart + spawnCount), wrapping at
+// capacity, are respawned
+uniform int capacity;
+uniform int spawnStart;
+uniform int spawnCount;
+uniform int seed;
+
+uniform vec3 origin;
+uniform vec3 axis;
+uniform vec3 tangent;
+uniform vec3 bitangent;
+uniform float cosSpread;
+uniform vec2 lifetimeRange;
+uniform vec2 speedRange;
+
+uint Hash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float Random(inout uint state) {
+    state = Hash(state);
+    return float(state >> 8) * (1.0 / 16777216.0);
+}
+
+void main() {
+    vec3 position = aPositionAge.xyz;
+    float age = aPositionAge.w;
+    vec3 velocity = aVelocityLifetime.xyz;
+    float lifetime = aVelocityLifetime.w;
+
+    int slot = (gl_VertexID - spawnStart + capacity) % capacity;
+    if (age >= lifetime && slot < spawnCount) {
+        // Same distribution as the CPU path: even over the cone's cap
+        uint state = uint(gl_VertexID) * 747796405u + uint(seed);
+        float cosTheta = 1.0 - Random(state) * (1.0 - cosSpread);
+        float sinTheta = sqrt(max(0.0, 1.0 - cosTheta * cosTheta));
+        float phi = Random(state) * 6.28318531;
+        vec3 direction = axis * cosTheta + (tangent * cos(phi) + bitangent * sin(phi)) * sinTheta;
+
+        position = origin;
+        velocity = direction * mix(speedRange.x, speedRange.y, Random(state));
+        age = 0.0;
+        lifetime = mix(lifetimeRange.x, lifetimeRange.y, Random(state));
+    }
+
+    if (age < lifetime) {
+        velocity = (velocity + gravity * deltaTime) * damping;
+        position += velocity * deltaTime;
+        age += deltaTime;
+    }
+
+    outPositionAge = vec4(position, age);
+    outVelocityLifetime = vec4(velocity, lifetime);
+}
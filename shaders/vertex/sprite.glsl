@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec2 aUV;
+layout (location = 2) in vec4 aColor;
+
+uniform mat4 viewProjection;
+
+out vec2 UV;
+out vec4 Color;
+
+void main() {
+    UV = aUV;
+    Color = aColor;
+    gl_Position = viewProjection * vec4(aPosition, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec4 aPositionUV;
+layout (location = 1) in vec4 aColor;
+layout (location = 2) in vec4 aOutlineColor;
+// Distance scale, outline width, softness
+layout (location = 3) in vec3 aEdge;
+
+uniform mat4 projection;
+
+out vec2 UV;
+out vec4 Color;
+out vec4 OutlineColor;
+out vec3 Edge;
+
+void main() {
+    UV = aPositionUV.zw;
+    Color = aColor;
+    OutlineColor = aOutlineColor;
+    Edge = aEdge;
+    gl_Position = projection * vec4(aPositionUV.xy, 0.0, 1.0);
+}
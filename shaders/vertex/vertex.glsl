@@ -3,15 +3,21 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
 layout (location = 2) in vec3 aNormal;
 layout (location = 3) in vec2 aTexCoords;
+layout (location = 4) in vec2 aLightmapUV;
 
 uniform mat4 model;
+uniform mat3 normalMatrix; // Inverse transpose of model's upper 3x3, from the CPU
 uniform mat4 view;
 uniform mat4 projection;
+// The object's square in the lightmap atlas (see Lightmaps)
+uniform vec4 lightmapRect;
 
 out vec3 ourColor;
 out vec3 fragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+out float viewDepth;
+out vec2 lightmapUV;
 
 void main() {
     // Apply all three transformation matrices in the correct order
@@ -20,14 +26,18 @@ void main() {
     // Calculate fragment position in world space (for lighting)
     fragPos = vec3(model * vec4(aPos, 1.0));
 
+    // Distance in front of the camera, to pick a shadow cascade with
+    viewDepth = -(view * vec4(fragPos, 1.0)).z;
+
     // Transform normals to world space using normal matrix
     // This handles non-uniform scaling correctly
-    // Normal = mat3(transpose(inverse(model))) * aNormal;
-    Normal = aNormal;
+    Normal = normalMatrix * aNormal;
 
     // Pass color to fragment shader
     ourColor = aColor;
 
     // Pass texture coords to frag shader
     TexCoords = aTexCoords;
+
+    lightmapUV = aLightmapUV * lightmapRect.xy + lightmapRect.zw;
 }
\ No newline at end of file
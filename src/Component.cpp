@@ -26,6 +26,9 @@ void Component::SetComponentProps() {
         if ((*componentRef)["OnLateUpdate"].isFunction()) {
             hasLateUpdate = true;
         }
+        if ((*componentRef)["OnFixedUpdate"].isFunction()) {
+            hasFixedUpdate = true;
+        }
         if ((*componentRef)["OnDestroy"].isFunction()) {
             hasDestroy = true;
         }
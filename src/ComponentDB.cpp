@@ -7,6 +7,8 @@
 #include "Application.hpp"
 #include "Input.h"
 #include "TextDB.h"
+#include "ImageDB.h"
+#include "DebugDraw.h"
 #include "AudioDB.h"
 #include "EventSystem.h"
 #include "Renderer.h"
@@ -14,6 +16,17 @@
 #include "GameObjectDB.h"
 #include "GameObject.h"
 #include "LightComponent.h"
+#include "TransformComponent.h"
+#include "ParticleSystemComponent.h"
+#include "OcclusionCulling.h"
+#include "SoftwareOcclusion.h"
+#include "QualityGovernor.h"
+#include "GpuProfiler.h"
+#include "StreamBuffer.h"
+#include "ImpostorSystem.h"
+#include "ShadowSystem.h"
+#include "FramePacer.h"
+#include "GameTime.h"
 
 #include <filesystem>
 #include <string>
@@ -24,12 +37,22 @@ static glm::vec3 vec3_add(const glm::vec3& v1, const glm::vec3& v2) { return v1
 static glm::vec3 vec3_sub(const glm::vec3& v1, const glm::vec3& v2) { return v1 - v2; }
 static glm::vec3 vec3_mul(const glm::vec3& v, float scalar) { return v * scalar; }
 
+// Lua colors are 0-255, like Text and Image
+static void debug_line(const glm::vec3& from, const glm::vec3& to, float r, float g, float b) { DebugDraw::Line(from, to, glm::vec4(r, g, b, 255.0f) / 255.0f); }
+static void debug_box(const glm::vec3& min, const glm::vec3& max, float r, float g, float b) { DebugDraw::Box(min, max, glm::vec4(r, g, b, 255.0f) / 255.0f); }
+static void debug_sphere(const glm::vec3& center, float radius, float r, float g, float b) { DebugDraw::Sphere(center, radius, glm::vec4(r, g, b, 255.0f) / 255.0f); }
+
 void ComponentDB::Init() {
     // Added debug statements - Debug.Log / Debug.Error
     luabridge::getGlobalNamespace(ComponentManager::lua_state)
     .beginNamespace("Debug")
     .addFunction("Log", ComponentDB::CppLog)
     // .addFunction("LogError", ComponentDB::CppError)
+    .addFunction("DrawLine", debug_line)
+    .addFunction("DrawBox", debug_box)
+    .addFunction("DrawSphere", debug_sphere)
+    .addFunction("ShowBounds", DebugDraw::SetBoundsEnabled)
+    .addFunction("ShowLights", DebugDraw::SetLightsEnabled)
     .endNamespace();
 
     // Add Other Actor API
@@ -60,6 +83,13 @@ void ComponentDB::Init() {
     .addFunction("Quit", &Application::Quit)
     .addFunction("Sleep", &Application::Sleep)
     .addFunction("OpenURL", &Application::OpenUrl)
+    .addFunction("SetVsync", &FramePacer::SetVsync)
+    .addFunction("GetVsync", &FramePacer::GetVsync)
+    .addFunction("SetTargetFps", &FramePacer::SetTargetFps)
+    .addFunction("GetTargetFps", &FramePacer::GetTargetFps)
+    .addFunction("GetFrameInterval", &FramePacer::GetFrameInterval)
+    .addFunction("GetFps", &FramePacer::GetFps)
+    .addFunction("GetMissedFrames", &FramePacer::GetMissedFrames)
     .endNamespace();
 
     // Add vec2 Class to Lua
@@ -88,6 +118,17 @@ void ComponentDB::Init() {
     luabridge::getGlobalNamespace(ComponentManager::lua_state)
     .beginNamespace("Text")
     .addFunction("Draw", TextDB::Draw)
+    .addFunction("DrawStyled", TextDB::DrawStyled)
+    .endNamespace();
+
+    // Add Image manager
+    luabridge::getGlobalNamespace(ComponentManager::lua_state)
+    .beginNamespace("Image")
+    .addFunction("Draw", ImageDB::Draw)
+    .addFunction("DrawEx", ImageDB::DrawEx)
+    .addFunction("DrawWorld", ImageDB::DrawWorld)
+    .addFunction("DrawWorldEx", ImageDB::DrawWorldEx)
+    .addFunction("DrawPixel", ImageDB::DrawPixel)
     .endNamespace();
 
     // Add volume manager
@@ -137,6 +178,65 @@ void ComponentDB::Init() {
     .addFunction("DrawModel", &GameObjectDB::LoadModel)
     .addFunction("DrawPlane", &GameObjectDB::CreatePlane)
     .addFunction("DrawTexturedPlane", &GameObjectDB::CreateTexturedPlane)
+    .addFunction("Attach", &GameObjectDB::Attach)
+    .addFunction("SetStatic", &GameObjectDB::SetStatic)
+    .endNamespace();
+
+    // Frame and fixed-step timing, in seconds
+    luabridge::getGlobalNamespace(ComponentManager::lua_state)
+    .beginNamespace("Time")
+    .addFunction("GetDeltaTime", &GameTime::GetDeltaTime)
+    .addFunction("GetFixedDeltaTime", &GameTime::GetFixedDeltaTime)
+    .addFunction("GetTime", &GameTime::GetTime)
+    .addFunction("GetFixedTime", &GameTime::GetFixedTime)
+    .addFunction("GetAlpha", &GameTime::GetAlpha)
+    .addFunction("GetTickRate", &GameTime::GetTickRate)
+    .addFunction("SetTickRate", &GameTime::SetTickRate)
+    .endNamespace();
+
+    // Occlusion culling controls and last frame's stats
+    luabridge::getGlobalNamespace(ComponentManager::lua_state)
+    .beginNamespace("Occlusion")
+    .addFunction("SetEnabled", &OcclusionCulling::SetEnabled)
+    .addFunction("IsEnabled", &OcclusionCulling::IsEnabled)
+    .addFunction("GetCulledCount", &OcclusionCulling::GetCulledCount)
+    .addFunction("GetQueryCount", &OcclusionCulling::GetQueryCount)
+    .addFunction("GetQueryLatency", &OcclusionCulling::GetQueryLatency)
+    .addFunction("SetSoftwareEnabled", &SoftwareOcclusion::SetEnabled)
+    .addFunction("IsSoftwareEnabled", &SoftwareOcclusion::IsEnabled)
+    .addFunction("SetOccluderModel", &SoftwareOcclusion::SetOccluderModel)
+    .addFunction("GetSoftwareCulledCount", &SoftwareOcclusion::GetCulledCount)
+    .endNamespace();
+
+    // Dynamic resolution and the quality governor's current settings
+    luabridge::getGlobalNamespace(ComponentManager::lua_state)
+    .beginNamespace("Quality")
+    .addFunction("SetEnabled", &QualityGovernor::SetEnabled)
+    .addFunction("IsEnabled", &QualityGovernor::IsEnabled)
+    .addFunction("SetTargetFrameTime", &QualityGovernor::SetTargetFrameTime)
+    .addFunction("GetGpuFrameTime", &QualityGovernor::GetGpuFrameTime)
+    .addFunction("GetRenderScale", &QualityGovernor::GetRenderScale)
+    .addFunction("SetRenderScale", &QualityGovernor::SetRenderScale)
+    .addFunction("GetLodBias", &QualityGovernor::GetLodBias)
+    .addFunction("GetLightLimit", &QualityGovernor::GetLightLimit)
+    .addFunction("SetLightLimit", &LightComponent::SetLightLimit)
+    .addFunction("GetLastDecision", &QualityGovernor::GetLastDecision)
+    .addFunction("SetImpostorDistance", &ImpostorSystem::SetDistance)
+    .addFunction("GetImpostorDistance", &ImpostorSystem::GetDistance)
+    .endNamespace();
+
+    // GPU time per render pass, in milliseconds
+    luabridge::getGlobalNamespace(ComponentManager::lua_state)
+    .beginNamespace("Profiler")
+    .addFunction("SetEnabled", &GpuProfiler::SetEnabled)
+    .addFunction("IsEnabled", &GpuProfiler::IsEnabled)
+    .addFunction("GetPassTime", &GpuProfiler::GetPassTime)
+    .addFunction("GetLastPassTime", &GpuProfiler::GetLastPassTime)
+    .addFunction("GetPassPercentile", &GpuProfiler::GetPassPercentile)
+    .addFunction("GetDroppedFrames", &GpuProfiler::GetDroppedFrames)
+    .addFunction("GetReport", &GpuProfiler::GetReport)
+    .addFunction("GetStreamReport", &StreamBuffer::GetReport)
+    .addFunction("GetShadowReport", &ShadowSystem::GetReport)
     .endNamespace();
 
     luabridge::getGlobalNamespace(ComponentManager::lua_state)
@@ -172,6 +272,7 @@ void ComponentDB::Init() {
     .addFunction("GetQuadratic", &LightComponent::GetQuadratic)
     .addFunction("GetInnerCutoff", &LightComponent::GetInnerCutoff)
     .addFunction("GetOuterCutoff", &LightComponent::GetOuterCutoff)
+    .addFunction("GetBaked", &LightComponent::GetBaked)
     .addFunction("GetName", &LightComponent::GetName)
     // Light properties setters
     .addFunction("SetType", &LightComponent::SetType)
@@ -184,8 +285,59 @@ void ComponentDB::Init() {
     .addFunction("SetQuadratic", &LightComponent::SetQuadratic)
     .addFunction("SetInnerCutoff", &LightComponent::SetInnerCutoff)
     .addFunction("SetOuterCutoff", &LightComponent::SetOuterCutoff)
+    .addFunction("SetBaked", &LightComponent::SetBaked)
     .addFunction("SetName", &LightComponent::SetName)
     .endClass();
+
+    // Transform component; position, rotation (degrees) and scale are local to the parent
+    luabridge::getGlobalNamespace(ComponentManager::lua_state)
+    .beginClass<TransformComponent>("TransformComponent")
+    .addFunction("GetPosition", &TransformComponent::GetPosition)
+    .addFunction("SetPosition", &TransformComponent::SetPosition)
+    .addFunction("GetRotation", &TransformComponent::GetRotation)
+    .addFunction("SetRotation", &TransformComponent::SetRotation)
+    .addFunction("GetScale", &TransformComponent::GetScale)
+    .addFunction("SetScale", &TransformComponent::SetScale)
+    .addFunction("Translate", &TransformComponent::Translate)
+    .addFunction("Rotate", &TransformComponent::Rotate)
+    .addFunction("GetWorldPosition", &TransformComponent::GetWorldPosition)
+    .addFunction("SetParent", &TransformComponent::SetParent)
+    .addFunction("ClearParent", &TransformComponent::ClearParent)
+    .addFunction("HasParent", &TransformComponent::HasParent)
+    .endClass();
+
+    // Particle emitter; colors are r, g, b, a from 0 to 1
+    luabridge::getGlobalNamespace(ComponentManager::lua_state)
+    .beginClass<ParticleSystemComponent>("ParticleSystemComponent")
+    .addFunction("GetRate", &ParticleSystemComponent::GetRate)
+    .addFunction("SetRate", &ParticleSystemComponent::SetRate)
+    .addFunction("GetMaxParticles", &ParticleSystemComponent::GetMaxParticles)
+    .addFunction("SetMaxParticles", &ParticleSystemComponent::SetMaxParticles)
+    .addFunction("SetLifetime", &ParticleSystemComponent::SetLifetime)
+    .addFunction("SetSpeed", &ParticleSystemComponent::SetSpeed)
+    .addFunction("GetDirection", &ParticleSystemComponent::GetDirection)
+    .addFunction("SetDirection", &ParticleSystemComponent::SetDirection)
+    .addFunction("GetSpread", &ParticleSystemComponent::GetSpread)
+    .addFunction("SetSpread", &ParticleSystemComponent::SetSpread)
+    .addFunction("GetGravity", &ParticleSystemComponent::GetGravity)
+    .addFunction("SetGravity", &ParticleSystemComponent::SetGravity)
+    .addFunction("GetDrag", &ParticleSystemComponent::GetDrag)
+    .addFunction("SetDrag", &ParticleSystemComponent::SetDrag)
+    .addFunction("SetSize", &ParticleSystemComponent::SetSize)
+    .addFunction("SetStartColor", &ParticleSystemComponent::SetStartColor)
+    .addFunction("SetEndColor", &ParticleSystemComponent::SetEndColor)
+    .addFunction("GetOffset", &ParticleSystemComponent::GetOffset)
+    .addFunction("SetOffset", &ParticleSystemComponent::SetOffset)
+    .addFunction("IsAdditive", &ParticleSystemComponent::IsAdditive)
+    .addFunction("SetAdditive", &ParticleSystemComponent::SetAdditive)
+    .addFunction("IsGpu", &ParticleSystemComponent::IsGpu)
+    .addFunction("SetGpu", &ParticleSystemComponent::SetGpu)
+    .addFunction("Emit", &ParticleSystemComponent::Emit)
+    .addFunction("Clear", &ParticleSystemComponent::Clear)
+    .addFunction("GetParticleCount", &ParticleSystemComponent::GetParticleCount)
+    .addFunction("SetEnabled", &ParticleSystemComponent::SetEnabled)
+    .addFunction("IsEnabled", &ParticleSystemComponent::GetEnabled)
+    .endClass();
 }
 
 std::shared_ptr<Component> ComponentDB::AddComponent(std::string component_name) {
@@ -0,0 +1,207 @@
+#include "DebugDraw.h"
+#include "ShaderDB.h"
+#include "GameObject.h"
+#include "LightComponent.h"
+
+#include <cmath>
+#include <cstring>
+
+#include <glm/gtc/constants.hpp>
+
+// x, y, z, color packed as RGBA8
+static const int FLOATS_PER_VERTEX = 4;
+// Line segments per circle
+static const int CIRCLE_SEGMENTS = 24;
+// A light is drawn out to where it adds less than one step of an 8 bit color
+static const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+bool DebugDraw::drawBounds = false;
+bool DebugDraw::drawLights = false;
+std::vector<float> DebugDraw::depthTestedLines;
+std::vector<float> DebugDraw::overlayLines;
+std::shared_ptr<Shader> DebugDraw::shader = nullptr;
+GLuint DebugDraw::vao = 0;
+std::unique_ptr<StreamBuffer> DebugDraw::stream = nullptr;
+
+static float PackColor(const glm::vec4& color) {
+  glm::vec4 clamped = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+  uint8_t bytes[4] = { static_cast<uint8_t>(clamped.r), static_cast<uint8_t>(clamped.g), static_cast<uint8_t>(clamped.b), static_cast<uint8_t>(clamped.a) };
+  float packed;
+  std::memcpy(&packed, bytes, sizeof(packed));
+  return packed;
+}
+
+// Two vectors perpendicular to normal and each other
+static void Basis(const glm::vec3& normal, glm::vec3& tangent, glm::vec3& bitangent) {
+  tangent = glm::normalize(glm::cross(normal, std::abs(normal.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f)));
+  bitangent = glm::cross(normal, tangent);
+}
+
+void DebugDraw::Init(bool bounds, bool lights) {
+  drawBounds = bounds;
+  drawLights = lights;
+  shader = ShaderDB::GetShader("shaders/vertex/debug.glsl", "shaders/fragment/debug.glsl");
+
+  // Attribute pointers are set per frame, at wherever the lines were streamed to
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glBindVertexArray(0);
+  stream = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, 64 * 1024);
+}
+
+void DebugDraw::Shutdown() {
+  depthTestedLines.clear();
+  overlayLines.clear();
+  if (vao) {
+    glDeleteVertexArrays(1, &vao);
+    vao = 0;
+  }
+  stream = nullptr;
+  shader = nullptr;
+}
+
+void DebugDraw::Line(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color, bool overlay) {
+  float packed = PackColor(color);
+  LinesFor(overlay).insert(LinesFor(overlay).end(), {
+    from.x, from.y, from.z, packed,
+    to.x, to.y, to.z, packed
+  });
+}
+
+void DebugDraw::Box(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color, bool overlay) {
+  glm::vec3 corners[8];
+  for (int i = 0; i < 8; ++i) {
+    corners[i] = glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+  }
+  // Each edge joins corners that differ in one axis
+  for (int i = 0; i < 8; ++i) {
+    for (int axis = 1; axis < 8; axis <<= 1) {
+      if (!(i & axis)) {
+        Line(corners[i], corners[i | axis], color, overlay);
+      }
+    }
+  }
+}
+
+void DebugDraw::Circle(const glm::vec3& center, const glm::vec3& normal, float radius, const glm::vec4& color, bool overlay) {
+  glm::vec3 tangent, bitangent;
+  Basis(glm::normalize(normal), tangent, bitangent);
+  glm::vec3 previous = center + tangent * radius;
+  for (int i = 1; i <= CIRCLE_SEGMENTS; ++i) {
+    float angle = glm::two_pi<float>() * i / CIRCLE_SEGMENTS;
+    glm::vec3 point = center + (tangent * std::cos(angle) + bitangent * std::sin(angle)) * radius;
+    Line(previous, point, color, overlay);
+    previous = point;
+  }
+}
+
+void DebugDraw::Sphere(const glm::vec3& center, float radius, const glm::vec4& color, bool overlay) {
+  Circle(center, glm::vec3(1.0f, 0.0f, 0.0f), radius, color, overlay);
+  Circle(center, glm::vec3(0.0f, 1.0f, 0.0f), radius, color, overlay);
+  Circle(center, glm::vec3(0.0f, 0.0f, 1.0f), radius, color, overlay);
+}
+
+void DebugDraw::Cone(const glm::vec3& apex, const glm::vec3& direction, float length, float angleDegrees, const glm::vec4& color, bool overlay) {
+  glm::vec3 axis = glm::normalize(direction);
+  glm::vec3 tangent, bitangent;
+  Basis(axis, tangent, bitangent);
+
+  float radius = length * std::tan(glm::radians(glm::clamp(angleDegrees, 0.0f, 89.0f)));
+  glm::vec3 base = apex + axis * length;
+  Circle(base, axis, radius, color, overlay);
+  for (const glm::vec3& side : { tangent, -tangent, bitangent, -bitangent }) {
+    Line(apex, base + side * radius, color, overlay);
+  }
+}
+
+void DebugDraw::Frustum(const glm::mat4& viewProjection, const glm::vec4& color, bool overlay) {
+  // Corners of clip space, taken back to the world
+  glm::mat4 inverse = glm::inverse(viewProjection);
+  glm::vec3 corners[8];
+  for (int i = 0; i < 8; ++i) {
+    glm::vec4 corner = inverse * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+    corners[i] = glm::vec3(corner) / corner.w;
+  }
+  for (int i = 0; i < 8; ++i) {
+    for (int axis = 1; axis < 8; axis <<= 1) {
+      if (!(i & axis)) {
+        Line(corners[i], corners[i | axis], color, overlay);
+      }
+    }
+  }
+}
+
+void DebugDraw::Light(const ShaderLight& light, bool overlay) {
+  glm::vec4 color = glm::vec4(light.color, 1.0f);
+  if (light.type == static_cast<int>(LightType::DIRECTIONAL)) {
+    glm::vec3 direction = glm::normalize(light.direction);
+    Line(light.position, light.position + direction, color, overlay);
+    Circle(light.position, direction, 0.25f, color, overlay);
+    return;
+  }
+
+  float range = LightComponent::GetRange(light, LIGHT_CUTOFF);
+  if (std::isinf(range)) {
+    // Never fades; just mark where it is
+    range = 0.25f;
+  }
+
+  if (light.type == static_cast<int>(LightType::SPOT)) {
+    float angle = glm::degrees(std::acos(glm::clamp(light.outerCutoffCos, -1.0f, 1.0f)));
+    Cone(light.position, light.direction, range, angle, color, overlay);
+  } else {
+    Sphere(light.position, range, color, overlay);
+  }
+}
+
+void DebugDraw::BuildFrame(DebugFrame& frame, const std::vector<std::shared_ptr<GameObject>>& objects, const std::vector<ShaderLight>& lights) {
+  if (drawBounds) {
+    glm::vec4 color = glm::vec4(0.2f, 1.0f, 0.2f, 1.0f);
+    for (const auto& object : objects) {
+      glm::vec3 min, max;
+      object->GetWorldBounds(min, max);
+      Box(min, max, color);
+    }
+  }
+  if (drawLights) {
+    for (const ShaderLight& light : lights) {
+      Light(light);
+    }
+  }
+
+  frame.vertices.clear();
+  frame.vertices.reserve(depthTestedLines.size() + overlayLines.size());
+  frame.vertices.insert(frame.vertices.end(), depthTestedLines.begin(), depthTestedLines.end());
+  frame.vertices.insert(frame.vertices.end(), overlayLines.begin(), overlayLines.end());
+  frame.depthTestedVertices = static_cast<int>(depthTestedLines.size() / FLOATS_PER_VERTEX);
+  depthTestedLines.clear();
+  overlayLines.clear();
+}
+
+void DebugDraw::Render(const DebugFrame& frame, const glm::mat4& view, const glm::mat4& projection) {
+  if (frame.vertices.empty()) {
+    return;
+  }
+
+  glBindVertexArray(vao);
+  size_t offset = stream->Write(frame.vertices.data(), frame.vertices.size() * sizeof(float));
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)offset);
+  glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, FLOATS_PER_VERTEX * sizeof(float), (void*)(offset + 3 * sizeof(float)));
+
+  shader->Use();
+  shader->SetMat4("viewProjection", projection * view);
+
+  int vertexCount = static_cast<int>(frame.vertices.size() / FLOATS_PER_VERTEX);
+  if (frame.depthTestedVertices > 0) {
+    glEnable(GL_DEPTH_TEST);
+    glDrawArrays(GL_LINES, 0, frame.depthTestedVertices);
+  }
+  if (vertexCount > frame.depthTestedVertices) {
+    glDisable(GL_DEPTH_TEST);
+    glDrawArrays(GL_LINES, frame.depthTestedVertices, vertexCount - frame.depthTestedVertices);
+    glEnable(GL_DEPTH_TEST);
+  }
+  glBindVertexArray(0);
+}
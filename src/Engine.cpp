@@ -13,6 +13,27 @@
 
 #include "Renderer.h"
 #include "Shader.h"
+#include "ShaderDB.h"
+#include "OcclusionCulling.h"
+#include "SoftwareOcclusion.h"
+#include "RenderCommandQueue.h"
+#include "JobSystem.h"
+#include "QualityGovernor.h"
+#include "GpuProfiler.h"
+#include "StreamBuffer.h"
+#include "FramePacer.h"
+#include "GameTime.h"
+#include "RenderThread.h"
+#include "SimdMath.h"
+#include "NullGL.h"
+#include "FrameCapture.h"
+#include "ParticleSystem.h"
+#include "ImageDB.h"
+#include "DebugDraw.h"
+#include "ImpostorSystem.h"
+#include "ShadowSystem.h"
+#include "Lightmaps.h"
+#include "LightProbes.h"
 
 #include "Mesh.h"
 #include "Shapes/Cube.h"
@@ -28,7 +49,7 @@ int Application::frameNumber = 0;
 bool DEBUG = false;
 
 // Engine initialization.
-Engine::Engine() {
+Engine::Engine(const LaunchOptions& options) : launchOptions(options) {
     if (!std::filesystem::exists("resources/")) {
         std::cout << "error: resources/ missing";
         std::exit(0);
@@ -40,14 +61,39 @@ Engine::Engine() {
 
     Application::frameNumber = 0;
 
-    // Start and initialize the lua shi
-    ComponentManager::Initialize();
-    ComponentDB::Init();
+    JobSystem::Init();
+
+    // Start and initialize the lua shi (replays don't run any)
+    if (launchOptions.replayPath.empty()) {
+        ComponentManager::Initialize();
+        ComponentDB::Init();
+    }
 
     SetupInitialProps();
 
     // Create Shader program
-    shaderProgram = std::make_shared<Shader>("shaders/vertex/vertex.glsl", "shaders/fragment/fragment.glsl");
+    ShaderDB::Init(renderingSettings.shaderCache, renderingSettings.shaderCacheDir);
+    ShaderDB::RegisterPermutation("shaders/vertex/vertex.glsl", "shaders/fragment/fragment.glsl");
+    OcclusionCulling::Init(renderingSettings.occlusionCulling);
+
+    // Software depth buffer keeps the window's aspect ratio
+    int occlusionWidth = renderingSettings.softwareOcclusionWidth;
+    int occlusionHeight = occlusionWidth * renderingSettings.cameraSize.y / std::max(1, renderingSettings.cameraSize.x);
+    SoftwareOcclusion::Init(renderingSettings.softwareOcclusion, renderingSettings.softwareOcclusionAsync, occlusionWidth, occlusionHeight);
+    GpuProfiler::Init(renderingSettings.gpuProfiler);
+    ParticleSystem::Init();
+    TextDB::Init();
+    ImageDB::Init();
+    DebugDraw::Init(renderingSettings.debugBounds, renderingSettings.debugLights);
+    ImpostorSystem::Init(renderingSettings.impostorDistance, renderingSettings.impostorFade, renderingSettings.impostorResolution, renderingSettings.impostorCache, renderingSettings.impostorCacheDir);
+    ShadowSystem::Init(renderingSettings.shadowResolution, renderingSettings.shadowCascades, renderingSettings.shadowDistance, renderingSettings.shadowFarCascadeInterval, renderingSettings.spotShadows);
+    FramePacer::Init(renderingSettings.vsync, renderingSettings.targetFps);
+    QualityGovernor::Init(renderingSettings.dynamicResolution, renderingSettings.targetFrameTimeMs, renderingSettings.minRenderScale, renderingSettings.maxRenderScale, renderingSettings.renderScale);
+    if (renderingSettings.shaderWarmup) {
+        ShaderDB::WarmUp();
+    }
+
+    shaderProgram = ShaderDB::GetShader("shaders/vertex/vertex.glsl", "shaders/fragment/fragment.glsl");
     if (!shaderProgram->GetID()) {
         // SDL_GL_DeleteContext(glContext);
         SDL_DestroyWindow(Renderer::window);
@@ -56,6 +102,12 @@ Engine::Engine() {
     }
 
     SetupShaderUniforms();
+
+    if (!launchOptions.replayPath.empty()) {
+        FrameCapture::CreateResources();
+    } else if (!launchOptions.capturePath.empty()) {
+        FrameCapture::StartRecording(launchOptions.capturePath, launchOptions.captureStart, launchOptions.captureFrames, renderingSettings.cameraSize.x, renderingSettings.cameraSize.y);
+    }
 }
 
 // Engine's gameloop.
@@ -77,14 +129,18 @@ void Engine::GameLoop() {
         100.0f
     );
 
-    float lastFrameTime = 0.0f;
-    float deltaTime = 0.0f;
+    // From here on the main thread only simulates; the render thread owns the
+    // window's context
+    bool threaded = renderingSettings.renderThread && RenderThread::Start([this](FramePacket& packet) {
+        RenderFrame(packet);
+    });
+
+    // Start the clock here so loading time doesn't land in the first frame
+    GameTime::Init(tick_rate, max_fixed_steps);
     
     while (running) {
-        // Calculate delta time
-        float currentTime = static_cast<float>(SDL_GetTicks()) / 1000.0f;
-        deltaTime = currentTime - lastFrameTime;
-        lastFrameTime = currentTime;
+        // Calculate delta time and queue up this frame's fixed steps
+        GameTime::BeginFrame();
 
         // Process input events
         if (Scene::load_new_scene) {
@@ -97,53 +153,206 @@ void Engine::GameLoop() {
         // Update camera direction based on yaw and pitch
         Renderer::UpdateCameraDirection();
 
-        // Get the view matrix with forward-looking camera
-        glm::mat4 view = Renderer::GetViewMatrix();
+        // Camera and lights are captured before scripts run, as they always were
+        FramePacket packet;
+        packet.frameNumber = Application::frameNumber;
+        packet.view = Renderer::GetViewMatrix();
+        packet.projection = projection;
+        packet.cameraPos = Renderer::GetCamPos();
+        packet.lights = LightComponent::GatherShaderLights(packet.cameraPos);
 
-        // Process events
+        // Process events (SDL wants this on the thread that made the window)
         running = Renderer::Update();
 
-        // Clear screen for renderer
-        Renderer::ClearScreen();
+        UpdateGame();
 
-        shaderProgram->Use();
+        GameObjectDB::UpdateAll(GameTime::GetDeltaTime(), GameTime::GetAlpha());
+        packet.objects = GameObjectDB::TakeRenderQueue();
+        Lightmaps::BuildFrame(packet.objects);
+        ParticleSystem::Update(GameTime::GetDeltaTime(), packet.particles, packet.gpuParticles);
+        ImageDB::BuildFrame(packet.sprites, packet.view);
+        DebugDraw::BuildFrame(packet.debug, packet.objects, packet.lights);
+        TextDB::BuildFrame(packet.text);
+        FrameCapture::Record(packet);
+        // Before impostors take far models out, so they still cast
+        ShadowSystem::BuildFrame(packet.shadows, packet.objects, packet.lights, packet.view, packet.projection);
+        // After recording, so replays get every model and pick their own
+        // impostors the same way
+        ImpostorSystem::BuildFrame(packet.impostors, packet.objects, packet.projection * packet.view, packet.cameraPos);
 
-        // Set view and projection (camera) uniforms
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+        // Process pending event subscriptions
+        EventSystem::ProcessPendingChanges();
 
-        LightComponent::ApplyAllLightsToShader(shaderProgram->GetID());
+        if (threaded) {
+            RenderThread::Submit(std::move(packet));
+        } else {
+            RenderFrame(packet);
+        }
 
-        UpdateGame();
+        Input::LateUpdate();
 
-        GameObjectDB::UpdateAll(deltaTime);
+        ++Application::frameNumber;
+        if (launchOptions.frameLimit > 0 && Application::frameNumber >= launchOptions.frameLimit) {
+            running = false;
+        }
+    }
 
-        // Render 3d scene objects
-        GameObjectDB::RenderAndClearObjects(shaderProgram->GetID(), modelLoc);
+    if (threaded) {
+        RenderThread::Stop();
+    }
 
-        // Render all of the queued stuff
-        // ImageDB::RenderAndClearImages();
+    FrameCapture::StopRecording();
 
-        // Render all of the queued text
-        // TextDB::RenderText();
+    if (Renderer::GetBackend() == Renderer::Backend::Null) {
+        NullGL::PrintReport();
+    }
 
-        // Render all of the queued pixels
-        // ImageDB::RenderAndClearPixels();
+    AudioDB::Shutdown();
+    ShutdownSystems();
+} 
 
-        // Process pending event subscriptions
-        EventSystem::ProcessPendingChanges();
-        
-        // Swap buffers at the end
-        Renderer::SwapBuffers();
+void Engine::ReplayLoop() {
+    glPolygonMode(GL_FRONT_AND_BACK, DEBUG ? GL_LINE : GL_FILL);
 
-        Input::LateUpdate();
+    int frameCount = FrameCapture::GetFrameCount();
+    int loops = std::max(launchOptions.replayLoops, 1);
+    std::vector<double> frameTimes;
+    frameTimes.reserve(static_cast<size_t>(frameCount) * loops);
+    double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
 
-        ++Application::frameNumber;
+    bool running = true;
+    for (int loop = 0; loop < loops && running; ++loop) {
+        for (int frame = 0; frame < frameCount && running; ++frame) {
+            // Only the renderer's share of the frame is timed
+            FramePacket packet;
+            FrameCapture::BuildPacket(frame, packet);
+            Lightmaps::BuildFrame(packet.objects);
+            ShadowSystem::BuildFrame(packet.shadows, packet.objects, packet.lights, packet.view, packet.projection);
+            ImpostorSystem::BuildFrame(packet.impostors, packet.objects, packet.projection * packet.view, packet.cameraPos);
+
+            Uint64 start = SDL_GetPerformanceCounter();
+            RenderFrame(packet);
+            frameTimes.push_back(static_cast<double>(SDL_GetPerformanceCounter() - start) * 1000.0 / frequency);
+
+            running = Renderer::Update();
+            ++Application::frameNumber;
+        }
     }
 
+    if (!frameTimes.empty()) {
+        std::vector<double> sorted = frameTimes;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (double time : frameTimes) {
+            total += time;
+        }
+        std::cout << "Replayed " << frameTimes.size() << " frames: avg " << total / frameTimes.size()
+                  << " ms, median " << sorted[sorted.size() / 2]
+                  << " ms, p95 " << sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)]
+                  << " ms, min " << sorted.front() << " ms, max " << sorted.back() << " ms" << std::endl;
+    }
+
+    if (Renderer::GetBackend() == Renderer::Backend::Null) {
+        NullGL::PrintReport();
+    }
+
+    FrameCapture::ReleaseResources();
+    ShutdownSystems();
+}
+
+void Engine::ShutdownSystems() {
+    OcclusionCulling::Shutdown();
+    SoftwareOcclusion::Shutdown();
+    QualityGovernor::Shutdown();
+    GpuProfiler::Shutdown();
+    ParticleSystem::Shutdown();
     TextDB::Shutdown();
-    AudioDB::Shutdown();
-} 
+    ImageDB::Shutdown();
+    DebugDraw::Shutdown();
+    ImpostorSystem::Shutdown();
+    ShadowSystem::Shutdown();
+    Lightmaps::Shutdown();
+    LightProbes::Shutdown();
+    ShaderDB::Shutdown();
+    JobSystem::Shutdown();
+}
+
+void Engine::RenderFrame(FramePacket& packet) {
+    glm::mat4 viewProjection = packet.projection * packet.view;
+    OcclusionCulling::SetCamera(packet.view, packet.projection, packet.cameraPos);
+    SoftwareOcclusion::SetCamera(viewProjection);
+    RenderCommandQueue::SetCamera(viewProjection, packet.cameraPos);
+
+    GpuProfiler::BeginFrame();
+    QualityGovernor::BeginFrame();
+
+    // Bakes into its own target, so before the scene's is bound
+    ImpostorSystem::Prepare(packet.impostors);
+
+    GpuProfiler::BeginPass("shadows");
+    ShadowSystem::Render(packet.shadows);
+    GpuProfiler::EndPass();
+
+    // Bind the (possibly scaled) scene target and clear it
+    GpuProfiler::BeginPass("clear");
+    Renderer::BeginScene();
+    GpuProfiler::EndPass();
+
+    shaderProgram->Use();
+
+    // Set view and projection (camera) uniforms
+    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(packet.view));
+    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(packet.projection));
+
+    GpuProfiler::BeginPass("lights");
+    LightComponent::UploadLights(shaderProgram->GetID(), packet.lights);
+    ShadowSystem::Apply(shaderProgram->GetID(), packet.shadows);
+    Lightmaps::Apply(shaderProgram->GetID());
+    LightProbes::Apply(shaderProgram->GetID());
+    GpuProfiler::EndPass();
+
+    // Render 3d scene objects
+    GpuProfiler::BeginPass("scene");
+    GameObjectDB::RenderObjects(packet.objects, shaderProgram->GetID(), modelLoc);
+    GpuProfiler::EndPass();
+
+    GpuProfiler::BeginPass("impostors");
+    ImpostorSystem::Render(packet.impostors, packet.view, packet.projection, packet.cameraPos, packet.lights);
+    GpuProfiler::EndPass();
+
+    // Blended, so after everything opaque
+    GpuProfiler::BeginPass("sprites");
+    ImageDB::RenderWorld(packet.sprites, packet.view, packet.projection);
+    GpuProfiler::EndPass();
+
+    GpuProfiler::BeginPass("particles");
+    ParticleSystem::Render(packet.particles, packet.gpuParticles, packet.view, packet.projection);
+    GpuProfiler::EndPass();
+
+    GpuProfiler::BeginPass("debug");
+    DebugDraw::Render(packet.debug, packet.view, packet.projection);
+    GpuProfiler::EndPass();
+
+    // Upscale the scene to the window
+    GpuProfiler::BeginPass("upscale");
+    Renderer::EndScene();
+    GpuProfiler::EndPass();
+
+    // UI images and text go on at window resolution, after the upscale
+    GpuProfiler::BeginPass("ui");
+    ImageDB::RenderScreen(packet.sprites);
+    TextDB::Render(packet.text);
+    GpuProfiler::EndPass();
+
+    QualityGovernor::EndFrame();
+    GpuProfiler::EndFrame();
+    StreamBuffer::EndFrame();
+
+    // Hold the frame for the FPS cap, then swap buffers at the end
+    FramePacer::WaitForNextFrame();
+    Renderer::SwapBuffers();
+    FramePacer::OnPresent();
+}
 
 void Engine::SetupInitialProps() {
     rapidjson::Document doc;
@@ -154,8 +363,21 @@ void Engine::SetupInitialProps() {
 
     std::string font_name = getJsonStringOrDefault(doc, "font", "");
     
+    // Simulation rate for OnFixedUpdate
+    tick_rate = getJsonIntOrDefault(doc, "tick_rate", 60);
+    max_fixed_steps = getJsonIntOrDefault(doc, "max_fixed_steps", 8);
+
+    // Batched transform math
+    simd_level = getJsonStringOrDefault(doc, "simd", "auto");
+    simd_benchmark = getJsonBoolOrDefault(doc, "simd_benchmark", false);
+    SimdMath::Init(simd_level);
+    if (simd_benchmark) {
+        SimdMath::RunBenchmarks();
+    }
+
     std::string initial_scene = getJsonStringOrDefault(doc, "initial_scene", "");
-    if (initial_scene.empty()) {
+    bool replaying = !launchOptions.replayPath.empty();
+    if (initial_scene.empty() && !replaying) {
         std::cout << "error: initial_scene unspecified";
         exit(0);
     }
@@ -171,24 +393,98 @@ void Engine::SetupInitialProps() {
         renderingSettings.colorB = getJsonIntOrDefault(doc, "clear_color_b", 255);
         renderingSettings.zoomFactor = getJsonFloatOrDefault(doc, "zoom_factor", 1.0f);
         DEBUG = getJsonBoolOrDefault(doc, "debug", false);
+
+        renderingSettings.shaderCache = getJsonBoolOrDefault(doc, "shader_cache", true);
+        renderingSettings.shaderCacheDir = getJsonStringOrDefault(doc, "shader_cache_dir", "shader_cache");
+        renderingSettings.shaderWarmup = getJsonBoolOrDefault(doc, "shader_warmup", false);
+        renderingSettings.occlusionCulling = getJsonBoolOrDefault(doc, "occlusion_culling", false);
+        renderingSettings.softwareOcclusion = getJsonBoolOrDefault(doc, "software_occlusion", false);
+        renderingSettings.softwareOcclusionAsync = getJsonBoolOrDefault(doc, "software_occlusion_async", true);
+        renderingSettings.softwareOcclusionWidth = getJsonIntOrDefault(doc, "software_occlusion_width", 256);
+        renderingSettings.dynamicResolution = getJsonBoolOrDefault(doc, "dynamic_resolution", false);
+        renderingSettings.targetFrameTimeMs = getJsonFloatOrDefault(doc, "target_frame_time_ms", 16.67f);
+        renderingSettings.minRenderScale = getJsonFloatOrDefault(doc, "min_render_scale", 0.5f);
+        renderingSettings.maxRenderScale = getJsonFloatOrDefault(doc, "max_render_scale", 1.0f);
+        renderingSettings.renderScale = getJsonFloatOrDefault(doc, "render_scale", 1.0f);
+        renderingSettings.gpuProfiler = getJsonBoolOrDefault(doc, "gpu_profiler", false);
+        renderingSettings.impostorDistance = getJsonFloatOrDefault(doc, "impostor_distance", 0.0f);
+        renderingSettings.impostorFade = getJsonFloatOrDefault(doc, "impostor_fade", 5.0f);
+        renderingSettings.impostorResolution = getJsonIntOrDefault(doc, "impostor_resolution", 1024);
+        renderingSettings.impostorCache = getJsonBoolOrDefault(doc, "impostor_cache", true);
+        renderingSettings.impostorCacheDir = getJsonStringOrDefault(doc, "impostor_cache_dir", "impostor_cache");
+        renderingSettings.shadowResolution = getJsonIntOrDefault(doc, "shadow_resolution", 0);
+        renderingSettings.shadowCascades = getJsonIntOrDefault(doc, "shadow_cascades", 3);
+        renderingSettings.shadowDistance = getJsonFloatOrDefault(doc, "shadow_distance", 50.0f);
+        renderingSettings.shadowFarCascadeInterval = getJsonIntOrDefault(doc, "shadow_far_cascade_interval", 4);
+        renderingSettings.spotShadows = getJsonIntOrDefault(doc, "spot_shadows", 2);
+        renderingSettings.lightmaps = getJsonBoolOrDefault(doc, "lightmaps", true);
+        renderingSettings.lightProbes = getJsonBoolOrDefault(doc, "light_probes", true);
+        renderingSettings.debugBounds = getJsonBoolOrDefault(doc, "debug_bounds", false);
+        renderingSettings.debugLights = getJsonBoolOrDefault(doc, "debug_lights", false);
+        renderingSettings.vsync = getJsonStringOrDefault(doc, "vsync", "on");
+        renderingSettings.targetFps = getJsonIntOrDefault(doc, "target_fps", 0);
+        renderingSettings.renderThread = getJsonBoolOrDefault(doc, "render_thread", false);
     }else{
         renderingSettings.cameraSize.x = 640;
         renderingSettings.cameraSize.y = 360;
     }
 
+    if (replaying) {
+        if (!FrameCapture::Load(launchOptions.replayPath)) {
+            exit(1);
+        }
+        // Draw at the captured size, and as fast as possible: nothing may
+        // pace frames or change the resolution between runs
+        renderingSettings.cameraSize.x = FrameCapture::GetWidth();
+        renderingSettings.cameraSize.y = FrameCapture::GetHeight();
+        renderingSettings.vsync = "off";
+        renderingSettings.targetFps = 0;
+        renderingSettings.dynamicResolution = false;
+        renderingSettings.renderThread = false;
+    }
+
+    if (launchOptions.nullRenderer) {
+        Renderer::SetBackend(Renderer::Backend::Null);
+    } else if (launchOptions.headless) {
+        Renderer::SetBackend(Renderer::Backend::Headless);
+    }
     Renderer::LoadRenderer(renderingSettings.cameraSize.x, renderingSettings.cameraSize.y, renderingSettings.colorR, renderingSettings.colorG, renderingSettings.colorB, renderingSettings.cameraSize, renderingSettings.zoomFactor, renderingSettings.cameraPos);
-    Renderer::RenderWindow(game_title);
+    Renderer::RenderWindow(replaying ? "ngine_replay" : game_title);
+
+    // Meshes pick up their lightmap UVs as they're created, so this goes
+    // before the scene, or a replay's captured meshes, load any
+    if (!initial_scene.empty()) {
+        std::string lightmapPath = "resources/lightmaps/" + initial_scene + ".lightmap";
+        if (renderingSettings.lightmaps && std::filesystem::exists(lightmapPath)) {
+            Lightmaps::Load(lightmapPath);
+        }
+        std::string probePath = "resources/lightmaps/" + initial_scene + ".probes";
+        if (renderingSettings.lightProbes && std::filesystem::exists(probePath)) {
+            LightProbes::Load(probePath);
+        }
+    }
+    if (replaying) {
+        return;
+    }
 
     current_scene = Scene();
     current_scene.LoadScene(initial_scene);
     
-    // TextDB::Init(Renderer::renderer);
     Input::Init();
     AudioDB::Init();
 }
 
 
 void Engine::UpdateGame() {
+    // Components added last frame get OnStart before their first fixed step
+    current_scene.StartPendingComponents();
+
+    while (GameTime::StepFixed()) {
+        GameObjectDB::BeginFixedStep();
+        current_scene.FixedUpdate();
+        GameObjectDB::EndFixedStep();
+    }
+
     current_scene.Update();
 }
 
@@ -0,0 +1,653 @@
+#include "FrameCapture.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+
+#include "GameObject.h"
+#include "Model.h"
+
+unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma = false);
+
+static const char MAGIC[8] = { 'N', 'G', 'C', 'A', 'P', 'T', 'U', 'R' };
+static const uint32_t VERSION = 4;
+static const int32_t NONE = -1;
+
+// Each record starts with one of these; resources always come before the
+// first frame that uses them
+enum RecordTag : uint8_t {
+  TAG_TEXTURE = 1,
+  TAG_MESH = 2,
+  TAG_MODEL = 3,
+  TAG_FRAME = 4
+};
+
+// A Material with its GL texture names swapped for capture indices
+struct CapturedMaterial {
+  int32_t diffuseMap;
+  int32_t specularMap;
+  int32_t normalMap;
+  glm::vec3 ambient;
+  glm::vec3 diffuse;
+  glm::vec3 specular;
+  float shininess;
+  int32_t useTexture;
+};
+
+struct CapturedObject {
+  int32_t mesh;
+  int32_t model;
+  int32_t isModel;
+  int32_t isOccluder;
+  int32_t isStatic;
+  glm::vec3 color;
+  CapturedMaterial material;
+  glm::mat4 worldMatrix;
+  glm::mat3 normalMatrix;
+  glm::vec3 boundsMin;
+  glm::vec3 boundsMax;
+};
+
+static_assert(std::is_trivially_copyable<CapturedObject>::value, "captured objects are written as raw bytes");
+static_assert(std::is_trivially_copyable<ShaderLight>::value, "lights are written as raw bytes");
+static_assert(std::is_trivially_copyable<GpuParticleEmitter>::value, "GPU emitters are written as raw bytes");
+static_assert(std::is_trivially_copyable<SpriteBatch>::value, "sprite batches are written as raw bytes");
+
+// Recording
+
+static std::ofstream output;
+static std::string outputPath;
+static bool recording = false;
+static int recordFirst = 0;
+static int recordLast = 0;
+static int recordedFrames = 0;
+
+// Every texture TextureFromFile has made, by GL name
+static std::mutex textureMutex;
+static std::unordered_map<unsigned int, std::pair<std::string, std::string>> textureFiles;
+
+static std::unordered_map<unsigned int, int32_t> recordedTextures;
+static std::unordered_map<const Mesh*, int32_t> recordedMeshes;
+static std::unordered_map<const Model*, int32_t> recordedModels;
+// Keeps written meshes and models alive, so a new one can't reuse an address
+// that's already in the maps above
+static std::vector<std::shared_ptr<const void>> recordedResources;
+
+template <typename T>
+static void Write(const T& value) {
+  static_assert(std::is_trivially_copyable<T>::value, "only plain data is written as bytes");
+  output.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static void WriteArray(const std::vector<T>& values) {
+  static_assert(std::is_trivially_copyable<T>::value, "only plain data is written as bytes");
+  Write(static_cast<uint32_t>(values.size()));
+  output.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+static void WriteString(const std::string& value) {
+  Write(static_cast<uint32_t>(value.size()));
+  output.write(value.data(), value.size());
+}
+
+static int32_t RecordTexture(unsigned int id) {
+  if (id == 0 || id == UINT_MAX) {
+    return NONE;
+  }
+  auto recorded = recordedTextures.find(id);
+  if (recorded != recordedTextures.end()) {
+    return recorded->second;
+  }
+
+  std::pair<std::string, std::string> file;
+  {
+    std::lock_guard<std::mutex> lock(textureMutex);
+    auto it = textureFiles.find(id);
+    if (it == textureFiles.end()) {
+      // Not from a file, so it can't be loaded again; replays draw untextured
+      return NONE;
+    }
+    file = it->second;
+  }
+
+  int32_t index = static_cast<int32_t>(recordedTextures.size());
+  recordedTextures[id] = index;
+  Write(TAG_TEXTURE);
+  Write(index);
+  WriteString(file.first);
+  WriteString(file.second);
+  return index;
+}
+
+static CapturedMaterial CaptureMaterial(const Material& material) {
+  CapturedMaterial captured;
+  captured.diffuseMap = RecordTexture(material.diffuseMap);
+  captured.specularMap = RecordTexture(material.specularMap);
+  captured.normalMap = RecordTexture(material.normalMap);
+  captured.ambient = material.ambient;
+  captured.diffuse = material.diffuse;
+  captured.specular = material.specular;
+  captured.shininess = material.shininess;
+  captured.useTexture = material.useTexture ? 1 : 0;
+  return captured;
+}
+
+static int32_t RecordMesh(const std::shared_ptr<Mesh>& mesh) {
+  if (!mesh) {
+    return NONE;
+  }
+  auto recorded = recordedMeshes.find(mesh.get());
+  if (recorded != recordedMeshes.end()) {
+    return recorded->second;
+  }
+
+  // Textures first, so their records come before the mesh's
+  CapturedMaterial material = CaptureMaterial(mesh->material);
+  std::vector<int32_t> textures;
+  for (const Texture& texture : mesh->textures) {
+    textures.push_back(RecordTexture(texture.id));
+  }
+
+  int32_t index = static_cast<int32_t>(recordedMeshes.size());
+  recordedMeshes[mesh.get()] = index;
+  recordedResources.push_back(mesh);
+  Write(TAG_MESH);
+  Write(index);
+  Write(static_cast<int32_t>(mesh->vertexStride));
+  WriteArray(mesh->vertices);
+  WriteArray(mesh->indices);
+  Write(material);
+  WriteArray(textures);
+  for (const Texture& texture : mesh->textures) {
+    WriteString(texture.type);
+  }
+  return index;
+}
+
+static int32_t RecordModel(const std::shared_ptr<Model>& model) {
+  if (!model) {
+    return NONE;
+  }
+  auto recorded = recordedModels.find(model.get());
+  if (recorded != recordedModels.end()) {
+    return recorded->second;
+  }
+
+  std::vector<int32_t> meshes;
+  for (const auto& mesh : model->meshes) {
+    meshes.push_back(RecordMesh(mesh));
+  }
+
+  int32_t index = static_cast<int32_t>(recordedModels.size());
+  recordedModels[model.get()] = index;
+  recordedResources.push_back(model);
+  Write(TAG_MODEL);
+  Write(index);
+  WriteArray(meshes);
+  Write(model->boundsMin);
+  Write(model->boundsMax);
+  WriteArray(model->occluderTriangles ? *model->occluderTriangles : std::vector<glm::vec3>());
+  return index;
+}
+
+bool FrameCapture::StartRecording(const std::string& path, int firstFrame, int frameCount, int width, int height) {
+  StopRecording();
+
+  output.open(path, std::ios::binary | std::ios::trunc);
+  if (!output) {
+    std::cerr << "Failed to open capture file " << path << std::endl;
+    return false;
+  }
+
+  output.write(MAGIC, sizeof(MAGIC));
+  Write(VERSION);
+  // Replays built with a different layout refuse the file instead of misreading it
+  Write(static_cast<uint32_t>(sizeof(CapturedObject)));
+  Write(static_cast<uint32_t>(sizeof(ShaderLight)));
+  Write(static_cast<uint32_t>(sizeof(GpuParticleEmitter)));
+  Write(static_cast<int32_t>(width));
+  Write(static_cast<int32_t>(height));
+
+  outputPath = path;
+  recordFirst = firstFrame;
+  recordLast = firstFrame + std::max(frameCount, 1) - 1;
+  recordedFrames = 0;
+  recording = true;
+  std::cout << "Capturing frames " << recordFirst << " to " << recordLast << " to " << path << std::endl;
+  return true;
+}
+
+void FrameCapture::StopRecording() {
+  if (!recording) {
+    return;
+  }
+  recording = false;
+  output.close();
+  recordedTextures.clear();
+  recordedMeshes.clear();
+  recordedModels.clear();
+  recordedResources.clear();
+  std::cout << "Captured " << recordedFrames << " frames to " << outputPath << std::endl;
+}
+
+bool FrameCapture::IsRecording() {
+  return recording;
+}
+
+void FrameCapture::Record(const FramePacket& packet) {
+  if (!recording || packet.frameNumber < recordFirst) {
+    return;
+  }
+
+  // Resource records are written here, ahead of the frame that needs them
+  std::vector<CapturedObject> objects;
+  objects.reserve(packet.objects.size());
+  for (const auto& gameObject : packet.objects) {
+    CapturedObject object;
+    object.mesh = RecordMesh(gameObject->mesh);
+    object.model = RecordModel(gameObject->model);
+    object.isModel = gameObject->isModel ? 1 : 0;
+    object.isOccluder = gameObject->isOccluder ? 1 : 0;
+    object.isStatic = gameObject->isStatic ? 1 : 0;
+    object.color = gameObject->color;
+    object.material = CaptureMaterial(gameObject->material);
+    object.worldMatrix = gameObject->GetDrawMatrix();
+    object.normalMatrix = gameObject->GetNormalMatrix();
+    gameObject->GetWorldBounds(object.boundsMin, object.boundsMax);
+    objects.push_back(object);
+  }
+
+  // Atlases are only sent to the renderer as they change, so the first frame
+  // carries them whole for the replay to start from
+  std::vector<SpritePageUpload> firstUploads;
+  TextFrame firstText;
+  if (recordedFrames == 0) {
+    ImageDB::SnapshotPages(firstUploads);
+    firstText = packet.text;
+    TextDB::SnapshotAtlas(firstText);
+  }
+  const std::vector<SpritePageUpload>& uploads = recordedFrames == 0 ? firstUploads : packet.sprites.uploads;
+  const TextFrame& text = recordedFrames == 0 ? firstText : packet.text;
+
+  Write(TAG_FRAME);
+  Write(static_cast<int32_t>(packet.frameNumber));
+  Write(packet.view);
+  Write(packet.projection);
+  Write(packet.cameraPos);
+  WriteArray(packet.lights);
+  WriteArray(objects);
+
+  Write(static_cast<uint32_t>(packet.particles.size()));
+  for (const ParticleBatch& batch : packet.particles) {
+    Write(static_cast<int32_t>(batch.count));
+    Write(static_cast<int32_t>(batch.additive ? 1 : 0));
+    WriteArray(batch.instances);
+  }
+  WriteArray(packet.gpuParticles);
+
+  WriteArray(packet.sprites.vertices);
+  WriteArray(packet.sprites.batches);
+  Write(static_cast<uint32_t>(uploads.size()));
+  for (const SpritePageUpload& upload : uploads) {
+    Write(static_cast<int32_t>(upload.page));
+    Write(static_cast<int32_t>(upload.width));
+    Write(static_cast<int32_t>(upload.height));
+    Write(static_cast<int32_t>(upload.top));
+    Write(static_cast<int32_t>(upload.rows));
+    WriteArray(upload.pixels);
+  }
+
+  WriteArray(text.vertices);
+  Write(static_cast<int32_t>(text.dirtyTop));
+  Write(static_cast<int32_t>(text.dirtyRows));
+  WriteArray(text.dirtyPixels);
+
+  WriteArray(packet.debug.vertices);
+  Write(static_cast<int32_t>(packet.debug.depthTestedVertices));
+  ++recordedFrames;
+
+  if (packet.frameNumber >= recordLast) {
+    StopRecording();
+  }
+}
+
+void FrameCapture::NoteTexture(unsigned int id, const std::string& directory, const std::string& path) {
+  std::lock_guard<std::mutex> lock(textureMutex);
+  textureFiles[id] = { directory, path };
+}
+
+// Replay
+
+struct LoadedTexture {
+  std::string directory;
+  std::string path;
+};
+
+struct LoadedMesh {
+  int32_t stride = 9;
+  std::vector<float> vertices;
+  std::vector<unsigned int> indices;
+  CapturedMaterial material;
+  std::vector<int32_t> textures;
+  std::vector<std::string> textureTypes;
+};
+
+struct LoadedModel {
+  std::vector<int32_t> meshes;
+  glm::vec3 boundsMin;
+  glm::vec3 boundsMax;
+  std::vector<glm::vec3> occluderTriangles;
+};
+
+struct LoadedFrame {
+  int32_t frameNumber = 0;
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec3 cameraPos;
+  std::vector<ShaderLight> lights;
+  std::vector<CapturedObject> objects;
+  std::vector<ParticleBatch> particles;
+  std::vector<GpuParticleEmitter> gpuParticles;
+  SpriteFrame sprites;
+  TextFrame text;
+  DebugFrame debug;
+};
+
+static int replayWidth = 0;
+static int replayHeight = 0;
+static std::vector<LoadedTexture> loadedTextures;
+static std::vector<LoadedMesh> loadedMeshes;
+static std::vector<LoadedModel> loadedModels;
+static std::vector<LoadedFrame> loadedFrames;
+
+// GL resources made from the above, by capture index
+static std::vector<unsigned int> textureIds;
+static std::vector<std::shared_ptr<Mesh>> meshes;
+static std::vector<std::shared_ptr<Model>> models;
+
+// Reads from the whole file in memory; any read past the end clears ok
+struct CaptureReader {
+  const std::vector<char>& data;
+  size_t offset = 0;
+  bool ok = true;
+
+  bool Read(void* out, size_t size) {
+    if (!ok || data.size() - offset < size) {
+      ok = false;
+      return false;
+    }
+    std::memcpy(out, data.data() + offset, size);
+    offset += size;
+    return true;
+  }
+
+  template <typename T>
+  T Read() {
+    T value{};
+    Read(&value, sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  void ReadArray(std::vector<T>& values) {
+    uint32_t count = Read<uint32_t>();
+    if (!ok || (data.size() - offset) / sizeof(T) < count) {
+      ok = false;
+      return;
+    }
+    values.resize(count);
+    Read(values.data(), count * sizeof(T));
+  }
+
+  std::string ReadString() {
+    uint32_t length = Read<uint32_t>();
+    if (!ok || data.size() - offset < length) {
+      ok = false;
+      return std::string();
+    }
+    std::string value(data.data() + offset, length);
+    offset += length;
+    return value;
+  }
+};
+
+bool FrameCapture::Load(const std::string& path) {
+  std::ifstream input(path, std::ios::binary);
+  if (!input) {
+    std::cerr << "Failed to open capture " << path << std::endl;
+    return false;
+  }
+  std::vector<char> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+  CaptureReader reader{ data };
+  char magic[sizeof(MAGIC)];
+  if (!reader.Read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+    std::cerr << path << " is not a frame capture" << std::endl;
+    return false;
+  }
+  uint32_t version = reader.Read<uint32_t>();
+  uint32_t objectSize = reader.Read<uint32_t>();
+  uint32_t lightSize = reader.Read<uint32_t>();
+  uint32_t emitterSize = version == VERSION ? reader.Read<uint32_t>() : 0;
+  if (version != VERSION || objectSize != sizeof(CapturedObject) || lightSize != sizeof(ShaderLight) || emitterSize != sizeof(GpuParticleEmitter)) {
+    std::cerr << path << " was captured by an incompatible build" << std::endl;
+    return false;
+  }
+  replayWidth = reader.Read<int32_t>();
+  replayHeight = reader.Read<int32_t>();
+
+  loadedTextures.clear();
+  loadedMeshes.clear();
+  loadedModels.clear();
+  loadedFrames.clear();
+
+  // A capture cut short (Application.Quit mid-recording) still replays up to
+  // its last whole frame
+  while (reader.ok && reader.offset < data.size()) {
+    uint8_t tag = reader.Read<uint8_t>();
+    int32_t index = tag == TAG_FRAME ? 0 : reader.Read<int32_t>();
+    if (tag == TAG_TEXTURE && index == static_cast<int32_t>(loadedTextures.size())) {
+      LoadedTexture texture;
+      texture.directory = reader.ReadString();
+      texture.path = reader.ReadString();
+      if (reader.ok) {
+        loadedTextures.push_back(texture);
+      }
+    } else if (tag == TAG_MESH && index == static_cast<int32_t>(loadedMeshes.size())) {
+      LoadedMesh mesh;
+      mesh.stride = reader.Read<int32_t>();
+      reader.ReadArray(mesh.vertices);
+      reader.ReadArray(mesh.indices);
+      mesh.material = reader.Read<CapturedMaterial>();
+      reader.ReadArray(mesh.textures);
+      for (size_t i = 0; i < mesh.textures.size() && reader.ok; ++i) {
+        mesh.textureTypes.push_back(reader.ReadString());
+      }
+      if (reader.ok) {
+        loadedMeshes.push_back(std::move(mesh));
+      }
+    } else if (tag == TAG_MODEL && index == static_cast<int32_t>(loadedModels.size())) {
+      LoadedModel model;
+      reader.ReadArray(model.meshes);
+      model.boundsMin = reader.Read<glm::vec3>();
+      model.boundsMax = reader.Read<glm::vec3>();
+      reader.ReadArray(model.occluderTriangles);
+      if (reader.ok) {
+        loadedModels.push_back(std::move(model));
+      }
+    } else if (tag == TAG_FRAME) {
+      LoadedFrame frame;
+      frame.frameNumber = reader.Read<int32_t>();
+      frame.view = reader.Read<glm::mat4>();
+      frame.projection = reader.Read<glm::mat4>();
+      frame.cameraPos = reader.Read<glm::vec3>();
+      reader.ReadArray(frame.lights);
+      reader.ReadArray(frame.objects);
+
+      uint32_t particleBatches = reader.Read<uint32_t>();
+      for (uint32_t i = 0; i < particleBatches && reader.ok; ++i) {
+        ParticleBatch batch;
+        batch.count = reader.Read<int32_t>();
+        batch.additive = reader.Read<int32_t>() != 0;
+        reader.ReadArray(batch.instances);
+        frame.particles.push_back(std::move(batch));
+      }
+      reader.ReadArray(frame.gpuParticles);
+
+      reader.ReadArray(frame.sprites.vertices);
+      reader.ReadArray(frame.sprites.batches);
+      uint32_t uploads = reader.Read<uint32_t>();
+      for (uint32_t i = 0; i < uploads && reader.ok; ++i) {
+        SpritePageUpload upload;
+        upload.page = reader.Read<int32_t>();
+        upload.width = reader.Read<int32_t>();
+        upload.height = reader.Read<int32_t>();
+        upload.top = reader.Read<int32_t>();
+        upload.rows = reader.Read<int32_t>();
+        reader.ReadArray(upload.pixels);
+        frame.sprites.uploads.push_back(std::move(upload));
+      }
+
+      reader.ReadArray(frame.text.vertices);
+      frame.text.dirtyTop = reader.Read<int32_t>();
+      frame.text.dirtyRows = reader.Read<int32_t>();
+      reader.ReadArray(frame.text.dirtyPixels);
+
+      reader.ReadArray(frame.debug.vertices);
+      frame.debug.depthTestedVertices = reader.Read<int32_t>();
+      if (reader.ok) {
+        loadedFrames.push_back(std::move(frame));
+      }
+    } else if (reader.ok) {
+      std::cerr << path << " has a bad record at byte " << reader.offset << ", stopping there" << std::endl;
+      break;
+    }
+  }
+
+  std::cout << "Loaded " << loadedFrames.size() << " frames, " << loadedMeshes.size() << " meshes, "
+            << loadedModels.size() << " models and " << loadedTextures.size() << " textures from " << path << std::endl;
+  return !loadedFrames.empty();
+}
+
+static unsigned int TextureId(int32_t index) {
+  return index >= 0 && index < static_cast<int32_t>(textureIds.size()) ? textureIds[index] : UINT_MAX;
+}
+
+static Material RestoreMaterial(const CapturedMaterial& captured) {
+  Material material;
+  material.diffuseMap = TextureId(captured.diffuseMap);
+  material.specularMap = TextureId(captured.specularMap);
+  material.normalMap = TextureId(captured.normalMap);
+  material.ambient = captured.ambient;
+  material.diffuse = captured.diffuse;
+  material.specular = captured.specular;
+  material.shininess = captured.shininess;
+  material.useTexture = captured.useTexture != 0;
+  return material;
+}
+
+void FrameCapture::CreateResources() {
+  ReleaseResources();
+
+  for (const LoadedTexture& texture : loadedTextures) {
+    textureIds.push_back(TextureFromFile(texture.path.c_str(), texture.directory));
+  }
+
+  for (const LoadedMesh& loaded : loadedMeshes) {
+    Material material = RestoreMaterial(loaded.material);
+    std::shared_ptr<Mesh> mesh;
+    if (loaded.stride >= 11) {
+      std::vector<Texture> textures;
+      for (size_t i = 0; i < loaded.textures.size(); ++i) {
+        textures.push_back({ TextureId(loaded.textures[i]), loaded.textureTypes[i], "" });
+      }
+      mesh = std::make_shared<Mesh>(loaded.vertices, loaded.indices, textures, material);
+    } else {
+      mesh = std::make_shared<Mesh>(loaded.vertices, loaded.indices);
+      mesh->material = material;
+    }
+    meshes.push_back(mesh);
+  }
+
+  for (const LoadedModel& loaded : loadedModels) {
+    auto model = std::make_shared<Model>();
+    for (int32_t index : loaded.meshes) {
+      if (index >= 0 && index < static_cast<int32_t>(meshes.size())) {
+        model->meshes.push_back(meshes[index]);
+      }
+    }
+    model->boundsMin = loaded.boundsMin;
+    model->boundsMax = loaded.boundsMax;
+    if (!loaded.occluderTriangles.empty()) {
+      model->occluderTriangles = std::make_shared<const std::vector<glm::vec3>>(loaded.occluderTriangles);
+    }
+    models.push_back(model);
+  }
+}
+
+void FrameCapture::ReleaseResources() {
+  models.clear();
+  meshes.clear();
+  for (unsigned int id : textureIds) {
+    if (id != UINT_MAX) {
+      glDeleteTextures(1, &id);
+    }
+  }
+  textureIds.clear();
+}
+
+int FrameCapture::GetFrameCount() {
+  return static_cast<int>(loadedFrames.size());
+}
+
+int FrameCapture::GetWidth() {
+  return replayWidth;
+}
+
+int FrameCapture::GetHeight() {
+  return replayHeight;
+}
+
+void FrameCapture::BuildPacket(int frame, FramePacket& packet) {
+  const LoadedFrame& loaded = loadedFrames[frame];
+  packet.frameNumber = loaded.frameNumber;
+  packet.view = loaded.view;
+  packet.projection = loaded.projection;
+  packet.cameraPos = loaded.cameraPos;
+  packet.lights = loaded.lights;
+  packet.particles = loaded.particles;
+  packet.gpuParticles = loaded.gpuParticles;
+  packet.sprites = loaded.sprites;
+  packet.text = loaded.text;
+  packet.debug = loaded.debug;
+  packet.objects.clear();
+  packet.objects.reserve(loaded.objects.size());
+
+  for (const CapturedObject& captured : loaded.objects) {
+    if (captured.mesh < 0 || captured.mesh >= static_cast<int32_t>(meshes.size())) {
+      continue;
+    }
+    auto gameObject = std::make_shared<GameObject>();
+    gameObject->mesh = meshes[captured.mesh];
+    if (captured.model >= 0 && captured.model < static_cast<int32_t>(models.size())) {
+      gameObject->model = models[captured.model];
+    }
+    gameObject->isModel = captured.isModel != 0;
+    gameObject->isOccluder = captured.isOccluder != 0;
+    gameObject->isStatic = captured.isStatic != 0;
+    gameObject->color = captured.color;
+    gameObject->material = RestoreMaterial(captured.material);
+    // Straight into the caches UpdateWorldMatrices would have filled
+    gameObject->worldMatrix = captured.worldMatrix;
+    gameObject->normalMatrix = captured.normalMatrix;
+    gameObject->worldBoundsMin = captured.boundsMin;
+    gameObject->worldBoundsMax = captured.boundsMax;
+    packet.objects.push_back(gameObject);
+  }
+}
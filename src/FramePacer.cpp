@@ -0,0 +1,204 @@
+#include "FramePacer.h"
+#include "Renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+// A present this much later than expected counts as a missed frame
+static const float MISSED_FRAME_FACTOR = 1.5f;
+
+std::atomic<FramePacer::VsyncMode> FramePacer::vsyncMode(FramePacer::VsyncMode::On);
+std::atomic<bool> FramePacer::vsyncChanged(false);
+std::atomic<int> FramePacer::targetFps(0);
+int FramePacer::pacedFps = 0;
+
+Uint64 FramePacer::nextFrameTicks = 0;
+Uint64 FramePacer::lastPresentTicks = 0;
+
+double FramePacer::sleepEstimate = 0.005;
+double FramePacer::sleepMean = 0.005;
+double FramePacer::sleepM2 = 0.0;
+int64_t FramePacer::sleepSamples = 1;
+
+FramePacer::Stats FramePacer::stats;
+std::mutex FramePacer::statsMutex;
+
+void FramePacer::Init(const std::string& vsync, int fps) {
+  SetVsync(vsync);
+  ApplyVsyncMode();
+  SetTargetFps(fps);
+  lastPresentTicks = 0;
+  stats = Stats();
+}
+
+void FramePacer::WaitForNextFrame() {
+  if (vsyncChanged) {
+    ApplyVsyncMode();
+  }
+
+  int fps = targetFps;
+  if (fps <= 0) {
+    return;
+  }
+
+  Uint64 frequency = SDL_GetPerformanceFrequency();
+  Uint64 period = frequency / static_cast<Uint64>(fps);
+  Uint64 now = SDL_GetPerformanceCounter();
+
+  // A new cap starts a new schedule
+  if (fps != pacedFps) {
+    pacedFps = fps;
+    nextFrameTicks = 0;
+  }
+
+  // Deadlines advance by whole periods so small overshoots don't add up.
+  // After a long hitch, start over instead of rushing to catch up.
+  if (nextFrameTicks == 0 || now > nextFrameTicks + period) {
+    nextFrameTicks = now;
+  }
+
+  if (now < nextFrameTicks) {
+    PreciseSleep(static_cast<double>(nextFrameTicks - now) / static_cast<double>(frequency));
+  }
+  nextFrameTicks += period;
+}
+
+void FramePacer::OnPresent() {
+  Uint64 now = SDL_GetPerformanceCounter();
+  if (lastPresentTicks != 0) {
+    double ticksToMs = 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+    float intervalMs = static_cast<float>((now - lastPresentTicks) * ticksToMs);
+
+    // What the interval should be: the cap, or the refresh rate if vsync is
+    // holding us to it. Uncapped without vsync there's nothing to miss.
+    double expectedMs = 0.0;
+    int fps = targetFps;
+    if (fps > 0) {
+      expectedMs = 1000.0 / fps;
+    }
+    if (vsyncMode != VsyncMode::Off) {
+      expectedMs = std::max(expectedMs, GetRefreshInterval() * 1000.0);
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    stats.lastIntervalMs = intervalMs;
+    stats.expectedIntervalMs = static_cast<float>(expectedMs);
+    stats.averageIntervalMs = stats.averageIntervalMs == 0.0f ? intervalMs : stats.averageIntervalMs + (intervalMs - stats.averageIntervalMs) * 0.05f;
+    if (expectedMs > 0.0 && intervalMs > expectedMs * MISSED_FRAME_FACTOR) {
+      ++stats.missedFrames;
+    }
+  }
+  lastPresentTicks = now;
+}
+
+void FramePacer::PreciseSleep(double seconds) {
+  // Sleep in 1ms steps while the worst likely sleep still fits, learning how
+  // long those sleeps actually take, then spin off the remainder.
+  Uint64 frequency = SDL_GetPerformanceFrequency();
+  while (seconds > sleepEstimate) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    double observed = static_cast<double>(SDL_GetPerformanceCounter() - start) / static_cast<double>(frequency);
+    seconds -= observed;
+
+    // Welford's running mean/variance, estimate = mean + one deviation
+    ++sleepSamples;
+    double delta = observed - sleepMean;
+    sleepMean += delta / sleepSamples;
+    sleepM2 += delta * (observed - sleepMean);
+    sleepEstimate = sleepMean + std::sqrt(sleepM2 / (sleepSamples - 1));
+  }
+
+  Uint64 end = SDL_GetPerformanceCounter() + static_cast<Uint64>(std::max(seconds, 0.0) * frequency);
+  while (SDL_GetPerformanceCounter() < end) {
+    std::this_thread::yield();
+  }
+}
+
+double FramePacer::GetRefreshInterval() {
+  SDL_DisplayMode mode;
+  if (Renderer::window && SDL_GetWindowDisplayMode(Renderer::window, &mode) == 0 && mode.refresh_rate > 0) {
+    return 1.0 / mode.refresh_rate;
+  }
+  return 1.0 / 60.0;
+}
+
+void FramePacer::SetVsyncMode(VsyncMode mode) {
+  // The swap interval belongs to the context, so it's set where we present
+  vsyncMode = mode;
+  vsyncChanged = true;
+}
+
+void FramePacer::ApplyVsyncMode() {
+  vsyncChanged = false;
+  // No window to sync to when headless or on the null renderer
+  if (!Renderer::HasWindow()) {
+    return;
+  }
+  VsyncMode mode = vsyncMode;
+  int interval = mode == VsyncMode::Off ? 0 : (mode == VsyncMode::On ? 1 : -1);
+  if (SDL_GL_SetSwapInterval(interval) != 0) {
+    if (mode == VsyncMode::Adaptive) {
+      // Late swap tearing isn't supported everywhere - plain vsync is closest
+      std::cout << "Adaptive vsync not supported, using vsync" << std::endl;
+      vsyncMode = VsyncMode::On;
+      ApplyVsyncMode();
+      return;
+    }
+    std::cerr << "Failed to set swap interval: " << SDL_GetError() << std::endl;
+  }
+}
+
+FramePacer::VsyncMode FramePacer::GetVsyncMode() {
+  return vsyncMode;
+}
+
+FramePacer::Stats FramePacer::GetStats() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  return stats;
+}
+
+void FramePacer::SetVsync(const std::string& vsync) {
+  if (vsync == "off") {
+    SetVsyncMode(VsyncMode::Off);
+  } else if (vsync == "adaptive") {
+    SetVsyncMode(VsyncMode::Adaptive);
+  } else {
+    if (vsync != "on") {
+      std::cout << "Unknown vsync mode " << vsync << ", using on" << std::endl;
+    }
+    SetVsyncMode(VsyncMode::On);
+  }
+}
+
+std::string FramePacer::GetVsync() {
+  switch (vsyncMode.load()) {
+    case VsyncMode::Off: return "off";
+    case VsyncMode::Adaptive: return "adaptive";
+    default: return "on";
+  }
+}
+
+void FramePacer::SetTargetFps(int fps) {
+  targetFps = std::max(fps, 0);
+}
+
+int FramePacer::GetTargetFps() {
+  return targetFps;
+}
+
+float FramePacer::GetFrameInterval() {
+  return GetStats().averageIntervalMs;
+}
+
+float FramePacer::GetFps() {
+  float intervalMs = GetStats().averageIntervalMs;
+  return intervalMs > 0.0f ? 1000.0f / intervalMs : 0.0f;
+}
+
+int FramePacer::GetMissedFrames() {
+  return GetStats().missedFrames;
+}
@@ -0,0 +1,48 @@
+#include "GLExtensions.h"
+
+bool GLExtensions::programBinary = false;
+bool GLExtensions::conservativeOcclusion = false;
+bool GLExtensions::bufferStorage = false;
+
+PFN_glGetProgramBinary GLExtensions::GetProgramBinary = nullptr;
+PFN_glProgramBinary GLExtensions::ProgramBinary = nullptr;
+PFN_glProgramParameteri GLExtensions::ProgramParameteri = nullptr;
+PFN_glBufferStorage GLExtensions::BufferStorage = nullptr;
+
+void GLExtensions::Load(GLADloadproc loader) {
+  // Program binaries - also require at least one binary format, some drivers
+  // expose the entry points but never hand out a binary.
+  if (IsVersionAtLeast(4, 1) || HasExtension("GL_ARB_get_program_binary")) {
+    GetProgramBinary = reinterpret_cast<PFN_glGetProgramBinary>(loader("glGetProgramBinary"));
+    ProgramBinary = reinterpret_cast<PFN_glProgramBinary>(loader("glProgramBinary"));
+    ProgramParameteri = reinterpret_cast<PFN_glProgramParameteri>(loader("glProgramParameteri"));
+
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    programBinary = GetProgramBinary && ProgramBinary && ProgramParameteri && numFormats > 0;
+  }
+
+  conservativeOcclusion = IsVersionAtLeast(4, 3) || HasExtension("GL_ARB_ES3_compatibility");
+
+  // Persistently mapped stream buffers
+  if (IsVersionAtLeast(4, 4) || HasExtension("GL_ARB_buffer_storage")) {
+    BufferStorage = reinterpret_cast<PFN_glBufferStorage>(loader("glBufferStorage"));
+    bufferStorage = BufferStorage != nullptr;
+  }
+}
+
+bool GLExtensions::HasExtension(const std::string& name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; ++i) {
+    const char* ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+    if (ext && name == ext) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool GLExtensions::IsVersionAtLeast(int major, int minor) {
+  return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
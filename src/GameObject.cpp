@@ -10,6 +10,7 @@
 #include "Shapes/Sphere.h"
 #include "Shapes/Plane.h"
 #include "Model.h"
+#include "SimdMath.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -20,19 +21,14 @@ unsigned int TextureFromFile(const char *path, const std::string &directory, boo
 void GameObject::Draw(GLuint shaderProgram, GLint modelLoc) {
   if (!isActive || !mesh) return;
 
-  // Set up model matrix
-  glm::mat4 model = glm::mat4(1.0f);
-  model = glm::translate(model, position);
-  model = glm::rotate(model, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-  model = glm::rotate(model, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-  model = glm::rotate(model, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
-  model = glm::scale(model, scale);
-  
-  // Pass model matrix to shader
-  glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+  // Pass the cached world and normal matrices to the shader
+  glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(worldMatrix));
+  glUniformMatrix3fv(glGetUniformLocation(shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
 
   // Set the vertex color
   glUniform3fv(glGetUniformLocation(shaderProgram, "ourColor"), 1, glm::value_ptr(color));
+  glUniform1f(glGetUniformLocation(shaderProgram, "fadeOut"), fadeOut);
+  glUniform4fv(glGetUniformLocation(shaderProgram, "lightmapRect"), 1, glm::value_ptr(lightmapRect));
   
   // For models, we let each mesh handle its own materials
   if(isModel) {
@@ -50,19 +46,82 @@ void GameObject::Update(float deltaTime) {
 }
 
 glm::mat4 GameObject::GetModelMatrix() const {
-  glm::mat4 modelMatrix = glm::mat4(1.0f);
-  
-  // Apply transformations in order: scale, rotate, translate
-  modelMatrix = glm::translate(modelMatrix, position);
-  
-  // Apply rotations around each axis
-  modelMatrix = glm::rotate(modelMatrix, rotation.x, glm::vec3(1.0f, 0.0f, 0.0f));
-  modelMatrix = glm::rotate(modelMatrix, rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
-  modelMatrix = glm::rotate(modelMatrix, rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
-  
-  modelMatrix = glm::scale(modelMatrix, scale);
-  
-  return modelMatrix;
+  return TransformSystem::Compose(position, rotation, scale);
+}
+
+// Scratch arrays for UpdateWorldMatrices, kept between frames
+struct WorldMatrixBatch {
+  std::vector<float> positionX, positionY, positionZ;
+  std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+  std::vector<float> scaleX, scaleY, scaleZ;
+  std::vector<glm::mat4> matrices;
+  std::vector<glm::mat3> normals;
+  std::vector<glm::vec3> localMin, localMax, worldMin, worldMax;
+};
+static WorldMatrixBatch batch;
+
+void GameObject::UpdateWorldMatrices(const std::vector<std::shared_ptr<GameObject>>& objects) {
+  int count = static_cast<int>(objects.size());
+  for (auto* values : { &batch.positionX, &batch.positionY, &batch.positionZ, &batch.rotationX, &batch.rotationY, &batch.rotationZ, &batch.rotationW, &batch.scaleX, &batch.scaleY, &batch.scaleZ }) {
+    values->resize(count);
+  }
+  batch.matrices.resize(count);
+  batch.normals.resize(count);
+  batch.localMin.resize(count);
+  batch.localMax.resize(count);
+  batch.worldMin.resize(count);
+  batch.worldMax.resize(count);
+
+  // Objects keep Euler angles, so the trig happens here; the rest is batched
+  for (int i = 0; i < count; ++i) {
+    const GameObject& gameObject = *objects[i];
+    glm::quat rotation = SimdMath::EulerToQuat(gameObject.rotation);
+    batch.positionX[i] = gameObject.position.x;
+    batch.positionY[i] = gameObject.position.y;
+    batch.positionZ[i] = gameObject.position.z;
+    batch.rotationX[i] = rotation.x;
+    batch.rotationY[i] = rotation.y;
+    batch.rotationZ[i] = rotation.z;
+    batch.rotationW[i] = rotation.w;
+    batch.scaleX[i] = gameObject.scale.x;
+    batch.scaleY[i] = gameObject.scale.y;
+    batch.scaleZ[i] = gameObject.scale.z;
+    gameObject.GetLocalBounds(batch.localMin[i], batch.localMax[i]);
+  }
+
+  TransformStreams streams = {
+    batch.positionX.data(), batch.positionY.data(), batch.positionZ.data(),
+    batch.rotationX.data(), batch.rotationY.data(), batch.rotationZ.data(), batch.rotationW.data(),
+    batch.scaleX.data(), batch.scaleY.data(), batch.scaleZ.data()
+  };
+  SimdMath::ComposeTRS(count, streams, batch.matrices.data());
+  for (int i = 0; i < count; ++i) {
+    if (objects[i]->parentTransform != TransformSystem::INVALID) {
+      SimdMath::Multiply(TransformSystem::GetWorldMatrix(objects[i]->parentTransform), batch.matrices[i], batch.matrices[i]);
+    }
+  }
+  SimdMath::NormalMatrices(count, batch.matrices.data(), batch.normals.data());
+  SimdMath::TransformBounds(count, batch.matrices.data(), batch.localMin.data(), batch.localMax.data(), batch.worldMin.data(), batch.worldMax.data());
+
+  for (int i = 0; i < count; ++i) {
+    GameObject& gameObject = *objects[i];
+    gameObject.worldMatrix = batch.matrices[i];
+    gameObject.normalMatrix = batch.normals[i];
+    gameObject.worldBoundsMin = batch.worldMin[i];
+    gameObject.worldBoundsMax = batch.worldMax[i];
+  }
+}
+
+void GameObject::GetLocalBounds(glm::vec3& outMin, glm::vec3& outMax) const {
+  if (isModel && model) {
+    outMin = model->boundsMin;
+    outMax = model->boundsMax;
+  } else if (mesh) {
+    outMin = mesh->boundsMin;
+    outMax = mesh->boundsMax;
+  } else {
+    outMin = outMax = glm::vec3(0.0f);
+  }
 }
 
 std::shared_ptr<GameObject> GameObject::CreateCube(float size) {
@@ -5,6 +5,13 @@
 
 #include "GameObjectDB.h"
 #include "Renderer.h"
+#include "OcclusionCulling.h"
+#include "SoftwareOcclusion.h"
+#include "GpuProfiler.h"
+#include "RenderCommandQueue.h"
+#include "TransformComponent.h"
+
+#include <filesystem>
 
 unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma = false);
 
@@ -12,18 +19,74 @@ unsigned int TextureFromFile(const char *path, const std::string &directory, boo
 std::vector<std::shared_ptr<GameObject>> GameObjectDB::allGameObjects;
 std::vector<std::shared_ptr<GameObject>> GameObjectDB::renderQueue;
 std::unordered_map<std::string, std::shared_ptr<GameObject>> GameObjectDB::gameObjectMap;
+std::vector<std::shared_ptr<GameObject>> GameObjectDB::currentFixedObjects;
+std::vector<std::shared_ptr<GameObject>> GameObjectDB::previousFixedObjects;
+bool GameObjectDB::inFixedStep = false;
 static std::unordered_map<std::string, unsigned int> textureCache;
 
+// Identifies a resubmitted object by what it draws and how many times that was
+// drawn before it in the same step
+static uint64_t SubmissionKey(const GameObject& gameObject, std::unordered_map<const void*, uint32_t>& ordinals) {
+  const void* geometry = (gameObject.isModel && gameObject.model) ? static_cast<const void*>(gameObject.model.get()) : static_cast<const void*>(gameObject.mesh.get());
+  uint32_t ordinal = ordinals[geometry]++;
+  return (reinterpret_cast<uintptr_t>(geometry) * 31ull) ^ (static_cast<uint64_t>(ordinal) << 48);
+}
+
+// Euler angles in degrees, taking the short way round
+static glm::vec3 LerpDegrees(const glm::vec3& from, const glm::vec3& to, float alpha) {
+  glm::vec3 delta = glm::mod(to - from + glm::vec3(180.0f), glm::vec3(360.0f)) - glm::vec3(180.0f);
+  return from + delta * alpha;
+}
+
+// Marks a model as a software occluder if it ships a proxy mesh or was registered from Lua
+static void ApplyOccluderSettings(const std::string& name, const std::shared_ptr<GameObject>& gameObject) {
+  if (!gameObject->model || gameObject->isOccluder) {
+    return;
+  }
+
+  std::string proxyFp = "resources/models/" + name + "/" + name + "_occluder.obj";
+  if (!gameObject->model->occluderTriangles && std::filesystem::exists(proxyFp)) {
+    gameObject->model->LoadOccluderProxy(proxyFp);
+  } else if (SoftwareOcclusion::IsOccluderModel(name)) {
+    gameObject->model->UseMeshesAsOccluder();
+  }
+
+  gameObject->isOccluder = gameObject->model->occluderTriangles != nullptr;
+}
+
 void GameObjectDB::Init() {
   // Clear any existing objects
   allGameObjects.clear();
   renderQueue.clear();
+  currentFixedObjects.clear();
+  previousFixedObjects.clear();
 }
 
 void GameObjectDB::Shutdown() {
   // Clean up all game objects
   allGameObjects.clear();
   renderQueue.clear();
+  currentFixedObjects.clear();
+  previousFixedObjects.clear();
+}
+
+void GameObjectDB::Track(const std::shared_ptr<GameObject>& gameObject) {
+  if (inFixedStep) {
+    currentFixedObjects.push_back(gameObject);
+  } else {
+    allGameObjects.push_back(gameObject);
+  }
+}
+
+void GameObjectDB::BeginFixedStep() {
+  // What the last step drew becomes the state we interpolate from
+  previousFixedObjects.swap(currentFixedObjects);
+  currentFixedObjects.clear();
+  inFixedStep = true;
+}
+
+void GameObjectDB::EndFixedStep() {
+  inFixedStep = false;
 }
 
 std::shared_ptr<GameObject> GameObjectDB::CreateCube(float size, const glm::vec3& position) {
@@ -34,7 +97,7 @@ std::shared_ptr<GameObject> GameObjectDB::CreateCube(float size, const glm::vec3
   if(gameObjectMap.find(key) != gameObjectMap.end()) {
     auto gameObject = std::make_shared<GameObject>(*gameObjectMap[key]);
     gameObject->position = position; // Update position
-    allGameObjects.push_back(gameObject);
+    Track(gameObject);
     return gameObject;
   }
   
@@ -44,8 +107,8 @@ std::shared_ptr<GameObject> GameObjectDB::CreateCube(float size, const glm::vec3
   gameObject->mesh = Shape::Cube::Create(size);
   
   // Cache the cube
-  gameObjectMap[key] = gameObject;
-  allGameObjects.push_back(gameObject);
+  gameObjectMap[key] = std::make_shared<GameObject>(*gameObject);
+  Track(gameObject);
   return gameObject;
 }
 
@@ -59,7 +122,7 @@ std::shared_ptr<GameObject> GameObjectDB::CreateSphere(float radius, const glm::
   if(gameObjectMap.find(key) != gameObjectMap.end()) {
     auto gameObject = std::make_shared<GameObject>(*gameObjectMap[key]);
     gameObject->position = position; // Update position
-    allGameObjects.push_back(gameObject);
+    Track(gameObject);
     return gameObject;
   }
   
@@ -70,8 +133,8 @@ std::shared_ptr<GameObject> GameObjectDB::CreateSphere(float radius, const glm::
   gameObject->mesh = Shape::Sphere::Create(radius, color, segments);
   
   // Cache the sphere
-  gameObjectMap[key] = gameObject;
-  allGameObjects.push_back(gameObject);
+  gameObjectMap[key] = std::make_shared<GameObject>(*gameObject);
+  Track(gameObject);
   return gameObject;
 }
 
@@ -85,7 +148,7 @@ std::shared_ptr<GameObject> GameObjectDB::CreatePlane(float width, float length,
   if(gameObjectMap.find(key) != gameObjectMap.end()) {
     auto gameObject = std::make_shared<GameObject>(*gameObjectMap[key]);
     gameObject->position = position; // Update position
-    allGameObjects.push_back(gameObject);
+    Track(gameObject);
     return gameObject;
   }
   
@@ -102,8 +165,8 @@ std::shared_ptr<GameObject> GameObjectDB::CreatePlane(float width, float length,
   gameObject->material.shininess = 32.0f;
   
   // Cache the plane
-  gameObjectMap[key] = gameObject;
-  allGameObjects.push_back(gameObject);
+  gameObjectMap[key] = std::make_shared<GameObject>(*gameObject);
+  Track(gameObject);
   return gameObject;
 }
 
@@ -115,7 +178,7 @@ std::shared_ptr<GameObject> GameObjectDB::CreateTexturedPlane(const std::string&
   if(gameObjectMap.find(key) != gameObjectMap.end()) {
     auto gameObject = std::make_shared<GameObject>(*gameObjectMap[key]);
     gameObject->position = position; // Update position
-    allGameObjects.push_back(gameObject);
+    Track(gameObject);
     return gameObject;
   }
   
@@ -155,8 +218,8 @@ std::shared_ptr<GameObject> GameObjectDB::CreateTexturedPlane(const std::string&
   gameObject->material.diffuseMap = textureID;
   
   // Cache the textured plane
-  gameObjectMap[key] = gameObject;
-  allGameObjects.push_back(gameObject);
+  gameObjectMap[key] = std::make_shared<GameObject>(*gameObject);
+  Track(gameObject);
   return gameObject;
 }
 
@@ -165,42 +228,86 @@ std::shared_ptr<GameObject> GameObjectDB::LoadModel(const std::string& name, con
   std::string key = "model_" + name;
   
   if(gameObjectMap.find(key) != gameObjectMap.end()) {
+    // Occluders can be registered after the model was first loaded
+    if (SoftwareOcclusion::IsOccluderModel(name)) {
+      ApplyOccluderSettings(name, gameObjectMap[key]);
+    }
+
     // Create a COPY of the cached model (not reuse the same one)
     auto gameObject = std::make_shared<GameObject>(*gameObjectMap[key]);
     gameObject->position = position;
     gameObject->scale = scale;
     gameObject->isModel = true;
 
-    allGameObjects.push_back(gameObject);
+    Track(gameObject);
     return gameObject;
   } else {
     auto gameObject = GameObject::LoadModel(name, scale);
     gameObject->position = position;
     gameObject->isModel = true;
+    ApplyOccluderSettings(name, gameObject);
     
-    // Cache the model template (not the positioned instance)
-    gameObjectMap[key] = gameObject;
-    allGameObjects.push_back(gameObject);
+    // Cache the model template (a copy, so changes to this instance don't stick)
+    gameObjectMap[key] = std::make_shared<GameObject>(*gameObject);
+    Track(gameObject);
     return gameObject;
   }
 }
 
+void GameObjectDB::Attach(std::shared_ptr<GameObject> gameObject, TransformComponent* transform) {
+  if (gameObject) {
+    gameObject->parentTransform = transform ? transform->GetHandle() : TransformSystem::INVALID;
+  }
+}
+
+void GameObjectDB::SetStatic(std::shared_ptr<GameObject> gameObject, bool isStatic) {
+  if (gameObject) {
+    gameObject->isStatic = isStatic;
+  }
+}
+
 void GameObjectDB::RenderAndClearObjects(GLuint shaderProgram, GLint modelLoc) {
+  RenderObjects(TakeRenderQueue(), shaderProgram, modelLoc);
+}
+
+std::vector<std::shared_ptr<GameObject>> GameObjectDB::TakeRenderQueue() {
+  // The caller now owns this frame's objects; the next frame starts empty
+  std::vector<std::shared_ptr<GameObject>> queue;
+  queue.swap(renderQueue);
+  allGameObjects.clear();
+  GameObject::UpdateWorldMatrices(queue);
+  return queue;
+}
+
+void GameObjectDB::RenderObjects(const std::vector<std::shared_ptr<GameObject>>& queue, GLuint shaderProgram, GLint modelLoc) {
 
   // Enable depth testing for proper 3D rendering
   glEnable(GL_DEPTH_TEST);
   
+  // Drop objects hidden in the software depth buffer before anything reaches GL
+  const std::vector<std::shared_ptr<GameObject>>* drawQueue = &queue;
+  std::vector<std::shared_ptr<GameObject>> unoccluded;
+  if (SoftwareOcclusion::IsEnabled()) {
+    SoftwareOcclusion::Cull(queue, unoccluded);
+    drawQueue = &unoccluded;
+  }
+
   // Render all objects in the queue
-  for (auto& gameObject : renderQueue) {
-    gameObject->Draw(shaderProgram, modelLoc);
+  GpuProfiler::BeginPass("opaque");
+  if (OcclusionCulling::IsEnabled()) {
+    OcclusionCulling::RenderQueue(*drawQueue, shaderProgram, modelLoc);
+  } else {
+    // Workers cull and record commands, then this thread sorts and draws them
+    RenderCommandQueue::Build(*drawQueue);
+    RenderCommandQueue::Execute(shaderProgram, modelLoc);
   }
-  
-  // Clear the queue after rendering
-  renderQueue.clear();
-  allGameObjects.clear();
+  GpuProfiler::EndPass();
 }
 
-void GameObjectDB::UpdateAll(float deltaTime) {
+void GameObjectDB::UpdateAll(float deltaTime, float alpha) {
+  // Bring transforms moved by scripts up to date before objects read them
+  TransformSystem::Update();
+
   // Update all game objects and queue them for rendering
   for (auto& gameObject : allGameObjects) {
     if (gameObject->isActive) {
@@ -214,6 +321,32 @@ void GameObjectDB::UpdateAll(float deltaTime) {
       QueueForRendering(gameObject);
     }
   }
+
+  // Objects drawn from OnFixedUpdate are shown between their last two
+  // simulation states. They persist until the next step replaces them.
+  std::unordered_map<uint64_t, const GameObject*> previous;
+  std::unordered_map<const void*, uint32_t> ordinals;
+  for (const auto& gameObject : previousFixedObjects) {
+    previous[SubmissionKey(*gameObject, ordinals)] = gameObject.get();
+  }
+  ordinals.clear();
+
+  for (const auto& gameObject : currentFixedObjects) {
+    auto it = previous.find(SubmissionKey(*gameObject, ordinals));
+    if (!gameObject->isActive) {
+      continue;
+    }
+
+    auto interpolated = std::make_shared<GameObject>(*gameObject);
+    if (it != previous.end()) {
+      const GameObject& from = *it->second;
+      interpolated->position = glm::mix(from.position, gameObject->position, alpha);
+      interpolated->rotation = LerpDegrees(from.rotation, gameObject->rotation, alpha);
+      interpolated->scale = glm::mix(from.scale, gameObject->scale, alpha);
+    }
+    interpolated->Update(deltaTime);
+    QueueForRendering(interpolated);
+  }
 }
 
 
@@ -0,0 +1,92 @@
+#include "GameTime.h"
+
+#include <algorithm>
+
+// Frames longer than this (breakpoints, window drags) count as this long
+static const double MAX_FRAME_TIME = 0.25;
+
+Uint64 GameTime::startTicks = 0;
+Uint64 GameTime::lastTicks = 0;
+double GameTime::deltaTime = 0.0;
+double GameTime::time = 0.0;
+double GameTime::fixedTime = 0.0;
+double GameTime::fixedDeltaTime = 1.0 / 60.0;
+double GameTime::accumulator = 0.0;
+int GameTime::tickRate = 60;
+int GameTime::maxStepsPerFrame = 8;
+int GameTime::stepsThisFrame = 0;
+
+void GameTime::Init(int rate, int maxSteps) {
+  SetTickRate(rate);
+  maxStepsPerFrame = std::max(maxSteps, 1);
+
+  startTicks = SDL_GetPerformanceCounter();
+  lastTicks = startTicks;
+  deltaTime = 0.0;
+  time = 0.0;
+  fixedTime = 0.0;
+  accumulator = 0.0;
+  stepsThisFrame = 0;
+}
+
+void GameTime::BeginFrame() {
+  Uint64 now = SDL_GetPerformanceCounter();
+  double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+
+  deltaTime = std::min(static_cast<double>(now - lastTicks) / frequency, MAX_FRAME_TIME);
+  time = static_cast<double>(now - startTicks) / frequency;
+  lastTicks = now;
+
+  accumulator += deltaTime;
+  stepsThisFrame = 0;
+}
+
+bool GameTime::StepFixed() {
+  if (accumulator < fixedDeltaTime) {
+    return false;
+  }
+
+  // Out of steps for this frame - drop the backlog rather than carry it over
+  if (stepsThisFrame >= maxStepsPerFrame) {
+    accumulator = std::min(accumulator, fixedDeltaTime * 0.999);
+    return false;
+  }
+
+  accumulator -= fixedDeltaTime;
+  fixedTime += fixedDeltaTime;
+  ++stepsThisFrame;
+  return true;
+}
+
+float GameTime::GetDeltaTime() {
+  return static_cast<float>(deltaTime);
+}
+
+float GameTime::GetFixedDeltaTime() {
+  return static_cast<float>(fixedDeltaTime);
+}
+
+double GameTime::GetFixedTime() {
+  return fixedTime;
+}
+
+double GameTime::GetTime() {
+  return time;
+}
+
+float GameTime::GetAlpha() {
+  return static_cast<float>(std::clamp(accumulator / fixedDeltaTime, 0.0, 1.0));
+}
+
+int GameTime::GetStepsThisFrame() {
+  return stepsThisFrame;
+}
+
+void GameTime::SetTickRate(int rate) {
+  tickRate = std::max(rate, 1);
+  fixedDeltaTime = 1.0 / tickRate;
+}
+
+int GameTime::GetTickRate() {
+  return tickRate;
+}
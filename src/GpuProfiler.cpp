@@ -0,0 +1,273 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+std::atomic<bool> GpuProfiler::enabled(false);
+bool GpuProfiler::frameActive = false;
+int GpuProfiler::frameIndex = 0;
+std::atomic<int> GpuProfiler::droppedFrames(0);
+
+GpuProfiler::FrameSlot GpuProfiler::slots[FRAME_RING_SIZE];
+std::vector<int> GpuProfiler::openMarkers;
+
+std::vector<GpuProfiler::PassHistory> GpuProfiler::passes;
+std::unordered_map<std::string, int> GpuProfiler::passLookup;
+std::mutex GpuProfiler::historyMutex;
+
+void GpuProfiler::Init(bool enable) {
+  enabled = enable;
+  frameActive = false;
+  frameIndex = 0;
+  droppedFrames = 0;
+}
+
+void GpuProfiler::Shutdown() {
+  for (auto& slot : slots) {
+    if (!slot.queries.empty()) {
+      glDeleteQueries(static_cast<GLsizei>(slot.queries.size()), slot.queries.data());
+    }
+    slot = FrameSlot();
+  }
+  openMarkers.clear();
+  {
+    std::lock_guard<std::mutex> lock(historyMutex);
+    passes.clear();
+    passLookup.clear();
+  }
+  frameActive = false;
+}
+
+void GpuProfiler::SetEnabled(bool enable) {
+  // Takes effect from the next BeginFrame so a frame is never half-measured
+  enabled = enable;
+}
+
+bool GpuProfiler::IsEnabled() {
+  return enabled;
+}
+
+void GpuProfiler::BeginFrame() {
+  frameActive = enabled;
+  if (!frameActive) {
+    return;
+  }
+
+  // The GPU is more than a ring behind - throw that frame away rather than wait
+  FrameSlot& slot = slots[frameIndex % FRAME_RING_SIZE];
+  if (slot.pending && !TryReadBack(slot)) {
+    ++droppedFrames;
+  }
+  slot.pending = false;
+  slot.queriesUsed = 0;
+  slot.markers.clear();
+  openMarkers.clear();
+
+  BeginPass("frame");
+}
+
+void GpuProfiler::EndFrame() {
+  if (!frameActive) {
+    return;
+  }
+
+  // Close anything a caller forgot, then the frame itself
+  while (!openMarkers.empty()) {
+    EndPass();
+  }
+  frameActive = false;
+
+  slots[frameIndex % FRAME_RING_SIZE].pending = true;
+  ++frameIndex;
+
+  // Pick up whatever older frames have finished, oldest first
+  for (int age = FRAME_RING_SIZE - 1; age >= 1; --age) {
+    int index = frameIndex - age;
+    if (index < 0) {
+      continue;
+    }
+    FrameSlot& slot = slots[index % FRAME_RING_SIZE];
+    if (slot.pending && TryReadBack(slot)) {
+      slot.pending = false;
+    }
+  }
+}
+
+void GpuProfiler::BeginPass(const std::string& name) {
+  if (!frameActive) {
+    return;
+  }
+
+  FrameSlot& slot = slots[frameIndex % FRAME_RING_SIZE];
+  Marker marker;
+  marker.pass = FindOrAddPass(name);
+  marker.beginQuery = AllocateQuery(slot);
+  marker.endQuery = AllocateQuery(slot);
+
+  // Timestamps rather than GL_TIME_ELAPSED so passes can nest
+  glQueryCounter(marker.beginQuery, GL_TIMESTAMP);
+  openMarkers.push_back(static_cast<int>(slot.markers.size()));
+  slot.markers.push_back(marker);
+}
+
+void GpuProfiler::EndPass() {
+  if (!frameActive || openMarkers.empty()) {
+    return;
+  }
+
+  FrameSlot& slot = slots[frameIndex % FRAME_RING_SIZE];
+  glQueryCounter(slot.markers[openMarkers.back()].endQuery, GL_TIMESTAMP);
+  openMarkers.pop_back();
+}
+
+int GpuProfiler::FindOrAddPass(const std::string& name) {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  auto it = passLookup.find(name);
+  if (it != passLookup.end()) {
+    return it->second;
+  }
+
+  PassHistory history;
+  history.name = name;
+  history.samples.resize(HISTORY_SIZE, 0.0f);
+  passes.push_back(history);
+
+  int index = static_cast<int>(passes.size()) - 1;
+  passLookup[name] = index;
+  return index;
+}
+
+GLuint GpuProfiler::AllocateQuery(FrameSlot& slot) {
+  // Queries are kept per slot and reused every time the slot comes around
+  if (slot.queriesUsed == static_cast<int>(slot.queries.size())) {
+    GLuint query = 0;
+    glGenQueries(1, &query);
+    slot.queries.push_back(query);
+  }
+  return slot.queries[slot.queriesUsed++];
+}
+
+bool GpuProfiler::TryReadBack(FrameSlot& slot) {
+  if (slot.markers.empty()) {
+    return true;
+  }
+
+  // The frame marker's end is issued last and queries complete in order, so
+  // once it's ready every other result is too
+  GLuint available = GL_FALSE;
+  glGetQueryObjectuiv(slot.markers.front().endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(historyMutex);
+  std::vector<float> frameTotals(passes.size(), 0.0f);
+  std::vector<bool> seen(passes.size(), false);
+  for (const Marker& marker : slot.markers) {
+    GLuint64 begin = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(marker.beginQuery, GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(marker.endQuery, GL_QUERY_RESULT, &end);
+    if (end > begin) {
+      frameTotals[marker.pass] += static_cast<float>(end - begin) / 1000000.0f;
+    }
+    seen[marker.pass] = true;
+  }
+
+  for (size_t i = 0; i < passes.size(); ++i) {
+    if (!seen[i]) {
+      continue;
+    }
+    PassHistory& history = passes[i];
+    history.lastMs = frameTotals[i];
+    history.samples[history.next] = frameTotals[i];
+    history.next = (history.next + 1) % HISTORY_SIZE;
+    history.count = std::min(history.count + 1, HISTORY_SIZE);
+  }
+  return true;
+}
+
+float GpuProfiler::Percentile(const PassHistory& history, float percentile) {
+  if (history.count == 0) {
+    return 0.0f;
+  }
+
+  std::vector<float> sorted(history.samples.begin(), history.samples.begin() + history.count);
+  size_t rank = static_cast<size_t>(std::clamp(percentile, 0.0f, 100.0f) / 100.0f * (sorted.size() - 1) + 0.5f);
+  std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+  return sorted[rank];
+}
+
+GpuProfiler::PassStats GpuProfiler::GetPassStats(const std::string& name) {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  auto it = passLookup.find(name);
+  if (it == passLookup.end()) {
+    PassStats stats;
+    stats.name = name;
+    return stats;
+  }
+  return StatsFor(passes[it->second]);
+}
+
+GpuProfiler::PassStats GpuProfiler::StatsFor(const PassHistory& history) {
+  PassStats stats;
+  stats.name = history.name;
+  stats.samples = history.count;
+  stats.lastMs = history.lastMs;
+  if (history.count == 0) {
+    return stats;
+  }
+
+  float total = 0.0f;
+  for (int i = 0; i < history.count; ++i) {
+    total += history.samples[i];
+  }
+  stats.averageMs = total / history.count;
+  stats.p50Ms = Percentile(history, 50.0f);
+  stats.p95Ms = Percentile(history, 95.0f);
+  stats.p99Ms = Percentile(history, 99.0f);
+  return stats;
+}
+
+std::vector<GpuProfiler::PassStats> GpuProfiler::GetAllPassStats() {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  std::vector<PassStats> all;
+  all.reserve(passes.size());
+  for (const auto& history : passes) {
+    all.push_back(StatsFor(history));
+  }
+  return all;
+}
+
+int GpuProfiler::GetDroppedFrames() {
+  return droppedFrames;
+}
+
+float GpuProfiler::GetPassTime(const std::string& name) {
+  return GetPassStats(name).averageMs;
+}
+
+float GpuProfiler::GetLastPassTime(const std::string& name) {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  auto it = passLookup.find(name);
+  return it == passLookup.end() ? 0.0f : passes[it->second].lastMs;
+}
+
+float GpuProfiler::GetPassPercentile(const std::string& name, float percentile) {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  auto it = passLookup.find(name);
+  return it == passLookup.end() ? 0.0f : Percentile(passes[it->second], percentile);
+}
+
+std::string GpuProfiler::GetReport() {
+  std::ostringstream report;
+  char line[128];
+  std::snprintf(line, sizeof(line), "%-16s %8s %8s %8s %8s\n", "pass", "avg ms", "p50", "p95", "p99");
+  report << line;
+  for (const auto& stats : GetAllPassStats()) {
+    std::snprintf(line, sizeof(line), "%-16s %8.3f %8.3f %8.3f %8.3f\n", stats.name.c_str(), stats.averageMs, stats.p50Ms, stats.p95Ms, stats.p99Ms);
+    report << line;
+  }
+  return report.str();
+}
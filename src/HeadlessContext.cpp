@@ -0,0 +1,259 @@
+#include "HeadlessContext.h"
+
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef NGINE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+GLuint HeadlessContext::framebuffer = 0;
+GLuint HeadlessContext::colorBuffer = 0;
+GLuint HeadlessContext::depthBuffer = 0;
+
+#ifdef NGINE_EGL
+
+// EGL state stays in this file so the header doesn't need EGL
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLConfig config = nullptr;
+static EGLContext mainContext = EGL_NO_CONTEXT;
+static bool surfaceless = false;
+// Without surfaceless contexts each context needs a pbuffer of its own, since
+// a surface can only be current on one thread at a time
+static std::unordered_map<EGLContext, EGLSurface> pbuffers;
+static std::mutex pbufferMutex;
+
+static bool HasExtension(const char* extensions, const char* name) {
+  if (!extensions) {
+    return false;
+  }
+  size_t length = std::strlen(name);
+  for (const char* found = std::strstr(extensions, name); found; found = std::strstr(found + length, name)) {
+    bool startsWord = found == extensions || found[-1] == ' ';
+    bool endsWord = found[length] == ' ' || found[length] == '\0';
+    if (startsWord && endsWord) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static EGLDisplay OpenDisplay() {
+  // Mesa's surfaceless platform needs no X server, Wayland or DRM device
+  const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (HasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) {
+      EGLDisplay surfacelessDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+      if (surfacelessDisplay != EGL_NO_DISPLAY) {
+        return surfacelessDisplay;
+      }
+    }
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static EGLContext CreateContext(EGLContext shareWith) {
+  const EGLint contextAttribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+    EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+    EGL_NONE
+  };
+  EGLContext context = eglCreateContext(display, config, shareWith, contextAttribs);
+  if (context == EGL_NO_CONTEXT) {
+    std::cerr << "Failed to create EGL context: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+    return EGL_NO_CONTEXT;
+  }
+
+  if (!surfaceless) {
+    const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+    EGLSurface pbuffer = eglCreatePbufferSurface(display, config, pbufferAttribs);
+    if (pbuffer == EGL_NO_SURFACE) {
+      std::cerr << "Failed to create EGL pbuffer: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+      eglDestroyContext(display, context);
+      return EGL_NO_CONTEXT;
+    }
+    std::lock_guard<std::mutex> lock(pbufferMutex);
+    pbuffers[context] = pbuffer;
+  }
+  return context;
+}
+
+bool HeadlessContext::Init(int width, int height) {
+  display = OpenDisplay();
+  EGLint major = 0, minor = 0;
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+    std::cerr << "Failed to initialize EGL: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+    return false;
+  }
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    std::cerr << "EGL has no desktop OpenGL" << std::endl;
+    Shutdown();
+    return false;
+  }
+  surfaceless = HasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+  const EGLint configAttribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_DEPTH_SIZE, 24,
+    EGL_NONE
+  };
+  EGLint configCount = 0;
+  if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+    std::cerr << "No EGL config for an OpenGL 3.3 core context" << std::endl;
+    Shutdown();
+    return false;
+  }
+
+  mainContext = CreateContext(EGL_NO_CONTEXT);
+  if (mainContext == EGL_NO_CONTEXT || !MakeCurrent(mainContext)) {
+    Shutdown();
+    return false;
+  }
+
+  if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(GetProcAddress))) {
+    std::cerr << "Failed to initialize GLAD" << std::endl;
+    Shutdown();
+    return false;
+  }
+  if (!CreateFramebuffer(width, height)) {
+    Shutdown();
+    return false;
+  }
+
+  std::cout << "Headless rendering on " << glGetString(GL_RENDERER) << " (EGL " << major << "." << minor
+            << (surfaceless ? ", surfaceless)" : ", pbuffer)") << std::endl;
+  return true;
+}
+
+void HeadlessContext::Shutdown() {
+  if (display == EGL_NO_DISPLAY) {
+    return;
+  }
+
+  if (framebuffer && mainContext != EGL_NO_CONTEXT && MakeCurrent(mainContext)) {
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+  }
+  framebuffer = colorBuffer = depthBuffer = 0;
+
+  MakeCurrent(nullptr);
+  if (mainContext != EGL_NO_CONTEXT) {
+    DestroyContext(mainContext);
+    mainContext = EGL_NO_CONTEXT;
+  }
+  eglTerminate(display);
+  display = EGL_NO_DISPLAY;
+}
+
+void* HeadlessContext::GetMainContext() {
+  return mainContext;
+}
+
+void* HeadlessContext::CreateSharedContext() {
+  EGLContext context = CreateContext(mainContext);
+  if (context == EGL_NO_CONTEXT || !MakeCurrent(context)) {
+    return nullptr;
+  }
+  return context;
+}
+
+void HeadlessContext::DestroyContext(void* context) {
+  if (!context) {
+    return;
+  }
+  eglDestroyContext(display, context);
+
+  std::lock_guard<std::mutex> lock(pbufferMutex);
+  auto it = pbuffers.find(context);
+  if (it != pbuffers.end()) {
+    eglDestroySurface(display, it->second);
+    pbuffers.erase(it);
+  }
+}
+
+bool HeadlessContext::MakeCurrent(void* context) {
+  EGLSurface surface = EGL_NO_SURFACE;
+  if (context && !surfaceless) {
+    std::lock_guard<std::mutex> lock(pbufferMutex);
+    surface = pbuffers[context];
+  }
+  if (!eglMakeCurrent(display, surface, surface, context ? context : EGL_NO_CONTEXT)) {
+    std::cerr << "Failed to make EGL context current: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void* HeadlessContext::GetProcAddress(const char* name) {
+  return reinterpret_cast<void*>(eglGetProcAddress(name));
+}
+
+#else
+
+bool HeadlessContext::Init(int /*width*/, int /*height*/) {
+  std::cerr << "Headless rendering needs EGL; this build has none (try --null-renderer)" << std::endl;
+  return false;
+}
+
+void HeadlessContext::Shutdown() {}
+
+void* HeadlessContext::GetMainContext() {
+  return nullptr;
+}
+
+void* HeadlessContext::CreateSharedContext() {
+  return nullptr;
+}
+
+void HeadlessContext::DestroyContext(void* /*context*/) {}
+
+bool HeadlessContext::MakeCurrent(void* /*context*/) {
+  return false;
+}
+
+void* HeadlessContext::GetProcAddress(const char* /*name*/) {
+  return nullptr;
+}
+
+#endif // NGINE_EGL
+
+bool HeadlessContext::CreateFramebuffer(int width, int height) {
+  glGenRenderbuffers(1, &colorBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenRenderbuffers(1, &depthBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cerr << "Headless framebuffer incomplete" << std::endl;
+    return false;
+  }
+
+  // A surfaceless context starts with a 0x0 viewport
+  glViewport(0, 0, width, height);
+  return true;
+}
+
+GLuint HeadlessContext::GetFramebuffer() {
+  return framebuffer;
+}
+
+void HeadlessContext::Present() {
+  glFinish();
+}
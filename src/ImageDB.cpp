@@ -0,0 +1,365 @@
+#include "ImageDB.h"
+#include "ShaderDB.h"
+#include "Renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "stb/stb_image.h"
+
+// RGBA pages, so 16MB each on both sides
+static const int PAGE_SIZE = 2048;
+// Anything wider or taller than this gets a page of its own
+static const int MAX_PACKED_SIZE = PAGE_SIZE / 2;
+// x, y, z, u, v, r, g, b, a
+static const int FLOATS_PER_VERTEX = 9;
+
+std::unordered_map<std::string, ImageDB::Image> ImageDB::images;
+std::vector<std::unique_ptr<TextureAtlas>> ImageDB::pages;
+int ImageDB::sharedPage = -1;
+std::vector<ImageDB::SpriteRequest> ImageDB::drawQueue;
+ImageDB::Image ImageDB::whitePixel;
+std::shared_ptr<Shader> ImageDB::shader = nullptr;
+std::vector<GLuint> ImageDB::pageTextures;
+GLuint ImageDB::vao = 0;
+std::unique_ptr<StreamBuffer> ImageDB::stream = nullptr;
+GLuint ImageDB::ebo = 0;
+int ImageDB::indexCapacity = 0;
+
+void ImageDB::Init() {
+  shader = ShaderDB::GetShader("shaders/vertex/sprite.glsl", "shaders/fragment/sprite.glsl");
+
+  // Pixels are drawn as a sprite sampling the middle of a small white block
+  uint8_t white[3 * 3 * 4];
+  std::fill(std::begin(white), std::end(white), 255);
+  whitePixel = AddImage(3, 3, white);
+  whitePixel.u0 = whitePixel.u1 = (whitePixel.u0 + whitePixel.u1) * 0.5f;
+  whitePixel.v0 = whitePixel.v1 = (whitePixel.v0 + whitePixel.v1) * 0.5f;
+
+  // Attribute pointers are set per frame, at wherever the sprites were streamed to
+  glGenVertexArrays(1, &vao);
+  glGenBuffers(1, &ebo);
+  glBindVertexArray(vao);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+  glBindVertexArray(0);
+  stream = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, 256 * 1024);
+}
+
+void ImageDB::Shutdown() {
+  drawQueue.clear();
+  images.clear();
+  pages.clear();
+  sharedPage = -1;
+
+  if (!pageTextures.empty()) {
+    glDeleteTextures(static_cast<GLsizei>(pageTextures.size()), pageTextures.data());
+    pageTextures.clear();
+  }
+  if (vao) {
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &ebo);
+    vao = ebo = 0;
+  }
+  stream = nullptr;
+  indexCapacity = 0;
+  shader = nullptr;
+}
+
+ImageDB::Image ImageDB::AddImage(int width, int height, const uint8_t* pixels) {
+  int x = 0, y = 0;
+  int page;
+  if (width > MAX_PACKED_SIZE || height > MAX_PACKED_SIZE) {
+    // The packer leaves a pixel of padding after every image
+    pages.push_back(std::make_unique<TextureAtlas>(width + 1, height + 1, 4));
+    page = static_cast<int>(pages.size()) - 1;
+    pages[page]->Allocate(width, height, x, y);
+  } else {
+    if (sharedPage < 0 || !pages[sharedPage]->Allocate(width, height, x, y)) {
+      pages.push_back(std::make_unique<TextureAtlas>(PAGE_SIZE, PAGE_SIZE, 4));
+      sharedPage = static_cast<int>(pages.size()) - 1;
+      pages[sharedPage]->Allocate(width, height, x, y);
+    }
+    page = sharedPage;
+  }
+
+  TextureAtlas& atlas = *pages[page];
+  atlas.Write(x, y, width, height, pixels);
+
+  Image image;
+  image.page = page;
+  image.width = static_cast<float>(width);
+  image.height = static_cast<float>(height);
+  image.u0 = static_cast<float>(x) / atlas.GetWidth();
+  image.v0 = static_cast<float>(y) / atlas.GetHeight();
+  image.u1 = static_cast<float>(x + width) / atlas.GetWidth();
+  image.v1 = static_cast<float>(y + height) / atlas.GetHeight();
+  return image;
+}
+
+const ImageDB::Image* ImageDB::GetImage(const std::string& image_name) {
+  auto found = images.find(image_name);
+  if (found != images.end()) {
+    return &found->second;
+  }
+
+  std::string path = "resources/images/" + image_name + ".png";
+  if (!std::filesystem::exists(path)) {
+    std::cout << "error: missing image " << image_name;
+    exit(0);
+  }
+
+  int width, height, channels;
+  unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+  if (!data) {
+    std::cout << "Image " << image_name << " not loaded correctly" << std::endl;
+    exit(0);
+  }
+  Image& image = images[image_name] = AddImage(width, height, data);
+  stbi_image_free(data);
+  return &image;
+}
+
+void ImageDB::Draw(const std::string& image_name, float x, float y) {
+  DrawEx(image_name, x, y, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 255.0f, 255.0f, 255.0f, 255.0f, 0);
+}
+
+void ImageDB::DrawEx(const std::string& image_name, float x, float y, float rotation, float scale_x, float scale_y, float pivot_x, float pivot_y, float r, float g, float b, float a, int layer) {
+  const Image* image = GetImage(image_name);
+  SpriteRequest request;
+  request.image = image;
+  request.position = glm::vec3(x, y, 0.0f);
+  request.size = glm::vec2(image->width * scale_x, image->height * scale_y);
+  request.pivot = glm::vec2(pivot_x, pivot_y);
+  request.rotation = rotation;
+  request.color = glm::vec4(r, g, b, a) / 255.0f;
+  request.layer = layer;
+  request.world = false;
+  drawQueue.push_back(request);
+}
+
+void ImageDB::DrawWorld(const std::string& image_name, float x, float y, float z, float width) {
+  DrawWorldEx(image_name, x, y, z, width, 0.0f, 255.0f, 255.0f, 255.0f, 255.0f, 0);
+}
+
+void ImageDB::DrawWorldEx(const std::string& image_name, float x, float y, float z, float width, float rotation, float r, float g, float b, float a, int layer) {
+  const Image* image = GetImage(image_name);
+  SpriteRequest request;
+  request.image = image;
+  request.position = glm::vec3(x, y, z);
+  request.size = glm::vec2(width, width * image->height / image->width);
+  request.pivot = glm::vec2(0.5f);
+  request.rotation = rotation;
+  request.color = glm::vec4(r, g, b, a) / 255.0f;
+  request.layer = layer;
+  request.world = true;
+  drawQueue.push_back(request);
+}
+
+void ImageDB::DrawPixel(float x, float y, float r, float g, float b, float a) {
+  SpriteRequest request;
+  request.image = &whitePixel;
+  request.position = glm::vec3(x, y, 0.0f);
+  request.size = glm::vec2(1.0f);
+  request.pivot = glm::vec2(0.0f);
+  request.rotation = 0.0f;
+  request.color = glm::vec4(r, g, b, a) / 255.0f;
+  request.layer = 0;
+  request.world = false;
+  drawQueue.push_back(request);
+}
+
+void ImageDB::BuildFrame(SpriteFrame& frame, const glm::mat4& view) {
+  frame.vertices.clear();
+  frame.batches.clear();
+  frame.uploads.clear();
+
+  // World sprites first, then by layer and page; otherwise in the order
+  // drawn. World sprites blend without writing depth, so within a layer they
+  // go far to near and only sprites at the same depth share a batch by page.
+  glm::vec3 forward = glm::vec3(view[0][2], view[1][2], view[2][2]);
+  std::stable_sort(drawQueue.begin(), drawQueue.end(), [&forward](const SpriteRequest& a, const SpriteRequest& b) {
+    if (a.world != b.world) {
+      return a.world;
+    }
+    if (a.layer != b.layer) {
+      return a.layer < b.layer;
+    }
+    if (a.world) {
+      // View space z up to a constant, more negative the farther away
+      float depthA = glm::dot(forward, a.position);
+      float depthB = glm::dot(forward, b.position);
+      if (depthA != depthB) {
+        return depthA < depthB;
+      }
+    }
+    return a.image->page < b.image->page;
+  });
+
+  // The view matrix's rows are the camera's right and up axes
+  glm::vec3 right = glm::vec3(view[0][0], view[1][0], view[2][0]);
+  glm::vec3 up = glm::vec3(view[0][1], view[1][1], view[2][1]);
+
+  frame.vertices.reserve(drawQueue.size() * 4 * FLOATS_PER_VERTEX);
+  for (size_t i = 0; i < drawQueue.size(); ++i) {
+    const SpriteRequest& sprite = drawQueue[i];
+    const Image& image = *sprite.image;
+
+    float radians = glm::radians(sprite.rotation);
+    float c = std::cos(radians);
+    float s = std::sin(radians);
+
+    // Top left, top right, bottom right, bottom left, with y down the image
+    static const glm::vec2 corners[4] = { {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f} };
+    for (const glm::vec2& corner : corners) {
+      glm::vec2 local = (corner - sprite.pivot) * sprite.size;
+      glm::vec2 rotated = glm::vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+      glm::vec3 position = sprite.world
+                         ? sprite.position + right * rotated.x - up * rotated.y
+                         : sprite.position + glm::vec3(rotated, 0.0f);
+      frame.vertices.insert(frame.vertices.end(), {
+        position.x, position.y, position.z,
+        corner.x > 0.0f ? image.u1 : image.u0, corner.y > 0.0f ? image.v1 : image.v0,
+        sprite.color.r, sprite.color.g, sprite.color.b, sprite.color.a
+      });
+    }
+
+    if (frame.batches.empty() || frame.batches.back().page != image.page || frame.batches.back().world != sprite.world) {
+      SpriteBatch batch;
+      batch.page = image.page;
+      batch.first = static_cast<int>(i);
+      batch.world = sprite.world;
+      frame.batches.push_back(batch);
+    }
+    ++frame.batches.back().count;
+  }
+  drawQueue.clear();
+
+  // New pages come through whole, so the render thread can create them
+  for (size_t page = 0; page < pages.size(); ++page) {
+    TextureAtlas& atlas = *pages[page];
+    int top, bottom;
+    if (!atlas.TakeDirtyRows(top, bottom)) {
+      continue;
+    }
+    size_t rowBytes = static_cast<size_t>(atlas.GetWidth()) * atlas.GetChannels();
+    SpritePageUpload upload;
+    upload.page = static_cast<int>(page);
+    upload.width = atlas.GetWidth();
+    upload.height = atlas.GetHeight();
+    upload.top = top;
+    upload.rows = bottom - top;
+    upload.pixels.assign(atlas.GetPixels() + top * rowBytes, atlas.GetPixels() + bottom * rowBytes);
+    frame.uploads.push_back(std::move(upload));
+  }
+}
+
+void ImageDB::SnapshotPages(std::vector<SpritePageUpload>& uploads) {
+  uploads.clear();
+  for (size_t page = 0; page < pages.size(); ++page) {
+    const TextureAtlas& atlas = *pages[page];
+    SpritePageUpload upload;
+    upload.page = static_cast<int>(page);
+    upload.width = atlas.GetWidth();
+    upload.height = atlas.GetHeight();
+    upload.top = 0;
+    upload.rows = atlas.GetHeight();
+    upload.pixels.assign(atlas.GetPixels(), atlas.GetPixels() + static_cast<size_t>(atlas.GetWidth()) * atlas.GetHeight() * atlas.GetChannels());
+    uploads.push_back(std::move(upload));
+  }
+}
+
+void ImageDB::RenderWorld(const SpriteFrame& frame, const glm::mat4& view, const glm::mat4& projection) {
+  for (const SpritePageUpload& upload : frame.uploads) {
+    if (upload.page >= static_cast<int>(pageTextures.size())) {
+      pageTextures.resize(upload.page + 1, 0);
+    }
+    GLuint& texture = pageTextures[upload.page];
+    if (!texture) {
+      glGenTextures(1, &texture);
+      glBindTexture(GL_TEXTURE_2D, texture);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, upload.width, upload.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    } else {
+      glBindTexture(GL_TEXTURE_2D, texture);
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, upload.top, upload.width, upload.rows, GL_RGBA, GL_UNSIGNED_BYTE, upload.pixels.data());
+  }
+
+  if (frame.vertices.empty()) {
+    return;
+  }
+
+  // The screen pass later in the frame draws from the same vertices
+  glBindVertexArray(vao);
+  size_t offset = stream->Write(frame.vertices.data(), frame.vertices.size() * sizeof(float));
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)offset);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(offset + 3 * sizeof(float)));
+  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(offset + 5 * sizeof(float)));
+
+  // Every sprite is two triangles over its own four vertices
+  int sprites = static_cast<int>(frame.vertices.size() / (4 * FLOATS_PER_VERTEX));
+  if (sprites > indexCapacity) {
+    indexCapacity = std::max(sprites, indexCapacity * 2);
+    std::vector<GLuint> indices(static_cast<size_t>(indexCapacity) * 6);
+    for (int i = 0; i < indexCapacity; ++i) {
+      GLuint base = static_cast<GLuint>(i) * 4;
+      GLuint quad[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+      std::copy(quad, quad + 6, indices.begin() + static_cast<size_t>(i) * 6);
+    }
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+  }
+  glBindVertexArray(0);
+
+  if (frame.batches.empty() || !frame.batches.front().world) {
+    return;
+  }
+
+  shader->Use();
+  shader->SetMat4("viewProjection", projection * view);
+  glEnable(GL_DEPTH_TEST);
+  glDepthMask(GL_FALSE);
+  DrawBatches(frame, true);
+  glDepthMask(GL_TRUE);
+}
+
+void ImageDB::RenderScreen(const SpriteFrame& frame) {
+  if (frame.batches.empty() || frame.batches.back().world) {
+    return;
+  }
+
+  // Window pixels, y down, like the coordinates Lua passes in
+  shader->Use();
+  shader->SetMat4("viewProjection", glm::ortho(0.0f, static_cast<float>(Renderer::x_resolution), static_cast<float>(Renderer::y_resolution), 0.0f));
+  glDisable(GL_DEPTH_TEST);
+  DrawBatches(frame, false);
+  glEnable(GL_DEPTH_TEST);
+}
+
+void ImageDB::DrawBatches(const SpriteFrame& frame, bool world) {
+  shader->SetInt("image", 0);
+  glActiveTexture(GL_TEXTURE0);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glBindVertexArray(vao);
+
+  for (const SpriteBatch& batch : frame.batches) {
+    if (batch.world != world) {
+      continue;
+    }
+    glBindTexture(GL_TEXTURE_2D, pageTextures[batch.page]);
+    glDrawElements(GL_TRIANGLES, batch.count * 6, GL_UNSIGNED_INT, (void*)(static_cast<size_t>(batch.first) * 6 * sizeof(GLuint)));
+  }
+
+  glBindVertexArray(0);
+  glDisable(GL_BLEND);
+}
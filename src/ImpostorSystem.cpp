@@ -0,0 +1,556 @@
+#include "ImpostorSystem.h"
+#include "ShaderDB.h"
+#include "GameObject.h"
+#include "Model.h"
+#include "LightComponent.h"
+#include "QualityGovernor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// world center, radius, rotation quaternion, r, g, b, fade in
+static const int FLOATS_PER_INSTANCE = 12;
+// How far each view's edge colors are spread into the empty texels around
+// it, so filtering and mipmaps don't pull in black
+static const int DILATE_TEXELS = 4;
+// Smallest mip a single view is allowed to shrink to
+static const int MIN_FRAME_TEXELS = 8;
+
+static const char CACHE_MAGIC[8] = { 'N', 'G', 'I', 'M', 'P', 'O', 'S', 'T' };
+static const uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+  char magic[8];
+  uint32_t version;
+  int32_t resolution;
+  int32_t frames;
+  // Modification time of the model file the atlases were baked from
+  int64_t sourceTime;
+};
+
+float ImpostorSystem::distance = 0.0f;
+float ImpostorSystem::fadeBand = 5.0f;
+int ImpostorSystem::resolution = 1024;
+bool ImpostorSystem::useCache = true;
+std::string ImpostorSystem::cacheDir;
+std::shared_ptr<Shader> ImpostorSystem::bakeShader = nullptr;
+std::shared_ptr<Shader> ImpostorSystem::shader = nullptr;
+GLuint ImpostorSystem::vao = 0;
+GLuint ImpostorSystem::quadVBO = 0;
+std::unique_ptr<StreamBuffer> ImpostorSystem::instanceStream = nullptr;
+
+// Scratch for BuildFrame: each impostor's batch this frame
+static std::unordered_map<const Impostor*, size_t> batchIndex;
+
+Impostor::~Impostor() {
+  if (albedo) {
+    glDeleteTextures(1, &albedo);
+  }
+  if (normalDepth) {
+    glDeleteTextures(1, &normalDepth);
+  }
+}
+
+// Inverse of OctahedronEncode in the impostor vertex shader
+static glm::vec3 OctahedronDirection(float u, float v) {
+  glm::vec2 p = glm::vec2(u, v) * 2.0f - 1.0f;
+  float y = 1.0f - std::abs(p.x) - std::abs(p.y);
+  if (y < 0.0f) {
+    p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  return glm::normalize(glm::vec3(p.x, y, p.y));
+}
+
+// Up axis for a view looking along forward; the vertex shader picks the same
+static glm::vec3 UpFor(const glm::vec3& forward) {
+  return std::abs(forward.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+static int64_t SourceTime(const std::string& path) {
+  std::error_code ec;
+  auto time = std::filesystem::last_write_time(path, ec);
+  return ec ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+// Each view spreads separately; texels are only filled from ones filled on
+// an earlier pass, so the order they're visited in doesn't matter
+static void Dilate(std::vector<uint8_t>& albedo, std::vector<uint8_t>& normalDepth, int size, int frameSize) {
+  std::vector<uint8_t> filled(static_cast<size_t>(size) * size);
+  for (size_t i = 0; i < filled.size(); ++i) {
+    filled[i] = albedo[i * 4 + 3] > 0;
+  }
+
+  std::vector<uint8_t> next;
+  for (int pass = 0; pass < DILATE_TEXELS; ++pass) {
+    next = filled;
+    for (int y = 0; y < size; ++y) {
+      for (int x = 0; x < size; ++x) {
+        size_t index = static_cast<size_t>(y) * size + x;
+        if (filled[index]) {
+          continue;
+        }
+
+        int sums[6] = { 0, 0, 0, 0, 0, 0 };
+        int count = 0;
+        const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+        for (const auto& offset : offsets) {
+          int nx = x + offset[0];
+          int ny = y + offset[1];
+          if (nx < 0 || ny < 0 || nx >= size || ny >= size || nx / frameSize != x / frameSize || ny / frameSize != y / frameSize) {
+            continue;
+          }
+          size_t neighbour = static_cast<size_t>(ny) * size + nx;
+          if (!filled[neighbour]) {
+            continue;
+          }
+          for (int c = 0; c < 3; ++c) {
+            sums[c] += albedo[neighbour * 4 + c];
+            sums[c + 3] += normalDepth[neighbour * 4 + c];
+          }
+          ++count;
+        }
+        if (count == 0) {
+          continue;
+        }
+
+        // Coverage stays zero; only the color underneath changes
+        for (int c = 0; c < 3; ++c) {
+          albedo[index * 4 + c] = static_cast<uint8_t>(sums[c] / count);
+          normalDepth[index * 4 + c] = static_cast<uint8_t>(sums[c + 3] / count);
+        }
+        next[index] = 1;
+      }
+    }
+    filled.swap(next);
+  }
+}
+
+void ImpostorSystem::Init(float impostorDistance, float impostorFadeBand, int atlasResolution, bool cache, const std::string& cacheDirectory) {
+  distance = std::max(impostorDistance, 0.0f);
+  fadeBand = std::max(impostorFadeBand, 0.0f);
+  // Whole views, each at least a few mips deep
+  resolution = std::max(atlasResolution / FRAMES, MIN_FRAME_TEXELS) * FRAMES;
+  useCache = cache;
+  cacheDir = cacheDirectory;
+
+  bakeShader = ShaderDB::GetShader("shaders/vertex/impostor_bake.glsl", "shaders/fragment/impostor_bake.glsl");
+  shader = ShaderDB::GetShader("shaders/vertex/impostor.glsl", "shaders/fragment/impostor.glsl");
+
+  const float corners[] = {
+    -1.0f, -1.0f,  1.0f, -1.0f,  -1.0f, 1.0f,  1.0f, 1.0f
+  };
+
+  glGenVertexArrays(1, &vao);
+  glGenBuffers(1, &quadVBO);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+
+  // Instance pointers are set per batch, at wherever its instances were streamed to
+  for (GLuint attribute = 1; attribute <= 3; ++attribute) {
+    glEnableVertexAttribArray(attribute);
+    glVertexAttribDivisor(attribute, 1);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+  instanceStream = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, 64 * 1024);
+}
+
+void ImpostorSystem::Shutdown() {
+  batchIndex.clear();
+  if (vao) {
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &quadVBO);
+    vao = quadVBO = 0;
+  }
+  instanceStream = nullptr;
+  bakeShader = nullptr;
+  shader = nullptr;
+}
+
+void ImpostorSystem::SetDistance(float impostorDistance) {
+  distance = std::max(impostorDistance, 0.0f);
+}
+
+float ImpostorSystem::GetDistance() {
+  return distance;
+}
+
+void ImpostorSystem::BuildFrame(ImpostorFrame& frame, std::vector<std::shared_ptr<GameObject>>& objects, const glm::mat4& viewProjection, const glm::vec3& cameraPos) {
+  frame.batches.clear();
+  batchIndex.clear();
+
+  // Gribb/Hartmann planes, as RenderCommandQueue culls with
+  glm::vec4 planes[6];
+  glm::mat4 m = glm::transpose(viewProjection);
+  planes[0] = m[3] + m[0];
+  planes[1] = m[3] - m[0];
+  planes[2] = m[3] + m[1];
+  planes[3] = m[3] - m[1];
+  planes[4] = m[3] + m[2];
+  planes[5] = m[3] - m[2];
+  for (auto& plane : planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+
+  float start = distance / (1.0f + QualityGovernor::GetLodBias());
+  float band = std::max(fadeBand, 0.001f);
+
+  size_t kept = 0;
+  for (size_t i = 0; i < objects.size(); ++i) {
+    GameObject& object = *objects[i];
+    object.fadeOut = 0.0f;
+
+    bool keep = true;
+    if (distance > 0.0f && object.isModel && object.model && !object.model->meshes.empty()) {
+      glm::vec3 boundsMin, boundsMax;
+      object.GetWorldBounds(boundsMin, boundsMax);
+      float fadeIn = glm::clamp((glm::length((boundsMin + boundsMax) * 0.5f - cameraPos) - start) / band, 0.0f, 1.0f);
+
+      Model& model = *object.model;
+      if (fadeIn > 0.0f && !model.impostor) {
+        model.impostor = std::make_shared<Impostor>();
+        model.impostor->center = (model.boundsMin + model.boundsMax) * 0.5f;
+        model.impostor->radius = glm::length(model.boundsMax - model.boundsMin) * 0.5f;
+        if (model.impostor->radius <= 0.0f) {
+          model.impostor->failed.store(true, std::memory_order_release);
+        }
+      }
+
+      const glm::mat4& world = object.GetDrawMatrix();
+      glm::vec3 axes[3] = { glm::vec3(world[0]), glm::vec3(world[1]), glm::vec3(world[2]) };
+      float lengths[3] = { glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]) };
+      bool scaled = lengths[0] > 0.0f && lengths[1] > 0.0f && lengths[2] > 0.0f;
+
+      if (fadeIn > 0.0f && scaled && !model.impostor->failed.load(std::memory_order_acquire)) {
+        const std::shared_ptr<Impostor>& impostor = model.impostor;
+        // Non-uniform scale is framed by its largest axis
+        glm::vec3 center = glm::vec3(world * glm::vec4(impostor->center, 1.0f));
+        float radius = impostor->radius * std::max(lengths[0], std::max(lengths[1], lengths[2]));
+
+        bool visible = true;
+        for (const auto& plane : planes) {
+          if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            visible = false;
+            break;
+          }
+        }
+
+        if (visible) {
+          auto it = batchIndex.find(impostor.get());
+          if (it == batchIndex.end()) {
+            it = batchIndex.emplace(impostor.get(), frame.batches.size()).first;
+            frame.batches.emplace_back();
+            frame.batches.back().model = object.model;
+            frame.batches.back().impostor = impostor;
+          }
+          ImpostorBatch& batch = frame.batches[it->second];
+          glm::quat rotation = glm::quat_cast(glm::mat3(axes[0] / lengths[0], axes[1] / lengths[1], axes[2] / lengths[2]));
+          batch.instances.insert(batch.instances.end(), {
+            center.x, center.y, center.z, radius,
+            rotation.x, rotation.y, rotation.z, rotation.w,
+            object.color.r, object.color.g, object.color.b, fadeIn
+          });
+          ++batch.count;
+        }
+
+        // Until the atlases exist the model stays fully drawn
+        if (impostor->ready.load(std::memory_order_acquire)) {
+          if (fadeIn >= 1.0f) {
+            keep = false;
+          } else {
+            object.fadeOut = fadeIn;
+          }
+        }
+      }
+    }
+
+    if (keep) {
+      if (kept != i) {
+        objects[kept] = std::move(objects[i]);
+      }
+      ++kept;
+    }
+  }
+  objects.resize(kept);
+}
+
+void ImpostorSystem::Prepare(const ImpostorFrame& frame) {
+  for (const ImpostorBatch& batch : frame.batches) {
+    Impostor& impostor = *batch.impostor;
+    if (impostor.ready.load(std::memory_order_relaxed) || impostor.failed.load(std::memory_order_relaxed)) {
+      continue;
+    }
+
+    if (LoadCached(*batch.model, impostor) || Bake(*batch.model, impostor)) {
+      impostor.ready.store(true, std::memory_order_release);
+    } else {
+      impostor.failed.store(true, std::memory_order_release);
+    }
+    // One a frame, so a screen of new models spreads its baking out
+    return;
+  }
+}
+
+bool ImpostorSystem::Bake(const Model& model, Impostor& impostor) {
+  if (!bakeShader || !bakeShader->GetID()) {
+    return false;
+  }
+  int frameSize = resolution / FRAMES;
+
+  // State the frame in progress expects back
+  GLint previousFramebuffer = 0;
+  GLint viewport[4];
+  GLint polygonMode[2];
+  GLfloat clearColor[4];
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+  glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+  GLuint targets[2];
+  glGenTextures(2, targets);
+  for (GLuint target : targets) {
+    glBindTexture(GL_TEXTURE_2D, target);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, resolution, resolution, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  GLuint depth;
+  glGenRenderbuffers(1, &depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, resolution, resolution);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  GLuint fbo;
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targets[0], 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, targets[1], 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+  const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+  glDrawBuffers(2, drawBuffers);
+  bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+  size_t bytes = static_cast<size_t>(resolution) * resolution * 4;
+  std::vector<uint8_t> albedo;
+  std::vector<uint8_t> normalDepth;
+  if (complete) {
+    glViewport(0, 0, resolution, resolution);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    bakeShader->Use();
+    GLuint program = bakeShader->GetID();
+    float r = impostor.radius;
+    // Orthographic around the bounding sphere, from twice its radius away:
+    // depth runs from its front (0) to its back (1)
+    glm::mat4 projection = glm::ortho(-r, r, -r, r, r, 3.0f * r);
+    for (int y = 0; y < FRAMES; ++y) {
+      for (int x = 0; x < FRAMES; ++x) {
+        glm::vec3 direction = OctahedronDirection((x + 0.5f) / FRAMES, (y + 0.5f) / FRAMES);
+        glm::mat4 view = glm::lookAt(impostor.center + direction * (2.0f * r), impostor.center, UpFor(-direction));
+        bakeShader->SetMat4("viewProjection", projection * view);
+        glViewport(x * frameSize, y * frameSize, frameSize, frameSize);
+
+        for (const auto& mesh : model.meshes) {
+          // Don't let an earlier mesh's textures stand in for an untextured one's
+          if (!mesh->material.useTexture) {
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, 0);
+          }
+          mesh->ApplyMaterial(program, mesh->material);
+          mesh->DrawElements();
+        }
+      }
+    }
+
+    albedo.resize(bytes);
+    normalDepth.resize(bytes);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, resolution, resolution, GL_RGBA, GL_UNSIGNED_BYTE, albedo.data());
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glReadPixels(0, 0, resolution, resolution, GL_RGBA, GL_UNSIGNED_BYTE, normalDepth.data());
+  }
+
+  glBindVertexArray(0);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+  glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+  glDeleteFramebuffers(1, &fbo);
+  glDeleteRenderbuffers(1, &depth);
+  glDeleteTextures(2, targets);
+
+  if (!complete) {
+    std::cerr << "Impostor bake target incomplete for " << model.path << std::endl;
+    return false;
+  }
+
+  Dilate(albedo, normalDepth, resolution, frameSize);
+  if (useCache) {
+    SaveCached(model, albedo, normalDepth);
+  }
+  CreateTextures(impostor, albedo, normalDepth);
+  std::cout << "Baked impostor for " << (model.path.empty() ? "unnamed model" : model.path) << std::endl;
+  return true;
+}
+
+void ImpostorSystem::CreateTextures(Impostor& impostor, const std::vector<uint8_t>& albedo, const std::vector<uint8_t>& normalDepth) {
+  int maxLevel = 0;
+  for (int size = resolution / FRAMES; size > MIN_FRAME_TEXELS; size /= 2) {
+    ++maxLevel;
+  }
+
+  GLuint* textures[2] = { &impostor.albedo, &impostor.normalDepth };
+  const std::vector<uint8_t>* pixels[2] = { &albedo, &normalDepth };
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  for (int i = 0; i < 2; ++i) {
+    glGenTextures(1, textures[i]);
+    glBindTexture(GL_TEXTURE_2D, *textures[i]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, resolution, resolution, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels[i]->data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+    glGenerateMipmap(GL_TEXTURE_2D);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+std::string ImpostorSystem::CachePath(const Model& model) {
+  if (!useCache || model.path.empty()) {
+    return "";
+  }
+  // FNV-1a of the model's path
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : model.path) {
+    hash = (hash ^ c) * 1099511628211ull;
+  }
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.impostor", static_cast<unsigned long long>(hash));
+  return cacheDir + "/" + name;
+}
+
+bool ImpostorSystem::LoadCached(const Model& model, Impostor& impostor) {
+  std::string path = CachePath(model);
+  if (path.empty()) {
+    return false;
+  }
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  // Baked at another resolution, or from an older version of the model
+  CacheHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION ||
+      header.resolution != resolution || header.frames != FRAMES || header.sourceTime != SourceTime(model.path)) {
+    return false;
+  }
+
+  size_t bytes = static_cast<size_t>(resolution) * resolution * 4;
+  std::vector<uint8_t> albedo(bytes);
+  std::vector<uint8_t> normalDepth(bytes);
+  if (!file.read(reinterpret_cast<char*>(albedo.data()), bytes) || !file.read(reinterpret_cast<char*>(normalDepth.data()), bytes)) {
+    return false;
+  }
+  CreateTextures(impostor, albedo, normalDepth);
+  return true;
+}
+
+void ImpostorSystem::SaveCached(const Model& model, const std::vector<uint8_t>& albedo, const std::vector<uint8_t>& normalDepth) {
+  std::string path = CachePath(model);
+  if (path.empty()) {
+    return;
+  }
+  std::error_code ec;
+  std::filesystem::create_directories(cacheDir, ec);
+  if (ec) {
+    std::cerr << "Failed to create impostor cache directory " << cacheDir << ": " << ec.message() << std::endl;
+    return;
+  }
+
+  CacheHeader header;
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version = CACHE_VERSION;
+  header.resolution = resolution;
+  header.frames = FRAMES;
+  header.sourceTime = SourceTime(model.path);
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(albedo.data()), albedo.size());
+  file.write(reinterpret_cast<const char*>(normalDepth.data()), normalDepth.size());
+  if (!file) {
+    std::cerr << "Failed to write impostor cache " << path << std::endl;
+  }
+}
+
+void ImpostorSystem::Render(const ImpostorFrame& frame, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos, const std::vector<ShaderLight>& lights) {
+  if (frame.batches.empty() || !shader) {
+    return;
+  }
+
+  shader->Use();
+  shader->SetMat4("viewProjection", projection * view);
+  shader->SetVec3("cameraPos", cameraPos);
+  shader->SetFloat("frames", static_cast<float>(FRAMES));
+  shader->SetInt("albedoAtlas", 0);
+  shader->SetInt("normalDepthAtlas", 1);
+  LightComponent::UploadLights(shader->GetID(), lights);
+
+  // Opaque, cut out by coverage and dithered while fading in
+  glEnable(GL_DEPTH_TEST);
+  glDepthMask(GL_TRUE);
+  glDisable(GL_BLEND);
+  glBindVertexArray(vao);
+
+  for (const ImpostorBatch& batch : frame.batches) {
+    if (!batch.impostor->ready.load(std::memory_order_acquire)) {
+      continue;
+    }
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, batch.impostor->normalDepth);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, batch.impostor->albedo);
+
+    size_t offset = instanceStream->Write(batch.instances.data(), batch.instances.size() * sizeof(float));
+    GLsizei stride = FLOATS_PER_INSTANCE * sizeof(float);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + 4 * sizeof(float)));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + 8 * sizeof(float)));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, batch.count);
+  }
+
+  glBindVertexArray(0);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,125 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+std::vector<std::thread> JobSystem::workers;
+std::deque<JobSystem::Job> JobSystem::queue;
+std::mutex JobSystem::queueMutex;
+std::condition_variable JobSystem::queueCondition;
+bool JobSystem::running = false;
+
+void JobSystem::Init(int numThreads) {
+  if (running) {
+    return;
+  }
+
+  if (numThreads <= 0) {
+    numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+  }
+
+  running = true;
+  for (int i = 0; i < numThreads; ++i) {
+    workers.emplace_back(WorkerLoop);
+  }
+}
+
+void JobSystem::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    running = false;
+  }
+  queueCondition.notify_all();
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  workers.clear();
+  queue.clear();
+}
+
+int JobSystem::GetWorkerCount() {
+  return static_cast<int>(workers.size());
+}
+
+std::shared_ptr<JobCounter> JobSystem::Dispatch(int count, std::function<void(int)> func) {
+  auto counter = std::make_shared<JobCounter>();
+  if (count <= 0) {
+    return counter;
+  }
+
+  counter->remaining = count;
+
+  // Without workers everything runs inline on the caller
+  if (workers.empty()) {
+    for (int i = 0; i < count; ++i) {
+      func(i);
+    }
+    counter->remaining = 0;
+    return counter;
+  }
+
+  auto shared = std::make_shared<std::function<void(int)>>(std::move(func));
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    for (int i = 0; i < count; ++i) {
+      queue.push_back({ shared, i, counter });
+    }
+  }
+  queueCondition.notify_all();
+  return counter;
+}
+
+void JobSystem::Wait(const std::shared_ptr<JobCounter>& counter) {
+  if (!counter) {
+    return;
+  }
+
+  while (counter->remaining.load(std::memory_order_acquire) > 0) {
+    if (!TryRunOne()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+bool JobSystem::IsDone(const std::shared_ptr<JobCounter>& counter) {
+  return !counter || counter->remaining.load(std::memory_order_acquire) == 0;
+}
+
+void JobSystem::ParallelFor(int count, std::function<void(int)> func) {
+  Wait(Dispatch(count, std::move(func)));
+}
+
+void JobSystem::WorkerLoop() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(queueMutex);
+      queueCondition.wait(lock, [] { return !running || !queue.empty(); });
+      if (!running && queue.empty()) {
+        return;
+      }
+      job = std::move(queue.front());
+      queue.pop_front();
+    }
+    Run(job);
+  }
+}
+
+bool JobSystem::TryRunOne() {
+  Job job;
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (queue.empty()) {
+      return false;
+    }
+    job = std::move(queue.front());
+    queue.pop_front();
+  }
+  Run(job);
+  return true;
+}
+
+void JobSystem::Run(Job& job) {
+  (*job.func)(job.index);
+  job.counter->remaining.fetch_sub(1, std::memory_order_acq_rel);
+}
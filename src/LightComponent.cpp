@@ -4,37 +4,126 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Renderer.h"
+#include "Actor.hpp"
+
 std::vector<std::shared_ptr<LightComponent>> LightComponent::lights;
+std::atomic<int> LightComponent::lightLimit{ LightComponent::MAX_SHADER_LIGHTS };
+
+static void UploadLight(unsigned int shaderProgram, const std::string& uniformName, const ShaderLight& light) {
+  // Set light type
+  glUniform1i(glGetUniformLocation(shaderProgram, (uniformName + ".type").c_str()), light.type);
+
+  // Set position and direction
+  glUniform3fv(glGetUniformLocation(shaderProgram, (uniformName + ".position").c_str()), 1, glm::value_ptr(light.position));
+  glUniform3fv(glGetUniformLocation(shaderProgram, (uniformName + ".direction").c_str()), 1, glm::value_ptr(light.direction));
+
+  // Set color and intensity
+  glUniform3fv(glGetUniformLocation(shaderProgram, (uniformName + ".color").c_str()), 1, glm::value_ptr(light.color));
+  glUniform1f(glGetUniformLocation(shaderProgram, (uniformName + ".intensity").c_str()), light.intensity);
+
+  // Set attenuation factors (primarily used by point and spot lights)
+  glUniform1f(glGetUniformLocation(shaderProgram, (uniformName + ".constant").c_str()), light.constant);
+  glUniform1f(glGetUniformLocation(shaderProgram, (uniformName + ".linear").c_str()), light.linear);
+  glUniform1f(glGetUniformLocation(shaderProgram, (uniformName + ".quadratic").c_str()), light.quadratic);
+
+  // Set spotlight parameters
+  glUniform1f(glGetUniformLocation(shaderProgram, (uniformName + ".innerCutoff").c_str()), light.innerCutoffCos);
+  glUniform1f(glGetUniformLocation(shaderProgram, (uniformName + ".outerCutoff").c_str()), light.outerCutoffCos);
+
+  glUniform1i(glGetUniformLocation(shaderProgram, (uniformName + ".baked").c_str()), light.baked);
+}
 
 void LightComponent::ApplyAllLightsToShader(unsigned int shaderProgram) {
-  
-  glUniform1i(glGetUniformLocation(shaderProgram, "numLights"), static_cast<int>(lights.size()));
+  UploadLights(shaderProgram, GatherShaderLights(Renderer::GetCamPos()));
+}
+
+std::vector<ShaderLight> LightComponent::GatherShaderLights(const glm::vec3& camPos) {
+  int limit = std::min(lightLimit.load(), MAX_SHADER_LIGHTS);
+  std::vector<ShaderLight> shaderLights;
+  shaderLights.reserve(lights.size());
+  for (const auto& light : lights) {
+    shaderLights.push_back(light->ToShaderLight());
+  }
+
+  // Only rank lights when some have to be dropped
+  if (static_cast<int>(shaderLights.size()) > limit) {
+    auto importance = [&camPos](const ShaderLight& light) {
+      if (light.type == static_cast<int>(LightType::DIRECTIONAL)) {
+        return std::numeric_limits<float>::max();
+      }
+      glm::vec3 offset = light.position - camPos;
+      return light.intensity / (1.0f + glm::dot(offset, offset));
+    };
+    std::partial_sort(shaderLights.begin(), shaderLights.begin() + limit, shaderLights.end(), [&importance](const ShaderLight& a, const ShaderLight& b) {
+      return importance(a) > importance(b);
+    });
+    shaderLights.resize(limit);
+  }
+  return shaderLights;
+}
+
+void LightComponent::UploadLights(unsigned int shaderProgram, const std::vector<ShaderLight>& shaderLights) {
+  glUniform1i(glGetUniformLocation(shaderProgram, "numLights"), static_cast<int>(shaderLights.size()));
   
   // Apply each light to the shader with its own uniform location
-  for (size_t i = 0; i < lights.size(); i++) {
+  for (size_t i = 0; i < shaderLights.size(); i++) {
     std::string uniformPrefix = "lights[" + std::to_string(i) + "]";
-    lights[i]->ApplyToShader(shaderProgram, uniformPrefix);
+    UploadLight(shaderProgram, uniformPrefix, shaderLights[i]);
   }
 }
 
-void LightComponent::ApplyToShader(unsigned int shaderProgram, const std::string& uniformName) const {
-  // Set light type
-  glUniform1i(glGetUniformLocation(shaderProgram, (uniformName + ".type").c_str()), static_cast<int>(lightType));
+float LightComponent::GetRange(const ShaderLight& light, float cutoff) {
+  // Solve intensity / (constant + linear d + quadratic d^2) = cutoff for d
+  float c = light.constant - light.intensity / cutoff;
+  float range;
+  if (light.quadratic > 0.0f) {
+    range = (-light.linear + std::sqrt(std::max(light.linear * light.linear - 4.0f * light.quadratic * c, 0.0f))) / (2.0f * light.quadratic);
+  } else if (light.linear > 0.0f) {
+    range = -c / light.linear;
+  } else {
+    return std::numeric_limits<float>::infinity();
+  }
+  return std::max(range, 0.0f);
+}
 
-  // Set position and direction
-  glUniform3fv(glGetUniformLocation(shaderProgram, (uniformName + ".position").c_str()), 1, glm::value_ptr(position));
-  glUniform3fv(glGetUniformLocation(shaderProgram, (uniformName + ".direction").c_str()), 1, glm::value_ptr(direction));
+void LightComponent::SetLightLimit(int limit) {
+  lightLimit = std::clamp(limit, 0, MAX_SHADER_LIGHTS);
+}
 
-  // Set color and intensity
-  glUniform3fv(glGetUniformLocation(shaderProgram, (uniformName + ".color").c_str()), 1, glm::value_ptr(color));
-  glUniform1f(glGetUniformLocation(shaderProgram, (uniformName + ".intensity").c_str()), intensity);
+int LightComponent::GetLightLimit() {
+  return lightLimit;
+}
 
-  // Set attenuation factors (primarily used by point and spot lights)
-  glUniform1f(glGetUniformLocation(shaderProgram, (uniformName + ".constant").c_str()), constant);
-  glUniform1f(glGetUniformLocation(shaderProgram, (uniformName + ".linear").c_str()), linear);
-  glUniform1f(glGetUniformLocation(shaderProgram, (uniformName + ".quadratic").c_str()), quadratic);
+void LightComponent::ApplyToShader(unsigned int shaderProgram, const std::string& uniformName) const {
+  UploadLight(shaderProgram, uniformName, ToShaderLight());
+}
 
-  // Set spotlight parameters (convert degrees to cosine values for shader efficiency)
-  glUniform1f(glGetUniformLocation(shaderProgram, (uniformName + ".innerCutoff").c_str()), glm::cos(glm::radians(innerCutoff)));
-  glUniform1f(glGetUniformLocation(shaderProgram, (uniformName + ".outerCutoff").c_str()), glm::cos(glm::radians(outerCutoff)));
+ShaderLight LightComponent::ToShaderLight() const {
+  ShaderLight light;
+  light.type = static_cast<int>(lightType);
+  light.position = position;
+  light.direction = direction;
+
+  // On an actor with a Transform, position and direction are relative to it
+  TransformComponent* transform = actor ? TransformComponent::FindOn(*actor) : nullptr;
+  if (transform) {
+    const glm::mat4& world = transform->GetWorldMatrix();
+    light.position = glm::vec3(world * glm::vec4(position, 1.0f));
+    light.direction = glm::normalize(glm::mat3(world) * direction);
+  }
+  light.color = color;
+  light.intensity = intensity;
+  light.constant = constant;
+  light.linear = linear;
+  light.quadratic = quadratic;
+  // Cosines rather than degrees for shader efficiency
+  light.innerCutoffCos = glm::cos(glm::radians(innerCutoff));
+  light.outerCutoffCos = glm::cos(glm::radians(outerCutoff));
+  light.baked = baked ? 1 : 0;
+  return light;
 }
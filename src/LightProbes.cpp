@@ -0,0 +1,139 @@
+#include "LightProbes.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <glm/gtc/type_ptr.hpp>
+
+static const char MAGIC[8] = { 'N', 'G', 'P', 'R', 'O', 'B', 'E', 'S' };
+static const uint32_t VERSION = 1;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  float origin[3];
+  float spacing;
+  int32_t counts[3];
+};
+
+GLuint LightProbes::texture = 0;
+glm::vec3 LightProbes::origin = glm::vec3(0.0f);
+float LightProbes::spacing = 1.0f;
+glm::ivec3 LightProbes::counts = glm::ivec3(0);
+
+bool LightProbes::Save(const std::string& path, const ProbeGridData& data) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    std::cerr << "Can't write light probes " << path << std::endl;
+    return false;
+  }
+
+  FileHeader header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  for (int i = 0; i < 3; ++i) {
+    header.origin[i] = data.origin[i];
+    header.counts[i] = data.counts[i];
+  }
+  header.spacing = data.spacing;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(data.coefficients.data()), static_cast<std::streamsize>(data.coefficients.size() * sizeof(float)));
+  return static_cast<bool>(out);
+}
+
+bool LightProbes::Read(const std::string& path, ProbeGridData& data) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+
+  FileHeader header;
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!in || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+    std::cerr << "Light probes " << path << " are from another version of ngine_bake; bake them again" << std::endl;
+    return false;
+  }
+  for (int i = 0; i < 3; ++i) {
+    if (header.counts[i] < 1 || header.counts[i] > MAX_PROBES_PER_AXIS) {
+      std::cerr << "Light probes " << path << " have a bad grid size" << std::endl;
+      return false;
+    }
+    data.origin[i] = header.origin[i];
+    data.counts[i] = header.counts[i];
+  }
+  data.spacing = header.spacing;
+
+  size_t probeCount = static_cast<size_t>(data.counts.x) * data.counts.y * data.counts.z;
+  data.coefficients.resize(probeCount * COEFFICIENTS * 3);
+  in.read(reinterpret_cast<char*>(data.coefficients.data()), static_cast<std::streamsize>(data.coefficients.size() * sizeof(float)));
+  if (!in) {
+    std::cerr << "Light probes " << path << " are truncated" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool LightProbes::Load(const std::string& path) {
+  ProbeGridData data;
+  if (!Read(path, data)) {
+    return false;
+  }
+
+  // Block k holds floats 4k to 4k + 3 of every probe's coefficients
+  glm::ivec3 size(data.counts.x, data.counts.y, data.counts.z * BLOCKS);
+  std::vector<float> texels(static_cast<size_t>(size.x) * size.y * size.z * 4, 0.0f);
+  size_t probe = 0;
+  for (int z = 0; z < data.counts.z; ++z) {
+    for (int y = 0; y < data.counts.y; ++y) {
+      for (int x = 0; x < data.counts.x; ++x, ++probe) {
+        const float* source = &data.coefficients[probe * COEFFICIENTS * 3];
+        for (int i = 0; i < COEFFICIENTS * 3; ++i) {
+          int slice = (i / 4) * data.counts.z + z;
+          texels[((static_cast<size_t>(slice) * size.y + y) * size.x + x) * 4 + i % 4] = source[i];
+        }
+      }
+    }
+  }
+
+  if (!texture) {
+    glGenTextures(1, &texture);
+  }
+  glBindTexture(GL_TEXTURE_3D, texture);
+  glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, size.x, size.y, size.z, 0, GL_RGBA, GL_FLOAT, texels.data());
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_3D, 0);
+
+  origin = data.origin;
+  spacing = data.spacing;
+  counts = data.counts;
+  std::cout << "Loaded light probes " << path << " (" << counts.x << "x" << counts.y << "x" << counts.z << ", " << spacing << " apart)" << std::endl;
+  return true;
+}
+
+void LightProbes::Shutdown() {
+  if (texture) {
+    glDeleteTextures(1, &texture);
+    texture = 0;
+  }
+  counts = glm::ivec3(0);
+}
+
+bool LightProbes::IsLoaded() {
+  return texture != 0;
+}
+
+void LightProbes::Apply(GLuint program) {
+  glUniform1i(glGetUniformLocation(program, "probeGrid"), PROBE_UNIT);
+  glUniform3fv(glGetUniformLocation(program, "probeOrigin"), 1, glm::value_ptr(origin));
+  glUniform1f(glGetUniformLocation(program, "probeSpacing"), spacing);
+  // Zero counts turn the probes off
+  glUniform3i(glGetUniformLocation(program, "probeCounts"), counts.x, counts.y, counts.z);
+  glActiveTexture(GL_TEXTURE0 + PROBE_UNIT);
+  glBindTexture(GL_TEXTURE_3D, texture);
+  glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,254 @@
+#include "Lightmaps.h"
+#include "GameObject.h"
+#include "Mesh.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+static const char MAGIC[8] = { 'N', 'G', 'L', 'I', 'G', 'H', 'T', 'M' };
+static const uint32_t VERSION = 1;
+// World matrices are matched to this many steps per unit
+static const float PLACEMENT_STEPS = 1024.0f;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  uint32_t layoutCount;
+  uint32_t instanceCount;
+};
+
+static_assert(std::is_trivially_copyable<LightmapInstance>::value, "instances are written as raw bytes");
+
+std::unordered_map<uint64_t, LightmapLayout> Lightmaps::layouts;
+std::unordered_map<uint64_t, glm::vec4> Lightmaps::rects;
+GLuint Lightmaps::texture = 0;
+
+static uint64_t Mix(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+static uint64_t InstanceKey(uint64_t geometry, uint64_t placement) {
+  return Mix(geometry ^ (placement * 0x9e3779b97f4a7c15ull));
+}
+
+template <typename T>
+static void WriteVector(std::ofstream& out, const std::vector<T>& values) {
+  out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+template <typename T>
+static void ReadVector(std::ifstream& in, std::vector<T>& values, size_t count) {
+  values.resize(count);
+  in.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+bool Lightmaps::Save(const std::string& path, const LightmapData& data) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    std::cerr << "Can't write lightmap " << path << std::endl;
+    return false;
+  }
+
+  FileHeader header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.width = data.width;
+  header.height = data.height;
+  header.layoutCount = static_cast<uint32_t>(data.layouts.size());
+  header.instanceCount = static_cast<uint32_t>(data.instances.size());
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  for (const auto& entry : data.layouts) {
+    uint64_t hash = entry.first;
+    uint32_t counts[2] = { static_cast<uint32_t>(entry.second.remap.size()), static_cast<uint32_t>(entry.second.indices.size()) };
+    out.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+    out.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+    WriteVector(out, entry.second.remap);
+    WriteVector(out, entry.second.uvs);
+    WriteVector(out, entry.second.indices);
+  }
+  WriteVector(out, data.instances);
+  WriteVector(out, data.texels);
+  return static_cast<bool>(out);
+}
+
+bool Lightmaps::Read(const std::string& path, LightmapData& data) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+
+  FileHeader header;
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!in || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.width <= 0 || header.height <= 0) {
+    std::cerr << "Lightmap " << path << " is from another version of ngine_bake; bake it again" << std::endl;
+    return false;
+  }
+
+  // Counts are checked against what's left of the file before anything is
+  // sized from them
+  std::streamoff start = in.tellg();
+  in.seekg(0, std::ios::end);
+  uint64_t remaining = static_cast<uint64_t>(in.tellg() - start);
+  in.seekg(start);
+
+  data.width = header.width;
+  data.height = header.height;
+  data.layouts.clear();
+  for (uint32_t i = 0; i < header.layoutCount && in; ++i) {
+    uint64_t hash;
+    uint32_t counts[2];
+    in.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+    in.read(reinterpret_cast<char*>(counts), sizeof(counts));
+    uint64_t bytes = sizeof(hash) + sizeof(counts) + static_cast<uint64_t>(counts[0]) * (sizeof(uint32_t) + 2 * sizeof(float)) + static_cast<uint64_t>(counts[1]) * sizeof(uint32_t);
+    if (!in || bytes > remaining) {
+      in.setstate(std::ios::failbit);
+      break;
+    }
+    remaining -= bytes;
+    LightmapLayout& layout = data.layouts[hash];
+    ReadVector(in, layout.remap, counts[0]);
+    ReadVector(in, layout.uvs, static_cast<size_t>(counts[0]) * 2);
+    ReadVector(in, layout.indices, counts[1]);
+  }
+  uint64_t tail = static_cast<uint64_t>(header.instanceCount) * sizeof(LightmapInstance) + static_cast<uint64_t>(data.width) * data.height * 3 * sizeof(uint16_t);
+  if (!in || tail > remaining) {
+    std::cerr << "Lightmap " << path << " is truncated" << std::endl;
+    return false;
+  }
+  ReadVector(in, data.instances, header.instanceCount);
+  ReadVector(in, data.texels, static_cast<size_t>(data.width) * data.height * 3);
+  if (!in) {
+    std::cerr << "Lightmap " << path << " is truncated" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool Lightmaps::Load(const std::string& path) {
+  LightmapData data;
+  if (!Read(path, data)) {
+    return false;
+  }
+
+  layouts = std::move(data.layouts);
+  rects.clear();
+  for (const LightmapInstance& instance : data.instances) {
+    rects[InstanceKey(instance.geometry, instance.placement)] = instance.rect;
+  }
+
+  if (!texture) {
+    glGenTextures(1, &texture);
+  }
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, data.width, data.height, 0, GL_RGB, GL_HALF_FLOAT, data.texels.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  std::cout << "Loaded lightmap " << path << " (" << data.width << "x" << data.height << ", " << rects.size() << " objects)" << std::endl;
+  return true;
+}
+
+void Lightmaps::Shutdown() {
+  if (texture) {
+    glDeleteTextures(1, &texture);
+    texture = 0;
+  }
+  layouts.clear();
+  rects.clear();
+}
+
+bool Lightmaps::IsLoaded() {
+  return texture != 0;
+}
+
+const LightmapLayout* Lightmaps::FindLayout(uint64_t meshHash, size_t vertexCount, size_t indexCount) {
+  auto it = layouts.find(meshHash);
+  if (it == layouts.end()) {
+    return nullptr;
+  }
+
+  // A stale file or a hash collision can describe some other mesh; its
+  // numbers are only trusted once they fit this one
+  const LightmapLayout& layout = it->second;
+  bool fits = layout.indices.size() == indexCount && layout.uvs.size() == layout.remap.size() * 2;
+  for (size_t k = 0; fits && k < layout.remap.size(); ++k) {
+    fits = layout.remap[k] < vertexCount;
+  }
+  for (size_t k = 0; fits && k < layout.indices.size(); ++k) {
+    fits = layout.indices[k] < layout.remap.size();
+  }
+  if (!fits) {
+    std::cerr << "Lightmap layout " << std::hex << meshHash << std::dec << " doesn't match its mesh; drawing it without the lightmap" << std::endl;
+    return nullptr;
+  }
+  return &layout;
+}
+
+uint64_t Lightmaps::GeometryHash(const GameObject& object) {
+  if (object.isModel && object.model) {
+    uint64_t hash = 0;
+    for (const auto& mesh : object.model->meshes) {
+      hash = Mix(hash ^ mesh->contentHash);
+    }
+    return hash;
+  }
+  return object.mesh ? object.mesh->contentHash : 0;
+}
+
+uint64_t Lightmaps::PlacementHash(const glm::mat4& worldMatrix) {
+  uint64_t hash = 0;
+  for (int column = 0; column < 4; ++column) {
+    for (int row = 0; row < 3; ++row) {
+      int64_t step = static_cast<int64_t>(std::llround(worldMatrix[column][row] * PLACEMENT_STEPS));
+      hash = Mix(hash ^ static_cast<uint64_t>(step));
+    }
+  }
+  return hash;
+}
+
+// Meshes made before the lightmap was loaded never got their UVs
+static bool HasLightmapUVs(const GameObject& object) {
+  if (object.isModel && object.model) {
+    for (const auto& mesh : object.model->meshes) {
+      if (!mesh->lightmapVBO) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return object.mesh->lightmapVBO != 0;
+}
+
+void Lightmaps::BuildFrame(const std::vector<std::shared_ptr<GameObject>>& objects) {
+  if (rects.empty()) {
+    return;
+  }
+  for (const auto& object : objects) {
+    if (!object->isStatic || !object->mesh || !HasLightmapUVs(*object)) {
+      continue;
+    }
+    auto it = rects.find(InstanceKey(GeometryHash(*object), PlacementHash(object->GetDrawMatrix())));
+    object->lightmapRect = it == rects.end() ? glm::vec4(0.0f) : it->second;
+  }
+}
+
+void Lightmaps::Apply(GLuint program) {
+  glUniform1i(glGetUniformLocation(program, "lightmap"), LIGHTMAP_UNIT);
+  glActiveTexture(GL_TEXTURE0 + LIGHTMAP_UNIT);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glActiveTexture(GL_TEXTURE0);
+}
@@ -1,63 +1,105 @@
 #include "Mesh.h"
+#include "Lightmaps.h"
 
 #include <glm/gtc/type_ptr.hpp>
 
 Mesh::Mesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices)
-  : vertices(vertices), indices(indices), vertexCount(vertices.size() / 9), indexCount(indices.size()) {
+  : VAO(0), vertices(vertices), indices(indices), vertexCount(vertices.size() / 9), indexCount(indices.size()), vertexStride(9) {
   
-  // Create buffers
-  glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
-  glGenBuffers(1, &EBO);
-  
-  // Bind the VAO
-  glBindVertexArray(VAO);
-  
-  // Bind and set the VBO
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-  
-  // Bind the EBO
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-  
-  // Position attribute (3 floats)
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-  
-  // Color attribute (3 floats)
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
-  
-  // Normal attribute (3 floats)
-  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(6 * sizeof(float)));
-  glEnableVertexAttribArray(2);
-
-  // Unbind the VBO and VAO
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+  ComputeContentHash();
+  CreateBuffers();
+  ComputeBounds(vertexStride);
 }
 
 // Constructor for textured meshes
 Mesh::Mesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures, Material material)
-    : vertices(vertices), indices(indices), textures(textures), vertexCount(vertices.size() / 11), indexCount(indices.size()), hasTextureCoords(true) {
+    : VAO(0), vertices(vertices), indices(indices), textures(textures), vertexCount(vertices.size() / 11), indexCount(indices.size()), vertexStride(11), hasTextureCoords(true) {
 
-  // Create buffers
-  glGenVertexArrays(1, &VAO);
+  ComputeContentHash();
+  CreateBuffers();
+
+  this->material = material;
+
+  ComputeBounds(vertexStride);
+}
+
+Mesh::~Mesh() {
+  if (VAO) {
+    glDeleteVertexArrays(1, &VAO);
+  }
+  glDeleteBuffers(1, &VBO);
+  glDeleteBuffers(1, &EBO);
+  if (lightmapVBO) {
+    glDeleteBuffers(1, &lightmapVBO);
+  }
+}
+
+void Mesh::ComputeContentHash() {
+  // FNV-1a
+  uint64_t hash = 1469598103934665603ull;
+  auto mix = [&hash](const void* data, size_t bytes) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < bytes; ++i) {
+      hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+  };
+  mix(&vertexStride, sizeof(vertexStride));
+  mix(vertices.data(), vertices.size() * sizeof(float));
+  mix(indices.data(), indices.size() * sizeof(unsigned int));
+  contentHash = hash;
+}
+
+void Mesh::CreateBuffers() {
+  // Buffers are shared between GL contexts, so these can be filled on
+  // whichever thread loads the mesh
   glGenBuffers(1, &VBO);
   glGenBuffers(1, &EBO);
 
-  // Bind the VAO
-  glBindVertexArray(VAO);
+  // Lightmapped meshes split their vertices along chart edges
+  const LightmapLayout* layout = Lightmaps::FindLayout(contentHash, vertices.size() / vertexStride, indices.size());
+  if (layout) {
+    std::vector<float> remapped;
+    remapped.reserve(layout->remap.size() * vertexStride);
+    for (uint32_t source : layout->remap) {
+      remapped.insert(remapped.end(), vertices.begin() + source * vertexStride, vertices.begin() + (source + 1) * vertexStride);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, remapped.size() * sizeof(float), remapped.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &lightmapVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, lightmapVBO);
+    glBufferData(GL_ARRAY_BUFFER, layout->uvs.size() * sizeof(float), layout->uvs.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, layout->indices.size() * sizeof(uint32_t), layout->indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    return;
+  }
 
-  // Bind and set the VBO/EBO (same as your current code)
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
   glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Mesh::BindVertexArray() const {
+  if (VAO) {
+    glBindVertexArray(VAO);
+    return;
+  }
+
+  // VAOs are not shared between contexts, so the VAO is made by the first
+  // context to draw the mesh
+  glGenVertexArrays(1, &VAO);
+  glBindVertexArray(VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 
-  int stride = 11 * sizeof(float);
+  GLsizei stride = vertexStride * sizeof(float);
 
   // Position attribute
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
@@ -72,23 +114,52 @@ Mesh::Mesh(const std::vector<float>& vertices, const std::vector<unsigned int>&
   glEnableVertexAttribArray(2);
 
   // Texture coordinate attribute
-  glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void*)(9 * sizeof(float)));
-  glEnableVertexAttribArray(3);
+  if (vertexStride >= 11) {
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void*)(9 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+  }
 
-  // Unbind
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+  // Lightmap UVs live in a buffer of their own
+  if (lightmapVBO) {
+    glBindBuffer(GL_ARRAY_BUFFER, lightmapVBO);
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(4);
+  }
 
-  this->material = material;
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-Mesh::~Mesh() {
-  glDeleteVertexArrays(1, &VAO);
-  glDeleteBuffers(1, &VBO);
-  glDeleteBuffers(1, &EBO);
+void Mesh::ComputeBounds(int stride) {
+  if (vertices.size() < 3) {
+    return;
+  }
+
+  boundsMin = glm::vec3(vertices[0], vertices[1], vertices[2]);
+  boundsMax = boundsMin;
+  for (size_t i = 0; i + 2 < vertices.size(); i += stride) {
+    glm::vec3 position(vertices[i], vertices[i + 1], vertices[i + 2]);
+    boundsMin = glm::min(boundsMin, position);
+    boundsMax = glm::max(boundsMax, position);
+  }
 }
 
 void Mesh::Draw(unsigned int shaderProgram) const {
+  ApplyMaterial(shaderProgram, material);
+
+  // Draw the mesh
+  DrawElements();
+  glBindVertexArray(0);
+  
+  // Clean up textures
+  if (material.useTexture) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+}
+
+void Mesh::ApplyMaterial(unsigned int shaderProgram, const Material& material) const {
   // Set material properties
   glUniform3fv(glGetUniformLocation(shaderProgram, "material.ambient"), 1, glm::value_ptr(material.ambient));
   glUniform3fv(glGetUniformLocation(shaderProgram, "material.diffuse"), 1, glm::value_ptr(material.diffuse));
@@ -129,17 +200,9 @@ void Mesh::Draw(unsigned int shaderProgram) const {
       glUniform1i(glGetUniformLocation(shaderProgram, "material.specularMap"), 1);
     }
   }
+}
 
-  // Draw the mesh
-  glBindVertexArray(VAO);
+void Mesh::DrawElements() const {
+  BindVertexArray();
   glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
-  
-  // Clean up textures
-  if (material.useTexture) {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, 0);
-  }
 }
@@ -5,6 +5,8 @@
 
 #include <iostream>
 
+#include "FrameCapture.h"
+
 unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma = false);
 
 void Model::Draw(unsigned int shaderProgram) {
@@ -14,6 +16,7 @@ void Model::Draw(unsigned int shaderProgram) {
 }
 
 void Model::LoadModel(std::string& path) {
+  this->path = path;
   Assimp::Importer importer;
   const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
 
@@ -31,6 +34,55 @@ void Model::LoadModel(std::string& path) {
   }
 
   ProcessNode(scene->mRootNode, scene);
+
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    boundsMin = i == 0 ? meshes[i]->boundsMin : glm::min(boundsMin, meshes[i]->boundsMin);
+    boundsMax = i == 0 ? meshes[i]->boundsMax : glm::max(boundsMax, meshes[i]->boundsMax);
+  }
+}
+
+void Model::LoadOccluderProxy(const std::string& path) {
+  // Only positions are needed, so the proxy never touches the GPU
+  Assimp::Importer importer;
+  const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+
+  if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+    std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+    return;
+  }
+
+  auto triangles = std::make_shared<std::vector<glm::vec3>>();
+  for(unsigned int m = 0; m < scene->mNumMeshes; ++m) {
+    const aiMesh* mesh = scene->mMeshes[m];
+    for(unsigned int f = 0; f < mesh->mNumFaces; ++f) {
+      const aiFace& face = mesh->mFaces[f];
+      if(face.mNumIndices != 3) {
+        continue;
+      }
+      for(unsigned int j = 0; j < 3; ++j) {
+        const aiVector3D& v = mesh->mVertices[face.mIndices[j]];
+        triangles->push_back(glm::vec3(v.x, v.y, v.z));
+      }
+    }
+  }
+  occluderTriangles = triangles;
+}
+
+void Model::UseMeshesAsOccluder() {
+  if(occluderTriangles) {
+    return;
+  }
+
+  auto triangles = std::make_shared<std::vector<glm::vec3>>();
+  for(const auto& mesh : meshes) {
+    for(size_t i = 0; i + 2 < mesh->indices.size(); i += 3) {
+      for(size_t j = 0; j < 3; ++j) {
+        size_t base = static_cast<size_t>(mesh->indices[i + j]) * mesh->vertexStride;
+        triangles->push_back(glm::vec3(mesh->vertices[base], mesh->vertices[base + 1], mesh->vertices[base + 2]));
+      }
+    }
+  }
+  occluderTriangles = triangles;
 }
 
 void Model::ProcessNode(aiNode* node, const aiScene* scene) {
@@ -217,6 +269,7 @@ unsigned int TextureFromFile(const char *path, const std::string &directory, boo
     std::cout << "Texture failed to load at path: " << path << std::endl;
     stbi_image_free(data);
   }
+  FrameCapture::NoteTexture(textureID, directory, path);
 
   return textureID;
 }
\ No newline at end of file
@@ -0,0 +1,445 @@
+#include "NullGL.h"
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+// This frame's counters; stubs run on the render thread and the upload
+// context's thread at once
+static std::atomic<uint64_t> drawCalls(0);
+static std::atomic<uint64_t> indices(0);
+static std::atomic<uint64_t> bytesUploaded(0);
+static std::atomic<uint64_t> stateChanges(0);
+static std::atomic<uint64_t> uniformUploads(0);
+static std::atomic<uint64_t> objectsCreated(0);
+
+static std::atomic<GLuint> nextName(1);
+static std::mutex statsMutex;
+static NullGL::Stats lastFrame;
+static NullGL::Stats totals;
+
+// Anything non-null will do for a context
+static int contextToken = 0;
+
+static uint64_t BytesPerPixel(GLenum format, GLenum type) {
+  uint64_t channels = 4;
+  switch (format) {
+    case GL_RED: case GL_DEPTH_COMPONENT: case GL_RED_INTEGER: channels = 1; break;
+    case GL_RG: case GL_DEPTH_STENCIL: case GL_RG_INTEGER: channels = 2; break;
+    case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: channels = 3; break;
+    default: channels = 4; break;
+  }
+  switch (type) {
+    case GL_FLOAT: case GL_UNSIGNED_INT: case GL_INT: return channels * 4;
+    case GL_HALF_FLOAT: case GL_UNSIGNED_SHORT: case GL_SHORT: return channels * 2;
+    case GL_UNSIGNED_INT_24_8: return 4;
+    default: return channels;
+  }
+}
+
+// Objects
+
+static void APIENTRY NullGenNames(GLsizei n, GLuint* names) {
+  for (GLsizei i = 0; i < n; ++i) {
+    names[i] = nextName++;
+  }
+  objectsCreated += n;
+}
+
+static void APIENTRY NullDeleteNames(GLsizei, const GLuint*) {}
+static void APIENTRY NullDeleteName(GLuint) {}
+
+static GLuint APIENTRY NullCreateProgram() {
+  ++objectsCreated;
+  return nextName++;
+}
+
+static GLuint APIENTRY NullCreateShader(GLenum) {
+  ++objectsCreated;
+  return nextName++;
+}
+
+// Shaders always compile and link, with nothing to say about it
+static void APIENTRY NullGetObjectiv(GLuint, GLenum pname, GLint* params) {
+  *params = (pname == GL_COMPILE_STATUS || pname == GL_LINK_STATUS) ? GL_TRUE : 0;
+}
+
+static void APIENTRY NullGetInfoLog(GLuint, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+  if (length) {
+    *length = 0;
+  }
+  if (infoLog && bufSize > 0) {
+    infoLog[0] = '\0';
+  }
+}
+
+static void APIENTRY NullShaderSource(GLuint, GLsizei, const GLchar* const*, const GLint*) {}
+static void APIENTRY NullShaderOp(GLuint) {}
+static void APIENTRY NullShaderPair(GLuint, GLuint) {}
+static void APIENTRY NullTransformFeedbackVaryings(GLuint, GLsizei, const GLchar* const*, GLenum) {}
+
+static GLint APIENTRY NullGetUniformLocation(GLuint, const GLchar*) {
+  return 0;
+}
+
+// Uploads
+
+static void APIENTRY NullBufferData(GLenum, GLsizeiptr size, const void*, GLenum) {
+  bytesUploaded += static_cast<uint64_t>(size);
+}
+
+static void APIENTRY NullBufferSubData(GLenum, GLintptr, GLsizeiptr size, const void*) {
+  bytesUploaded += static_cast<uint64_t>(size);
+}
+
+// Mapped ranges are written into scratch memory that's thrown away. Stream
+// buffers map each write separately here, as there's no buffer storage.
+static thread_local std::vector<uint8_t> mappedScratch;
+
+static void* APIENTRY NullMapBufferRange(GLenum, GLintptr, GLsizeiptr length, GLbitfield) {
+  bytesUploaded += static_cast<uint64_t>(length);
+  if (mappedScratch.size() < static_cast<size_t>(length)) {
+    mappedScratch.resize(length);
+  }
+  return mappedScratch.data();
+}
+
+static GLboolean APIENTRY NullUnmapBuffer(GLenum) {
+  return GL_TRUE;
+}
+
+static void APIENTRY NullFlushMappedBufferRange(GLenum, GLintptr, GLsizeiptr) {}
+
+static void APIENTRY NullTexImage2D(GLenum, GLint, GLint, GLsizei width, GLsizei height, GLint, GLenum format, GLenum type, const void* pixels) {
+  // Allocation only when there's no data
+  if (pixels) {
+    bytesUploaded += static_cast<uint64_t>(width) * height * BytesPerPixel(format, type);
+  }
+}
+
+static void APIENTRY NullTexImage3D(GLenum, GLint, GLint, GLsizei width, GLsizei height, GLsizei depth, GLint, GLenum format, GLenum type, const void* pixels) {
+  if (pixels) {
+    bytesUploaded += static_cast<uint64_t>(width) * height * depth * BytesPerPixel(format, type);
+  }
+}
+
+static void APIENTRY NullTexSubImage2D(GLenum, GLint, GLint, GLint, GLsizei width, GLsizei height, GLenum format, GLenum type, const void*) {
+  bytesUploaded += static_cast<uint64_t>(width) * height * BytesPerPixel(format, type);
+}
+
+static void APIENTRY NullReadPixels(GLint, GLint, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels) {
+  if (pixels) {
+    std::memset(pixels, 0, static_cast<size_t>(width) * height * BytesPerPixel(format, type));
+  }
+}
+
+static void APIENTRY NullUniform1i(GLint, GLint) { ++uniformUploads; }
+static void APIENTRY NullUniform1f(GLint, GLfloat) { ++uniformUploads; }
+static void APIENTRY NullUniform3i(GLint, GLint, GLint, GLint) { ++uniformUploads; }
+static void APIENTRY NullUniformiv(GLint, GLsizei, const GLint*) { ++uniformUploads; }
+static void APIENTRY NullUniformfv(GLint, GLsizei, const GLfloat*) { ++uniformUploads; }
+static void APIENTRY NullUniformMatrix(GLint, GLsizei, GLboolean, const GLfloat*) { ++uniformUploads; }
+
+// Draws
+
+static void APIENTRY NullDrawArrays(GLenum, GLint, GLsizei count) {
+  ++drawCalls;
+  indices += count;
+}
+
+static void APIENTRY NullDrawElements(GLenum, GLsizei count, GLenum, const void*) {
+  ++drawCalls;
+  indices += count;
+}
+
+static void APIENTRY NullDrawArraysInstanced(GLenum, GLint, GLsizei count, GLsizei instances) {
+  ++drawCalls;
+  indices += static_cast<uint64_t>(count) * instances;
+}
+
+static void APIENTRY NullDrawElementsInstanced(GLenum, GLsizei count, GLenum, const void*, GLsizei instances) {
+  ++drawCalls;
+  indices += static_cast<uint64_t>(count) * instances;
+}
+
+// Transform feedback writes nothing, so captured buffers keep their contents
+static void APIENTRY NullBeginTransformFeedback(GLenum) { ++stateChanges; }
+static void APIENTRY NullEndTransformFeedback() { ++stateChanges; }
+
+static void APIENTRY NullClear(GLbitfield) {}
+static void APIENTRY NullBlitFramebuffer(GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLbitfield, GLenum) {}
+
+// State
+
+static void APIENTRY NullBind(GLenum, GLuint) { ++stateChanges; }
+static void APIENTRY NullBindOne(GLuint) { ++stateChanges; }
+static void APIENTRY NullBindBase(GLenum, GLuint, GLuint) { ++stateChanges; }
+static void APIENTRY NullEnum(GLenum) { ++stateChanges; }
+static void APIENTRY NullEnumPair(GLenum, GLenum) { ++stateChanges; }
+static void APIENTRY NullRect(GLint, GLint, GLsizei, GLsizei) { ++stateChanges; }
+static void APIENTRY NullColor(GLfloat, GLfloat, GLfloat, GLfloat) { ++stateChanges; }
+static void APIENTRY NullColorMask(GLboolean, GLboolean, GLboolean, GLboolean) { ++stateChanges; }
+static void APIENTRY NullDepthMask(GLboolean) { ++stateChanges; }
+static void APIENTRY NullPolygonOffset(GLfloat, GLfloat) { ++stateChanges; }
+static void APIENTRY NullPixelStorei(GLenum, GLint) { ++stateChanges; }
+static void APIENTRY NullTexParameteri(GLenum, GLenum, GLint) { ++stateChanges; }
+static void APIENTRY NullVertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) { ++stateChanges; }
+static void APIENTRY NullVertexAttribDivisor(GLuint, GLuint) { ++stateChanges; }
+
+static void APIENTRY NullGenerateMipmap(GLenum) {}
+static void APIENTRY NullFramebufferRenderbuffer(GLenum, GLenum, GLenum, GLuint) {}
+static void APIENTRY NullFramebufferTexture2D(GLenum, GLenum, GLenum, GLuint, GLint) {}
+static void APIENTRY NullFramebufferTextureLayer(GLenum, GLenum, GLuint, GLint, GLint) {}
+static void APIENTRY NullRenderbufferStorage(GLenum, GLenum, GLsizei, GLsizei) {}
+
+static GLenum APIENTRY NullCheckFramebufferStatus(GLenum) {
+  return GL_FRAMEBUFFER_COMPLETE;
+}
+
+// Queries and sync: everything is ready, visible and took no time
+
+static void APIENTRY NullQueryCounter(GLuint, GLenum) {}
+static void APIENTRY NullBeginQuery(GLenum, GLuint) {}
+static void APIENTRY NullEndQuery(GLenum) {}
+
+static void APIENTRY NullGetQueryObjectuiv(GLuint, GLenum, GLuint* params) {
+  *params = 1;
+}
+
+static void APIENTRY NullGetQueryObjectui64v(GLuint, GLenum, GLuint64* params) {
+  *params = 0;
+}
+
+static GLsync APIENTRY NullFenceSync(GLenum, GLbitfield) {
+  return reinterpret_cast<GLsync>(static_cast<uintptr_t>(nextName++));
+}
+
+static GLenum APIENTRY NullClientWaitSync(GLsync, GLbitfield, GLuint64) {
+  return GL_ALREADY_SIGNALED;
+}
+
+static void APIENTRY NullWaitSync(GLsync, GLbitfield, GLuint64) {}
+static void APIENTRY NullDeleteSync(GLsync) {}
+static void APIENTRY NullFlush() {}
+
+// Queries about the driver
+
+static const GLubyte* APIENTRY NullGetString(GLenum name) {
+  switch (name) {
+    case GL_VERSION: return reinterpret_cast<const GLubyte*>("3.3.0 NullGL");
+    case GL_SHADING_LANGUAGE_VERSION: return reinterpret_cast<const GLubyte*>("3.30");
+    case GL_RENDERER: return reinterpret_cast<const GLubyte*>("NullGL");
+    case GL_VENDOR: return reinterpret_cast<const GLubyte*>("NGine");
+    default: return reinterpret_cast<const GLubyte*>("");
+  }
+}
+
+// glad gives up on a driver without extensions, so there's one
+static const GLubyte* APIENTRY NullGetStringi(GLenum, GLuint) {
+  return reinterpret_cast<const GLubyte*>("GL_NGINE_null_driver");
+}
+
+static void APIENTRY NullGetIntegerv(GLenum pname, GLint* data) {
+  switch (pname) {
+    case GL_MAJOR_VERSION: *data = 3; break;
+    case GL_MINOR_VERSION: *data = 3; break;
+    case GL_MAX_TEXTURE_SIZE: *data = 16384; break;
+    case GL_NUM_EXTENSIONS: *data = 1; break;
+    case GL_VIEWPORT: case GL_SCISSOR_BOX: data[0] = data[1] = data[2] = data[3] = 0; break;
+    case GL_POLYGON_MODE: data[0] = data[1] = GL_FILL; break;
+    default: *data = 0; break;
+  }
+}
+
+static void APIENTRY NullGetFloatv(GLenum pname, GLfloat* data) {
+  switch (pname) {
+    case GL_COLOR_CLEAR_VALUE: data[0] = data[1] = data[2] = data[3] = 0.0f; break;
+    default: *data = 0.0f; break;
+  }
+}
+
+static void APIENTRY NullDrawBuffers(GLsizei, const GLenum*) { ++stateChanges; }
+
+static GLenum APIENTRY NullGetError() {
+  return GL_NO_ERROR;
+}
+
+struct NullEntry {
+  const char* name;
+  void* function;
+};
+
+#define NULL_GL(name, function) { name, reinterpret_cast<void*>(function) }
+
+static const NullEntry entries[] = {
+  NULL_GL("glGenBuffers", NullGenNames),
+  NULL_GL("glGenTextures", NullGenNames),
+  NULL_GL("glGenVertexArrays", NullGenNames),
+  NULL_GL("glGenFramebuffers", NullGenNames),
+  NULL_GL("glGenRenderbuffers", NullGenNames),
+  NULL_GL("glGenQueries", NullGenNames),
+  NULL_GL("glDeleteBuffers", NullDeleteNames),
+  NULL_GL("glDeleteTextures", NullDeleteNames),
+  NULL_GL("glDeleteVertexArrays", NullDeleteNames),
+  NULL_GL("glDeleteFramebuffers", NullDeleteNames),
+  NULL_GL("glDeleteRenderbuffers", NullDeleteNames),
+  NULL_GL("glDeleteQueries", NullDeleteNames),
+  NULL_GL("glDeleteProgram", NullDeleteName),
+  NULL_GL("glDeleteShader", NullDeleteName),
+  NULL_GL("glCreateProgram", NullCreateProgram),
+  NULL_GL("glCreateShader", NullCreateShader),
+  NULL_GL("glGetShaderiv", NullGetObjectiv),
+  NULL_GL("glGetProgramiv", NullGetObjectiv),
+  NULL_GL("glGetShaderInfoLog", NullGetInfoLog),
+  NULL_GL("glGetProgramInfoLog", NullGetInfoLog),
+  NULL_GL("glShaderSource", NullShaderSource),
+  NULL_GL("glCompileShader", NullShaderOp),
+  NULL_GL("glLinkProgram", NullShaderOp),
+  NULL_GL("glAttachShader", NullShaderPair),
+  NULL_GL("glDetachShader", NullShaderPair),
+  NULL_GL("glTransformFeedbackVaryings", NullTransformFeedbackVaryings),
+  NULL_GL("glGetUniformLocation", NullGetUniformLocation),
+
+  NULL_GL("glBufferData", NullBufferData),
+  NULL_GL("glBufferSubData", NullBufferSubData),
+  NULL_GL("glMapBufferRange", NullMapBufferRange),
+  NULL_GL("glUnmapBuffer", NullUnmapBuffer),
+  NULL_GL("glFlushMappedBufferRange", NullFlushMappedBufferRange),
+  NULL_GL("glTexImage2D", NullTexImage2D),
+  NULL_GL("glTexImage3D", NullTexImage3D),
+  NULL_GL("glTexSubImage2D", NullTexSubImage2D),
+  NULL_GL("glReadPixels", NullReadPixels),
+  NULL_GL("glUniform1i", NullUniform1i),
+  NULL_GL("glUniform1iv", NullUniformiv),
+  NULL_GL("glUniform1f", NullUniform1f),
+  NULL_GL("glUniform3i", NullUniform3i),
+  NULL_GL("glUniform2fv", NullUniformfv),
+  NULL_GL("glUniform3fv", NullUniformfv),
+  NULL_GL("glUniform4fv", NullUniformfv),
+  NULL_GL("glUniformMatrix3fv", NullUniformMatrix),
+  NULL_GL("glUniformMatrix4fv", NullUniformMatrix),
+
+  NULL_GL("glDrawArrays", NullDrawArrays),
+  NULL_GL("glDrawElements", NullDrawElements),
+  NULL_GL("glDrawArraysInstanced", NullDrawArraysInstanced),
+  NULL_GL("glDrawElementsInstanced", NullDrawElementsInstanced),
+  NULL_GL("glBeginTransformFeedback", NullBeginTransformFeedback),
+  NULL_GL("glEndTransformFeedback", NullEndTransformFeedback),
+  NULL_GL("glClear", NullClear),
+  NULL_GL("glBlitFramebuffer", NullBlitFramebuffer),
+
+  NULL_GL("glBindBuffer", NullBind),
+  NULL_GL("glBindTexture", NullBind),
+  NULL_GL("glBindFramebuffer", NullBind),
+  NULL_GL("glBindRenderbuffer", NullBind),
+  NULL_GL("glBindVertexArray", NullBindOne),
+  NULL_GL("glBindBufferBase", NullBindBase),
+  NULL_GL("glUseProgram", NullBindOne),
+  NULL_GL("glEnableVertexAttribArray", NullBindOne),
+  NULL_GL("glDisableVertexAttribArray", NullBindOne),
+  NULL_GL("glActiveTexture", NullEnum),
+  NULL_GL("glEnable", NullEnum),
+  NULL_GL("glDisable", NullEnum),
+  NULL_GL("glDepthFunc", NullEnum),
+  NULL_GL("glCullFace", NullEnum),
+  NULL_GL("glPolygonMode", NullEnumPair),
+  NULL_GL("glReadBuffer", NullEnum),
+  NULL_GL("glDrawBuffer", NullEnum),
+  NULL_GL("glDrawBuffers", NullDrawBuffers),
+  NULL_GL("glBlendFunc", NullEnumPair),
+  NULL_GL("glViewport", NullRect),
+  NULL_GL("glScissor", NullRect),
+  NULL_GL("glClearColor", NullColor),
+  NULL_GL("glColorMask", NullColorMask),
+  NULL_GL("glDepthMask", NullDepthMask),
+  NULL_GL("glPolygonOffset", NullPolygonOffset),
+  NULL_GL("glPixelStorei", NullPixelStorei),
+  NULL_GL("glTexParameteri", NullTexParameteri),
+  NULL_GL("glVertexAttribPointer", NullVertexAttribPointer),
+  NULL_GL("glVertexAttribDivisor", NullVertexAttribDivisor),
+
+  NULL_GL("glGenerateMipmap", NullGenerateMipmap),
+  NULL_GL("glFramebufferRenderbuffer", NullFramebufferRenderbuffer),
+  NULL_GL("glFramebufferTexture2D", NullFramebufferTexture2D),
+  NULL_GL("glFramebufferTextureLayer", NullFramebufferTextureLayer),
+  NULL_GL("glRenderbufferStorage", NullRenderbufferStorage),
+  NULL_GL("glCheckFramebufferStatus", NullCheckFramebufferStatus),
+
+  NULL_GL("glQueryCounter", NullQueryCounter),
+  NULL_GL("glBeginQuery", NullBeginQuery),
+  NULL_GL("glEndQuery", NullEndQuery),
+  NULL_GL("glGetQueryObjectuiv", NullGetQueryObjectuiv),
+  NULL_GL("glGetQueryObjectui64v", NullGetQueryObjectui64v),
+  NULL_GL("glFenceSync", NullFenceSync),
+  NULL_GL("glClientWaitSync", NullClientWaitSync),
+  NULL_GL("glWaitSync", NullWaitSync),
+  NULL_GL("glDeleteSync", NullDeleteSync),
+  NULL_GL("glFlush", NullFlush),
+  NULL_GL("glFinish", NullFlush),
+
+  NULL_GL("glGetString", NullGetString),
+  NULL_GL("glGetStringi", NullGetStringi),
+  NULL_GL("glGetIntegerv", NullGetIntegerv),
+  NULL_GL("glGetFloatv", NullGetFloatv),
+  NULL_GL("glGetError", NullGetError),
+};
+
+#undef NULL_GL
+
+void* NullGL::GetProcAddress(const char* name) {
+  for (const NullEntry& entry : entries) {
+    if (std::strcmp(entry.name, name) == 0) {
+      return entry.function;
+    }
+  }
+  return nullptr;
+}
+
+void* NullGL::GetContext() {
+  return &contextToken;
+}
+
+void NullGL::EndFrame() {
+  Stats frame;
+  frame.frames = 1;
+  frame.drawCalls = drawCalls.exchange(0);
+  frame.indices = indices.exchange(0);
+  frame.bytesUploaded = bytesUploaded.exchange(0);
+  frame.stateChanges = stateChanges.exchange(0);
+  frame.uniformUploads = uniformUploads.exchange(0);
+  frame.objectsCreated = objectsCreated.exchange(0);
+
+  std::lock_guard<std::mutex> lock(statsMutex);
+  lastFrame = frame;
+  totals.frames += frame.frames;
+  totals.drawCalls += frame.drawCalls;
+  totals.indices += frame.indices;
+  totals.bytesUploaded += frame.bytesUploaded;
+  totals.stateChanges += frame.stateChanges;
+  totals.uniformUploads += frame.uniformUploads;
+  totals.objectsCreated += frame.objectsCreated;
+}
+
+NullGL::Stats NullGL::GetLastFrame() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  return lastFrame;
+}
+
+NullGL::Stats NullGL::GetTotals() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  return totals;
+}
+
+void NullGL::PrintReport() {
+  Stats total = GetTotals();
+  uint64_t frames = total.frames > 0 ? total.frames : 1;
+  std::cout << "Null renderer: " << total.frames << " frames" << std::endl;
+  std::cout << "  per frame: " << total.drawCalls / frames << " draws, "
+            << total.indices / frames << " indices, "
+            << total.stateChanges / frames << " state changes, "
+            << total.uniformUploads / frames << " uniform uploads, "
+            << total.bytesUploaded / frames << " bytes uploaded" << std::endl;
+  std::cout << "  total: " << total.bytesUploaded << " bytes uploaded, " << total.objectsCreated << " objects created" << std::endl;
+}
@@ -0,0 +1,302 @@
+#include "OcclusionCulling.h"
+#include "GLExtensions.h"
+#include "ShaderDB.h"
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Visible objects are re-tested this often (plus a per-object random offset so
+// the queries are spread over several frames)
+static const int VISIBLE_QUERY_INTERVAL = 8;
+// Objects that haven't been queued for this many frames lose their state
+static const int STALE_OBJECT_FRAMES = 300;
+// Bounding boxes are grown slightly so they don't z-fight with the geometry
+static const float BOUNDS_PADDING = 0.01f;
+
+std::atomic<bool> OcclusionCulling::enabled(false);
+int OcclusionCulling::frame = 0;
+GLenum OcclusionCulling::queryTarget = GL_ANY_SAMPLES_PASSED;
+
+glm::mat4 OcclusionCulling::view(1.0f);
+glm::mat4 OcclusionCulling::projection(1.0f);
+glm::vec3 OcclusionCulling::cameraPos(0.0f);
+
+std::shared_ptr<Shader> OcclusionCulling::boundsShader = nullptr;
+GLuint OcclusionCulling::boundsVAO = 0;
+GLuint OcclusionCulling::boundsVBO = 0;
+GLuint OcclusionCulling::boundsEBO = 0;
+
+std::unordered_map<uint64_t, OcclusionCulling::ObjectState> OcclusionCulling::objects;
+OcclusionCulling::Stats OcclusionCulling::stats;
+
+void OcclusionCulling::Init(bool enable) {
+  enabled = enable;
+  frame = 0;
+  queryTarget = GLExtensions::conservativeOcclusion ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+
+  // Built on first use (or up front by ShaderDB::WarmUp)
+  ShaderDB::RegisterPermutation("shaders/vertex/bounds.glsl", "shaders/fragment/bounds.glsl");
+
+  // Unit cube from (0,0,0) to (1,1,1), scaled onto each bounding box
+  float vertices[] = {
+    0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 1.0f,  1.0f, 0.0f, 1.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 1.0f
+  };
+  unsigned int indices[] = {
+    0, 1, 2, 2, 3, 0,  // back
+    4, 6, 5, 6, 4, 7,  // front
+    0, 3, 7, 7, 4, 0,  // left
+    1, 5, 6, 6, 2, 1,  // right
+    0, 4, 5, 5, 1, 0,  // bottom
+    3, 2, 6, 6, 7, 3   // top
+  };
+
+  glGenVertexArrays(1, &boundsVAO);
+  glGenBuffers(1, &boundsVBO);
+  glGenBuffers(1, &boundsEBO);
+
+  glBindVertexArray(boundsVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, boundsVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boundsEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+}
+
+void OcclusionCulling::Shutdown() {
+  for (auto& entry : objects) {
+    if (entry.second.query) {
+      glDeleteQueries(1, &entry.second.query);
+    }
+  }
+  objects.clear();
+
+  if (boundsVAO) {
+    glDeleteVertexArrays(1, &boundsVAO);
+    glDeleteBuffers(1, &boundsVBO);
+    glDeleteBuffers(1, &boundsEBO);
+    boundsVAO = boundsVBO = boundsEBO = 0;
+  }
+  boundsShader = nullptr;
+}
+
+void OcclusionCulling::SetEnabled(bool enable) {
+  enabled = enable;
+}
+
+bool OcclusionCulling::IsEnabled() {
+  return enabled;
+}
+
+void OcclusionCulling::SetCamera(const glm::mat4& v, const glm::mat4& p, const glm::vec3& pos) {
+  view = v;
+  projection = p;
+  cameraPos = pos;
+}
+
+void OcclusionCulling::RenderQueue(const std::vector<std::shared_ptr<GameObject>>& queue, GLuint shaderProgram, GLint modelLoc) {
+  ++frame;
+  stats.objectsTested = 0;
+  stats.objectsCulled = 0;
+  stats.queriesIssued = 0;
+  stats.resultsReceived = 0;
+
+  PollResults();
+
+  struct Entry {
+    GameObject* object;
+    ObjectState* state;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    float distance;
+  };
+
+  // Scripts re-submit their draws every frame, so an object is identified by
+  // the geometry it draws and how many times that geometry was queued before it.
+  std::vector<Entry> entries;
+  entries.reserve(queue.size());
+  std::unordered_map<const void*, uint32_t> ordinals;
+
+  for (const auto& gameObject : queue) {
+    const void* geometry = (gameObject->isModel && gameObject->model) ? static_cast<const void*>(gameObject->model.get()) : static_cast<const void*>(gameObject->mesh.get());
+    uint32_t ordinal = ordinals[geometry]++;
+    uint64_t key = (reinterpret_cast<uintptr_t>(geometry) * 31ull) ^ (static_cast<uint64_t>(ordinal) << 48);
+
+    auto inserted = objects.try_emplace(key);
+    ObjectState& state = inserted.first->second;
+    if (inserted.second) {
+      state.jitter = std::rand() % VISIBLE_QUERY_INTERVAL;
+    }
+    state.lastSeenFrame = frame;
+
+    Entry entry;
+    entry.object = gameObject.get();
+    entry.state = &state;
+    gameObject->GetWorldBounds(entry.boundsMin, entry.boundsMax);
+    glm::vec3 padding = (entry.boundsMax - entry.boundsMin) * BOUNDS_PADDING + glm::vec3(BOUNDS_PADDING);
+    entry.boundsMin -= padding;
+    entry.boundsMax += padding;
+    glm::vec3 toCenter = (entry.boundsMin + entry.boundsMax) * 0.5f - cameraPos;
+    entry.distance = glm::dot(toCenter, toCenter);
+    entries.push_back(entry);
+  }
+
+  // Front to back, so near objects fill the depth buffer before far ones are tested
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+    return a.distance < b.distance;
+  });
+
+  std::vector<Entry*> hiddenToTest;
+
+  for (auto& entry : entries) {
+    ObjectState& state = *entry.state;
+    ++stats.objectsTested;
+
+    // A box around the camera would be clipped by the near plane and report
+    // hidden, so anything we're standing inside is always drawn.
+    bool cameraInside = glm::all(glm::greaterThanEqual(cameraPos, entry.boundsMin)) && glm::all(glm::lessThanEqual(cameraPos, entry.boundsMax));
+    if (cameraInside) {
+      state.visible = true;
+    }
+
+    if (state.visible) {
+      // Visible objects are queried with their real geometry while drawing
+      bool queryDue = !cameraInside && !state.queryPending && frame - state.lastQueryFrame >= VISIBLE_QUERY_INTERVAL + state.jitter;
+      if (queryDue) {
+        BeginQuery(state);
+        entry.object->Draw(shaderProgram, modelLoc);
+        EndQuery();
+      } else {
+        entry.object->Draw(shaderProgram, modelLoc);
+      }
+    } else {
+      ++stats.objectsCulled;
+      if (!state.queryPending) {
+        hiddenToTest.push_back(&entry);
+      }
+    }
+  }
+
+  // Test hidden objects against everything drawn this frame, without touching
+  // the color or depth buffers.
+  if (!hiddenToTest.empty() && !boundsShader) {
+    boundsShader = ShaderDB::GetShader("shaders/vertex/bounds.glsl", "shaders/fragment/bounds.glsl");
+  }
+
+  if (!hiddenToTest.empty() && boundsShader->GetID()) {
+    GpuProfileScope profile("occlusion_tests");
+    boundsShader->Use();
+    boundsShader->SetMat4("view", view);
+    boundsShader->SetMat4("projection", projection);
+    GLint boundsModelLoc = glGetUniformLocation(boundsShader->GetID(), "model");
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(boundsVAO);
+
+    for (Entry* entry : hiddenToTest) {
+      glm::mat4 model = glm::translate(glm::mat4(1.0f), entry->boundsMin);
+      model = glm::scale(model, entry->boundsMax - entry->boundsMin);
+      glUniformMatrix4fv(boundsModelLoc, 1, GL_FALSE, glm::value_ptr(model));
+
+      BeginQuery(*entry->state);
+      glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+      EndQuery();
+    }
+
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glUseProgram(shaderProgram);
+  }
+
+  EvictStaleObjects();
+}
+
+void OcclusionCulling::PollResults() {
+  Uint64 now = SDL_GetPerformanceCounter();
+  double ticksToMs = 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+
+  int pending = 0;
+  for (auto& entry : objects) {
+    ObjectState& state = entry.second;
+    if (!state.queryPending) {
+      continue;
+    }
+
+    // Never wait on the GPU - if the result isn't there yet, keep using the old one
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      ++pending;
+      continue;
+    }
+
+    GLuint anySamples = 0;
+    glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &anySamples);
+    state.visible = anySamples != 0;
+    state.queryPending = false;
+
+    // Rolling averages of how long results take to come back
+    float latencyMs = static_cast<float>((now - state.issuedTicks) * ticksToMs);
+    float latencyFrames = static_cast<float>(frame - state.issuedFrame);
+    stats.averageLatencyMs += (latencyMs - stats.averageLatencyMs) * 0.05f;
+    stats.averageLatencyFrames += (latencyFrames - stats.averageLatencyFrames) * 0.05f;
+    ++stats.resultsReceived;
+  }
+  stats.queriesPending = pending;
+}
+
+void OcclusionCulling::BeginQuery(ObjectState& state) {
+  if (!state.query) {
+    glGenQueries(1, &state.query);
+  }
+  glBeginQuery(queryTarget, state.query);
+
+  state.queryPending = true;
+  state.issuedFrame = frame;
+  state.issuedTicks = SDL_GetPerformanceCounter();
+  state.lastQueryFrame = frame;
+  ++stats.queriesIssued;
+  ++stats.queriesPending;
+}
+
+void OcclusionCulling::EndQuery() {
+  glEndQuery(queryTarget);
+}
+
+void OcclusionCulling::EvictStaleObjects() {
+  for (auto it = objects.begin(); it != objects.end();) {
+    if (frame - it->second.lastSeenFrame > STALE_OBJECT_FRAMES) {
+      if (it->second.query) {
+        glDeleteQueries(1, &it->second.query);
+      }
+      it = objects.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+const OcclusionCulling::Stats& OcclusionCulling::GetStats() {
+  return stats;
+}
+
+int OcclusionCulling::GetCulledCount() {
+  return stats.objectsCulled;
+}
+
+int OcclusionCulling::GetQueryCount() {
+  return stats.queriesIssued;
+}
+
+float OcclusionCulling::GetQueryLatency() {
+  return stats.averageLatencyMs;
+}
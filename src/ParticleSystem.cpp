@@ -0,0 +1,336 @@
+#include "ParticleSystem.h"
+#include "ParticleSystemComponent.h"
+#include "ShaderDB.h"
+#include "JobSystem.h"
+#include "SimdMath.h"
+
+#include <algorithm>
+
+// Particles per job; systems smaller than this run on the main thread
+static const int PARTICLES_PER_CHUNK = 16384;
+// x, y, z, size, r, g, b, a
+static const int FLOATS_PER_PARTICLE = 8;
+// GPU particles: position and age, then velocity and lifetime
+static const int GPU_FLOATS_PER_PARTICLE = 8;
+// GPU pools of systems that haven't been drawn for this many frames are freed
+static const int STALE_POOL_FRAMES = 120;
+
+std::vector<ParticleSystemComponent*> ParticleSystem::systems;
+std::vector<ParticleSystem::Chunk> ParticleSystem::chunks;
+std::shared_ptr<Shader> ParticleSystem::shader = nullptr;
+GLuint ParticleSystem::vao = 0;
+GLuint ParticleSystem::quadVBO = 0;
+std::unique_ptr<StreamBuffer> ParticleSystem::instanceStream = nullptr;
+std::shared_ptr<Shader> ParticleSystem::updateShader = nullptr;
+std::shared_ptr<Shader> ParticleSystem::gpuDrawShader = nullptr;
+std::unordered_map<uint64_t, ParticleSystem::GpuPool> ParticleSystem::gpuPools;
+int ParticleSystem::frame = 0;
+
+void ParticleSystem::Init() {
+  shader = ShaderDB::GetShader("shaders/vertex/particle.glsl", "shaders/fragment/particle.glsl");
+  updateShader = ShaderDB::GetShader("shaders/vertex/particle_update.glsl", "shaders/fragment/particle_update.glsl", {}, {"outPositionAge", "outVelocityLifetime"});
+  gpuDrawShader = ShaderDB::GetShader("shaders/vertex/particle_gpu.glsl", "shaders/fragment/particle.glsl");
+
+  // Corners of a unit quad, drawn as a strip and scaled by each particle's size
+  float corners[] = {
+    -0.5f, -0.5f,  0.5f, -0.5f,  -0.5f, 0.5f,  0.5f, 0.5f
+  };
+
+  glGenVertexArrays(1, &vao);
+  glGenBuffers(1, &quadVBO);
+
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+
+  // Instance pointers are set per batch, at wherever its particles were streamed to
+  glEnableVertexAttribArray(1);
+  glVertexAttribDivisor(1, 1);
+  glEnableVertexAttribArray(2);
+  glVertexAttribDivisor(2, 1);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+  instanceStream = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, 512 * 1024);
+}
+
+void ParticleSystem::Shutdown() {
+  for (auto& entry : gpuPools) {
+    DestroyPool(entry.second);
+  }
+  gpuPools.clear();
+
+  if (vao) {
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &quadVBO);
+    vao = quadVBO = 0;
+  }
+  instanceStream = nullptr;
+  shader = nullptr;
+  updateShader = nullptr;
+  gpuDrawShader = nullptr;
+}
+
+void ParticleSystem::Register(ParticleSystemComponent* system) {
+  systems.push_back(system);
+}
+
+void ParticleSystem::Unregister(ParticleSystemComponent* system) {
+  systems.erase(std::remove(systems.begin(), systems.end(), system), systems.end());
+}
+
+void ParticleSystem::Update(float deltaTime, std::vector<ParticleBatch>& batches, std::vector<GpuParticleEmitter>& emitters) {
+  batches.clear();
+  emitters.clear();
+  chunks.clear();
+  // Chunks point into batches, so it mustn't reallocate
+  batches.reserve(systems.size());
+
+  for (ParticleSystemComponent* system : systems) {
+    // Templates have no actor, and removed actors' components are never updated again
+    if (!system->actor || system->destroyed || !system->IsEnabled()) {
+      continue;
+    }
+
+    if (system->gpu) {
+      emitters.emplace_back();
+      system->SpawnGpu(deltaTime, emitters.back());
+      continue;
+    }
+
+    // Spawning uses the system's random generator, so it stays on this thread
+    system->Spawn(deltaTime);
+    if (system->count == 0) {
+      continue;
+    }
+
+    batches.emplace_back();
+    ParticleBatch& batch = batches.back();
+    batch.count = system->count;
+    batch.additive = system->additive;
+    batch.instances.resize(static_cast<size_t>(system->count) * FLOATS_PER_PARTICLE);
+
+    for (int begin = 0; begin < system->count; begin += PARTICLES_PER_CHUNK) {
+      chunks.push_back({system, &batch, begin, std::min(begin + PARTICLES_PER_CHUNK, system->count)});
+    }
+  }
+
+  if (chunks.size() > 1) {
+    JobSystem::ParallelFor(static_cast<int>(chunks.size()), [deltaTime](int i) {
+      RunChunk(chunks[i], deltaTime);
+    });
+  } else if (!chunks.empty()) {
+    RunChunk(chunks[0], deltaTime);
+  }
+}
+
+void ParticleSystem::RunChunk(const Chunk& chunk, float deltaTime) {
+  ParticleSystemComponent& system = *chunk.system;
+
+  ParticleStreams streams;
+  streams.positionX = system.positionX.data();
+  streams.positionY = system.positionY.data();
+  streams.positionZ = system.positionZ.data();
+  streams.velocityX = system.velocityX.data();
+  streams.velocityY = system.velocityY.data();
+  streams.velocityZ = system.velocityZ.data();
+  streams.age = system.age.data();
+  streams.invLifetime = system.invLifetime.data();
+  streams.size = system.size.data();
+  streams.colorR = system.colorR.data();
+  streams.colorG = system.colorG.data();
+  streams.colorB = system.colorB.data();
+  streams.colorA = system.colorA.data();
+
+  ParticleParams params;
+  params.deltaTime = deltaTime;
+  params.gravity = system.gravity;
+  params.drag = system.drag;
+  params.startSize = system.startSize;
+  params.endSize = system.endSize;
+  params.startColor = system.startColor;
+  params.endColor = system.endColor;
+
+  SimdMath::IntegrateParticles(chunk.begin, chunk.end, streams, params);
+
+  float* out = chunk.batch->instances.data() + static_cast<size_t>(chunk.begin) * FLOATS_PER_PARTICLE;
+  for (int i = chunk.begin; i < chunk.end; ++i) {
+    out[0] = streams.positionX[i];
+    out[1] = streams.positionY[i];
+    out[2] = streams.positionZ[i];
+    out[3] = streams.size[i];
+    out[4] = streams.colorR[i];
+    out[5] = streams.colorG[i];
+    out[6] = streams.colorB[i];
+    out[7] = streams.colorA[i];
+    out += FLOATS_PER_PARTICLE;
+  }
+}
+
+void ParticleSystem::Render(const std::vector<ParticleBatch>& batches, const std::vector<GpuParticleEmitter>& emitters, const glm::mat4& view, const glm::mat4& projection) {
+  ++frame;
+  EvictStalePools();
+  if ((batches.empty() && emitters.empty()) || !shader || !shader->GetID()) {
+    return;
+  }
+
+  // Step the GPU systems before anything is drawn
+  std::vector<GpuPool*> pools;
+  if (!emitters.empty() && updateShader && updateShader->GetID()) {
+    glEnable(GL_RASTERIZER_DISCARD);
+    updateShader->Use();
+    for (const GpuParticleEmitter& emitter : emitters) {
+      GpuPool& pool = GetPool(emitter);
+      SimulateGpu(emitter, pool);
+      pools.push_back(&pool);
+    }
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+  }
+
+  shader->Use();
+  shader->SetMat4("view", view);
+  shader->SetMat4("projection", projection);
+
+  // Particles are tested against the scene but don't write depth, so they
+  // don't cut holes in each other
+  glEnable(GL_DEPTH_TEST);
+  glDepthMask(GL_FALSE);
+  glEnable(GL_BLEND);
+  glBindVertexArray(vao);
+
+  for (const ParticleBatch& batch : batches) {
+    glBlendFunc(GL_SRC_ALPHA, batch.additive ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+    size_t offset = instanceStream->Write(batch.instances.data(), batch.instances.size() * sizeof(float));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_PARTICLE * sizeof(float), (void*)offset);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_PARTICLE * sizeof(float), (void*)(offset + 4 * sizeof(float)));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, batch.count);
+  }
+
+  // Every slot is drawn; the shader throws away the dead ones
+  if (!pools.empty()) {
+    gpuDrawShader->Use();
+    gpuDrawShader->SetMat4("view", view);
+    gpuDrawShader->SetMat4("projection", projection);
+    for (size_t i = 0; i < pools.size(); ++i) {
+      const GpuParticleEmitter& emitter = emitters[i];
+      const GpuPool& pool = *pools[i];
+      gpuDrawShader->SetVec2("size", glm::vec2(emitter.params.startSize, emitter.params.endSize));
+      gpuDrawShader->SetVec4("startColor", emitter.params.startColor);
+      gpuDrawShader->SetVec4("endColor", emitter.params.endColor);
+      glBlendFunc(GL_SRC_ALPHA, emitter.additive ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+      glBindVertexArray(pool.drawVAOs[pool.current]);
+      glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, pool.capacity);
+    }
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+  glDisable(GL_BLEND);
+  glDepthMask(GL_TRUE);
+}
+
+ParticleSystem::GpuPool& ParticleSystem::GetPool(const GpuParticleEmitter& emitter) {
+  GpuPool& pool = gpuPools[emitter.id];
+  if (pool.capacity != emitter.capacity) {
+    // Resizing starts the system over
+    DestroyPool(pool);
+    CreatePool(pool, emitter.capacity);
+  }
+  pool.lastFrame = frame;
+  return pool;
+}
+
+void ParticleSystem::CreatePool(GpuPool& pool, int capacity) {
+  pool.capacity = capacity;
+  pool.current = 0;
+  if (capacity <= 0) {
+    return;
+  }
+
+  // All zeros: age 0 and lifetime 0, so every slot starts out dead
+  std::vector<float> empty(static_cast<size_t>(capacity) * GPU_FLOATS_PER_PARTICLE, 0.0f);
+  GLsizei stride = GPU_FLOATS_PER_PARTICLE * sizeof(float);
+
+  glGenBuffers(2, pool.buffers);
+  glGenVertexArrays(2, pool.updateVAOs);
+  glGenVertexArrays(2, pool.drawVAOs);
+  for (int i = 0; i < 2; ++i) {
+    glBindBuffer(GL_ARRAY_BUFFER, pool.buffers[i]);
+    glBufferData(GL_ARRAY_BUFFER, empty.size() * sizeof(float), empty.data(), GL_DYNAMIC_COPY);
+
+    // Update pass reads one particle per vertex
+    glBindVertexArray(pool.updateVAOs[i]);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    // Draw pass reads one particle per quad
+    glBindVertexArray(pool.drawVAOs[i]);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, pool.buffers[i]);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleSystem::DestroyPool(GpuPool& pool) {
+  if (pool.buffers[0]) {
+    glDeleteVertexArrays(2, pool.updateVAOs);
+    glDeleteVertexArrays(2, pool.drawVAOs);
+    glDeleteBuffers(2, pool.buffers);
+  }
+  pool = GpuPool();
+}
+
+void ParticleSystem::SimulateGpu(const GpuParticleEmitter& emitter, GpuPool& pool) {
+  if (pool.capacity <= 0) {
+    return;
+  }
+
+  const ParticleParams& params = emitter.params;
+  updateShader->SetFloat("deltaTime", params.deltaTime);
+  updateShader->SetVec3("gravity", params.gravity);
+  updateShader->SetFloat("damping", std::max(0.0f, 1.0f - params.drag * params.deltaTime));
+  updateShader->SetInt("capacity", pool.capacity);
+  updateShader->SetInt("spawnStart", emitter.spawnStart);
+  updateShader->SetInt("spawnCount", emitter.spawnCount);
+  updateShader->SetInt("seed", emitter.seed);
+  updateShader->SetVec3("origin", emitter.origin);
+  updateShader->SetVec3("axis", emitter.axis);
+  updateShader->SetVec3("tangent", emitter.tangent);
+  updateShader->SetVec3("bitangent", emitter.bitangent);
+  updateShader->SetFloat("cosSpread", emitter.cosSpread);
+  updateShader->SetVec2("lifetimeRange", emitter.lifetime);
+  updateShader->SetVec2("speedRange", emitter.speed);
+
+  int next = 1 - pool.current;
+  glBindVertexArray(pool.updateVAOs[pool.current]);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, pool.buffers[next]);
+  glBeginTransformFeedback(GL_POINTS);
+  glDrawArrays(GL_POINTS, 0, pool.capacity);
+  glEndTransformFeedback();
+  pool.current = next;
+}
+
+void ParticleSystem::EvictStalePools() {
+  for (auto it = gpuPools.begin(); it != gpuPools.end();) {
+    if (frame - it->second.lastFrame > STALE_POOL_FRAMES) {
+      DestroyPool(it->second);
+      it = gpuPools.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
@@ -0,0 +1,184 @@
+#include "ParticleSystemComponent.h"
+#include "ParticleSystem.h"
+#include "TransformComponent.h"
+#include "Actor.hpp"
+
+#include <cmath>
+
+#include <glm/gtc/constants.hpp>
+
+static uint64_t nextGpuId = 1;
+
+ParticleSystemComponent::ParticleSystemComponent() : Component(), gpuId(nextGpuId++), random(std::random_device{}()) {
+  type = "ParticleSystem";
+  isParticleSystem = true;
+  ParticleSystem::Register(this);
+}
+
+ParticleSystemComponent::ParticleSystemComponent(const ParticleSystemComponent& other)
+  : Component(other),
+    rate(other.rate),
+    maxParticles(other.maxParticles),
+    lifetimeMin(other.lifetimeMin),
+    lifetimeMax(other.lifetimeMax),
+    speedMin(other.speedMin),
+    speedMax(other.speedMax),
+    direction(other.direction),
+    spread(other.spread),
+    gravity(other.gravity),
+    drag(other.drag),
+    startSize(other.startSize),
+    endSize(other.endSize),
+    startColor(other.startColor),
+    endColor(other.endColor),
+    offset(other.offset),
+    additive(other.additive),
+    gpu(other.gpu),
+    gpuId(nextGpuId++),
+    pendingEmit(other.pendingEmit),
+    random(std::random_device{}()) {
+  ParticleSystem::Register(this);
+}
+
+ParticleSystemComponent::~ParticleSystemComponent() {
+  ParticleSystem::Unregister(this);
+}
+
+void ParticleSystemComponent::SetMaxParticles(int value) {
+  maxParticles = std::max(value, 0);
+  count = std::min(count, maxParticles);
+}
+
+void ParticleSystemComponent::SetLifetime(float min, float max) {
+  lifetimeMin = std::max(min, 0.001f);
+  lifetimeMax = std::max(max, lifetimeMin);
+}
+
+void ParticleSystemComponent::SetSpeed(float min, float max) {
+  speedMin = min;
+  speedMax = std::max(max, min);
+}
+
+void ParticleSystemComponent::SetSize(float start, float end) {
+  startSize = start;
+  endSize = end;
+}
+
+void ParticleSystemComponent::SetGpu(bool value) {
+  gpu = value;
+  // Neither pool carries over to the other
+  count = 0;
+  gpuCursor = 0;
+}
+
+void ParticleSystemComponent::GetEmitterFrame(glm::vec3& origin, glm::vec3& axis, glm::vec3& tangent, glm::vec3& bitangent) const {
+  TransformComponent* transform = actor ? TransformComponent::FindOn(*actor) : nullptr;
+  glm::mat4 emitter = transform ? transform->GetWorldMatrix() : glm::mat4(1.0f);
+
+  origin = glm::vec3(emitter * glm::vec4(offset, 1.0f));
+  axis = glm::mat3(emitter) * direction;
+  axis = glm::length(axis) > 1e-6f ? glm::normalize(axis) : glm::vec3(0.0f, 1.0f, 0.0f);
+  tangent = glm::normalize(glm::cross(axis, std::abs(axis.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f)));
+  bitangent = glm::cross(axis, tangent);
+}
+
+int ParticleSystemComponent::TakeSpawnCount(float deltaTime) {
+  emitAccumulator += rate * deltaTime;
+  int spawnCount = static_cast<int>(emitAccumulator);
+  emitAccumulator -= spawnCount;
+  spawnCount += pendingEmit;
+  pendingEmit = 0;
+  return spawnCount;
+}
+
+void ParticleSystemComponent::Resize(int capacity) {
+  for (std::vector<float>* stream : {&positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ,
+                                     &age, &invLifetime, &size, &colorR, &colorG, &colorB, &colorA}) {
+    stream->resize(capacity);
+  }
+}
+
+void ParticleSystemComponent::Spawn(float deltaTime) {
+  // Dead particles are replaced by the last live one, so the pool stays packed
+  int i = 0;
+  while (i < count) {
+    if (age[i] * invLifetime[i] < 1.0f) {
+      ++i;
+      continue;
+    }
+    --count;
+    for (std::vector<float>* stream : {&positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ,
+                                       &age, &invLifetime, &size, &colorR, &colorG, &colorB, &colorA}) {
+      (*stream)[i] = (*stream)[count];
+    }
+  }
+
+  int spawnCount = std::min(TakeSpawnCount(deltaTime), maxParticles - count);
+  if (spawnCount <= 0) {
+    return;
+  }
+
+  if (count + spawnCount > static_cast<int>(positionX.size())) {
+    Resize(std::min(maxParticles, std::max(count + spawnCount, static_cast<int>(positionX.size()) * 2)));
+  }
+
+  glm::vec3 origin, axis, tangent, bitangent;
+  GetEmitterFrame(origin, axis, tangent, bitangent);
+  float cosSpread = std::cos(glm::radians(glm::clamp(spread, 0.0f, 180.0f)));
+
+  // Directions are spread evenly over the cone's cap
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  for (int n = 0; n < spawnCount; ++n) {
+    float cosTheta = 1.0f - unit(random) * (1.0f - cosSpread);
+    float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+    float phi = unit(random) * glm::two_pi<float>();
+    glm::vec3 velocity = (axis * cosTheta + (tangent * std::cos(phi) + bitangent * std::sin(phi)) * sinTheta)
+                       * (speedMin + unit(random) * (speedMax - speedMin));
+    float lifetime = lifetimeMin + unit(random) * (lifetimeMax - lifetimeMin);
+
+    int p = count++;
+    positionX[p] = origin.x;
+    positionY[p] = origin.y;
+    positionZ[p] = origin.z;
+    velocityX[p] = velocity.x;
+    velocityY[p] = velocity.y;
+    velocityZ[p] = velocity.z;
+    age[p] = 0.0f;
+    invLifetime[p] = 1.0f / lifetime;
+    size[p] = startSize;
+    colorR[p] = startColor.r;
+    colorG[p] = startColor.g;
+    colorB[p] = startColor.b;
+    colorA[p] = startColor.a;
+  }
+}
+
+void ParticleSystemComponent::SpawnGpu(float deltaTime, GpuParticleEmitter& emitter) {
+  // The pool may have shrunk since last frame
+  if (gpuCursor >= maxParticles) {
+    gpuCursor = 0;
+  }
+
+  // Slots are handed out round robin; the shader skips any still alive
+  int spawnCount = std::min(TakeSpawnCount(deltaTime), maxParticles);
+  emitter.id = gpuId;
+  emitter.capacity = maxParticles;
+  emitter.spawnStart = gpuCursor;
+  emitter.spawnCount = spawnCount;
+  emitter.seed = static_cast<int>(random() & 0x7FFFFFFF);
+  gpuCursor = maxParticles > 0 ? (gpuCursor + spawnCount) % maxParticles : 0;
+
+  GetEmitterFrame(emitter.origin, emitter.axis, emitter.tangent, emitter.bitangent);
+  emitter.cosSpread = std::cos(glm::radians(glm::clamp(spread, 0.0f, 180.0f)));
+  emitter.lifetime = glm::vec2(lifetimeMin, lifetimeMax);
+  emitter.speed = glm::vec2(speedMin, speedMax);
+
+  emitter.params.deltaTime = deltaTime;
+  emitter.params.gravity = gravity;
+  emitter.params.drag = drag;
+  emitter.params.startSize = startSize;
+  emitter.params.endSize = endSize;
+  emitter.params.startColor = startColor;
+  emitter.params.endColor = endColor;
+  emitter.additive = additive;
+}
@@ -0,0 +1,214 @@
+#include "QualityGovernor.h"
+#include "Renderer.h"
+#include "LightComponent.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include <glm/glm.hpp>
+
+// Frames to wait after a change before judging its effect (readback lags ~3 frames)
+static const int ADJUST_INTERVAL = 15;
+// Over budget above target * this, headroom below target * that
+static const float OVER_BUDGET = 1.05f;
+static const float UNDER_BUDGET = 0.8f;
+static const float LOD_BIAS_STEP = 0.25f;
+static const float MAX_LOD_BIAS = 2.0f;
+
+std::atomic<bool> QualityGovernor::enabled(false);
+std::atomic<float> QualityGovernor::targetFrameMs(16.6f);
+float QualityGovernor::minScale = 0.5f;
+float QualityGovernor::maxScale = 1.0f;
+
+GLuint QualityGovernor::queries[QUERY_RING_SIZE] = { 0 };
+bool QualityGovernor::queryIssued[QUERY_RING_SIZE] = { false };
+int QualityGovernor::queryIndex = 0;
+bool QualityGovernor::haveTiming = false;
+int QualityGovernor::framesSinceAdjust = 0;
+
+QualityGovernor::Stats QualityGovernor::stats;
+std::mutex QualityGovernor::statsMutex;
+
+// Whether BeginFrame started a query EndFrame has to close
+static bool frameQueryActive = false;
+
+void QualityGovernor::Init(bool enable, float target, float minimumScale, float maximumScale, float initialScale) {
+  enabled = enable;
+  targetFrameMs = target;
+  minScale = glm::clamp(minimumScale, 0.1f, 1.0f);
+  maxScale = glm::clamp(maximumScale, minScale, 2.0f);
+
+  // Only pay for the offscreen target when it can differ from the window
+  if (enabled || initialScale != 1.0f) {
+    Renderer::InitSceneTarget(std::max(maxScale, initialScale));
+    Renderer::SetRenderScale(initialScale);
+  }
+
+  glGenQueries(QUERY_RING_SIZE, queries);
+  std::fill(queryIssued, queryIssued + QUERY_RING_SIZE, false);
+  queryIndex = 0;
+  haveTiming = false;
+  framesSinceAdjust = 0;
+
+  stats = Stats();
+  stats.renderScale = Renderer::GetRenderScale();
+  stats.lightLimit = LightComponent::GetLightLimit();
+}
+
+void QualityGovernor::Shutdown() {
+  glDeleteQueries(QUERY_RING_SIZE, queries);
+  std::fill(queries, queries + QUERY_RING_SIZE, 0);
+}
+
+void QualityGovernor::BeginFrame() {
+  // The slot we'd write to still hasn't been read - skip timing this frame
+  // rather than wait for it
+  frameQueryActive = !queryIssued[queryIndex];
+  if (frameQueryActive) {
+    glBeginQuery(GL_TIME_ELAPSED, queries[queryIndex]);
+  }
+}
+
+void QualityGovernor::EndFrame() {
+  if (frameQueryActive) {
+    glEndQuery(GL_TIME_ELAPSED);
+    queryIssued[queryIndex] = true;
+    queryIndex = (queryIndex + 1) % QUERY_RING_SIZE;
+    frameQueryActive = false;
+  }
+
+  ReadBackTimings();
+
+  ++framesSinceAdjust;
+  if (enabled && haveTiming && framesSinceAdjust >= ADJUST_INTERVAL) {
+    Adjust();
+  }
+}
+
+void QualityGovernor::ReadBackTimings() {
+  // Oldest first, stop at the first result that isn't ready
+  for (int i = 0; i < QUERY_RING_SIZE; ++i) {
+    int slot = (queryIndex + i) % QUERY_RING_SIZE;
+    if (!queryIssued[slot]) {
+      continue;
+    }
+
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      break;
+    }
+
+    GLuint64 elapsedNs = 0;
+    glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsedNs);
+    queryIssued[slot] = false;
+
+    float sampleMs = static_cast<float>(elapsedNs) / 1000000.0f;
+    std::lock_guard<std::mutex> lock(statsMutex);
+    stats.gpuFrameMs = haveTiming ? stats.gpuFrameMs * 0.9f + sampleMs * 0.1f : sampleMs;
+    haveTiming = true;
+  }
+}
+
+void QualityGovernor::Adjust() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  float gpuMs = std::max(stats.gpuFrameMs, 0.01f);
+  float scale = Renderer::GetRenderScale();
+  int lightLimit = LightComponent::GetLightLimit();
+
+  // Pixel cost goes with the square of the scale
+  float scaleFactor = std::sqrt(targetFrameMs.load() / gpuMs);
+
+  if (gpuMs > targetFrameMs * OVER_BUDGET) {
+    // Cheapest to the eye first: resolution, then lights, then detail
+    if (scale > minScale + 0.001f) {
+      Renderer::SetRenderScale(std::max(minScale, scale * glm::clamp(scaleFactor, 0.8f, 0.97f)));
+      Decide("over budget: render scale down");
+    } else if (lightLimit > 1) {
+      LightComponent::SetLightLimit(lightLimit - 1);
+      Decide("over budget: light limit down");
+    } else if (stats.lodBias < MAX_LOD_BIAS) {
+      stats.lodBias = std::min(MAX_LOD_BIAS, stats.lodBias + LOD_BIAS_STEP);
+      Decide("over budget: LOD bias up");
+    }
+  } else if (gpuMs < targetFrameMs * UNDER_BUDGET) {
+    // Restore in the opposite order
+    if (stats.lodBias > 0.0f) {
+      stats.lodBias = std::max(0.0f, stats.lodBias - LOD_BIAS_STEP);
+      Decide("headroom: LOD bias down");
+    } else if (lightLimit < LightComponent::MAX_SHADER_LIGHTS) {
+      LightComponent::SetLightLimit(lightLimit + 1);
+      Decide("headroom: light limit up");
+    } else if (scale < maxScale - 0.001f) {
+      Renderer::SetRenderScale(std::min(maxScale, scale * glm::clamp(scaleFactor, 1.02f, 1.1f)));
+      Decide("headroom: render scale up");
+    }
+  }
+}
+
+// Called from Adjust with statsMutex held
+void QualityGovernor::Decide(const std::string& decision) {
+  stats.renderScale = Renderer::GetRenderScale();
+  stats.lightLimit = LightComponent::GetLightLimit();
+  ++stats.adjustments;
+  framesSinceAdjust = 0;
+
+  std::ostringstream text;
+  text << decision << " (gpu " << stats.gpuFrameMs << "ms, scale " << stats.renderScale
+       << ", lights " << stats.lightLimit << ", lod bias " << stats.lodBias << ")";
+  stats.lastDecision = text.str();
+}
+
+void QualityGovernor::SetEnabled(bool enable) {
+  // Turning the governor on at runtime needs an offscreen target to scale
+  if (enable && !Renderer::HasSceneTarget()) {
+    Renderer::InitSceneTarget(maxScale);
+  }
+  enabled = enable;
+}
+
+bool QualityGovernor::IsEnabled() {
+  return enabled;
+}
+
+void QualityGovernor::SetTargetFrameTime(float ms) {
+  targetFrameMs = std::max(ms, 0.1f);
+}
+
+QualityGovernor::Stats QualityGovernor::GetStats() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  return stats;
+}
+
+float QualityGovernor::GetGpuFrameTime() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  return stats.gpuFrameMs;
+}
+
+float QualityGovernor::GetRenderScale() {
+  return Renderer::GetRenderScale();
+}
+
+void QualityGovernor::SetRenderScale(float scale) {
+  if (!Renderer::HasSceneTarget()) {
+    Renderer::InitSceneTarget(std::max(maxScale, scale));
+  }
+  Renderer::SetRenderScale(scale);
+  std::lock_guard<std::mutex> lock(statsMutex);
+  stats.renderScale = Renderer::GetRenderScale();
+}
+
+float QualityGovernor::GetLodBias() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  return stats.lodBias;
+}
+
+int QualityGovernor::GetLightLimit() {
+  return LightComponent::GetLightLimit();
+}
+
+std::string QualityGovernor::GetLastDecision() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  return stats.lastDecision;
+}
@@ -0,0 +1,231 @@
+#include "RenderCommandQueue.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#include <glm/gtc/type_ptr.hpp>
+
+// Objects per job - enough that a job outweighs the cost of queuing it
+static const int OBJECTS_PER_BATCH = 64;
+// View distance mapped onto the depth bits of the sort key
+static const float SORT_DEPTH_RANGE = 100.0f;
+
+glm::mat4 RenderCommandQueue::viewProjection(1.0f);
+glm::vec4 RenderCommandQueue::frustumPlanes[6];
+glm::vec3 RenderCommandQueue::cameraPos(0.0f);
+
+std::vector<std::vector<RenderCommand>> RenderCommandQueue::batchBuffers;
+std::vector<int> RenderCommandQueue::batchCulled;
+std::vector<RenderCommand> RenderCommandQueue::merged;
+
+RenderCommandQueue::Stats RenderCommandQueue::stats;
+
+// Folds a value into a few well-mixed bits. Collisions only cost sort
+// quality, Execute compares the real materials and meshes.
+static uint64_t MixBits(uint64_t value, int bits) {
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdull;
+  value ^= value >> 33;
+  return value & ((1ull << bits) - 1);
+}
+
+static uint64_t PointerBits(const void* pointer, int bits) {
+  return MixBits(reinterpret_cast<uintptr_t>(pointer), bits);
+}
+
+// Hash of what ApplyMaterial sets, so equal materials sort together
+// wherever they live; shapes each carry their own copy
+static uint64_t MaterialBits(const Material& material, int bits) {
+  uint64_t hash = 1469598103934665603ull;
+  auto mix = [&hash](const void* data, size_t bytes) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < bytes; ++i) {
+      hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+  };
+  mix(&material.diffuseMap, sizeof(material.diffuseMap));
+  mix(&material.specularMap, sizeof(material.specularMap));
+  mix(&material.normalMap, sizeof(material.normalMap));
+  mix(&material.ambient, sizeof(material.ambient));
+  mix(&material.diffuse, sizeof(material.diffuse));
+  mix(&material.specular, sizeof(material.specular));
+  mix(&material.shininess, sizeof(material.shininess));
+  mix(&material.useTexture, sizeof(material.useTexture));
+  return MixBits(hash, bits);
+}
+
+static bool SameMaterial(const Material& a, const Material& b) {
+  return a.diffuseMap == b.diffuseMap && a.specularMap == b.specularMap && a.normalMap == b.normalMap &&
+         a.ambient == b.ambient && a.diffuse == b.diffuse && a.specular == b.specular &&
+         a.shininess == b.shininess && a.useTexture == b.useTexture;
+}
+
+void RenderCommandQueue::SetCamera(const glm::mat4& vp, const glm::vec3& pos) {
+  viewProjection = vp;
+  cameraPos = pos;
+
+  // Gribb/Hartmann plane extraction, normalized so distances are in world units
+  glm::mat4 m = glm::transpose(vp);
+  frustumPlanes[0] = m[3] + m[0]; // left
+  frustumPlanes[1] = m[3] - m[0]; // right
+  frustumPlanes[2] = m[3] + m[1]; // bottom
+  frustumPlanes[3] = m[3] - m[1]; // top
+  frustumPlanes[4] = m[3] + m[2]; // near
+  frustumPlanes[5] = m[3] - m[2]; // far
+  for (auto& plane : frustumPlanes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+}
+
+void RenderCommandQueue::Build(const std::vector<std::shared_ptr<GameObject>>& queue) {
+  int objectCount = static_cast<int>(queue.size());
+  int batchCount = (objectCount + OBJECTS_PER_BATCH - 1) / OBJECTS_PER_BATCH;
+
+  // Buffers keep their capacity from frame to frame
+  if (static_cast<int>(batchBuffers.size()) < batchCount) {
+    batchBuffers.resize(batchCount);
+  }
+  batchCulled.assign(batchCount, 0);
+
+  JobSystem::ParallelFor(batchCount, [&queue, objectCount](int batch) {
+    int begin = batch * OBJECTS_PER_BATCH;
+    int end = std::min(begin + OBJECTS_PER_BATCH, objectCount);
+    batchBuffers[batch].clear();
+    RecordBatch(queue, begin, end, batchBuffers[batch], batchCulled[batch]);
+  });
+
+  stats = Stats();
+  stats.objects = objectCount;
+  stats.batches = batchCount;
+
+  merged.clear();
+  for (int batch = 0; batch < batchCount; ++batch) {
+    merged.insert(merged.end(), batchBuffers[batch].begin(), batchBuffers[batch].end());
+    stats.culled += batchCulled[batch];
+  }
+  stats.commands = static_cast<int>(merged.size());
+}
+
+void RenderCommandQueue::RecordBatch(const std::vector<std::shared_ptr<GameObject>>& queue, int begin, int end, std::vector<RenderCommand>& out, int& culled) {
+  for (int i = begin; i < end; ++i) {
+    const GameObject& gameObject = *queue[i];
+    if (!gameObject.isActive || !gameObject.mesh) {
+      continue;
+    }
+
+    // Frustum test on the world bounding box: outside if the corner furthest
+    // along any plane normal is still behind it
+    glm::vec3 boundsMin, boundsMax;
+    gameObject.GetWorldBounds(boundsMin, boundsMax);
+    bool outside = false;
+    for (const auto& plane : frustumPlanes) {
+      glm::vec3 positive(plane.x >= 0.0f ? boundsMax.x : boundsMin.x,
+                         plane.y >= 0.0f ? boundsMax.y : boundsMin.y,
+                         plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+      if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f) {
+        outside = true;
+        break;
+      }
+    }
+    if (outside) {
+      ++culled;
+      continue;
+    }
+
+    const glm::mat4& modelMatrix = gameObject.GetDrawMatrix();
+    const glm::mat3& normalMatrix = gameObject.GetNormalMatrix();
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float depth = glm::clamp(glm::length(center - cameraPos) / SORT_DEPTH_RANGE, 0.0f, 1.0f);
+    uint64_t depthBits = static_cast<uint64_t>(depth * 0xFFFF);
+
+    auto record = [&](const Mesh* mesh, const Material* material) {
+      RenderCommand command;
+      // material (24) | mesh (24) | front-to-back depth (16)
+      command.sortKey = (MaterialBits(*material, 24) << 40) | (PointerBits(mesh, 24) << 16) | depthBits;
+      command.modelMatrix = modelMatrix;
+      command.normalMatrix = normalMatrix;
+      command.color = gameObject.color;
+      command.fadeOut = gameObject.fadeOut;
+      command.lightmapRect = gameObject.lightmapRect;
+      command.mesh = mesh;
+      command.material = material;
+      out.push_back(command);
+    };
+
+    // Models draw every mesh with its own material; shapes use the object's
+    if (gameObject.isModel && gameObject.model) {
+      for (const auto& mesh : gameObject.model->meshes) {
+        record(mesh.get(), &mesh->material);
+      }
+    } else {
+      record(gameObject.mesh.get(), &gameObject.material);
+    }
+  }
+}
+
+void RenderCommandQueue::Execute(GLuint shaderProgram, GLint modelLoc) {
+  std::sort(merged.begin(), merged.end(), [](const RenderCommand& a, const RenderCommand& b) {
+    return a.sortKey < b.sortKey;
+  });
+
+  GLint colorLoc = glGetUniformLocation(shaderProgram, "ourColor");
+  GLint normalLoc = glGetUniformLocation(shaderProgram, "normalMatrix");
+  GLint fadeLoc = glGetUniformLocation(shaderProgram, "fadeOut");
+  GLint lightmapLoc = glGetUniformLocation(shaderProgram, "lightmapRect");
+  const Material* lastMaterial = nullptr;
+  const Mesh* lastMesh = nullptr;
+  const Mesh* lastTextureMesh = nullptr;
+  bool texturesBound = false;
+  glm::vec3 lastColor(-1.0f);
+  float lastFade = -1.0f;
+  glm::vec4 lastLightmapRect(-1.0f);
+
+  for (const RenderCommand& command : merged) {
+    // Model meshes bind their own texture list, so the material state also
+    // depends on which mesh supplied the textures
+    bool usesMeshTextures = command.material->useTexture && !command.mesh->textures.empty();
+    bool materialChanged = !lastMaterial || (command.material != lastMaterial && !SameMaterial(*command.material, *lastMaterial));
+    if (materialChanged || (usesMeshTextures && command.mesh != lastTextureMesh)) {
+      command.mesh->ApplyMaterial(shaderProgram, *command.material);
+      lastMaterial = command.material;
+      lastTextureMesh = usesMeshTextures ? command.mesh : nullptr;
+      texturesBound = texturesBound || command.material->useTexture;
+      ++stats.materialChanges;
+    }
+
+    if (command.color != lastColor) {
+      glUniform3fv(colorLoc, 1, glm::value_ptr(command.color));
+      lastColor = command.color;
+    }
+    if (command.fadeOut != lastFade) {
+      glUniform1f(fadeLoc, command.fadeOut);
+      lastFade = command.fadeOut;
+    }
+    if (command.lightmapRect != lastLightmapRect) {
+      glUniform4fv(lightmapLoc, 1, glm::value_ptr(command.lightmapRect));
+      lastLightmapRect = command.lightmapRect;
+    }
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(command.modelMatrix));
+    glUniformMatrix3fv(normalLoc, 1, GL_FALSE, glm::value_ptr(command.normalMatrix));
+
+    if (command.mesh != lastMesh) {
+      command.mesh->BindVertexArray();
+      lastMesh = command.mesh;
+      ++stats.meshChanges;
+    }
+    glDrawElements(GL_TRIANGLES, command.mesh->indexCount, GL_UNSIGNED_INT, 0);
+  }
+
+  glBindVertexArray(0);
+  if (texturesBound) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+  merged.clear();
+}
+
+const RenderCommandQueue::Stats& RenderCommandQueue::GetStats() {
+  return stats;
+}
@@ -0,0 +1,94 @@
+#include "RenderThread.h"
+#include "Renderer.h"
+
+#include <iostream>
+
+std::thread RenderThread::thread;
+std::mutex RenderThread::mutex;
+std::condition_variable RenderThread::condition;
+std::unique_ptr<FramePacket> RenderThread::pending;
+std::function<void(FramePacket&)> RenderThread::renderFrame;
+bool RenderThread::running = false;
+
+bool RenderThread::Start(std::function<void(FramePacket&)> render) {
+  if (running) {
+    return true;
+  }
+
+  // Leaves the upload context current here, which frees the window's context
+  // for the render thread
+  if (!Renderer::CreateUploadContext()) {
+    std::cout << "Render thread unavailable, rendering on the main thread" << std::endl;
+    return false;
+  }
+
+  renderFrame = render;
+  running = true;
+  thread = std::thread(ThreadLoop);
+  return true;
+}
+
+void RenderThread::Stop() {
+  if (!running) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  condition.notify_all();
+  thread.join();
+
+  Renderer::MakeRenderContextCurrent();
+  if (pending && pending->uploadFence) {
+    glDeleteSync(pending->uploadFence);
+  }
+  pending.reset();
+  Renderer::DestroyUploadContext();
+}
+
+bool RenderThread::IsRunning() {
+  return running;
+}
+
+void RenderThread::Submit(FramePacket&& packet) {
+  // The render thread's context waits on this before touching the frame, and
+  // the flush makes sure the fence actually reaches the GPU
+  packet.uploadFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glFlush();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  condition.wait(lock, [] { return !pending || !running; });
+  pending = std::make_unique<FramePacket>(std::move(packet));
+  lock.unlock();
+  condition.notify_all();
+}
+
+void RenderThread::ThreadLoop() {
+  Renderer::MakeRenderContextCurrent();
+
+  while (true) {
+    std::unique_ptr<FramePacket> packet;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [] { return pending || !running; });
+      if (!running) {
+        break;
+      }
+      packet = std::move(pending);
+    }
+    // The slot is free again, so the main thread can queue the next frame
+    condition.notify_all();
+
+    if (packet->uploadFence) {
+      glWaitSync(packet->uploadFence, 0, GL_TIMEOUT_IGNORED);
+      glDeleteSync(packet->uploadFence);
+      packet->uploadFence = nullptr;
+    }
+
+    renderFrame(*packet);
+  }
+
+  Renderer::ReleaseContext();
+}
@@ -10,6 +10,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "Input.h"
+#include "GLExtensions.h"
+#include "HeadlessContext.h"
+#include "NullGL.h"
 
 // Define static members
 int Renderer::x_resolution = 640;
@@ -31,9 +34,39 @@ float Renderer::cameraPitch = 0.0f;
 
 
 SDL_GLContext Renderer::glContext = nullptr;
+SDL_GLContext Renderer::uploadContext = nullptr;
+Renderer::Backend Renderer::backend = Renderer::Backend::Window;
+
+std::atomic<bool> Renderer::sceneTargetRequested(false);
+GLuint Renderer::sceneFBO = 0;
+GLuint Renderer::sceneColor = 0;
+GLuint Renderer::sceneDepth = 0;
+int Renderer::sceneTargetWidth = 0;
+int Renderer::sceneTargetHeight = 0;
+int Renderer::sceneWidth = 0;
+int Renderer::sceneHeight = 0;
+std::atomic<float> Renderer::renderScale(1.0f);
+std::atomic<float> Renderer::maxRenderScale(1.0f);
+
+void Renderer::SetBackend(Backend newBackend) {
+    backend = newBackend;
+}
+
+Renderer::Backend Renderer::GetBackend() {
+    return backend;
+}
+
+bool Renderer::HasWindow() {
+    return backend == Backend::Window;
+}
+
+GLuint Renderer::GetDefaultFramebuffer() {
+    return backend == Backend::Headless ? HeadlessContext::GetFramebuffer() : 0;
+}
 
 void Renderer::LoadRenderer(int x_res, int y_res, int r, int g, int b, glm::vec2 cam_size, float z, glm::vec2 cam_pos) {
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) != 0) {
+    Uint32 subsystems = !HasWindow() ? SDL_INIT_EVENTS : SDL_INIT_VIDEO | SDL_INIT_EVENTS;
+    if (SDL_Init(subsystems) != 0) {
         std::cerr << "Failed to initialize SDL: " << SDL_GetError() << std::endl;
         exit(1);
     }
@@ -66,6 +99,24 @@ void Renderer::LoadRenderer(int x_res, int y_res, int r, int g, int b, glm::vec2
 }
 
 void Renderer::RenderWindow(const std::string& title) {
+    if (backend == Backend::Null) {
+        gladLoadGLLoader((GLADloadproc)NullGL::GetProcAddress);
+        GLExtensions::Load((GLADloadproc)NullGL::GetProcAddress);
+        glContext = NullGL::GetContext();
+        std::cout << "Null renderer: GL calls are counted, not executed" << std::endl;
+        return;
+    }
+    if (backend == Backend::Headless) {
+        if (!HeadlessContext::Init(x_resolution, y_resolution)) {
+            SDL_Quit();
+            std::exit(1);
+        }
+        glContext = HeadlessContext::GetMainContext();
+        GLExtensions::Load((GLADloadproc)HeadlessContext::GetProcAddress);
+        ClearScreen();
+        return;
+    }
+
     if(!window) {
         window = SDL_CreateWindow(title.c_str(), 100, 100, x_resolution, y_resolution, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_SHOWN);
     }
@@ -93,11 +144,19 @@ void Renderer::RenderWindow(const std::string& title) {
         std::exit(1);
     }
 
+    // Pick up anything newer than the 3.3 core profile glad was generated for
+    GLExtensions::Load((GLADloadproc)SDL_GL_GetProcAddress);
+
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 bool Renderer::Update() {
+    // Nothing to receive events from; runs until the frame limit or Application.Quit
+    if (!HasWindow()) {
+        return true;
+    }
+
     SDL_Event e;
     
     while (SDL_PollEvent(&e)) {
@@ -116,10 +175,135 @@ void Renderer::ClearScreen() {
 }
 
 void Renderer::SwapBuffers() {
+    if (backend == Backend::Null) {
+        NullGL::EndFrame();
+        return;
+    }
+    if (backend == Backend::Headless) {
+        HeadlessContext::Present();
+        return;
+    }
     SDL_GL_SwapWindow(window);
 }
 
+void Renderer::InitSceneTarget(float maxScale) {
+    if (sceneTargetRequested) {
+        return;
+    }
+    maxRenderScale = glm::max(maxScale, 0.1f);
+    sceneTargetRequested = true;
+}
+
+void Renderer::CreateSceneTarget() {
+    // Sized for the maximum scale so changing scale never reallocates - lower
+    // scales just render into a corner of it.
+    sceneTargetWidth = glm::max(1, static_cast<int>(x_resolution * maxRenderScale));
+    sceneTargetHeight = glm::max(1, static_cast<int>(y_resolution * maxRenderScale));
+
+    glGenTextures(1, &sceneColor);
+    glBindTexture(GL_TEXTURE_2D, sceneColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, sceneTargetWidth, sceneTargetHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &sceneDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, sceneDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, sceneTargetWidth, sceneTargetHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &sceneFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, sceneDepth);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Scene framebuffer incomplete, rendering at window resolution" << std::endl;
+        glDeleteFramebuffers(1, &sceneFBO);
+        glDeleteTextures(1, &sceneColor);
+        glDeleteRenderbuffers(1, &sceneDepth);
+        sceneFBO = sceneColor = sceneDepth = 0;
+        sceneTargetRequested = false;
+        glBindFramebuffer(GL_FRAMEBUFFER, GetDefaultFramebuffer());
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, GetDefaultFramebuffer());
+}
+
+bool Renderer::HasSceneTarget() {
+    return sceneTargetRequested;
+}
+
+void Renderer::BeginScene() {
+    if (sceneTargetRequested && !sceneFBO) {
+        CreateSceneTarget();
+    }
+    if (!sceneFBO) {
+        ClearScreen();
+        return;
+    }
+
+    // Kept for EndScene in case the scale changes mid-frame
+    sceneWidth = glm::max(1, static_cast<int>(x_resolution * renderScale));
+    sceneHeight = glm::max(1, static_cast<int>(y_resolution * renderScale));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glViewport(0, 0, sceneWidth, sceneHeight);
+    ClearScreen();
+}
+
+void Renderer::EndScene() {
+    if (!sceneFBO) {
+        return;
+    }
+
+    // Bilinear upscale of the rendered region to the whole window
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GetDefaultFramebuffer());
+    glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, x_resolution, y_resolution, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, GetDefaultFramebuffer());
+    glViewport(0, 0, x_resolution, y_resolution);
+}
+
+void Renderer::SetRenderScale(float scale) {
+    renderScale = glm::clamp(scale, 0.1f, maxRenderScale.load());
+}
+
+float Renderer::GetRenderScale() {
+    return sceneTargetRequested ? renderScale.load() : 1.0f;
+}
+
+void Renderer::DrawLoadingScreen(float progress) {
+    progress = glm::clamp(progress, 0.0f, 1.0f);
+
+    ClearScreen();
+
+    // Progress bar drawn with scissored clears so it doesn't need any shaders
+    int barWidth = x_resolution / 2;
+    int barHeight = glm::max(y_resolution / 40, 4);
+    int barX = (x_resolution - barWidth) / 2;
+    int barY = y_resolution / 4;
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(barX, barY, barWidth, barHeight);
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glScissor(barX, barY, static_cast<int>(barWidth * progress), barHeight);
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+
+    SwapBuffers();
+}
+
 void Renderer::DestroyScreen() {
+    if (backend == Backend::Headless) {
+        HeadlessContext::Shutdown();
+    }
+    if (!HasWindow()) {
+        glContext = nullptr;
+    }
     if (glContext) {
         SDL_GL_DeleteContext(glContext);
         glContext = nullptr;
@@ -227,5 +411,75 @@ glm::mat4 Renderer::GetViewMatrix() {
 }
 
 void Renderer::Cleanup() {
-    SDL_GL_DeleteContext(glContext);
+    if (sceneFBO) {
+        glDeleteFramebuffers(1, &sceneFBO);
+        glDeleteTextures(1, &sceneColor);
+        glDeleteRenderbuffers(1, &sceneDepth);
+        sceneFBO = sceneColor = sceneDepth = 0;
+    }
+    sceneTargetRequested = false;
+    DestroyUploadContext();
+    if (backend == Backend::Headless) {
+        HeadlessContext::Shutdown();
+    } else if (backend == Backend::Window) {
+        SDL_GL_DeleteContext(glContext);
+    }
+    glContext = nullptr;
+}
+
+bool Renderer::CreateUploadContext() {
+    if (uploadContext) {
+        return true;
+    }
+
+    if (backend == Backend::Null) {
+        uploadContext = NullGL::GetContext();
+    } else if (backend == Backend::Headless) {
+        uploadContext = HeadlessContext::CreateSharedContext();
+    } else {
+        SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+        uploadContext = SDL_GL_CreateContext(window);
+        SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+    }
+    if (!uploadContext) {
+        std::cerr << "Failed to create upload context: " << SDL_GetError() << std::endl;
+        MakeRenderContextCurrent();
+        return false;
+    }
+    return true;
+}
+
+void Renderer::DestroyUploadContext() {
+    if (uploadContext) {
+        if (backend == Backend::Headless) {
+            HeadlessContext::DestroyContext(uploadContext);
+        } else if (backend == Backend::Window) {
+            SDL_GL_DeleteContext(uploadContext);
+        }
+        uploadContext = nullptr;
+    }
+}
+
+void Renderer::MakeRenderContextCurrent() {
+    if (backend == Backend::Null) {
+        return;
+    }
+    if (backend == Backend::Headless) {
+        HeadlessContext::MakeCurrent(glContext);
+        return;
+    }
+    if (SDL_GL_MakeCurrent(window, glContext) != 0) {
+        std::cerr << "Failed to make render context current: " << SDL_GetError() << std::endl;
+    }
+}
+
+void Renderer::ReleaseContext() {
+    if (backend == Backend::Null) {
+        return;
+    }
+    if (backend == Backend::Headless) {
+        HeadlessContext::MakeCurrent(nullptr);
+        return;
+    }
+    SDL_GL_MakeCurrent(window, nullptr);
 }
\ No newline at end of file
@@ -10,6 +10,8 @@
 #include "ComponentManager.h"
 #include "ComponentDB.hpp"
 #include "LightComponent.h"
+#include "TransformComponent.h"
+#include "ParticleSystemComponent.h"
 
 void ReportError(std::string& actor_name, const luabridge::LuaException& e);
 std::shared_ptr<Component> LoadExistingComponent(std::shared_ptr<Component> component);
@@ -28,6 +30,7 @@ std::string Scene::curr_name;
 std::vector<std::shared_ptr<Component>> Scene::onStartComponents;
 std::vector<std::shared_ptr<Component>> Scene::onUpdateComponents;
 std::vector<std::shared_ptr<Component>> Scene::onLateUpdateComponents;
+std::vector<std::shared_ptr<Component>> Scene::onFixedUpdateComponents;
 std::vector<std::shared_ptr<Component>> Scene::onDestroyComponents;
 
 std::unordered_map<std::string, std::vector<std::shared_ptr<Actor>>> Scene::actor_name_map;
@@ -117,6 +120,9 @@ void Scene::LoadScene(std::string& scene_name) {
                     if(newActor->components[componentKey]->hasLateUpdate) {
                         onLateUpdateComponents.push_back(newActor->components[componentKey]);
                     }
+                    if(newActor->components[componentKey]->hasFixedUpdate) {
+                        onFixedUpdateComponents.push_back(newActor->components[componentKey]);
+                    }
                 } else {
                     // If the component doesn't have a type, override the current properties of the current component
                     LoadComponent(componentKey, "", newActor->components, component.value, newActor);
@@ -131,6 +137,9 @@ void Scene::LoadScene(std::string& scene_name) {
                     if(newActor->components[componentKey]->hasLateUpdate) {
                         onLateUpdateComponents.push_back(newActor->components[componentKey]);
                     }
+                    if(newActor->components[componentKey]->hasFixedUpdate) {
+                        onFixedUpdateComponents.push_back(newActor->components[componentKey]);
+                    }
                 }
             }
         } else if(actor_template != templates.end()) {
@@ -147,6 +156,9 @@ void Scene::LoadScene(std::string& scene_name) {
                 if(componentPair.second->hasLateUpdate) {
                     onLateUpdateComponents.push_back(componentPair.second);
                 }
+                if(componentPair.second->hasFixedUpdate) {
+                    onFixedUpdateComponents.push_back(componentPair.second);
+                }
             }
         }
 
@@ -160,6 +172,10 @@ void Scene::LoadScene(std::string& scene_name) {
         scene_actors.push_back(std::move(newActor));
     }
 
+    for (const auto& actor : scene_actors) {
+        ResolveTransformParent(actor);
+    }
+
     // Sort the components by key and actor id
     std::sort(onStartComponents.begin(), onStartComponents.end(), [](const std::shared_ptr<Component>& a, const std::shared_ptr<Component>& b) {
         if (a->actor->id == b->actor->id) {
@@ -181,6 +197,13 @@ void Scene::LoadScene(std::string& scene_name) {
         }
         return a->actor->id < b->actor->id;
     });
+
+    std::sort(onFixedUpdateComponents.begin(), onFixedUpdateComponents.end(), [](const std::shared_ptr<Component>& a, const std::shared_ptr<Component>& b) {
+        if (a->actor->id == b->actor->id) {
+            return a->key < b->key;
+        }
+        return a->actor->id < b->actor->id;
+    });
 }
 
 /*
@@ -240,6 +263,9 @@ void Scene::LoadComponent(const std::string& componentKey, const std::string& co
             // Spotlight parameters
             lightComponent->SetInnerCutoff(getJsonFloatOrDefault(componentData, "innerCutoff", 12.5f));
             lightComponent->SetOuterCutoff(getJsonFloatOrDefault(componentData, "outerCutoff", 17.5f));
+
+            // Left to the lightmap on lightmapped objects
+            lightComponent->SetBaked(getJsonBoolOrDefault(componentData, "baked", false));
             
             // Light name
             lightComponent->SetName(getJsonStringOrDefault(componentData, "name", "Light"));
@@ -247,6 +273,7 @@ void Scene::LoadComponent(const std::string& componentKey, const std::string& co
             lightComponent->hasStart = false;
             lightComponent->hasUpdate = false;
             lightComponent->hasLateUpdate = false;
+            lightComponent->hasFixedUpdate = false;
 
             newComponent = lightComponent;
 
@@ -262,6 +289,49 @@ void Scene::LoadComponent(const std::string& componentKey, const std::string& co
             newComponent->componentRef = std::make_shared<luabridge::LuaRef>(componentInstance);
 
             LightComponent::RegisterLight(lightComponent);
+        } else if(componentType == "Transform") {
+            auto transformComponent = std::make_shared<TransformComponent>();
+            transformComponent->SetPosition(glm::vec3(getJsonFloatOrDefault(componentData, "positionX", 0.0f), getJsonFloatOrDefault(componentData, "positionY", 0.0f), getJsonFloatOrDefault(componentData, "positionZ", 0.0f)));
+            transformComponent->SetRotation(glm::vec3(getJsonFloatOrDefault(componentData, "rotationX", 0.0f), getJsonFloatOrDefault(componentData, "rotationY", 0.0f), getJsonFloatOrDefault(componentData, "rotationZ", 0.0f)));
+            transformComponent->SetScale(glm::vec3(getJsonFloatOrDefault(componentData, "scaleX", 1.0f), getJsonFloatOrDefault(componentData, "scaleY", 1.0f), getJsonFloatOrDefault(componentData, "scaleZ", 1.0f)));
+
+            // Actor names aren't all known yet, the parent is hooked up after loading
+            transformComponent->parentName = getJsonStringOrDefault(componentData, "parent", "");
+
+            newComponent = transformComponent;
+
+            luabridge::LuaRef componentInstance = luabridge::newTable(ComponentManager::lua_state);
+            componentInstance["key"] = componentKey;
+            componentInstance["enabled"] = true;
+            componentInstance["type"] = componentType;
+            newComponent->componentRef = std::make_shared<luabridge::LuaRef>(componentInstance);
+        } else if(componentType == "ParticleSystem") {
+            auto particleSystem = std::make_shared<ParticleSystemComponent>();
+            particleSystem->SetRate(getJsonFloatOrDefault(componentData, "rate", particleSystem->GetRate()));
+            particleSystem->SetMaxParticles(getJsonIntOrDefault(componentData, "maxParticles", particleSystem->GetMaxParticles()));
+            particleSystem->SetLifetime(getJsonFloatOrDefault(componentData, "lifetimeMin", 1.0f), getJsonFloatOrDefault(componentData, "lifetimeMax", 2.0f));
+            particleSystem->SetSpeed(getJsonFloatOrDefault(componentData, "speedMin", 1.0f), getJsonFloatOrDefault(componentData, "speedMax", 2.0f));
+            particleSystem->SetDirection(glm::vec3(getJsonFloatOrDefault(componentData, "directionX", 0.0f), getJsonFloatOrDefault(componentData, "directionY", 1.0f), getJsonFloatOrDefault(componentData, "directionZ", 0.0f)));
+            particleSystem->SetSpread(getJsonFloatOrDefault(componentData, "spread", particleSystem->GetSpread()));
+            particleSystem->SetGravity(glm::vec3(getJsonFloatOrDefault(componentData, "gravityX", 0.0f), getJsonFloatOrDefault(componentData, "gravityY", -9.81f), getJsonFloatOrDefault(componentData, "gravityZ", 0.0f)));
+            particleSystem->SetDrag(getJsonFloatOrDefault(componentData, "drag", 0.0f));
+            particleSystem->SetSize(getJsonFloatOrDefault(componentData, "startSize", 0.1f), getJsonFloatOrDefault(componentData, "endSize", 0.1f));
+            particleSystem->SetStartColor(getJsonFloatOrDefault(componentData, "startColorR", 1.0f), getJsonFloatOrDefault(componentData, "startColorG", 1.0f), getJsonFloatOrDefault(componentData, "startColorB", 1.0f), getJsonFloatOrDefault(componentData, "startColorA", 1.0f));
+            particleSystem->SetEndColor(getJsonFloatOrDefault(componentData, "endColorR", 1.0f), getJsonFloatOrDefault(componentData, "endColorG", 1.0f), getJsonFloatOrDefault(componentData, "endColorB", 1.0f), getJsonFloatOrDefault(componentData, "endColorA", 0.0f));
+            particleSystem->SetOffset(glm::vec3(getJsonFloatOrDefault(componentData, "offsetX", 0.0f), getJsonFloatOrDefault(componentData, "offsetY", 0.0f), getJsonFloatOrDefault(componentData, "offsetZ", 0.0f)));
+            particleSystem->SetAdditive(getJsonBoolOrDefault(componentData, "additive", false));
+            particleSystem->SetGpu(getJsonBoolOrDefault(componentData, "gpu", false));
+            particleSystem->SetEnabled(getJsonBoolOrDefault(componentData, "enabled", true));
+            // Spawned on the first frame the actor is in the scene
+            particleSystem->Emit(getJsonIntOrDefault(componentData, "burst", 0));
+
+            newComponent = particleSystem;
+
+            luabridge::LuaRef componentInstance = luabridge::newTable(ComponentManager::lua_state);
+            componentInstance["key"] = componentKey;
+            componentInstance["enabled"] = true;
+            componentInstance["type"] = componentType;
+            newComponent->componentRef = std::make_shared<luabridge::LuaRef>(componentInstance);
         }else {
             // Create a new component instance
             std::shared_ptr<Component> baseComponent = ComponentDB::AddComponent(componentType);
@@ -316,11 +386,38 @@ std::shared_ptr<Component> LoadExistingComponent(std::shared_ptr<Component> comp
     ComponentDB::EstablishInheritance(componentInstance, *component->componentRef);
  
     std::shared_ptr<Component> componentPtr = std::make_shared<Component>();
+    if (component->isTransform) {
+        // The copy needs a transform of its own, not just the template's table
+        componentPtr = std::make_shared<TransformComponent>(*std::static_pointer_cast<TransformComponent>(component));
+        componentPtr->type = component->type;
+    } else if (component->isParticleSystem) {
+        // Same settings, its own particles
+        componentPtr = std::make_shared<ParticleSystemComponent>(*std::static_pointer_cast<ParticleSystemComponent>(component));
+        componentPtr->type = component->type;
+    }
     componentPtr->componentRef = std::make_shared<luabridge::LuaRef>(componentInstance);
     componentPtr->key = component->key;
     return componentPtr;
 }
 
+/*
+    * Attach an actor's Transform to the Transform of the actor named as its parent
+*/
+void Scene::ResolveTransformParent(const std::shared_ptr<Actor>& actor) {
+    TransformComponent* transform = TransformComponent::FindOn(*actor);
+    if (!transform || transform->parentName.empty()) {
+        return;
+    }
+
+    auto it = actor_name_map.find(transform->parentName);
+    TransformComponent* parent = it != actor_name_map.end() ? TransformComponent::FindOn(*it->second.front()) : nullptr;
+    if (!parent) {
+        std::cout << "error: parent " << transform->parentName << " of " << actor->name << " has no Transform" << std::endl;
+        return;
+    }
+    transform->SetParent(parent);
+}
+
 /*
     * Load an actor template 
     * This function will load an actor template from a file and store it in the templates hash table
@@ -350,10 +447,10 @@ void Scene::LoadActorTemplate(const std::string& templateFp, const std::string&
 }
 
 /*
-    Function that loops through the actors and calles the Update function, then the LateUpdate function.
+    Calls OnStart for components added since the last call. Runs before the
+    frame's fixed steps so a component is always started before its first OnFixedUpdate.
 */
-void Scene::Update() {
-    // Call the OnStart for the new components.
+void Scene::StartPendingComponents() {
     for(auto& component : onStartComponents) {
         if(component->IsEnabled()) {
             try {
@@ -364,7 +461,27 @@ void Scene::Update() {
         }
     }
     onStartComponents.clear();
+}
+
+/*
+    Calls OnFixedUpdate once per simulation step.
+*/
+void Scene::FixedUpdate() {
+    for(auto& component : onFixedUpdateComponents) {
+        if(component->IsEnabled()) {
+            try {
+                (*component->componentRef)["OnFixedUpdate"](*component->componentRef);
+            } catch (luabridge::LuaException const& e) {
+                ReportError(component->actor->name, e);
+            }
+        }
+    }
+}
 
+/*
+    Function that loops through the actors and calles the Update function, then the LateUpdate function.
+*/
+void Scene::Update() {
     for(auto& component : onUpdateComponents) {
         if(component->IsEnabled()) {
             try {
@@ -414,6 +531,10 @@ void Scene::Update() {
                 onLateUpdateComponents.push_back(componentPair.second);
                 componentPair.second->addedLate = true;
             }
+            if(componentPair.second->hasFixedUpdate && !componentPair.second->addedFixedUpdate) {
+                onFixedUpdateComponents.push_back(componentPair.second);
+                componentPair.second->addedFixedUpdate = true;
+            }
         }
     }
     new_actors_to_add.clear();
@@ -429,6 +550,9 @@ void Scene::Update() {
         if (component->hasLateUpdate && !component->addedLate) {
             onLateUpdateComponents.push_back(component);
         }
+        if (component->hasFixedUpdate && !component->addedFixedUpdate) {
+            onFixedUpdateComponents.push_back(component);
+        }
     }
     ComponentManager::components_to_add.clear();
     
@@ -449,6 +573,8 @@ void Scene::Update() {
         removeFromList(onStartComponents, component);
         removeFromList(onUpdateComponents, component);
         removeFromList(onLateUpdateComponents, component);
+        removeFromList(onFixedUpdateComponents, component);
+        component->destroyed = true;
     }
     ComponentManager::components_to_remove.clear();
     
@@ -464,6 +590,8 @@ void Scene::Update() {
             removeFromList(onStartComponents, component);
             removeFromList(onUpdateComponents, component);
             removeFromList(onLateUpdateComponents, component);
+            removeFromList(onFixedUpdateComponents, component);
+            component->destroyed = true;
         }
 
         scene_actors.erase(find(scene_actors.begin(), scene_actors.end(), actor));
@@ -503,6 +631,7 @@ luabridge::LuaRef Scene::InstantiateActor(const std::string& template_name) {
                 newComponent->hasStart = false;  // Lights don't need Start/Update
                 newComponent->hasUpdate = false;
                 newComponent->hasLateUpdate = false;
+                newComponent->hasFixedUpdate = false;
                 newComponent->isLC = true;
                 newActor->components[componentPair.first] = newComponent;
                 newComponent->actor = newActor;
@@ -525,6 +654,7 @@ luabridge::LuaRef Scene::InstantiateActor(const std::string& template_name) {
         // Add the new actor to the vector
         Scene::new_actors_to_add.push_back(newActor);
         actor_name_map[newActor->name].push_back(newActor);
+        ResolveTransformParent(newActor);
 
         // Return the Actor table reference
         return luabridge::LuaRef(ComponentManager::lua_state, newActor.get());
@@ -1,7 +1,9 @@
 #include "Shader.h"
+#include "ShaderDB.h"
+#include "GLExtensions.h"
 #include <iostream>
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines, const std::vector<std::string>& feedbackVaryings) {
   // Retreive the vertex/fragment source code from filePath
   std::string vertexCode;
   std::string fragmentCode;
@@ -28,12 +30,27 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
   fShaderFile.close();
 
   // Convert stream into string
-  vertexCode = vShaderStream.str();
-  fragmentCode = fShaderStream.str();
-  
-  const char* vShaderCode = vertexCode.c_str();
-  const char* fShaderCode = fragmentCode.c_str();
-  
+  vertexCode = InjectDefines(vShaderStream.str(), defines);
+  fragmentCode = InjectDefines(fShaderStream.str(), defines);
+
+  ID = glCreateProgram();
+
+  // Try the on-disk program binary first, it skips compiling and linking
+  uint64_t cacheKey = ShaderDB::HashProgram(vertexCode, fragmentCode, defines, feedbackVaryings);
+  if (ShaderDB::LoadProgramBinary(ID, cacheKey)) {
+    return;
+  }
+
+  if (GLExtensions::programBinary) {
+    GLExtensions::ProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+
+  if (CompileAndLink(vertexCode.c_str(), fragmentCode.c_str(), feedbackVaryings)) {
+    ShaderDB::SaveProgramBinary(ID, cacheKey);
+  }
+}
+
+bool Shader::CompileAndLink(const char* vShaderCode, const char* fShaderCode, const std::vector<std::string>& feedbackVaryings) {
   // Compile shaders
   GLuint vertex, fragment;
   GLint success;
@@ -61,10 +78,19 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
   }
 
-  // Create shader program
-  ID = glCreateProgram();
+  // Link the shader program
   glAttachShader(ID, vertex);
   glAttachShader(ID, fragment);
+
+  // Has to be set before linking
+  if (!feedbackVaryings.empty()) {
+    std::vector<const char*> names;
+    for (const auto& varying : feedbackVaryings) {
+      names.push_back(varying.c_str());
+    }
+    glTransformFeedbackVaryings(ID, static_cast<GLsizei>(names.size()), names.data(), GL_INTERLEAVED_ATTRIBS);
+  }
+
   glLinkProgram(ID);
 
   // Print linking errors if any
@@ -75,8 +101,34 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
   }
   
   // Delete the shaders as they're linked into the program now and no longer necessary
+  glDetachShader(ID, vertex);
+  glDetachShader(ID, fragment);
   glDeleteShader(vertex);
   glDeleteShader(fragment);
+
+  return success;
+}
+
+std::string Shader::InjectDefines(const std::string& code, const std::vector<std::string>& defines) {
+  if (defines.empty()) {
+    return code;
+  }
+
+  std::string defineBlock;
+  for (const auto& define : defines) {
+    defineBlock += "#define " + define + "\n";
+  }
+
+  // #version has to stay the first line of the shader
+  size_t insertAt = 0;
+  if (code.compare(0, 8, "#version") == 0) {
+    size_t lineEnd = code.find('\n');
+    insertAt = lineEnd == std::string::npos ? code.size() : lineEnd + 1;
+  }
+
+  std::string result = code;
+  result.insert(insertAt, defineBlock);
+  return result;
 }
 
 Shader::~Shader() {
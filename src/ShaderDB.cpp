@@ -0,0 +1,210 @@
+#include "ShaderDB.h"
+#include "GLExtensions.h"
+#include "Renderer.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstdio>
+
+#include <SDL2/SDL.h>
+
+// Header written in front of every cached program binary
+static const uint32_t PROGRAM_BINARY_MAGIC = 0x4253474E; // "NGSB"
+
+bool ShaderDB::useBinaryCache = false;
+std::string ShaderDB::cacheDir;
+std::string ShaderDB::driverSignature;
+std::unordered_map<std::string, std::shared_ptr<Shader>> ShaderDB::shaders;
+std::vector<ShaderDB::Permutation> ShaderDB::permutations;
+
+static void HashBytes(uint64_t& hash, const std::string& bytes) {
+  // FNV-1a, with a separator so ("ab", "c") and ("a", "bc") differ
+  for (unsigned char c : bytes) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  hash ^= 0xFF;
+  hash *= 1099511628211ull;
+}
+
+static std::string GetGLString(GLenum name) {
+  const GLubyte* str = glGetString(name);
+  return str ? reinterpret_cast<const char*>(str) : "";
+}
+
+void ShaderDB::Init(bool useCache, const std::string& cacheDirectory) {
+  cacheDir = cacheDirectory;
+
+  // A binary is only valid for the exact driver that produced it
+  driverSignature = GetGLString(GL_VENDOR) + "|" + GetGLString(GL_RENDERER) + "|" + GetGLString(GL_VERSION);
+
+  useBinaryCache = useCache && GLExtensions::programBinary;
+  if (useCache && !GLExtensions::programBinary) {
+    std::cout << "Program binaries not supported by driver, shader cache disabled" << std::endl;
+  }
+
+  if (useBinaryCache) {
+    std::error_code ec;
+    std::filesystem::create_directories(cacheDir, ec);
+    if (ec) {
+      std::cerr << "Failed to create shader cache directory " << cacheDir << ": " << ec.message() << std::endl;
+      useBinaryCache = false;
+    }
+  }
+}
+
+void ShaderDB::Shutdown() {
+  shaders.clear();
+  permutations.clear();
+}
+
+std::shared_ptr<Shader> ShaderDB::GetShader(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines, const std::vector<std::string>& feedbackVaryings) {
+  std::string key = PermutationKey(vertexPath, fragmentPath, defines, feedbackVaryings);
+
+  auto it = shaders.find(key);
+  if (it != shaders.end()) {
+    return it->second;
+  }
+
+  auto shader = std::make_shared<Shader>(vertexPath.c_str(), fragmentPath.c_str(), defines, feedbackVaryings);
+  shaders[key] = shader;
+  return shader;
+}
+
+void ShaderDB::RegisterPermutation(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines) {
+  std::string key = PermutationKey(vertexPath, fragmentPath, defines);
+  for (const auto& permutation : permutations) {
+    if (PermutationKey(permutation.vertexPath, permutation.fragmentPath, permutation.defines) == key) {
+      return;
+    }
+  }
+  permutations.push_back({ vertexPath, fragmentPath, defines });
+}
+
+void ShaderDB::WarmUp() {
+  // Build every registered permutation behind a loading screen so the first
+  // frames that need them don't hitch on compiles.
+  for (size_t i = 0; i < permutations.size(); ++i) {
+    Renderer::DrawLoadingScreen(static_cast<float>(i) / static_cast<float>(permutations.size()));
+
+    const Permutation& permutation = permutations[i];
+    GetShader(permutation.vertexPath, permutation.fragmentPath, permutation.defines);
+
+    // Keep the window responsive while we're busy
+    SDL_PumpEvents();
+  }
+  Renderer::DrawLoadingScreen(1.0f);
+}
+
+uint64_t ShaderDB::HashProgram(const std::string& vertexCode, const std::string& fragmentCode, const std::vector<std::string>& defines, const std::vector<std::string>& feedbackVaryings) {
+  uint64_t hash = 14695981039346656037ull;
+  HashBytes(hash, vertexCode);
+  HashBytes(hash, fragmentCode);
+  for (const auto& define : defines) {
+    HashBytes(hash, define);
+  }
+  // Prefixed so a varying can't be mistaken for a define
+  for (const auto& varying : feedbackVaryings) {
+    HashBytes(hash, ">" + varying);
+  }
+  HashBytes(hash, driverSignature);
+  return hash;
+}
+
+bool ShaderDB::LoadProgramBinary(GLuint program, uint64_t key) {
+  if (!useBinaryCache) {
+    return false;
+  }
+
+  std::string path = BinaryPath(key);
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  uint32_t header[3] = { 0, 0, 0 }; // magic, format, length
+  file.read(reinterpret_cast<char*>(header), sizeof(header));
+  if (!file || header[0] != PROGRAM_BINARY_MAGIC || header[2] == 0) {
+    file.close();
+    std::remove(path.c_str());
+    return false;
+  }
+
+  std::vector<char> binary(header[2]);
+  file.read(binary.data(), binary.size());
+  if (!file) {
+    file.close();
+    std::remove(path.c_str());
+    return false;
+  }
+  file.close();
+
+  GLExtensions::ProgramBinary(program, static_cast<GLenum>(header[1]), binary.data(), static_cast<GLsizei>(binary.size()));
+
+  // Drivers reject binaries after updates - throw the stale file away and let
+  // the caller compile from source.
+  GLint success = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    std::remove(path.c_str());
+    return false;
+  }
+  return true;
+}
+
+void ShaderDB::SaveProgramBinary(GLuint program, uint64_t key) {
+  if (!useBinaryCache) {
+    return;
+  }
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  GLsizei written = 0;
+  GLExtensions::GetProgramBinary(program, length, &written, &format, binary.data());
+  if (written <= 0) {
+    return;
+  }
+
+  // Write to a temporary file first so a crash never leaves a truncated binary
+  std::string path = BinaryPath(key);
+  std::string tmpPath = path + ".tmp";
+  std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return;
+  }
+
+  uint32_t header[3] = { PROGRAM_BINARY_MAGIC, static_cast<uint32_t>(format), static_cast<uint32_t>(written) };
+  file.write(reinterpret_cast<const char*>(header), sizeof(header));
+  file.write(binary.data(), written);
+  file.close();
+
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, path, ec);
+  if (ec) {
+    std::remove(tmpPath.c_str());
+  }
+}
+
+std::string ShaderDB::PermutationKey(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines, const std::vector<std::string>& feedbackVaryings) {
+  std::string key = vertexPath + "|" + fragmentPath;
+  for (const auto& define : defines) {
+    key += "|" + define;
+  }
+  for (const auto& varying : feedbackVaryings) {
+    key += "|>" + varying;
+  }
+  return key;
+}
+
+std::string ShaderDB::BinaryPath(uint64_t key) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+  return cacheDir + "/" + name;
+}
@@ -0,0 +1,440 @@
+#include "ShadowSystem.h"
+#include "ShaderDB.h"
+#include "GameObject.h"
+#include "LightComponent.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Smallest map that still leaves the cascades room to snap
+static const int MIN_RESOLUTION = 256;
+// Blend between uniform (0) and logarithmic (1) cascade splits
+static const float SPLIT_LAMBDA = 0.75f;
+// How far a cascade's center may drift before it snaps to the camera again,
+// as a share of the cascade's radius; the map is widened by the same amount
+static const float SNAP_FRACTION = 0.25f;
+// Extra cone around a spot light's outer cutoff, in radians
+static const float SPOT_MARGIN = 0.1f;
+// Spot maps only reach as far as the light adds one step of an 8 bit color
+static const float LIGHT_CUTOFF = 1.0f / 256.0f;
+// Slope scaled and constant depth offsets for casters, against acne
+static const float SLOPE_BIAS = 2.0f;
+static const float CONSTANT_BIAS = 4.0f;
+
+int ShadowSystem::resolution = 0;
+int ShadowSystem::cascadeCount = 3;
+float ShadowSystem::distance = 50.0f;
+int ShadowSystem::farInterval = 4;
+int ShadowSystem::spotCount = 2;
+std::shared_ptr<Shader> ShadowSystem::shader = nullptr;
+GLint ShadowSystem::matrixLoc = -1;
+GLint ShadowSystem::modelLoc = -1;
+GLuint ShadowSystem::cascadeMaps = 0;
+GLuint ShadowSystem::cascadeCache = 0;
+GLuint ShadowSystem::spotMaps = 0;
+GLuint ShadowSystem::spotCache = 0;
+GLuint ShadowSystem::fbo = 0;
+GLuint ShadowSystem::copyFBO = 0;
+ShadowSystem::MapState ShadowSystem::cascadeStates[ShadowFrame::MAX_CASCADES];
+ShadowSystem::MapState ShadowSystem::spotStates[ShadowFrame::MAX_SPOT_SHADOWS];
+uint64_t ShadowSystem::frameCounter = 0;
+std::atomic<uint64_t> ShadowSystem::casterDraws{0};
+std::atomic<uint64_t> ShadowSystem::naiveDraws{0};
+std::atomic<uint64_t> ShadowSystem::staticRebuilds{0};
+
+// Scratch for UpdateMap: the casters inside the map being updated
+static std::vector<const GameObject*> visibleStatic;
+static std::vector<const GameObject*> visibleDynamic;
+
+static glm::vec3 UpFor(const glm::vec3& direction) {
+  return std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+// Order independent, so scripts drawing the same static objects in a
+// different order don't throw the cache away
+static uint64_t CasterHash(const GameObject& object) {
+  const void* geometry = (object.isModel && object.model) ? static_cast<const void*>(object.model.get()) : static_cast<const void*>(object.mesh.get());
+  // FNV-1a over the geometry and where it is
+  uint64_t hash = 1469598103934665603ull;
+  auto mix = [&hash](const void* data, size_t bytes) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < bytes; ++i) {
+      hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+  };
+  mix(&geometry, sizeof(geometry));
+  mix(glm::value_ptr(object.GetDrawMatrix()), sizeof(glm::mat4));
+  // Spread the bits before they're summed
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+static glm::mat4 SpotMatrix(const ShaderLight& light, float range) {
+  glm::vec3 direction = glm::normalize(light.direction);
+  float angle = 2.0f * std::acos(glm::clamp(light.outerCutoffCos, -1.0f, 1.0f)) + SPOT_MARGIN;
+  angle = std::min(angle, glm::radians(170.0f));
+  glm::mat4 view = glm::lookAt(light.position, light.position + direction, UpFor(direction));
+  glm::mat4 projection = glm::perspective(angle, 1.0f, std::max(range * 0.01f, 0.05f), range);
+  return projection * view;
+}
+
+// Splits the view out to the shadow distance and fits an orthographic box
+// around each slice's bounding sphere. The sphere only depends on the
+// projection, so turning the camera leaves the box alone; moving it only
+// shifts the box once the center leaves its grid cell.
+static void PlaceCascades(ShadowFrame& frame, int count, float shadowDistance, int resolution, const glm::vec3& lightDirection, const glm::mat4& view, const glm::mat4& projection) {
+  float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+  float farPlane = std::min(projection[3][2] / (projection[2][2] + 1.0f), shadowDistance);
+  if (!(nearPlane > 0.0f) || farPlane <= nearPlane) {
+    return;
+  }
+  float tanX = 1.0f / projection[0][0];
+  float tanY = 1.0f / projection[1][1];
+
+  glm::vec3 direction = glm::normalize(lightDirection);
+  glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), direction, UpFor(direction));
+  glm::mat4 cameraToWorld = glm::inverse(view);
+
+  float sliceNear = nearPlane;
+  for (int c = 0; c < count; ++c) {
+    float t = static_cast<float>(c + 1) / count;
+    float uniform = nearPlane + (farPlane - nearPlane) * t;
+    float logarithmic = nearPlane * std::pow(farPlane / nearPlane, t);
+    float sliceFar = glm::mix(uniform, logarithmic, SPLIT_LAMBDA);
+
+    glm::vec3 center(0.0f, 0.0f, -0.5f * (sliceNear + sliceFar));
+    glm::vec3 nearCorner(sliceNear * tanX, sliceNear * tanY, -sliceNear);
+    glm::vec3 farCorner(sliceFar * tanX, sliceFar * tanY, -sliceFar);
+    float radius = std::max(glm::length(nearCorner - center), glm::length(farCorner - center));
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    // Snap in whole texels, so static shadows don't shimmer as it moves
+    float halfSize = radius * (1.0f + SNAP_FRACTION);
+    float texel = 2.0f * halfSize / resolution;
+    float step = std::max(std::floor(radius * SNAP_FRACTION / texel), 1.0f) * texel;
+    glm::vec3 lightCenter = glm::vec3(lightRotation * (cameraToWorld * glm::vec4(center, 1.0f)));
+    lightCenter = glm::round(lightCenter / step) * step;
+
+    // Built from the snapped center alone, so it comes out bit for bit the
+    // same until the next snap. Casters behind the near plane are clamped
+    // onto it rather than clipped.
+    glm::mat4 lightView = glm::translate(glm::mat4(1.0f), -(lightCenter + glm::vec3(0.0f, 0.0f, 2.0f * halfSize))) * lightRotation;
+    glm::mat4 lightProjection = glm::ortho(-halfSize, halfSize, -halfSize, halfSize, 0.0f, 4.0f * halfSize);
+    frame.cascades[c] = lightProjection * lightView;
+    frame.cascadeSplits[c] = sliceFar;
+    sliceNear = sliceFar;
+  }
+  frame.cascadeCount = count;
+}
+
+// Keeps the casters whose world bounds reach into the map. The near plane is
+// skipped: depth clamping still lets anything in front of it cast.
+static void CullCasters(const std::vector<std::shared_ptr<GameObject>>& casters, const glm::mat4& matrix, std::vector<const GameObject*>& visible) {
+  // Gribb/Hartmann planes, as RenderCommandQueue culls with
+  glm::mat4 m = glm::transpose(matrix);
+  const glm::vec4 planes[5] = { m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] - m[2] };
+
+  visible.clear();
+  for (const auto& caster : casters) {
+    glm::vec3 boundsMin, boundsMax;
+    caster->GetWorldBounds(boundsMin, boundsMax);
+    bool inside = true;
+    for (const glm::vec4& plane : planes) {
+      // The corner furthest along the plane's normal
+      glm::vec3 corner(plane.x >= 0.0f ? boundsMax.x : boundsMin.x, plane.y >= 0.0f ? boundsMax.y : boundsMin.y, plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+      if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+        inside = false;
+        break;
+      }
+    }
+    if (inside) {
+      visible.push_back(caster.get());
+    }
+  }
+}
+
+void ShadowSystem::Init(int mapResolution, int cascades, float shadowDistance, int farCascadeInterval, int spotShadows) {
+  resolution = mapResolution > 0 ? std::max(mapResolution, MIN_RESOLUTION) : 0;
+  cascadeCount = std::clamp(cascades, 1, ShadowFrame::MAX_CASCADES);
+  distance = std::max(shadowDistance, 1.0f);
+  farInterval = std::max(farCascadeInterval, 1);
+  spotCount = std::clamp(spotShadows, 0, ShadowFrame::MAX_SPOT_SHADOWS);
+  if (!resolution) {
+    return;
+  }
+
+  shader = ShaderDB::GetShader("shaders/vertex/shadow.glsl", "shaders/fragment/shadow.glsl");
+  if (!shader || !shader->GetID()) {
+    std::cerr << "Shadow shader failed to load; shadows are off" << std::endl;
+    resolution = 0;
+    return;
+  }
+  matrixLoc = glGetUniformLocation(shader->GetID(), "lightViewProjection");
+  modelLoc = glGetUniformLocation(shader->GetID(), "model");
+  CreateMaps();
+}
+
+void ShadowSystem::Shutdown() {
+  DeleteMaps();
+  shader = nullptr;
+  visibleStatic.clear();
+  visibleDynamic.clear();
+}
+
+bool ShadowSystem::IsEnabled() {
+  return resolution > 0;
+}
+
+void ShadowSystem::CreateMaps() {
+  auto createArray = [](GLuint& texture, int size, int layers, bool sampled) {
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, std::max(layers, 1), 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    GLint filter = sampled ? GL_LINEAR : GL_NEAREST;
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (sampled) {
+      // Hardware compares, and filters the results over 2x2 texels
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+  };
+  createArray(cascadeMaps, resolution, cascadeCount, true);
+  createArray(cascadeCache, resolution, cascadeCount, false);
+  createArray(spotMaps, resolution / 2, spotCount, true);
+  createArray(spotCache, resolution / 2, spotCount, false);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  // Depth only. Headless mode draws into its own framebuffer, so whatever
+  // is bound now is put back rather than 0.
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  GLuint framebuffers[2];
+  glGenFramebuffers(2, framebuffers);
+  fbo = framebuffers[0];
+  copyFBO = framebuffers[1];
+  for (GLuint framebuffer : framebuffers) {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+  }
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cascadeCache, 0, 0);
+  bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+  if (!complete) {
+    std::cerr << "Shadow map target incomplete; shadows are off" << std::endl;
+    DeleteMaps();
+    resolution = 0;
+  }
+}
+
+void ShadowSystem::DeleteMaps() {
+  GLuint textures[4] = { cascadeMaps, cascadeCache, spotMaps, spotCache };
+  for (GLuint texture : textures) {
+    if (texture) {
+      glDeleteTextures(1, &texture);
+    }
+  }
+  cascadeMaps = cascadeCache = spotMaps = spotCache = 0;
+  if (fbo) {
+    GLuint framebuffers[2] = { fbo, copyFBO };
+    glDeleteFramebuffers(2, framebuffers);
+    fbo = copyFBO = 0;
+  }
+  for (MapState& state : cascadeStates) {
+    state = MapState();
+  }
+  for (MapState& state : spotStates) {
+    state = MapState();
+  }
+}
+
+void ShadowSystem::BuildFrame(ShadowFrame& frame, const std::vector<std::shared_ptr<GameObject>>& objects, const std::vector<ShaderLight>& lights, const glm::mat4& view, const glm::mat4& projection) {
+  frame = ShadowFrame();
+  if (!IsEnabled()) {
+    return;
+  }
+
+  for (size_t i = 0; i < lights.size(); ++i) {
+    const ShaderLight& light = lights[i];
+    if (light.type == static_cast<int>(LightType::DIRECTIONAL)) {
+      if (frame.cascadeLight < 0) {
+        frame.cascadeLight = static_cast<int>(i);
+      }
+    } else if (light.type == static_cast<int>(LightType::SPOT) && frame.spotCount < spotCount) {
+      float range = std::min(LightComponent::GetRange(light, LIGHT_CUTOFF), distance);
+      if (range > 0.0f) {
+        frame.spotLights[frame.spotCount] = static_cast<int>(i);
+        frame.spots[frame.spotCount] = SpotMatrix(light, range);
+        ++frame.spotCount;
+      }
+    }
+  }
+  if (frame.cascadeLight >= 0) {
+    PlaceCascades(frame, cascadeCount, distance, resolution, lights[frame.cascadeLight].direction, view, projection);
+  }
+  if (frame.cascadeCount == 0 && frame.spotCount == 0) {
+    return;
+  }
+
+  for (const auto& object : objects) {
+    if (!object->isActive || !object->mesh) {
+      continue;
+    }
+    if (object->isStatic) {
+      frame.staticCasters.push_back(object);
+      frame.staticKey += CasterHash(*object);
+    } else {
+      frame.dynamicCasters.push_back(object);
+    }
+  }
+}
+
+void ShadowSystem::Render(const ShadowFrame& frame) {
+  ++frameCounter;
+  if (!fbo || (frame.cascadeCount == 0 && frame.spotCount == 0)) {
+    return;
+  }
+
+  // State the frame in progress expects back
+  GLint previousFramebuffer = 0;
+  GLint viewport[4];
+  GLint polygonMode[2];
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+
+  shader->Use();
+  glEnable(GL_DEPTH_TEST);
+  glDepthMask(GL_TRUE);
+  glEnable(GL_DEPTH_CLAMP);
+  glEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(SLOPE_BIAS, CONSTANT_BIAS);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+  for (int c = 0; c < frame.cascadeCount; ++c) {
+    // The nearest cascade every frame, the rest in turn
+    bool due = c == 0 || (frameCounter + c) % farInterval == 0;
+    UpdateMap(cascadeStates[c], cascadeCache, cascadeMaps, c, resolution, frame.cascades[c], due, frame);
+  }
+  for (int s = 0; s < frame.spotCount; ++s) {
+    UpdateMap(spotStates[s], spotCache, spotMaps, s, resolution / 2, frame.spots[s], true, frame);
+  }
+
+  glBindVertexArray(0);
+  glDisable(GL_POLYGON_OFFSET_FILL);
+  glDisable(GL_DEPTH_CLAMP);
+  glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+}
+
+void ShadowSystem::UpdateMap(MapState& state, GLuint cache, GLuint map, int layer, int size, const glm::mat4& matrix, bool due, const ShadowFrame& frame) {
+  CullCasters(frame.staticCasters, matrix, visibleStatic);
+  CullCasters(frame.dynamicCasters, matrix, visibleDynamic);
+  naiveDraws += visibleStatic.size() + visibleDynamic.size();
+
+  bool cached = state.valid && state.matrix == matrix && state.staticKey == frame.staticKey;
+  // Late or unchanged dynamic shadows are left as they are; a moved map or
+  // static object can't wait
+  if (cached && (!due || (visibleDynamic.empty() && state.dynamicCount == 0))) {
+    return;
+  }
+
+  glViewport(0, 0, size, size);
+  if (!cached) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cache, 0, layer);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    casterDraws += DrawCasters(visibleStatic, matrix);
+    ++staticRebuilds;
+  }
+
+  // Start from the static shadows and draw what moves on top
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, copyFBO);
+  glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cache, 0, layer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+  glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, map, 0, layer);
+  glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+  casterDraws += DrawCasters(visibleDynamic, matrix);
+
+  state.valid = true;
+  state.matrix = matrix;
+  state.staticKey = frame.staticKey;
+  state.dynamicCount = static_cast<int>(visibleDynamic.size());
+}
+
+int ShadowSystem::DrawCasters(const std::vector<const GameObject*>& casters, const glm::mat4& matrix) {
+  glUniformMatrix4fv(matrixLoc, 1, GL_FALSE, glm::value_ptr(matrix));
+  int draws = 0;
+  for (const GameObject* caster : casters) {
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(caster->GetDrawMatrix()));
+    if (caster->isModel && caster->model) {
+      for (const auto& mesh : caster->model->meshes) {
+        mesh->DrawElements();
+        ++draws;
+      }
+    } else {
+      caster->mesh->DrawElements();
+      ++draws;
+    }
+  }
+  return draws;
+}
+
+void ShadowSystem::Apply(GLuint program, const ShadowFrame& frame) {
+  glUniform1i(glGetUniformLocation(program, "cascadeMap"), CASCADE_UNIT);
+  glUniform1i(glGetUniformLocation(program, "spotShadowMap"), SPOT_UNIT);
+
+  // Sampled with the matrices the layers were last drawn with, which a
+  // staggered cascade may not have caught up to
+  int cascades = fbo ? frame.cascadeCount : 0;
+  glUniform1i(glGetUniformLocation(program, "cascadeLight"), cascades ? frame.cascadeLight : -1);
+  glUniform1i(glGetUniformLocation(program, "cascadeCount"), cascades);
+  if (cascades) {
+    glm::mat4 matrices[ShadowFrame::MAX_CASCADES];
+    for (int c = 0; c < cascades; ++c) {
+      matrices[c] = cascadeStates[c].matrix;
+    }
+    glUniformMatrix4fv(glGetUniformLocation(program, "cascadeMatrices"), cascades, GL_FALSE, glm::value_ptr(matrices[0]));
+    glUniform4fv(glGetUniformLocation(program, "cascadeSplits"), 1, frame.cascadeSplits);
+  }
+
+  int spots = fbo ? frame.spotCount : 0;
+  int spotLights[ShadowFrame::MAX_SPOT_SHADOWS];
+  glm::mat4 matrices[ShadowFrame::MAX_SPOT_SHADOWS];
+  for (int s = 0; s < ShadowFrame::MAX_SPOT_SHADOWS; ++s) {
+    spotLights[s] = s < spots ? frame.spotLights[s] : -1;
+    matrices[s] = spotStates[s].matrix;
+  }
+  glUniform1iv(glGetUniformLocation(program, "spotShadowLights"), ShadowFrame::MAX_SPOT_SHADOWS, spotLights);
+  if (spots) {
+    glUniformMatrix4fv(glGetUniformLocation(program, "spotMatrices"), spots, GL_FALSE, glm::value_ptr(matrices[0]));
+  }
+
+  glActiveTexture(GL_TEXTURE0 + CASCADE_UNIT);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, cascadeMaps);
+  glActiveTexture(GL_TEXTURE0 + SPOT_UNIT);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, spotMaps);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+std::string ShadowSystem::GetReport() {
+  uint64_t draws = casterDraws;
+  uint64_t naive = naiveDraws;
+  char line[160];
+  std::snprintf(line, sizeof(line), "shadow maps: %llu caster draws against %llu redrawing every frame (%.0f%%), %llu static rebuilds\n",
+                static_cast<unsigned long long>(draws), static_cast<unsigned long long>(naive), naive ? 100.0 * draws / naive : 0.0,
+                static_cast<unsigned long long>(staticRebuilds.load()));
+  return line;
+}
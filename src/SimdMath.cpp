@@ -0,0 +1,813 @@
+#include "SimdMath.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <SDL2/SDL.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only emit SSE4.1/AVX2 in functions that ask for it, so the
+// rest of the engine still runs on CPUs without them. MSVC always allows it.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SIMD_TARGET(isa)
+#else
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+SimdMath::Level SimdMath::level = SimdMath::Level::Scalar;
+
+// Kernels work on [begin, end) so the vector versions can hand their leftover
+// objects to the scalar ones
+typedef void (*ComposeFn)(int begin, int end, const TransformStreams& in, glm::mat4* out);
+typedef void (*NormalFn)(int begin, int end, const glm::mat4* models, glm::mat3* out);
+typedef void (*BoundsFn)(int begin, int end, const glm::mat4* models, const glm::vec3* localMin, const glm::vec3* localMax, glm::vec3* outMin, glm::vec3* outMax);
+typedef void (*MultiplyFn)(const glm::mat4& a, const glm::mat4& b, glm::mat4& out);
+typedef void (*ParticleFn)(int begin, int end, const ParticleStreams& streams, const ParticleParams& params);
+typedef void (*RasterFn)(const DepthTriangle& tri, int minX, int maxX, int minY, int maxY, float* depth, int stride);
+
+// Scalar
+
+static void ComposeScalar(int begin, int end, const TransformStreams& in, glm::mat4* out) {
+  for (int i = begin; i < end; ++i) {
+    float x = in.rotationX[i], y = in.rotationY[i], z = in.rotationZ[i], w = in.rotationW[i];
+    float x2 = x + x, y2 = y + y, z2 = z + z;
+    float xx = x * x2, yy = y * y2, zz = z * z2;
+    float xy = x * y2, xz = x * z2, yz = y * z2;
+    float wx = w * x2, wy = w * y2, wz = w * z2;
+    float sx = in.scaleX[i], sy = in.scaleY[i], sz = in.scaleZ[i];
+
+    glm::mat4& m = out[i];
+    m[0] = glm::vec4((1.0f - (yy + zz)) * sx, (xy + wz) * sx, (xz - wy) * sx, 0.0f);
+    m[1] = glm::vec4((xy - wz) * sy, (1.0f - (xx + zz)) * sy, (yz + wx) * sy, 0.0f);
+    m[2] = glm::vec4((xz + wy) * sz, (yz - wx) * sz, (1.0f - (xx + yy)) * sz, 0.0f);
+    m[3] = glm::vec4(in.positionX[i], in.positionY[i], in.positionZ[i], 1.0f);
+  }
+}
+
+static void NormalScalar(int begin, int end, const glm::mat4* models, glm::mat3* out) {
+  for (int i = begin; i < end; ++i) {
+    // The inverse transpose of [a b c] is [b×c c×a a×b] / det
+    glm::vec3 a(models[i][0]), b(models[i][1]), c(models[i][2]);
+    glm::vec3 bc = glm::cross(b, c);
+    float det = glm::dot(a, bc);
+    float invDet = det != 0.0f ? 1.0f / det : 0.0f;
+    out[i] = glm::mat3(bc * invDet, glm::cross(c, a) * invDet, glm::cross(a, b) * invDet);
+  }
+}
+
+static void BoundsScalar(int begin, int end, const glm::mat4* models, const glm::vec3* localMin, const glm::vec3* localMax, glm::vec3* outMin, glm::vec3* outMax) {
+  for (int i = begin; i < end; ++i) {
+    // Transform the box center and extents (Arvo's method) instead of all 8 corners
+    const glm::mat4& m = models[i];
+    glm::vec3 center = (localMin[i] + localMax[i]) * 0.5f;
+    glm::vec3 extents = (localMax[i] - localMin[i]) * 0.5f;
+    glm::vec3 worldCenter = glm::vec3(m[0]) * center.x + glm::vec3(m[1]) * center.y + glm::vec3(m[2]) * center.z + glm::vec3(m[3]);
+    glm::vec3 worldExtents = glm::abs(glm::vec3(m[0])) * extents.x + glm::abs(glm::vec3(m[1])) * extents.y + glm::abs(glm::vec3(m[2])) * extents.z;
+    outMin[i] = worldCenter - worldExtents;
+    outMax[i] = worldCenter + worldExtents;
+  }
+}
+
+static void ParticlesScalar(int begin, int end, const ParticleStreams& s, const ParticleParams& p) {
+  float dt = p.deltaTime;
+  float damping = std::max(0.0f, 1.0f - p.drag * dt);
+  glm::vec3 dv = p.gravity * dt;
+  float sizeRange = p.endSize - p.startSize;
+  glm::vec4 colorRange = p.endColor - p.startColor;
+  for (int i = begin; i < end; ++i) {
+    float vx = (s.velocityX[i] + dv.x) * damping;
+    float vy = (s.velocityY[i] + dv.y) * damping;
+    float vz = (s.velocityZ[i] + dv.z) * damping;
+    s.velocityX[i] = vx;
+    s.velocityY[i] = vy;
+    s.velocityZ[i] = vz;
+    s.positionX[i] += vx * dt;
+    s.positionY[i] += vy * dt;
+    s.positionZ[i] += vz * dt;
+
+    float age = s.age[i] + dt;
+    s.age[i] = age;
+    float t = std::min(age * s.invLifetime[i], 1.0f);
+    s.size[i] = p.startSize + sizeRange * t;
+    s.colorR[i] = p.startColor.r + colorRange.r * t;
+    s.colorG[i] = p.startColor.g + colorRange.g * t;
+    s.colorB[i] = p.startColor.b + colorRange.b * t;
+    s.colorA[i] = p.startColor.a + colorRange.a * t;
+  }
+}
+
+static void MultiplyScalar(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+  out = a * b;
+}
+
+static void RasterScalar(const DepthTriangle& t, int minX, int maxX, int minY, int maxY, float* depth, int stride) {
+  for (int y = minY; y <= maxY; ++y) {
+    float py = y + 0.5f;
+    float* dst = depth + static_cast<size_t>(y) * stride;
+    for (int x = minX; x <= maxX; ++x) {
+      float px = x + 0.5f;
+      if (t.a[0] * px + t.b[0] * py + t.c[0] < 0.0f || t.a[1] * px + t.b[1] * py + t.c[1] < 0.0f || t.a[2] * px + t.b[2] * py + t.c[2] < 0.0f) {
+        continue;
+      }
+      dst[x] = std::min(dst[x], t.zA * px + t.zB * py + t.zC);
+    }
+  }
+}
+
+#ifdef SIMD_X86
+
+// SSE2: 4 pixels per iteration. Every x86-64 CPU has it, so it's also the
+// raster kernel for the scalar level.
+
+SIMD_TARGET("sse2")
+static void RasterSSE2(const DepthTriangle& t, int minX, int maxX, int minY, int maxY, float* depth, int stride) {
+  const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 a0 = _mm_set1_ps(t.a[0]), a1 = _mm_set1_ps(t.a[1]), a2 = _mm_set1_ps(t.a[2]), zA = _mm_set1_ps(t.zA);
+  // Lanes left of minX fail the edge test like any other pixel outside
+  int startX = minX & ~3;
+
+  for (int y = minY; y <= maxY; ++y) {
+    float py = y + 0.5f;
+    __m128 row0 = _mm_set1_ps(t.b[0] * py + t.c[0]);
+    __m128 row1 = _mm_set1_ps(t.b[1] * py + t.c[1]);
+    __m128 row2 = _mm_set1_ps(t.b[2] * py + t.c[2]);
+    __m128 rowZ = _mm_set1_ps(t.zB * py + t.zC);
+    float* dst = depth + static_cast<size_t>(y) * stride;
+
+    for (int x = startX; x <= maxX; x += 4) {
+      __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+      __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+      __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+      __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+      __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+      if (_mm_movemask_ps(inside) == 0) {
+        continue;
+      }
+
+      __m128 z = _mm_add_ps(_mm_mul_ps(zA, px), rowZ);
+      __m128 current = _mm_loadu_ps(dst + x);
+      __m128 nearest = _mm_min_ps(current, z);
+      _mm_storeu_ps(dst + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+    }
+  }
+}
+
+// SSE4.1: 4 objects per iteration
+
+// Four objects' values for one matrix column, one register per row, turned
+// around into one register per object
+SIMD_TARGET("sse4.1")
+static inline void StoreColumnsSSE41(glm::mat4* out, int column, __m128 x, __m128 y, __m128 z, __m128 w) {
+  _MM_TRANSPOSE4_PS(x, y, z, w);
+  _mm_storeu_ps(&out[0][column][0], x);
+  _mm_storeu_ps(&out[1][column][0], y);
+  _mm_storeu_ps(&out[2][column][0], z);
+  _mm_storeu_ps(&out[3][column][0], w);
+}
+
+SIMD_TARGET("sse4.1")
+static void ComposeSSE41(int begin, int end, const TransformStreams& in, glm::mat4* out) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 zero = _mm_setzero_ps();
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128 x = _mm_loadu_ps(in.rotationX + i);
+    __m128 y = _mm_loadu_ps(in.rotationY + i);
+    __m128 z = _mm_loadu_ps(in.rotationZ + i);
+    __m128 w = _mm_loadu_ps(in.rotationW + i);
+    __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+    __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+    __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+    __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+    __m128 sx = _mm_loadu_ps(in.scaleX + i);
+    __m128 sy = _mm_loadu_ps(in.scaleY + i);
+    __m128 sz = _mm_loadu_ps(in.scaleZ + i);
+
+    StoreColumnsSSE41(out + i, 0,
+      _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx),
+      _mm_mul_ps(_mm_add_ps(xy, wz), sx),
+      _mm_mul_ps(_mm_sub_ps(xz, wy), sx),
+      zero);
+    StoreColumnsSSE41(out + i, 1,
+      _mm_mul_ps(_mm_sub_ps(xy, wz), sy),
+      _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy),
+      _mm_mul_ps(_mm_add_ps(yz, wx), sy),
+      zero);
+    StoreColumnsSSE41(out + i, 2,
+      _mm_mul_ps(_mm_add_ps(xz, wy), sz),
+      _mm_mul_ps(_mm_sub_ps(yz, wx), sz),
+      _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz),
+      zero);
+    StoreColumnsSSE41(out + i, 3,
+      _mm_loadu_ps(in.positionX + i),
+      _mm_loadu_ps(in.positionY + i),
+      _mm_loadu_ps(in.positionZ + i),
+      one);
+  }
+  ComposeScalar(i, end, in, out);
+}
+
+// Element (column, row) of four consecutive matrices
+SIMD_TARGET("sse4.1")
+static inline __m128 GatherSSE41(const glm::mat4* models, int column, int row) {
+  return _mm_setr_ps(models[0][column][row], models[1][column][row], models[2][column][row], models[3][column][row]);
+}
+
+SIMD_TARGET("sse4.1")
+static void NormalSSE41(int begin, int end, const glm::mat4* models, glm::mat3* out) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  alignas(16) float result[9][4];
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128 ax = GatherSSE41(models + i, 0, 0), ay = GatherSSE41(models + i, 0, 1), az = GatherSSE41(models + i, 0, 2);
+    __m128 bx = GatherSSE41(models + i, 1, 0), by = GatherSSE41(models + i, 1, 1), bz = GatherSSE41(models + i, 1, 2);
+    __m128 cx = GatherSSE41(models + i, 2, 0), cy = GatherSSE41(models + i, 2, 1), cz = GatherSSE41(models + i, 2, 2);
+
+    __m128 bcx = _mm_sub_ps(_mm_mul_ps(by, cz), _mm_mul_ps(bz, cy));
+    __m128 bcy = _mm_sub_ps(_mm_mul_ps(bz, cx), _mm_mul_ps(bx, cz));
+    __m128 bcz = _mm_sub_ps(_mm_mul_ps(bx, cy), _mm_mul_ps(by, cx));
+    __m128 cax = _mm_sub_ps(_mm_mul_ps(cy, az), _mm_mul_ps(cz, ay));
+    __m128 cay = _mm_sub_ps(_mm_mul_ps(cz, ax), _mm_mul_ps(cx, az));
+    __m128 caz = _mm_sub_ps(_mm_mul_ps(cx, ay), _mm_mul_ps(cy, ax));
+    __m128 abx = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+    __m128 aby = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+    __m128 abz = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bcx), _mm_mul_ps(ay, bcy)), _mm_mul_ps(az, bcz));
+    __m128 invDet = _mm_and_ps(_mm_cmpneq_ps(det, zero), _mm_div_ps(one, det));
+
+    _mm_store_ps(result[0], _mm_mul_ps(bcx, invDet));
+    _mm_store_ps(result[1], _mm_mul_ps(bcy, invDet));
+    _mm_store_ps(result[2], _mm_mul_ps(bcz, invDet));
+    _mm_store_ps(result[3], _mm_mul_ps(cax, invDet));
+    _mm_store_ps(result[4], _mm_mul_ps(cay, invDet));
+    _mm_store_ps(result[5], _mm_mul_ps(caz, invDet));
+    _mm_store_ps(result[6], _mm_mul_ps(abx, invDet));
+    _mm_store_ps(result[7], _mm_mul_ps(aby, invDet));
+    _mm_store_ps(result[8], _mm_mul_ps(abz, invDet));
+    for (int lane = 0; lane < 4; ++lane) {
+      out[i + lane] = glm::mat3(result[0][lane], result[1][lane], result[2][lane],
+                                result[3][lane], result[4][lane], result[5][lane],
+                                result[6][lane], result[7][lane], result[8][lane]);
+    }
+  }
+  NormalScalar(i, end, models, out);
+}
+
+SIMD_TARGET("sse4.1")
+static void BoundsSSE41(int begin, int end, const glm::mat4* models, const glm::vec3* localMin, const glm::vec3* localMax, glm::vec3* outMin, glm::vec3* outMax) {
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  alignas(16) float result[6][4];
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    // One box per lane
+    __m128 minX = _mm_setr_ps(localMin[i].x, localMin[i + 1].x, localMin[i + 2].x, localMin[i + 3].x);
+    __m128 minY = _mm_setr_ps(localMin[i].y, localMin[i + 1].y, localMin[i + 2].y, localMin[i + 3].y);
+    __m128 minZ = _mm_setr_ps(localMin[i].z, localMin[i + 1].z, localMin[i + 2].z, localMin[i + 3].z);
+    __m128 maxX = _mm_setr_ps(localMax[i].x, localMax[i + 1].x, localMax[i + 2].x, localMax[i + 3].x);
+    __m128 maxY = _mm_setr_ps(localMax[i].y, localMax[i + 1].y, localMax[i + 2].y, localMax[i + 3].y);
+    __m128 maxZ = _mm_setr_ps(localMax[i].z, localMax[i + 1].z, localMax[i + 2].z, localMax[i + 3].z);
+    __m128 centerX = _mm_mul_ps(_mm_add_ps(minX, maxX), half), extentX = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+    __m128 centerY = _mm_mul_ps(_mm_add_ps(minY, maxY), half), extentY = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+    __m128 centerZ = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half), extentZ = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+    for (int row = 0; row < 3; ++row) {
+      __m128 c0 = GatherSSE41(models + i, 0, row);
+      __m128 c1 = GatherSSE41(models + i, 1, row);
+      __m128 c2 = GatherSSE41(models + i, 2, row);
+      __m128 c3 = GatherSSE41(models + i, 3, row);
+      __m128 worldCenter = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+        _mm_mul_ps(c0, centerX), _mm_mul_ps(c1, centerY)), _mm_mul_ps(c2, centerZ)), c3);
+      __m128 worldExtent = _mm_add_ps(_mm_add_ps(
+        _mm_mul_ps(_mm_and_ps(c0, absMask), extentX),
+        _mm_mul_ps(_mm_and_ps(c1, absMask), extentY)),
+        _mm_mul_ps(_mm_and_ps(c2, absMask), extentZ));
+      _mm_store_ps(result[row], _mm_sub_ps(worldCenter, worldExtent));
+      _mm_store_ps(result[row + 3], _mm_add_ps(worldCenter, worldExtent));
+    }
+    for (int lane = 0; lane < 4; ++lane) {
+      outMin[i + lane] = glm::vec3(result[0][lane], result[1][lane], result[2][lane]);
+      outMax[i + lane] = glm::vec3(result[3][lane], result[4][lane], result[5][lane]);
+    }
+  }
+  BoundsScalar(i, end, models, localMin, localMax, outMin, outMax);
+}
+
+SIMD_TARGET("sse4.1")
+static void MultiplySSE41(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+  __m128 a0 = _mm_loadu_ps(&a[0][0]);
+  __m128 a1 = _mm_loadu_ps(&a[1][0]);
+  __m128 a2 = _mm_loadu_ps(&a[2][0]);
+  __m128 a3 = _mm_loadu_ps(&a[3][0]);
+  for (int column = 0; column < 4; ++column) {
+    __m128 bc = _mm_loadu_ps(&b[column][0]);
+    __m128 r = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(a0, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(0, 0, 0, 0))),
+                 _mm_mul_ps(a1, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(1, 1, 1, 1)))),
+      _mm_add_ps(_mm_mul_ps(a2, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(2, 2, 2, 2))),
+                 _mm_mul_ps(a3, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(3, 3, 3, 3)))));
+    _mm_storeu_ps(&out[column][0], r);
+  }
+}
+
+SIMD_TARGET("sse4.1")
+static void ParticlesSSE41(int begin, int end, const ParticleStreams& s, const ParticleParams& p) {
+  const __m128 dt = _mm_set1_ps(p.deltaTime);
+  const __m128 damping = _mm_set1_ps(std::max(0.0f, 1.0f - p.drag * p.deltaTime));
+  const __m128 dvx = _mm_set1_ps(p.gravity.x * p.deltaTime);
+  const __m128 dvy = _mm_set1_ps(p.gravity.y * p.deltaTime);
+  const __m128 dvz = _mm_set1_ps(p.gravity.z * p.deltaTime);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 startSize = _mm_set1_ps(p.startSize);
+  const __m128 sizeRange = _mm_set1_ps(p.endSize - p.startSize);
+  const __m128 startR = _mm_set1_ps(p.startColor.r), rangeR = _mm_set1_ps(p.endColor.r - p.startColor.r);
+  const __m128 startG = _mm_set1_ps(p.startColor.g), rangeG = _mm_set1_ps(p.endColor.g - p.startColor.g);
+  const __m128 startB = _mm_set1_ps(p.startColor.b), rangeB = _mm_set1_ps(p.endColor.b - p.startColor.b);
+  const __m128 startA = _mm_set1_ps(p.startColor.a), rangeA = _mm_set1_ps(p.endColor.a - p.startColor.a);
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128 vx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(s.velocityX + i), dvx), damping);
+    __m128 vy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(s.velocityY + i), dvy), damping);
+    __m128 vz = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(s.velocityZ + i), dvz), damping);
+    _mm_storeu_ps(s.velocityX + i, vx);
+    _mm_storeu_ps(s.velocityY + i, vy);
+    _mm_storeu_ps(s.velocityZ + i, vz);
+    _mm_storeu_ps(s.positionX + i, _mm_add_ps(_mm_loadu_ps(s.positionX + i), _mm_mul_ps(vx, dt)));
+    _mm_storeu_ps(s.positionY + i, _mm_add_ps(_mm_loadu_ps(s.positionY + i), _mm_mul_ps(vy, dt)));
+    _mm_storeu_ps(s.positionZ + i, _mm_add_ps(_mm_loadu_ps(s.positionZ + i), _mm_mul_ps(vz, dt)));
+
+    __m128 age = _mm_add_ps(_mm_loadu_ps(s.age + i), dt);
+    _mm_storeu_ps(s.age + i, age);
+    __m128 t = _mm_min_ps(_mm_mul_ps(age, _mm_loadu_ps(s.invLifetime + i)), one);
+    _mm_storeu_ps(s.size + i, _mm_add_ps(startSize, _mm_mul_ps(sizeRange, t)));
+    _mm_storeu_ps(s.colorR + i, _mm_add_ps(startR, _mm_mul_ps(rangeR, t)));
+    _mm_storeu_ps(s.colorG + i, _mm_add_ps(startG, _mm_mul_ps(rangeG, t)));
+    _mm_storeu_ps(s.colorB + i, _mm_add_ps(startB, _mm_mul_ps(rangeB, t)));
+    _mm_storeu_ps(s.colorA + i, _mm_add_ps(startA, _mm_mul_ps(rangeA, t)));
+  }
+  ParticlesScalar(i, end, s, p);
+}
+
+// AVX2: 8 objects per iteration
+
+// Like StoreColumnsSSE41, for 8 objects: each 128-bit half transposes on its
+// own, the low half holding objects 0-3 and the high half objects 4-7
+SIMD_TARGET("avx2")
+static inline void StoreColumnsAVX2(glm::mat4* out, int column, __m256 x, __m256 y, __m256 z, __m256 w) {
+  __m256 xy0 = _mm256_unpacklo_ps(x, y);
+  __m256 xy1 = _mm256_unpackhi_ps(x, y);
+  __m256 zw0 = _mm256_unpacklo_ps(z, w);
+  __m256 zw1 = _mm256_unpackhi_ps(z, w);
+  __m256 r0 = _mm256_shuffle_ps(xy0, zw0, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 r1 = _mm256_shuffle_ps(xy0, zw0, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 r2 = _mm256_shuffle_ps(xy1, zw1, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 r3 = _mm256_shuffle_ps(xy1, zw1, _MM_SHUFFLE(3, 2, 3, 2));
+  _mm_storeu_ps(&out[0][column][0], _mm256_castps256_ps128(r0));
+  _mm_storeu_ps(&out[1][column][0], _mm256_castps256_ps128(r1));
+  _mm_storeu_ps(&out[2][column][0], _mm256_castps256_ps128(r2));
+  _mm_storeu_ps(&out[3][column][0], _mm256_castps256_ps128(r3));
+  _mm_storeu_ps(&out[4][column][0], _mm256_extractf128_ps(r0, 1));
+  _mm_storeu_ps(&out[5][column][0], _mm256_extractf128_ps(r1, 1));
+  _mm_storeu_ps(&out[6][column][0], _mm256_extractf128_ps(r2, 1));
+  _mm_storeu_ps(&out[7][column][0], _mm256_extractf128_ps(r3, 1));
+}
+
+SIMD_TARGET("avx2")
+static void ComposeAVX2(int begin, int end, const TransformStreams& in, glm::mat4* out) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 zero = _mm256_setzero_ps();
+  int i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 x = _mm256_loadu_ps(in.rotationX + i);
+    __m256 y = _mm256_loadu_ps(in.rotationY + i);
+    __m256 z = _mm256_loadu_ps(in.rotationZ + i);
+    __m256 w = _mm256_loadu_ps(in.rotationW + i);
+    __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+    __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+    __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+    __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+    __m256 sx = _mm256_loadu_ps(in.scaleX + i);
+    __m256 sy = _mm256_loadu_ps(in.scaleY + i);
+    __m256 sz = _mm256_loadu_ps(in.scaleZ + i);
+
+    StoreColumnsAVX2(out + i, 0,
+      _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx),
+      _mm256_mul_ps(_mm256_add_ps(xy, wz), sx),
+      _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx),
+      zero);
+    StoreColumnsAVX2(out + i, 1,
+      _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy),
+      _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy),
+      _mm256_mul_ps(_mm256_add_ps(yz, wx), sy),
+      zero);
+    StoreColumnsAVX2(out + i, 2,
+      _mm256_mul_ps(_mm256_add_ps(xz, wy), sz),
+      _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz),
+      _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz),
+      zero);
+    StoreColumnsAVX2(out + i, 3,
+      _mm256_loadu_ps(in.positionX + i),
+      _mm256_loadu_ps(in.positionY + i),
+      _mm256_loadu_ps(in.positionZ + i),
+      one);
+  }
+  ComposeSSE41(i, end, in, out);
+}
+
+SIMD_TARGET("avx2")
+static void NormalAVX2(int begin, int end, const glm::mat4* models, glm::mat3* out) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  // Offsets of the same element in 8 consecutive matrices
+  const __m256i stride = _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112);
+  alignas(32) float result[9][8];
+  int i = begin;
+  for (; i + 8 <= end; i += 8) {
+    const float* base = &models[i][0][0];
+    __m256 ax = _mm256_i32gather_ps(base + 0, stride, 4), ay = _mm256_i32gather_ps(base + 1, stride, 4), az = _mm256_i32gather_ps(base + 2, stride, 4);
+    __m256 bx = _mm256_i32gather_ps(base + 4, stride, 4), by = _mm256_i32gather_ps(base + 5, stride, 4), bz = _mm256_i32gather_ps(base + 6, stride, 4);
+    __m256 cx = _mm256_i32gather_ps(base + 8, stride, 4), cy = _mm256_i32gather_ps(base + 9, stride, 4), cz = _mm256_i32gather_ps(base + 10, stride, 4);
+
+    __m256 bcx = _mm256_sub_ps(_mm256_mul_ps(by, cz), _mm256_mul_ps(bz, cy));
+    __m256 bcy = _mm256_sub_ps(_mm256_mul_ps(bz, cx), _mm256_mul_ps(bx, cz));
+    __m256 bcz = _mm256_sub_ps(_mm256_mul_ps(bx, cy), _mm256_mul_ps(by, cx));
+    __m256 cax = _mm256_sub_ps(_mm256_mul_ps(cy, az), _mm256_mul_ps(cz, ay));
+    __m256 cay = _mm256_sub_ps(_mm256_mul_ps(cz, ax), _mm256_mul_ps(cx, az));
+    __m256 caz = _mm256_sub_ps(_mm256_mul_ps(cx, ay), _mm256_mul_ps(cy, ax));
+    __m256 abx = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+    __m256 aby = _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz));
+    __m256 abz = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx));
+
+    __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bcx), _mm256_mul_ps(ay, bcy)), _mm256_mul_ps(az, bcz));
+    __m256 invDet = _mm256_and_ps(_mm256_cmp_ps(det, zero, _CMP_NEQ_UQ), _mm256_div_ps(one, det));
+
+    _mm256_store_ps(result[0], _mm256_mul_ps(bcx, invDet));
+    _mm256_store_ps(result[1], _mm256_mul_ps(bcy, invDet));
+    _mm256_store_ps(result[2], _mm256_mul_ps(bcz, invDet));
+    _mm256_store_ps(result[3], _mm256_mul_ps(cax, invDet));
+    _mm256_store_ps(result[4], _mm256_mul_ps(cay, invDet));
+    _mm256_store_ps(result[5], _mm256_mul_ps(caz, invDet));
+    _mm256_store_ps(result[6], _mm256_mul_ps(abx, invDet));
+    _mm256_store_ps(result[7], _mm256_mul_ps(aby, invDet));
+    _mm256_store_ps(result[8], _mm256_mul_ps(abz, invDet));
+    for (int lane = 0; lane < 8; ++lane) {
+      out[i + lane] = glm::mat3(result[0][lane], result[1][lane], result[2][lane],
+                                result[3][lane], result[4][lane], result[5][lane],
+                                result[6][lane], result[7][lane], result[8][lane]);
+    }
+  }
+  NormalSSE41(i, end, models, out);
+}
+
+SIMD_TARGET("avx2")
+static void BoundsAVX2(int begin, int end, const glm::mat4* models, const glm::vec3* localMin, const glm::vec3* localMax, glm::vec3* outMin, glm::vec3* outMax) {
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  // Offsets of the same element in 8 consecutive matrices / vectors
+  const __m256i matrixStride = _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112);
+  const __m256i vectorStride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+  alignas(32) float result[6][8];
+  int i = begin;
+  for (; i + 8 <= end; i += 8) {
+    // One box per lane
+    const float* lo = &localMin[i].x;
+    const float* hi = &localMax[i].x;
+    __m256 minX = _mm256_i32gather_ps(lo + 0, vectorStride, 4), maxX = _mm256_i32gather_ps(hi + 0, vectorStride, 4);
+    __m256 minY = _mm256_i32gather_ps(lo + 1, vectorStride, 4), maxY = _mm256_i32gather_ps(hi + 1, vectorStride, 4);
+    __m256 minZ = _mm256_i32gather_ps(lo + 2, vectorStride, 4), maxZ = _mm256_i32gather_ps(hi + 2, vectorStride, 4);
+    __m256 centerX = _mm256_mul_ps(_mm256_add_ps(minX, maxX), half), extentX = _mm256_mul_ps(_mm256_sub_ps(maxX, minX), half);
+    __m256 centerY = _mm256_mul_ps(_mm256_add_ps(minY, maxY), half), extentY = _mm256_mul_ps(_mm256_sub_ps(maxY, minY), half);
+    __m256 centerZ = _mm256_mul_ps(_mm256_add_ps(minZ, maxZ), half), extentZ = _mm256_mul_ps(_mm256_sub_ps(maxZ, minZ), half);
+
+    const float* base = &models[i][0][0];
+    for (int row = 0; row < 3; ++row) {
+      __m256 c0 = _mm256_i32gather_ps(base + row, matrixStride, 4);
+      __m256 c1 = _mm256_i32gather_ps(base + 4 + row, matrixStride, 4);
+      __m256 c2 = _mm256_i32gather_ps(base + 8 + row, matrixStride, 4);
+      __m256 c3 = _mm256_i32gather_ps(base + 12 + row, matrixStride, 4);
+      __m256 worldCenter = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+        _mm256_mul_ps(c0, centerX), _mm256_mul_ps(c1, centerY)), _mm256_mul_ps(c2, centerZ)), c3);
+      __m256 worldExtent = _mm256_add_ps(_mm256_add_ps(
+        _mm256_mul_ps(_mm256_and_ps(c0, absMask), extentX),
+        _mm256_mul_ps(_mm256_and_ps(c1, absMask), extentY)),
+        _mm256_mul_ps(_mm256_and_ps(c2, absMask), extentZ));
+      _mm256_store_ps(result[row], _mm256_sub_ps(worldCenter, worldExtent));
+      _mm256_store_ps(result[row + 3], _mm256_add_ps(worldCenter, worldExtent));
+    }
+    for (int lane = 0; lane < 8; ++lane) {
+      outMin[i + lane] = glm::vec3(result[0][lane], result[1][lane], result[2][lane]);
+      outMax[i + lane] = glm::vec3(result[3][lane], result[4][lane], result[5][lane]);
+    }
+  }
+  BoundsSSE41(i, end, models, localMin, localMax, outMin, outMax);
+}
+
+SIMD_TARGET("avx2")
+static void ParticlesAVX2(int begin, int end, const ParticleStreams& s, const ParticleParams& p) {
+  const __m256 dt = _mm256_set1_ps(p.deltaTime);
+  const __m256 damping = _mm256_set1_ps(std::max(0.0f, 1.0f - p.drag * p.deltaTime));
+  const __m256 dvx = _mm256_set1_ps(p.gravity.x * p.deltaTime);
+  const __m256 dvy = _mm256_set1_ps(p.gravity.y * p.deltaTime);
+  const __m256 dvz = _mm256_set1_ps(p.gravity.z * p.deltaTime);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 startSize = _mm256_set1_ps(p.startSize);
+  const __m256 sizeRange = _mm256_set1_ps(p.endSize - p.startSize);
+  const __m256 startR = _mm256_set1_ps(p.startColor.r), rangeR = _mm256_set1_ps(p.endColor.r - p.startColor.r);
+  const __m256 startG = _mm256_set1_ps(p.startColor.g), rangeG = _mm256_set1_ps(p.endColor.g - p.startColor.g);
+  const __m256 startB = _mm256_set1_ps(p.startColor.b), rangeB = _mm256_set1_ps(p.endColor.b - p.startColor.b);
+  const __m256 startA = _mm256_set1_ps(p.startColor.a), rangeA = _mm256_set1_ps(p.endColor.a - p.startColor.a);
+  int i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 vx = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(s.velocityX + i), dvx), damping);
+    __m256 vy = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(s.velocityY + i), dvy), damping);
+    __m256 vz = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(s.velocityZ + i), dvz), damping);
+    _mm256_storeu_ps(s.velocityX + i, vx);
+    _mm256_storeu_ps(s.velocityY + i, vy);
+    _mm256_storeu_ps(s.velocityZ + i, vz);
+    _mm256_storeu_ps(s.positionX + i, _mm256_add_ps(_mm256_loadu_ps(s.positionX + i), _mm256_mul_ps(vx, dt)));
+    _mm256_storeu_ps(s.positionY + i, _mm256_add_ps(_mm256_loadu_ps(s.positionY + i), _mm256_mul_ps(vy, dt)));
+    _mm256_storeu_ps(s.positionZ + i, _mm256_add_ps(_mm256_loadu_ps(s.positionZ + i), _mm256_mul_ps(vz, dt)));
+
+    __m256 age = _mm256_add_ps(_mm256_loadu_ps(s.age + i), dt);
+    _mm256_storeu_ps(s.age + i, age);
+    __m256 t = _mm256_min_ps(_mm256_mul_ps(age, _mm256_loadu_ps(s.invLifetime + i)), one);
+    _mm256_storeu_ps(s.size + i, _mm256_add_ps(startSize, _mm256_mul_ps(sizeRange, t)));
+    _mm256_storeu_ps(s.colorR + i, _mm256_add_ps(startR, _mm256_mul_ps(rangeR, t)));
+    _mm256_storeu_ps(s.colorG + i, _mm256_add_ps(startG, _mm256_mul_ps(rangeG, t)));
+    _mm256_storeu_ps(s.colorB + i, _mm256_add_ps(startB, _mm256_mul_ps(rangeB, t)));
+    _mm256_storeu_ps(s.colorA + i, _mm256_add_ps(startA, _mm256_mul_ps(rangeA, t)));
+  }
+  ParticlesSSE41(i, end, s, p);
+}
+
+// AVX2: 8 pixels per iteration, the same edge and depth math as SSE2
+SIMD_TARGET("avx2")
+static void RasterAVX2(const DepthTriangle& t, int minX, int maxX, int minY, int maxY, float* depth, int stride) {
+  const __m256 laneOffsets = _mm256_set_ps(7.5f, 6.5f, 5.5f, 4.5f, 3.5f, 2.5f, 1.5f, 0.5f);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 a0 = _mm256_set1_ps(t.a[0]), a1 = _mm256_set1_ps(t.a[1]), a2 = _mm256_set1_ps(t.a[2]), zA = _mm256_set1_ps(t.zA);
+  int startX = minX & ~7;
+
+  for (int y = minY; y <= maxY; ++y) {
+    float py = y + 0.5f;
+    __m256 row0 = _mm256_set1_ps(t.b[0] * py + t.c[0]);
+    __m256 row1 = _mm256_set1_ps(t.b[1] * py + t.c[1]);
+    __m256 row2 = _mm256_set1_ps(t.b[2] * py + t.c[2]);
+    __m256 rowZ = _mm256_set1_ps(t.zB * py + t.zC);
+    float* dst = depth + static_cast<size_t>(y) * stride;
+
+    for (int x = startX; x <= maxX; x += 8) {
+      __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneOffsets);
+      __m256 e0 = _mm256_add_ps(_mm256_mul_ps(a0, px), row0);
+      __m256 e1 = _mm256_add_ps(_mm256_mul_ps(a1, px), row1);
+      __m256 e2 = _mm256_add_ps(_mm256_mul_ps(a2, px), row2);
+      __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)), _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+      if (_mm256_movemask_ps(inside) == 0) {
+        continue;
+      }
+
+      __m256 z = _mm256_add_ps(_mm256_mul_ps(zA, px), rowZ);
+      __m256 current = _mm256_loadu_ps(dst + x);
+      _mm256_storeu_ps(dst + x, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+    }
+  }
+}
+
+#endif // SIMD_X86
+
+#if defined(SIMD_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+static const RasterFn rasterBaseline = RasterSSE2;
+#else
+static const RasterFn rasterBaseline = RasterScalar;
+#endif
+
+static ComposeFn composeImpl = ComposeScalar;
+static NormalFn normalImpl = NormalScalar;
+static BoundsFn boundsImpl = BoundsScalar;
+static MultiplyFn multiplyImpl = MultiplyScalar;
+static ParticleFn particleImpl = ParticlesScalar;
+static RasterFn rasterImpl = rasterBaseline;
+
+static bool IsSupported(SimdMath::Level level) {
+#ifdef SIMD_X86
+  switch (level) {
+    case SimdMath::Level::AVX2:
+      return SDL_HasAVX2() && SDL_HasSSE41();
+    case SimdMath::Level::SSE41:
+      return SDL_HasSSE41();
+    default:
+      return true;
+  }
+#else
+  return level == SimdMath::Level::Scalar;
+#endif
+}
+
+void SimdMath::Init(const std::string& requested) {
+  Level best = IsSupported(Level::AVX2) ? Level::AVX2 : IsSupported(Level::SSE41) ? Level::SSE41 : Level::Scalar;
+  Level chosen = best;
+  if (requested == "scalar") {
+    chosen = Level::Scalar;
+  } else if (requested == "sse4.1") {
+    chosen = Level::SSE41;
+  } else if (requested == "avx2") {
+    chosen = Level::AVX2;
+  } else if (requested != "auto") {
+    std::cout << "Unknown simd level " << requested << ", using auto" << std::endl;
+  }
+
+  if (!IsSupported(chosen)) {
+    std::cout << GetLevelName(chosen) << " not supported by this CPU, using " << GetLevelName(best) << std::endl;
+    chosen = best;
+  }
+  SelectLevel(chosen);
+}
+
+void SimdMath::SelectLevel(Level newLevel) {
+  level = newLevel;
+  composeImpl = ComposeScalar;
+  normalImpl = NormalScalar;
+  boundsImpl = BoundsScalar;
+  multiplyImpl = MultiplyScalar;
+  particleImpl = ParticlesScalar;
+  rasterImpl = rasterBaseline;
+#ifdef SIMD_X86
+  if (level == Level::SSE41) {
+    composeImpl = ComposeSSE41;
+    normalImpl = NormalSSE41;
+    boundsImpl = BoundsSSE41;
+    multiplyImpl = MultiplySSE41;
+    particleImpl = ParticlesSSE41;
+  } else if (level == Level::AVX2) {
+    composeImpl = ComposeAVX2;
+    normalImpl = NormalAVX2;
+    boundsImpl = BoundsAVX2;
+    multiplyImpl = MultiplySSE41;
+    particleImpl = ParticlesAVX2;
+    rasterImpl = RasterAVX2;
+  }
+#endif
+}
+
+SimdMath::Level SimdMath::GetLevel() {
+  return level;
+}
+
+const char* SimdMath::GetLevelName(Level level) {
+  switch (level) {
+    case Level::AVX2:
+      return "avx2";
+    case Level::SSE41:
+      return "sse4.1";
+    default:
+      return "scalar";
+  }
+}
+
+void SimdMath::ComposeTRS(int count, const TransformStreams& in, glm::mat4* out) {
+  composeImpl(0, count, in, out);
+}
+
+void SimdMath::NormalMatrices(int count, const glm::mat4* models, glm::mat3* out) {
+  normalImpl(0, count, models, out);
+}
+
+void SimdMath::TransformBounds(int count, const glm::mat4* models, const glm::vec3* localMin, const glm::vec3* localMax, glm::vec3* outMin, glm::vec3* outMax) {
+  boundsImpl(0, count, models, localMin, localMax, outMin, outMax);
+}
+
+void SimdMath::Multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+  multiplyImpl(a, b, out);
+}
+
+void SimdMath::IntegrateParticles(int begin, int end, const ParticleStreams& streams, const ParticleParams& params) {
+  particleImpl(begin, end, streams, params);
+}
+
+void SimdMath::RasterizeDepth(const DepthTriangle& tri, int minX, int maxX, int minY, int maxY, float* depth, int stride) {
+  rasterImpl(tri, minX, maxX, minY, maxY, depth, stride);
+}
+
+glm::quat SimdMath::EulerToQuat(const glm::vec3& degrees) {
+  glm::vec3 half = glm::radians(degrees) * 0.5f;
+  glm::quat qx(std::cos(half.x), std::sin(half.x), 0.0f, 0.0f);
+  glm::quat qy(std::cos(half.y), 0.0f, std::sin(half.y), 0.0f);
+  glm::quat qz(std::cos(half.z), 0.0f, 0.0f, std::sin(half.z));
+  return qx * qy * qz;
+}
+
+// Benchmarks
+
+static volatile float benchmarkSink;
+
+// Best of several runs, in nanoseconds per object
+static double TimePerObject(int count, const std::function<void()>& run) {
+  const int runs = 20;
+  double best = 1e30;
+  for (int r = 0; r < runs; ++r) {
+    auto start = std::chrono::high_resolution_clock::now();
+    run();
+    auto end = std::chrono::high_resolution_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+  }
+  return best / count;
+}
+
+void SimdMath::RunBenchmarks(int count) {
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> positionDist(-50.0f, 50.0f);
+  std::uniform_real_distribution<float> angleDist(-180.0f, 180.0f);
+  std::uniform_real_distribution<float> scaleDist(0.25f, 4.0f);
+
+  std::vector<glm::vec3> positions(count), rotations(count), scales(count);
+  std::vector<float> px(count), py(count), pz(count), qx(count), qy(count), qz(count), qw(count), sx(count), sy(count), sz(count);
+  std::vector<glm::vec3> localMin(count, glm::vec3(-1.0f)), localMax(count, glm::vec3(1.0f));
+  for (int i = 0; i < count; ++i) {
+    positions[i] = glm::vec3(positionDist(rng), positionDist(rng), positionDist(rng));
+    rotations[i] = glm::vec3(angleDist(rng), angleDist(rng), angleDist(rng));
+    scales[i] = glm::vec3(scaleDist(rng), scaleDist(rng), scaleDist(rng));
+    glm::quat q = EulerToQuat(rotations[i]);
+    px[i] = positions[i].x; py[i] = positions[i].y; pz[i] = positions[i].z;
+    qx[i] = q.x; qy[i] = q.y; qz[i] = q.z; qw[i] = q.w;
+    sx[i] = scales[i].x; sy[i] = scales[i].y; sz[i] = scales[i].z;
+  }
+  TransformStreams streams = { px.data(), py.data(), pz.data(), qx.data(), qy.data(), qz.data(), qw.data(), sx.data(), sy.data(), sz.data() };
+
+  std::vector<glm::mat4> reference(count), models(count);
+  std::vector<glm::mat3> normals(count);
+  std::vector<glm::vec3> boundsMin(count), boundsMax(count);
+
+  // What the engine did before: a glm call per step, per object
+  double glmCompose = TimePerObject(count, [&]() {
+    for (int i = 0; i < count; ++i) {
+      glm::mat4 m = glm::translate(glm::mat4(1.0f), positions[i]);
+      m = glm::rotate(m, glm::radians(rotations[i].x), glm::vec3(1.0f, 0.0f, 0.0f));
+      m = glm::rotate(m, glm::radians(rotations[i].y), glm::vec3(0.0f, 1.0f, 0.0f));
+      m = glm::rotate(m, glm::radians(rotations[i].z), glm::vec3(0.0f, 0.0f, 1.0f));
+      reference[i] = glm::scale(m, scales[i]);
+    }
+  });
+  double glmNormal = TimePerObject(count, [&]() {
+    for (int i = 0; i < count; ++i) {
+      normals[i] = glm::transpose(glm::inverse(glm::mat3(reference[i])));
+    }
+  });
+  double glmBounds = TimePerObject(count, [&]() {
+    for (int i = 0; i < count; ++i) {
+      glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+      for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 local((corner & 1) ? localMax[i].x : localMin[i].x, (corner & 2) ? localMax[i].y : localMin[i].y, (corner & 4) ? localMax[i].z : localMin[i].z);
+        glm::vec3 world = glm::vec3(reference[i] * glm::vec4(local, 1.0f));
+        lo = glm::min(lo, world);
+        hi = glm::max(hi, world);
+      }
+      boundsMin[i] = lo;
+      boundsMax[i] = hi;
+    }
+  });
+  benchmarkSink = normals[count / 2][1][1] + boundsMin[count / 2].x;
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "simd benchmark, " << count << " objects, ns per object (compose / normal / bounds)" << std::endl;
+  std::cout << "  glm     " << glmCompose << " / " << glmNormal << " / " << glmBounds << std::endl;
+
+  Level selected = level;
+  for (Level candidate : { Level::Scalar, Level::SSE41, Level::AVX2 }) {
+    if (!IsSupported(candidate)) {
+      continue;
+    }
+    SelectLevel(candidate);
+    double compose = TimePerObject(count, [&]() { ComposeTRS(count, streams, models.data()); });
+    double normal = TimePerObject(count, [&]() { NormalMatrices(count, models.data(), normals.data()); });
+    double bounds = TimePerObject(count, [&]() { TransformBounds(count, models.data(), localMin.data(), localMax.data(), boundsMin.data(), boundsMax.data()); });
+    benchmarkSink = normals[count / 2][1][1] + boundsMin[count / 2].x;
+
+    // Largest difference from the glm matrices, to catch a broken kernel
+    float maxError = 0.0f;
+    for (int i = 0; i < count; ++i) {
+      for (int column = 0; column < 4; ++column) {
+        maxError = std::max(maxError, glm::length(models[i][column] - reference[i][column]));
+      }
+    }
+    std::cout << "  " << std::left << std::setw(8) << GetLevelName(candidate) << std::right
+              << compose << " / " << normal << " / " << bounds
+              << "  (max error " << std::scientific << maxError << std::fixed << ")" << std::endl;
+  }
+  SelectLevel(selected);
+  std::cout.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,348 @@
+#include "SoftwareOcclusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "SimdMath.h"
+
+// Buffers are processed in 8x8 pixel tiles
+static const int TILE_SIZE = 8;
+// Anything closer than this to the eye is treated as crossing the near plane
+static const float NEAR_W = 1e-4f;
+// How far, in depth buffer pixels, the camera may move the occluders on screen
+// before a frame old async depth buffer is no longer trusted
+static const float MAX_CAMERA_SHIFT = static_cast<float>(TILE_SIZE);
+
+std::atomic<bool> SoftwareOcclusion::enabled(false);
+bool SoftwareOcclusion::async = true;
+int SoftwareOcclusion::width = 0;
+int SoftwareOcclusion::height = 0;
+int SoftwareOcclusion::tilesX = 0;
+int SoftwareOcclusion::tilesY = 0;
+
+std::vector<float> SoftwareOcclusion::depth;
+std::vector<float> SoftwareOcclusion::tileMaxDepth;
+
+glm::mat4 SoftwareOcclusion::viewProjection(1.0f);
+
+std::vector<SoftwareOcclusion::Occluder> SoftwareOcclusion::pendingOccluders;
+glm::mat4 SoftwareOcclusion::pendingViewProjection(1.0f);
+
+glm::mat4 SoftwareOcclusion::rasterViewProjection(1.0f);
+bool SoftwareOcclusion::hasDepth = false;
+
+std::shared_ptr<JobCounter> SoftwareOcclusion::rasterJob = nullptr;
+std::unordered_set<std::string> SoftwareOcclusion::occluderModels;
+SoftwareOcclusion::Stats SoftwareOcclusion::stats;
+
+// Written by the raster job, copied into stats once it has been waited on
+static int rasterTriangleCount = 0;
+static float rasterTime = 0.0f;
+static float rasterNearestDepth = 1.0f;
+
+void SoftwareOcclusion::Init(bool enable, bool runAsync, int w, int h) {
+  enabled = enable;
+  async = runAsync;
+
+  // Whole tiles only, which also keeps every SIMD row access in bounds
+  tilesX = std::max(1, (w + TILE_SIZE - 1) / TILE_SIZE);
+  tilesY = std::max(1, (h + TILE_SIZE - 1) / TILE_SIZE);
+  width = tilesX * TILE_SIZE;
+  height = tilesY * TILE_SIZE;
+
+  depth.assign(static_cast<size_t>(width) * height, 1.0f);
+  tileMaxDepth.assign(static_cast<size_t>(tilesX) * tilesY, 1.0f);
+  hasDepth = false;
+}
+
+void SoftwareOcclusion::Shutdown() {
+  JobSystem::Wait(rasterJob);
+  rasterJob = nullptr;
+  pendingOccluders.clear();
+  hasDepth = false;
+}
+
+void SoftwareOcclusion::SetEnabled(bool enable) {
+  enabled = enable;
+}
+
+bool SoftwareOcclusion::IsEnabled() {
+  return enabled;
+}
+
+void SoftwareOcclusion::SetOccluderModel(const std::string& name) {
+  occluderModels.insert(name);
+}
+
+bool SoftwareOcclusion::IsOccluderModel(const std::string& name) {
+  return occluderModels.find(name) != occluderModels.end();
+}
+
+void SoftwareOcclusion::SetCamera(const glm::mat4& vp) {
+  viewProjection = vp;
+}
+
+void SoftwareOcclusion::Cull(const std::vector<std::shared_ptr<GameObject>>& queue, std::vector<std::shared_ptr<GameObject>>& outVisible) {
+  if (!async) {
+    GatherOccluders(queue);
+    Kick();
+  }
+
+  // Async: this is the job kicked last frame, which ran during this frame's scripts
+  JobSystem::Wait(rasterJob);
+  rasterJob = nullptr;
+  stats.triangles = rasterTriangleCount;
+  stats.rasterMs = rasterTime;
+
+  stats.objectsTested = static_cast<int>(queue.size());
+  stats.objectsCulled = 0;
+
+  // A fast camera move would test this frame's objects against occluders that
+  // have since moved on screen, so everything is drawn until the buffer catches up
+  if (!hasDepth || (async && CameraMoved())) {
+    outVisible = queue;
+  } else {
+    // Test in chunks on the workers, each object writes only its own flag
+    const int chunkSize = 64;
+    int chunks = static_cast<int>((queue.size() + chunkSize - 1) / chunkSize);
+    std::vector<char> visible(queue.size(), 1);
+    glm::mat4 testViewProjection = rasterViewProjection;
+
+    JobSystem::ParallelFor(chunks, [&](int chunk) {
+      size_t begin = static_cast<size_t>(chunk) * chunkSize;
+      size_t end = std::min(queue.size(), begin + chunkSize);
+      for (size_t i = begin; i < end; ++i) {
+        glm::vec3 boundsMin, boundsMax;
+        queue[i]->GetWorldBounds(boundsMin, boundsMax);
+        visible[i] = IsVisible(boundsMin, boundsMax, testViewProjection);
+      }
+    });
+
+    outVisible.clear();
+    outVisible.reserve(queue.size());
+    for (size_t i = 0; i < queue.size(); ++i) {
+      if (visible[i]) {
+        outVisible.push_back(queue[i]);
+      } else {
+        ++stats.objectsCulled;
+      }
+    }
+  }
+
+  if (async) {
+    GatherOccluders(queue);
+    Kick();
+  }
+}
+
+void SoftwareOcclusion::GatherOccluders(const std::vector<std::shared_ptr<GameObject>>& queue) {
+  pendingOccluders.clear();
+  for (const auto& gameObject : queue) {
+    if (gameObject->isOccluder && gameObject->model && gameObject->model->occluderTriangles) {
+      pendingOccluders.push_back({ gameObject->model->occluderTriangles, gameObject->GetDrawMatrix() });
+    }
+  }
+  pendingViewProjection = viewProjection;
+  stats.occluders = static_cast<int>(pendingOccluders.size());
+}
+
+void SoftwareOcclusion::Kick() {
+  // The job owns the depth buffer until it's waited on
+  rasterViewProjection = pendingViewProjection;
+  rasterJob = JobSystem::Dispatch(1, [](int) {
+    Rasterize();
+  });
+}
+
+void SoftwareOcclusion::Rasterize() {
+  auto start = std::chrono::high_resolution_clock::now();
+
+  // Transform every occluder to screen space, one job per occluder
+  std::vector<std::vector<ScreenTriangle>> transformed(pendingOccluders.size());
+  JobSystem::ParallelFor(static_cast<int>(pendingOccluders.size()), [&](int index) {
+    const Occluder& occluder = pendingOccluders[index];
+    glm::mat4 mvp = rasterViewProjection * occluder.model;
+    const std::vector<glm::vec3>& triangles = *occluder.triangles;
+    std::vector<ScreenTriangle>& out = transformed[index];
+    out.reserve(triangles.size() / 3);
+
+    for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+      ScreenTriangle tri;
+      bool clipped = false;
+      for (int j = 0; j < 3; ++j) {
+        glm::vec4 clip = mvp * glm::vec4(triangles[i + j], 1.0f);
+        // Triangles crossing the near plane are dropped, which only makes
+        // the buffer less occluding, never wrong
+        if (clip.w < NEAR_W) {
+          clipped = true;
+          break;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        tri.v[j] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+      }
+      if (!clipped) {
+        out.push_back(tri);
+      }
+    }
+  });
+
+  int triangleCount = 0;
+  for (const auto& list : transformed) {
+    triangleCount += static_cast<int>(list.size());
+  }
+
+  // Each job owns a band of whole tile rows, so no two jobs touch the same pixels
+  int bands = std::min(tilesY, JobSystem::GetWorkerCount() + 1);
+  std::vector<float> bandNearestDepth(bands, 1.0f);
+  JobSystem::ParallelFor(bands, [&](int band) {
+    int tileRowBegin = tilesY * band / bands;
+    int tileRowEnd = tilesY * (band + 1) / bands;
+    int rowBegin = tileRowBegin * TILE_SIZE;
+    int rowEnd = tileRowEnd * TILE_SIZE;
+
+    std::fill(depth.begin() + static_cast<size_t>(rowBegin) * width, depth.begin() + static_cast<size_t>(rowEnd) * width, 1.0f);
+
+    for (const auto& list : transformed) {
+      for (const auto& tri : list) {
+        RasterizeTriangle(tri, rowBegin, rowEnd);
+      }
+    }
+
+    // Farthest occluder depth per tile, for the quick reject in IsVisible
+    float nearestDepth = 1.0f;
+    for (int ty = tileRowBegin; ty < tileRowEnd; ++ty) {
+      for (int tx = 0; tx < tilesX; ++tx) {
+        float maxDepth = 0.0f;
+        for (int y = ty * TILE_SIZE; y < (ty + 1) * TILE_SIZE; ++y) {
+          const float* row = &depth[static_cast<size_t>(y) * width + tx * TILE_SIZE];
+          for (int x = 0; x < TILE_SIZE; ++x) {
+            maxDepth = std::max(maxDepth, row[x]);
+            nearestDepth = std::min(nearestDepth, row[x]);
+          }
+        }
+        tileMaxDepth[static_cast<size_t>(ty) * tilesX + tx] = maxDepth;
+      }
+    }
+    bandNearestDepth[band] = nearestDepth;
+  });
+
+  hasDepth = true;
+  rasterTriangleCount = triangleCount;
+  rasterNearestDepth = *std::min_element(bandNearestDepth.begin(), bandNearestDepth.end());
+  rasterTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void SoftwareOcclusion::RasterizeTriangle(const ScreenTriangle& tri, int rowBegin, int rowEnd) {
+  glm::vec3 v0 = tri.v[0];
+  glm::vec3 v1 = tri.v[1];
+  glm::vec3 v2 = tri.v[2];
+
+  float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+  if (std::abs(area) < 1e-8f) {
+    return;
+  }
+  // Occluders are two sided, make the winding counter-clockwise
+  if (area < 0.0f) {
+    std::swap(v1, v2);
+    area = -area;
+  }
+
+  int minX = std::max(0, static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x }))));
+  int maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x }))));
+  int minY = std::max(rowBegin, static_cast<int>(std::floor(std::min({ v0.y, v1.y, v2.y }))));
+  int maxY = std::min(rowEnd - 1, static_cast<int>(std::ceil(std::max({ v0.y, v1.y, v2.y }))));
+  if (minX > maxX || minY > maxY) {
+    return;
+  }
+
+  // Edge functions E(x, y) = A * x + B * y + C, positive inside
+  DepthTriangle setup;
+  setup.a[0] = v1.y - v2.y; setup.b[0] = v2.x - v1.x; setup.c[0] = v1.x * v2.y - v1.y * v2.x;
+  setup.a[1] = v2.y - v0.y; setup.b[1] = v0.x - v2.x; setup.c[1] = v2.x * v0.y - v2.y * v0.x;
+  setup.a[2] = v0.y - v1.y; setup.b[2] = v1.x - v0.x; setup.c[2] = v0.x * v1.y - v0.y * v1.x;
+
+  // Depth is linear in screen space: z = zA * x + zB * y + zC
+  float invArea = 1.0f / area;
+  setup.zA = (setup.a[0] * v0.z + setup.a[1] * v1.z + setup.a[2] * v2.z) * invArea;
+  setup.zB = (setup.b[0] * v0.z + setup.b[1] * v1.z + setup.b[2] * v2.z) * invArea;
+  setup.zC = (setup.c[0] * v0.z + setup.c[1] * v1.z + setup.c[2] * v2.z) * invArea;
+
+  // Rows are whole tiles wide, which keeps every 8 pixel group in bounds
+  SimdMath::RasterizeDepth(setup, minX, maxX, minY, maxY, depth.data(), width);
+}
+
+bool SoftwareOcclusion::CameraMoved() {
+  // Reproject the corners and center of the buffer at the nearest occluder,
+  // which a camera move shifts the most, from the raster camera into this one
+  glm::mat4 reproject = viewProjection * glm::inverse(rasterViewProjection);
+  float ndcZ = rasterNearestDepth * 2.0f - 1.0f;
+  const glm::vec2 samples[5] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { -1.0f, 1.0f }, { 1.0f, 1.0f }, { 0.0f, 0.0f } };
+  for (const glm::vec2& sample : samples) {
+    glm::vec4 clip = reproject * glm::vec4(sample, ndcZ, 1.0f);
+    if (clip.w <= 0.0f) {
+      return true; // now behind the camera
+    }
+    glm::vec2 shift = (glm::vec2(clip) / clip.w - sample) * 0.5f * glm::vec2(width, height);
+    if (std::max(std::abs(shift.x), std::abs(shift.y)) > MAX_CAMERA_SHIFT) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SoftwareOcclusion::IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& vp) {
+  // Screen rectangle and nearest depth of the box
+  glm::vec2 rectMin(1e30f), rectMax(-1e30f);
+  float nearestZ = 1.0f;
+  for (int i = 0; i < 8; ++i) {
+    glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+    glm::vec4 clip = vp * glm::vec4(corner, 1.0f);
+    if (clip.w < NEAR_W) {
+      return true; // crosses the near plane
+    }
+    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    glm::vec2 screen((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height);
+    rectMin = glm::min(rectMin, screen);
+    rectMax = glm::max(rectMax, screen);
+    nearestZ = std::min(nearestZ, ndc.z * 0.5f + 0.5f);
+  }
+
+  // Off-screen objects are left to the GPU, this only answers "is it hidden"
+  int x0 = std::max(0, static_cast<int>(std::floor(rectMin.x)));
+  int x1 = std::min(width - 1, static_cast<int>(std::floor(rectMax.x)));
+  int y0 = std::max(0, static_cast<int>(std::floor(rectMin.y)));
+  int y1 = std::min(height - 1, static_cast<int>(std::floor(rectMax.y)));
+  if (x0 > x1 || y0 > y1) {
+    return true;
+  }
+
+  for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ++ty) {
+    for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; ++tx) {
+      // Every occluder in the tile is in front of the box
+      if (tileMaxDepth[static_cast<size_t>(ty) * tilesX + tx] < nearestZ) {
+        continue;
+      }
+
+      int px0 = std::max(x0, tx * TILE_SIZE), px1 = std::min(x1, (tx + 1) * TILE_SIZE - 1);
+      int py0 = std::max(y0, ty * TILE_SIZE), py1 = std::min(y1, (ty + 1) * TILE_SIZE - 1);
+      for (int y = py0; y <= py1; ++y) {
+        const float* row = &depth[static_cast<size_t>(y) * width];
+        for (int x = px0; x <= px1; ++x) {
+          if (row[x] >= nearestZ) {
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+const SoftwareOcclusion::Stats& SoftwareOcclusion::GetStats() {
+  return stats;
+}
+
+int SoftwareOcclusion::GetCulledCount() {
+  return stats.objectsCulled;
+}
@@ -0,0 +1,193 @@
+#include "StreamBuffer.h"
+#include "GLExtensions.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// How long a stalled write waits between checks, in nanoseconds
+static const GLuint64 STALL_WAIT_NS = 1000000;
+// Set once persistent mapping has failed, so later buffers don't retry it
+static bool persistentFailed = false;
+
+std::vector<StreamBuffer*> StreamBuffer::buffers;
+StreamBuffer::Stats StreamBuffer::retired;
+std::mutex StreamBuffer::publishedMutex;
+StreamBuffer::Stats StreamBuffer::published;
+
+static void AddStats(StreamBuffer::Stats& total, const StreamBuffer::Stats& stats) {
+  total.bytesWritten += stats.bytesWritten;
+  total.stalls += stats.stalls;
+  total.stallMs += stats.stallMs;
+  total.orphans += stats.orphans;
+  total.grows += stats.grows;
+}
+
+StreamBuffer::StreamBuffer(GLenum target, size_t segmentSize) : target(target), segmentSize(segmentSize) {
+  buffers.push_back(this);
+}
+
+StreamBuffer::~StreamBuffer() {
+  Release();
+  AddStats(retired, stats);
+  buffers.erase(std::remove(buffers.begin(), buffers.end(), this), buffers.end());
+}
+
+void StreamBuffer::Allocate(size_t newSegmentSize) {
+  Release();
+  segmentSize = newSegmentSize;
+  segment = 0;
+  cursor = 0;
+
+  glGenBuffers(1, &buffer);
+  glBindBuffer(target, buffer);
+  GLsizeiptr size = static_cast<GLsizeiptr>(segmentSize * SEGMENTS);
+  if (GLExtensions::bufferStorage && !persistentFailed) {
+    // Don't pin someone else's error on the storage call
+    for (int i = 0; i < 16 && glGetError() != GL_NO_ERROR; ++i) {}
+    // Flushed by hand, so the driver doesn't have to keep it coherent. The
+    // storage itself only takes the access bits; flushing is a map option.
+    GLbitfield storageFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT;
+    GLExtensions::BufferStorage(target, size, nullptr, storageFlags);
+    GLenum error = glGetError();
+    if (error == GL_NO_ERROR) {
+      mapped = static_cast<uint8_t*>(glMapBufferRange(target, 0, size, storageFlags | GL_MAP_FLUSH_EXPLICIT_BIT));
+      error = glGetError();
+    }
+    if (!mapped) {
+      // Immutable storage can't be respecified, so start over with a plain buffer
+      std::cerr << "Persistent mapping failed with 0x" << std::hex << error << std::dec << "; streaming without it" << std::endl;
+      glDeleteBuffers(1, &buffer);
+      glGenBuffers(1, &buffer);
+      glBindBuffer(target, buffer);
+      persistentFailed = true;
+    }
+  }
+  if (!mapped) {
+    glBufferData(target, size, nullptr, GL_STREAM_DRAW);
+  }
+}
+
+void StreamBuffer::Release() {
+  for (GLsync& fence : fences) {
+    if (fence) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+  if (buffer) {
+    if (mapped) {
+      glBindBuffer(target, buffer);
+      glUnmapBuffer(target);
+      mapped = nullptr;
+    }
+    // GL holds on to the storage until draws already issued are done with it
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+  }
+}
+
+void StreamBuffer::WaitForSegment() {
+  GLsync& fence = fences[segment];
+  if (!fence) {
+    return;
+  }
+
+  if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+    if (!mapped) {
+      // A fresh store costs less than waiting, and frees every segment
+      glBufferData(target, static_cast<GLsizeiptr>(segmentSize * SEGMENTS), nullptr, GL_STREAM_DRAW);
+      for (GLsync& other : fences) {
+        if (other) {
+          glDeleteSync(other);
+          other = nullptr;
+        }
+      }
+      ++stats.orphans;
+      return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    GLenum result;
+    do {
+      result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STALL_WAIT_NS);
+    } while (result == GL_TIMEOUT_EXPIRED);
+    ++stats.stalls;
+    stats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  glDeleteSync(fence);
+  fence = nullptr;
+}
+
+size_t StreamBuffer::Write(const void* data, size_t bytes, size_t alignment) {
+  size_t start = (cursor + alignment - 1) / alignment * alignment;
+  if (!buffer || start + bytes > segmentSize) {
+    // Alignment padding is the most a fresh segment could lose
+    size_t needed = bytes + alignment;
+    if (buffer) {
+      ++stats.grows;
+    }
+    Allocate(buffer ? std::max(segmentSize * 2, needed) : std::max(segmentSize, needed));
+    start = 0;
+  } else {
+    glBindBuffer(target, buffer);
+  }
+
+  if (!written) {
+    WaitForSegment();
+    written = true;
+  }
+
+  size_t offset = segment * segmentSize + start;
+  if (mapped) {
+    std::memcpy(mapped + offset, data, bytes);
+    glFlushMappedBufferRange(target, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes));
+  } else {
+    // The fences stand in for the driver's own synchronization
+    void* destination = glMapBufferRange(target, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (destination) {
+      std::memcpy(destination, data, bytes);
+    }
+    glUnmapBuffer(target);
+  }
+
+  cursor = start + bytes;
+  stats.bytesWritten += bytes;
+  return offset;
+}
+
+void StreamBuffer::EndFrame() {
+  for (StreamBuffer* stream : buffers) {
+    if (!stream->written) {
+      continue;
+    }
+    stream->fences[stream->segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->segment = (stream->segment + 1) % SEGMENTS;
+    stream->cursor = 0;
+    stream->written = false;
+  }
+
+  Stats total = retired;
+  for (const StreamBuffer* stream : buffers) {
+    AddStats(total, stream->stats);
+  }
+  std::lock_guard<std::mutex> lock(publishedMutex);
+  published = total;
+}
+
+StreamBuffer::Stats StreamBuffer::GetTotals() {
+  std::lock_guard<std::mutex> lock(publishedMutex);
+  return published;
+}
+
+std::string StreamBuffer::GetReport() {
+  Stats total = GetTotals();
+  char line[160];
+  std::snprintf(line, sizeof(line), "stream buffers: %.1f MB written, %llu stalls (%.2f ms), %llu orphans, %llu grows\n",
+                total.bytesWritten / (1024.0 * 1024.0), static_cast<unsigned long long>(total.stalls), total.stallMs,
+                static_cast<unsigned long long>(total.orphans), static_cast<unsigned long long>(total.grows));
+  return line;
+}
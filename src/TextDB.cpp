@@ -7,91 +7,418 @@
 
 #include <stdio.h>
 #include "TextDB.h"
+#include "ShaderDB.h"
+#include "Renderer.h"
 
-SDL_Renderer* TextDB::renderer = nullptr;
-std::unordered_map<std::string, std::unordered_map<int, TTF_Font*>> TextDB::fonts;
-std::queue<TextDB::TextDrawStruct> TextDB::drawQueue;
+#include <algorithm>
 
-void TextDB::Init(SDL_Renderer* r) {
+#include <glm/gtc/matrix_transform.hpp>
+
+// Big enough for several fonts; when it fills up it starts over
+static const int ATLAS_SIZE = 1024;
+// Size glyphs are rasterized at; every other size is scaled from it
+static const int BASE_FONT_SIZE = 32;
+// How far, in base size pixels, FreeType's distance fields reach either side
+// of the edge. Outlines and shadows can't be wider than this once scaled.
+static const float SDF_SPREAD = 8.0f;
+// x, y, u, v, color, outline color, distance scale, outline width, softness
+static const int FLOATS_PER_VERTEX = 15;
+// Laid out strings that haven't been drawn for this many frames are dropped
+static const int UNUSED_TEXT_FRAMES = 300;
+
+std::unordered_map<std::string, TTF_Font*> TextDB::fonts;
+std::vector<TextDB::TextDrawStruct> TextDB::drawQueue;
+TextureAtlas TextDB::atlas(ATLAS_SIZE, ATLAS_SIZE, 1);
+bool TextDB::atlasFull = false;
+std::unordered_map<TTF_Font*, std::unordered_map<Uint32, TextDB::Glyph>> TextDB::glyphs;
+std::unordered_map<std::string, TextDB::ShapedText> TextDB::shapedText;
+int TextDB::frame = 0;
+std::shared_ptr<Shader> TextDB::shader = nullptr;
+GLuint TextDB::vao = 0;
+std::unique_ptr<StreamBuffer> TextDB::stream = nullptr;
+GLuint TextDB::atlasTexture = 0;
+
+// Reads one code point and moves past it; bad bytes come out as U+FFFD
+static Uint32 NextCodepoint(const std::string& text, size_t& i) {
+    unsigned char lead = static_cast<unsigned char>(text[i++]);
+    int length = lead < 0x80 ? 0 : (lead >> 5) == 0x6 ? 1 : (lead >> 4) == 0xE ? 2 : (lead >> 3) == 0x1E ? 3 : -1;
+    if (length < 0) {
+        return 0xFFFD;
+    }
+    if (length == 0) {
+        return lead;
+    }
+
+    Uint32 codepoint = lead & (0x3F >> length);
+    for (int n = 0; n < length; ++n) {
+        if (i >= text.size() || (static_cast<unsigned char>(text[i]) & 0xC0) != 0x80) {
+            return 0xFFFD;
+        }
+        codepoint = (codepoint << 6) | (static_cast<unsigned char>(text[i++]) & 0x3F);
+    }
+    return codepoint;
+}
+
+void TextDB::Init() {
     if (TTF_Init() == -1) {
         std::cout << "Failed to initialize TTF: " << TTF_GetError() << std::endl;
         exit(1);
     }
-    renderer = r;
+
+    shader = ShaderDB::GetShader("shaders/vertex/text.glsl", "shaders/fragment/text.glsl");
+
+    // The atlas starts out empty, so nothing is dirty once it's uploaded here
+    int top, bottom;
+    atlas.TakeDirtyRows(top, bottom);
+    glGenTextures(1, &atlasTexture);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas.GetWidth(), atlas.GetHeight(), 0, GL_RED, GL_UNSIGNED_BYTE, atlas.GetPixels());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Attribute pointers are set in Render, at wherever the quads were streamed to
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    for (GLuint attribute = 0; attribute < 4; ++attribute) {
+        glEnableVertexAttribArray(attribute);
+    }
+    glBindVertexArray(0);
+    stream = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, 256 * 1024);
 }
 
 void TextDB::Shutdown() {
-    while (!drawQueue.empty()) {
-        drawQueue.pop();
-    }
-    for (auto& font_family : fonts) {
-        for (auto& font_pair : font_family.second) {
-            TTF_CloseFont(font_pair.second);
-        }
+    drawQueue.clear();
+    glyphs.clear();
+    shapedText.clear();
+    for (auto& font_pair : fonts) {
+        TTF_CloseFont(font_pair.second);
     }
+    fonts.clear();
     TTF_Quit();
+
+    if (vao) {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteTextures(1, &atlasTexture);
+        vao = atlasTexture = 0;
+    }
+    stream = nullptr;
+    shader = nullptr;
 }
 
-void TextDB::LoadFont(const std::string& font_name, const std::string& file_path, int font_size) {
+void TextDB::LoadFont(const std::string& font_name, const std::string& file_path) {
   if(!std::filesystem::exists(file_path)) {
     std::cout << "error: font " << font_name << " missing";
     exit(0);
   }
-  
-  TTF_Font* font = TTF_OpenFont(file_path.c_str(), font_size);
+
+  TTF_Font* font = TTF_OpenFont(file_path.c_str(), BASE_FONT_SIZE);
   if(!font) {
     std::cout << "Font " << font_name << " not loaded correctly" << std::endl;
     exit(0);
   }
+  if (TTF_SetFontSDF(font, SDL_TRUE) != 0) {
+    std::cout << "Font " << font_name << " has no distance field support, text will look soft: " << TTF_GetError() << std::endl;
+  }
 
-  fonts[font_name][font_size] = font;
+  fonts[font_name] = font;
 }
 
 void TextDB::Draw(const std::string& str_content, float x, float y, const std::string& font_name, int font_size, float r, float g, float b, float a) {
-    TextDrawStruct request = { str_content, x, y, font_name, font_size, r, g, b, a };
-    drawQueue.push(request);
+    if (str_content.empty()) {
+        return;
+    }
+    TextDrawStruct request = { str_content, x, y, font_name, font_size, r, g, b, a, TextStyle{} };
+    drawQueue.push_back(request);
 }
 
-void TextDB::RenderText() {
-    while (!drawQueue.empty()) {
-        TextDrawStruct request = drawQueue.front();
-        drawQueue.pop();
+void TextDB::DrawStyled(const std::string& str_content, float x, float y, const std::string& font_name, int font_size, float r, float g, float b, float a, luabridge::LuaRef style) {
+    if (str_content.empty()) {
+        return;
+    }
+    TextDrawStruct request = { str_content, x, y, font_name, font_size, r, g, b, a, TextStyle{} };
+    if (style.isTable()) {
+        auto number = [&style](const char* key, float fallback) {
+            luabridge::LuaRef value = style[key];
+            return value.isNumber() ? value.cast<float>() : fallback;
+        };
+        TextStyle& s = request.style;
+        s.outlineWidth = std::max(number("outline", 0.0f), 0.0f);
+        s.outlineColor = glm::vec4(number("outlineR", 0.0f), number("outlineG", 0.0f), number("outlineB", 0.0f), number("outlineA", 255.0f)) / 255.0f;
+        s.shadowOffset = glm::vec2(number("shadowX", 0.0f), number("shadowY", 0.0f));
+        s.shadowSoftness = std::max(number("shadowSoftness", 0.0f), 0.0f);
+        // A shadow is only drawn if it's given an offset or softness
+        float shadowAlpha = (s.shadowOffset != glm::vec2(0.0f) || s.shadowSoftness > 0.0f) ? 160.0f : 0.0f;
+        s.shadowColor = glm::vec4(number("shadowR", 0.0f), number("shadowG", 0.0f), number("shadowB", 0.0f), number("shadowA", shadowAlpha)) / 255.0f;
+        s.softness = std::max(number("softness", 0.0f), 0.0f);
+    }
+    drawQueue.push_back(request);
+}
 
-        if(request.str_content.empty()) {
-            return;
+TTF_Font* TextDB::GetFont(const std::string& font_name) {
+    if (fonts.find(font_name) == fonts.end()) {
+        std::string fp = "resources/fonts/" + font_name + ".ttf";
+        LoadFont(font_name, fp);
+    }
+    return fonts[font_name];
+}
+
+const TextDB::Glyph* TextDB::GetGlyph(TTF_Font* font, Uint32 codepoint) {
+    std::unordered_map<Uint32, Glyph>& fontGlyphs = glyphs[font];
+    auto found = fontGlyphs.find(codepoint);
+    if (found != fontGlyphs.end()) {
+        return &found->second;
+    }
+
+    Glyph glyph = {};
+    int minx, maxx, miny, maxy;
+    if (TTF_GlyphMetrics32(font, codepoint, &minx, &maxx, &miny, &maxy, &glyph.advance) != 0) {
+        // Not in the font; takes no space
+        glyph.advance = 0;
+        return &(fontGlyphs[codepoint] = glyph);
+    }
+
+    // Rendered on its own the glyph sits on a line-high surface with the pen
+    // at its left edge, so its offsets from there carry over to any string
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Surface* surface = TTF_RenderGlyph32_Blended(font, codepoint, white);
+    if (!surface) {
+        return &(fontGlyphs[codepoint] = glyph);
+    }
+    SDL_LockSurface(surface);
+
+    // Only the covered pixels go in the atlas
+    auto alphaAt = [surface](int x, int y) {
+        const Uint32* row = reinterpret_cast<const Uint32*>(static_cast<const uint8_t*>(surface->pixels) + y * surface->pitch);
+        return static_cast<uint8_t>(row[x] >> 24);
+    };
+    int left = surface->w, right = -1, top = surface->h, bottom = -1;
+    for (int y = 0; y < surface->h; ++y) {
+        for (int x = 0; x < surface->w; ++x) {
+            if (alphaAt(x, y)) {
+                left = std::min(left, x);
+                right = std::max(right, x);
+                top = std::min(top, y);
+                bottom = std::max(bottom, y);
+            }
         }
-    
-        if (fonts.find(request.font_name) == fonts.end() || fonts[request.font_name].find(request.font_size) == fonts[request.font_name].end()) {
-            std::string fp = "resources/fonts/" + request.font_name + ".ttf";
-            LoadFont(request.font_name, fp, request.font_size);
+    }
+
+    const Glyph* result = nullptr;
+    if (right < 0) {
+        // Blank, like a space
+        result = &(fontGlyphs[codepoint] = glyph);
+    } else {
+        int w = right - left + 1;
+        int h = bottom - top + 1;
+        int atlasX, atlasY;
+        if (atlas.Allocate(w, h, atlasX, atlasY)) {
+            std::vector<uint8_t> coverage(static_cast<size_t>(w) * h);
+            for (int y = 0; y < h; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    coverage[y * w + x] = alphaAt(left + x, top + y);
+                }
+            }
+            atlas.Write(atlasX, atlasY, w, h, coverage.data());
+
+            glyph.visible = true;
+            glyph.x0 = static_cast<float>(left);
+            glyph.y0 = static_cast<float>(top);
+            glyph.x1 = static_cast<float>(left + w);
+            glyph.y1 = static_cast<float>(top + h);
+            glyph.u0 = static_cast<float>(atlasX) / atlas.GetWidth();
+            glyph.v0 = static_cast<float>(atlasY) / atlas.GetHeight();
+            glyph.u1 = static_cast<float>(atlasX + w) / atlas.GetWidth();
+            glyph.v1 = static_cast<float>(atlasY + h) / atlas.GetHeight();
+            result = &(fontGlyphs[codepoint] = glyph);
+        } else {
+            atlasFull = true;
         }
+    }
+
+    SDL_UnlockSurface(surface);
+    SDL_FreeSurface(surface);
+    return result;
+}
 
-        TTF_Font* font = fonts[request.font_name][request.font_size];
-        SDL_Color color = { static_cast<Uint8>(request.r), static_cast<Uint8>(request.g), static_cast<Uint8>(request.b), static_cast<Uint8>(request.a) };
+const TextDB::ShapedText* TextDB::Shape(const TextDrawStruct& request) {
+    // Laid out at the base size, so every size shares it
+    std::string key = request.font_name + '\n' + request.str_content;
+    auto found = shapedText.find(key);
+    if (found != shapedText.end()) {
+        found->second.lastUsed = frame;
+        return &found->second;
+    }
+
+    TTF_Font* font = GetFont(request.font_name);
+    int lineSkip = TTF_FontLineSkip(font);
+
+    ShapedText shaped;
+    shaped.lastUsed = frame;
+    bool complete = true;
+    float penX = 0.0f;
+    float penY = 0.0f;
+    Uint32 previous = 0;
+    size_t i = 0;
+    while (i < request.str_content.size()) {
+        Uint32 codepoint = NextCodepoint(request.str_content, i);
+        if (codepoint == '\n') {
+            penX = 0.0f;
+            penY += lineSkip;
+            previous = 0;
+            continue;
+        }
+        if (previous) {
+            penX += TTF_GetFontKerningSizeGlyphs32(font, previous, codepoint);
+        }
+        previous = codepoint;
 
-        SDL_Surface* surface = TTF_RenderText_Solid(font, request.str_content.c_str(), color);
-        if (!surface) {
-            std::cout << "Failed to create text surface: " << TTF_GetError() << std::endl;
-            return;
+        const Glyph* glyph = GetGlyph(font, codepoint);
+        if (!glyph) {
+            complete = false;
+            continue;
+        }
+        if (glyph->visible) {
+            shaped.quads.insert(shaped.quads.end(), {
+                penX + glyph->x0, penY + glyph->y0, penX + glyph->x1, penY + glyph->y1,
+                glyph->u0, glyph->v0, glyph->u1, glyph->v1
+            });
         }
+        penX += glyph->advance;
+    }
 
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        if (!texture) {
-            std::cout << "Failed to create text texture: " << SDL_GetError() << std::endl;
-            SDL_FreeSurface(surface);
-            return;
+    // Strings missing glyphs are drawn as they are this frame but not kept
+    static ShapedText incomplete;
+    if (!complete) {
+        incomplete = std::move(shaped);
+        return &incomplete;
+    }
+    return &(shapedText[key] = std::move(shaped));
+}
+
+void TextDB::EvictUnusedText() {
+    for (auto entry = shapedText.begin(); entry != shapedText.end();) {
+        if (frame - entry->second.lastUsed > UNUSED_TEXT_FRAMES) {
+            entry = shapedText.erase(entry);
+        } else {
+            ++entry;
         }
+    }
+}
+
+void TextDB::AppendQuads(std::vector<float>& vertices, const ShapedText& shaped, const TextDrawStruct& request, glm::vec2 offset, const glm::vec4& color, const glm::vec4& outlineColor, float softness) {
+    float scale = static_cast<float>(request.font_size) / BASE_FONT_SIZE;
+    // Turns a sample from the atlas into a distance in window pixels
+    float distanceScale = 2.0f * SDF_SPREAD * scale;
+    float outline = request.style.outlineWidth;
 
-        SDL_Rect dstRect = { 
-            static_cast<int>(request.x), 
-            static_cast<int>(request.y), 
-            surface->w, 
-            surface->h 
+    float originX = request.x + offset.x;
+    float originY = request.y + offset.y;
+    for (size_t q = 0; q < shaped.quads.size(); q += 8) {
+        const float* quad = &shaped.quads[q];
+        float x0 = originX + quad[0] * scale, y0 = originY + quad[1] * scale;
+        float x1 = originX + quad[2] * scale, y1 = originY + quad[3] * scale;
+        float corners[6][4] = {
+            { x0, y0, quad[4], quad[5] },
+            { x1, y0, quad[6], quad[5] },
+            { x0, y1, quad[4], quad[7] },
+            { x1, y0, quad[6], quad[5] },
+            { x1, y1, quad[6], quad[7] },
+            { x0, y1, quad[4], quad[7] }
         };
+        for (const float* corner : corners) {
+            vertices.insert(vertices.end(), {
+                corner[0], corner[1], corner[2], corner[3],
+                color.r, color.g, color.b, color.a,
+                outlineColor.r, outlineColor.g, outlineColor.b, outlineColor.a,
+                distanceScale, outline, softness
+            });
+        }
+    }
+}
 
-        SDL_RenderCopy(renderer, texture, NULL, &dstRect);
+void TextDB::BuildFrame(TextFrame& textFrame) {
+    ++frame;
 
-        SDL_DestroyTexture(texture);
-        SDL_FreeSurface(surface);
+    // If the atlas fills up, it starts over with just this frame's glyphs
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        atlasFull = false;
+        textFrame.vertices.clear();
+        for (const TextDrawStruct& request : drawQueue) {
+            const ShapedText* shaped = Shape(request);
+            const TextStyle& style = request.style;
+            // Shadows go underneath, covering the outline too
+            if (style.shadowColor.a > 0.0f) {
+                AppendQuads(textFrame.vertices, *shaped, request, style.shadowOffset, style.shadowColor, style.shadowColor, style.softness + style.shadowSoftness);
+            }
+            glm::vec4 color = glm::vec4(request.r, request.g, request.b, request.a) / 255.0f;
+            AppendQuads(textFrame.vertices, *shaped, request, glm::vec2(0.0f), color, style.outlineColor, style.softness);
+        }
+        if (!atlasFull || attempt == 1) {
+            break;
+        }
+        std::cout << "Text atlas full, rebuilding it" << std::endl;
+        atlas.Clear();
+        glyphs.clear();
+        shapedText.clear();
     }
+    drawQueue.clear();
+    EvictUnusedText();
+
+    // The render thread gets its own copy of whatever changed
+    int top, bottom;
+    if (atlas.TakeDirtyRows(top, bottom)) {
+        size_t rowBytes = static_cast<size_t>(atlas.GetWidth()) * atlas.GetChannels();
+        textFrame.dirtyTop = top;
+        textFrame.dirtyRows = bottom - top;
+        textFrame.dirtyPixels.assign(atlas.GetPixels() + top * rowBytes, atlas.GetPixels() + bottom * rowBytes);
+    } else {
+        textFrame.dirtyRows = 0;
+        textFrame.dirtyPixels.clear();
+    }
+}
+
+void TextDB::SnapshotAtlas(TextFrame& frame) {
+    frame.dirtyTop = 0;
+    frame.dirtyRows = atlas.GetHeight();
+    frame.dirtyPixels.assign(atlas.GetPixels(), atlas.GetPixels() + static_cast<size_t>(atlas.GetWidth()) * atlas.GetHeight() * atlas.GetChannels());
+}
+
+void TextDB::Render(const TextFrame& textFrame) {
+    if (textFrame.dirtyRows > 0) {
+        glBindTexture(GL_TEXTURE_2D, atlasTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, textFrame.dirtyTop, atlas.GetWidth(), textFrame.dirtyRows, GL_RED, GL_UNSIGNED_BYTE, textFrame.dirtyPixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    if (textFrame.vertices.empty()) {
+        return;
+    }
+
+    // Window pixels, y down, like the coordinates Lua passes in
+    shader->Use();
+    shader->SetMat4("projection", glm::ortho(0.0f, static_cast<float>(Renderer::x_resolution), static_cast<float>(Renderer::y_resolution), 0.0f));
+    shader->SetInt("atlas", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glBindVertexArray(vao);
+    size_t offset = stream->Write(textFrame.vertices.data(), textFrame.vertices.size() * sizeof(float));
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)offset);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(offset + 4 * sizeof(float)));
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(offset + 8 * sizeof(float)));
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(offset + 12 * sizeof(float)));
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(textFrame.vertices.size() / FLOATS_PER_VERTEX));
+    glBindVertexArray(0);
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
 }
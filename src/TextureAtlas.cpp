@@ -0,0 +1,66 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+TextureAtlas::TextureAtlas(int width, int height, int channels)
+  : width(width), height(height), channels(channels),
+    pixels(static_cast<size_t>(width) * height * channels, 0) {
+  // A new atlas has to be uploaded whole
+  dirtyTop = 0;
+  dirtyBottom = height;
+}
+
+bool TextureAtlas::Allocate(int w, int h, int& x, int& y) {
+  int paddedWidth = w + PADDING;
+  int paddedHeight = h + PADDING;
+  if (paddedWidth > width || paddedHeight > height) {
+    return false;
+  }
+
+  if (shelfX + paddedWidth > width) {
+    shelfY += shelfHeight;
+    shelfX = 0;
+    shelfHeight = 0;
+  }
+  if (shelfY + paddedHeight > height) {
+    return false;
+  }
+
+  x = shelfX;
+  y = shelfY;
+  shelfX += paddedWidth;
+  shelfHeight = std::max(shelfHeight, paddedHeight);
+  return true;
+}
+
+void TextureAtlas::Write(int x, int y, int w, int h, const uint8_t* source) {
+  size_t rowBytes = static_cast<size_t>(w) * channels;
+  for (int row = 0; row < h; ++row) {
+    uint8_t* destination = pixels.data() + (static_cast<size_t>(y + row) * width + x) * channels;
+    std::memcpy(destination, source + row * rowBytes, rowBytes);
+  }
+  dirtyTop = std::min(dirtyTop, y);
+  dirtyBottom = std::max(dirtyBottom, y + h);
+}
+
+void TextureAtlas::Clear() {
+  std::fill(pixels.begin(), pixels.end(), 0);
+  shelfX = 0;
+  shelfY = 0;
+  shelfHeight = 0;
+  dirtyTop = 0;
+  dirtyBottom = height;
+  ++generation;
+}
+
+bool TextureAtlas::TakeDirtyRows(int& top, int& bottom) {
+  if (dirtyTop >= dirtyBottom) {
+    return false;
+  }
+  top = dirtyTop;
+  bottom = dirtyBottom;
+  dirtyTop = height;
+  dirtyBottom = 0;
+  return true;
+}
@@ -0,0 +1,35 @@
+#include "TransformComponent.h"
+#include "Actor.hpp"
+
+TransformComponent::TransformComponent() : Component(), handle(TransformSystem::Create()) {
+  type = "Transform";
+  isTransform = true;
+}
+
+TransformComponent::TransformComponent(const TransformComponent& other) : Component(other), parentName(other.parentName), handle(TransformSystem::Create()) {
+  SetPosition(other.GetPosition());
+  SetRotation(other.GetRotation());
+  SetScale(other.GetScale());
+  TransformSystem::SetParent(handle, TransformSystem::GetParent(other.handle));
+}
+
+TransformComponent::~TransformComponent() {
+  TransformSystem::Destroy(handle);
+}
+
+void TransformComponent::SetParent(TransformComponent* parent) {
+  TransformSystem::SetParent(handle, parent ? parent->handle : TransformSystem::INVALID);
+}
+
+TransformComponent* TransformComponent::FindOn(const Actor& actor) {
+  auto it = actor.componentsByType.find("Transform");
+  if (it == actor.componentsByType.end()) {
+    return nullptr;
+  }
+  for (const auto& component : it->second) {
+    if (component->isTransform) {
+      return static_cast<TransformComponent*>(component.get());
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,331 @@
+#include "TransformSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <type_traits>
+
+const TransformSystem::Handle TransformSystem::INVALID;
+
+std::vector<float> TransformSystem::positionX;
+std::vector<float> TransformSystem::positionY;
+std::vector<float> TransformSystem::positionZ;
+std::vector<float> TransformSystem::rotationX;
+std::vector<float> TransformSystem::rotationY;
+std::vector<float> TransformSystem::rotationZ;
+std::vector<float> TransformSystem::rotationW;
+std::vector<float> TransformSystem::scaleX;
+std::vector<float> TransformSystem::scaleY;
+std::vector<float> TransformSystem::scaleZ;
+std::vector<glm::vec3> TransformSystem::localRotations;
+std::vector<glm::mat4> TransformSystem::worldMatrices;
+std::vector<int> TransformSystem::parentSlots;
+std::vector<TransformSystem::Handle> TransformSystem::parentHandles;
+std::vector<TransformSystem::Handle> TransformSystem::slotHandles;
+std::vector<uint8_t> TransformSystem::dirty;
+
+std::vector<int> TransformSystem::handleSlots;
+std::vector<TransformSystem::Handle> TransformSystem::freeHandles;
+
+bool TransformSystem::orderChanged = false;
+bool TransformSystem::anyDirty = false;
+TransformSystem::Stats TransformSystem::stats;
+
+template <typename F>
+void TransformSystem::ForEachSlotArray(F f) {
+  f(positionX); f(positionY); f(positionZ);
+  f(rotationX); f(rotationY); f(rotationZ); f(rotationW);
+  f(scaleX); f(scaleY); f(scaleZ);
+  f(localRotations);
+  f(worldMatrices);
+  f(parentSlots);
+  f(parentHandles);
+  f(slotHandles);
+  f(dirty);
+}
+
+TransformStreams TransformSystem::StreamsFrom(int first) {
+  return {
+    positionX.data() + first, positionY.data() + first, positionZ.data() + first,
+    rotationX.data() + first, rotationY.data() + first, rotationZ.data() + first, rotationW.data() + first,
+    scaleX.data() + first, scaleY.data() + first, scaleZ.data() + first
+  };
+}
+
+TransformSystem::Handle TransformSystem::Create() {
+  Handle handle;
+  if (!freeHandles.empty()) {
+    handle = freeHandles.back();
+    freeHandles.pop_back();
+  } else {
+    handle = static_cast<Handle>(handleSlots.size());
+    handleSlots.push_back(-1);
+  }
+
+  // A new root can go at the end without breaking parents-before-children
+  int slot = static_cast<int>(slotHandles.size());
+  positionX.push_back(0.0f); positionY.push_back(0.0f); positionZ.push_back(0.0f);
+  rotationX.push_back(0.0f); rotationY.push_back(0.0f); rotationZ.push_back(0.0f); rotationW.push_back(1.0f);
+  scaleX.push_back(1.0f); scaleY.push_back(1.0f); scaleZ.push_back(1.0f);
+  localRotations.push_back(glm::vec3(0.0f));
+  worldMatrices.push_back(glm::mat4(1.0f));
+  parentSlots.push_back(-1);
+  parentHandles.push_back(INVALID);
+  slotHandles.push_back(handle);
+  dirty.push_back(1);
+
+  handleSlots[handle] = slot;
+  anyDirty = true;
+  return handle;
+}
+
+void TransformSystem::Destroy(Handle handle) {
+  if (!IsValid(handle)) {
+    return;
+  }
+
+  // Children become roots where they are in their parent's space
+  for (size_t slot = 0; slot < parentHandles.size(); ++slot) {
+    if (parentHandles[slot] == handle) {
+      parentHandles[slot] = INVALID;
+      dirty[slot] = 1;
+      anyDirty = true;
+    }
+  }
+
+  RemoveSlot(handleSlots[handle]);
+  handleSlots[handle] = -1;
+  freeHandles.push_back(handle);
+}
+
+void TransformSystem::RemoveSlot(int slot) {
+  // Move the last slot into the gap; Reorder puts the depth order right again
+  int last = static_cast<int>(slotHandles.size()) - 1;
+  ForEachSlotArray([slot, last](auto& values) {
+    values[slot] = values[last];
+    values.pop_back();
+  });
+  if (slot != last) {
+    handleSlots[slotHandles[slot]] = slot;
+  }
+  orderChanged = true;
+}
+
+bool TransformSystem::IsValid(Handle handle) {
+  return handle >= 0 && handle < static_cast<Handle>(handleSlots.size()) && handleSlots[handle] != -1;
+}
+
+bool TransformSystem::SetParent(Handle child, Handle parent) {
+  if (!IsValid(child) || (parent != INVALID && !IsValid(parent))) {
+    return false;
+  }
+
+  // Refuse cycles: the new parent can't be the child or one of its descendants
+  for (Handle ancestor = parent; ancestor != INVALID; ancestor = parentHandles[handleSlots[ancestor]]) {
+    if (ancestor == child) {
+      std::cerr << "Transform can't be parented to its own descendant" << std::endl;
+      return false;
+    }
+  }
+
+  int slot = handleSlots[child];
+  if (parentHandles[slot] == parent) {
+    return true;
+  }
+  parentHandles[slot] = parent;
+  dirty[slot] = 1;
+  anyDirty = true;
+  orderChanged = true;
+  return true;
+}
+
+TransformSystem::Handle TransformSystem::GetParent(Handle handle) {
+  return IsValid(handle) ? parentHandles[handleSlots[handle]] : INVALID;
+}
+
+void TransformSystem::SetLocalPosition(Handle handle, const glm::vec3& position) {
+  if (!IsValid(handle)) {
+    return;
+  }
+  int slot = handleSlots[handle];
+  positionX[slot] = position.x;
+  positionY[slot] = position.y;
+  positionZ[slot] = position.z;
+  dirty[slot] = 1;
+  anyDirty = true;
+}
+
+void TransformSystem::SetLocalRotation(Handle handle, const glm::vec3& rotation) {
+  if (!IsValid(handle)) {
+    return;
+  }
+  int slot = handleSlots[handle];
+  glm::quat quat = SimdMath::EulerToQuat(rotation);
+  localRotations[slot] = rotation;
+  rotationX[slot] = quat.x;
+  rotationY[slot] = quat.y;
+  rotationZ[slot] = quat.z;
+  rotationW[slot] = quat.w;
+  dirty[slot] = 1;
+  anyDirty = true;
+}
+
+void TransformSystem::SetLocalScale(Handle handle, const glm::vec3& scale) {
+  if (!IsValid(handle)) {
+    return;
+  }
+  int slot = handleSlots[handle];
+  scaleX[slot] = scale.x;
+  scaleY[slot] = scale.y;
+  scaleZ[slot] = scale.z;
+  dirty[slot] = 1;
+  anyDirty = true;
+}
+
+glm::vec3 TransformSystem::GetLocalPosition(Handle handle) {
+  if (!IsValid(handle)) {
+    return glm::vec3(0.0f);
+  }
+  int slot = handleSlots[handle];
+  return glm::vec3(positionX[slot], positionY[slot], positionZ[slot]);
+}
+
+glm::vec3 TransformSystem::GetLocalRotation(Handle handle) {
+  return IsValid(handle) ? localRotations[handleSlots[handle]] : glm::vec3(0.0f);
+}
+
+glm::vec3 TransformSystem::GetLocalScale(Handle handle) {
+  if (!IsValid(handle)) {
+    return glm::vec3(1.0f);
+  }
+  int slot = handleSlots[handle];
+  return glm::vec3(scaleX[slot], scaleY[slot], scaleZ[slot]);
+}
+
+const glm::mat4& TransformSystem::GetWorldMatrix(Handle handle) {
+  static const glm::mat4 identity(1.0f);
+  if (!IsValid(handle)) {
+    return identity;
+  }
+  if (anyDirty || orderChanged) {
+    Update();
+  }
+  return worldMatrices[handleSlots[handle]];
+}
+
+void TransformSystem::Reorder() {
+  int count = static_cast<int>(slotHandles.size());
+
+  // Depth of every slot, walking up until a known depth or a root
+  std::vector<int> depths(count, -1);
+  std::vector<int> chain;
+  int maxDepth = 0;
+  for (int slot = 0; slot < count; ++slot) {
+    int current = slot;
+    while (depths[current] == -1 && parentHandles[current] != INVALID) {
+      chain.push_back(current);
+      current = handleSlots[parentHandles[current]];
+    }
+    int depth = depths[current] == -1 ? 0 : depths[current];
+    depths[current] = depth;
+    while (!chain.empty()) {
+      depths[chain.back()] = ++depth;
+      chain.pop_back();
+    }
+    maxDepth = std::max(maxDepth, depths[slot]);
+  }
+
+  std::vector<int> order(count);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&depths](int a, int b) {
+    return depths[a] < depths[b];
+  });
+
+  auto permute = [&order](auto& values) {
+    typename std::decay<decltype(values)>::type sorted;
+    sorted.reserve(values.size());
+    for (int slot : order) {
+      sorted.push_back(values[slot]);
+    }
+    values.swap(sorted);
+  };
+  ForEachSlotArray(permute);
+
+  for (int slot = 0; slot < count; ++slot) {
+    handleSlots[slotHandles[slot]] = slot;
+  }
+  for (int slot = 0; slot < count; ++slot) {
+    parentSlots[slot] = parentHandles[slot] == INVALID ? -1 : handleSlots[parentHandles[slot]];
+  }
+
+  stats.maxDepth = maxDepth;
+  orderChanged = false;
+}
+
+void TransformSystem::Update() {
+  if (orderChanged) {
+    Reorder();
+  }
+  stats.transforms = static_cast<int>(slotHandles.size());
+  if (!anyDirty) {
+    return;
+  }
+
+  // Parents come first, so a parent's flag is final by the time its children
+  // look at it
+  int count = static_cast<int>(slotHandles.size());
+  for (int slot = 0; slot < count; ++slot) {
+    int parent = parentSlots[slot];
+    if (parent != -1 && dirty[parent]) {
+      dirty[slot] = 1;
+    }
+  }
+
+  // Local matrices for each run of dirty slots in one batch
+  int recomputed = 0;
+  for (int slot = 0; slot < count;) {
+    if (!dirty[slot]) {
+      ++slot;
+      continue;
+    }
+    int runEnd = slot;
+    while (runEnd < count && dirty[runEnd]) {
+      ++runEnd;
+    }
+    SimdMath::ComposeTRS(runEnd - slot, StreamsFrom(slot), worldMatrices.data() + slot);
+    recomputed += runEnd - slot;
+    slot = runEnd;
+  }
+
+  // Then into world space, parents again first
+  for (int slot = 0; slot < count; ++slot) {
+    int parent = parentSlots[slot];
+    if (dirty[slot] && parent != -1) {
+      SimdMath::Multiply(worldMatrices[parent], worldMatrices[slot], worldMatrices[slot]);
+    }
+  }
+
+  std::fill(dirty.begin(), dirty.end(), 0);
+  anyDirty = false;
+  stats.recomputed = recomputed;
+}
+
+const TransformSystem::Stats& TransformSystem::GetStats() {
+  return stats;
+}
+
+glm::mat4 TransformSystem::Compose(const glm::vec3& position, const glm::vec3& rotationDegrees, const glm::vec3& scale) {
+  glm::vec3 radians = glm::radians(rotationDegrees);
+  float sx = std::sin(radians.x), cx = std::cos(radians.x);
+  float sy = std::sin(radians.y), cy = std::cos(radians.y);
+  float sz = std::sin(radians.z), cz = std::cos(radians.z);
+
+  // Columns of Rx * Ry * Rz, each scaled by its axis
+  glm::mat4 matrix;
+  matrix[0] = glm::vec4(cy * cz, sx * sy * cz + cx * sz, sx * sz - cx * sy * cz, 0.0f) * scale.x;
+  matrix[1] = glm::vec4(-cy * sz, cx * cz - sx * sy * sz, cx * sy * sz + sx * cz, 0.0f) * scale.y;
+  matrix[2] = glm::vec4(sy, -sx * cy, cx * cy, 0.0f) * scale.z;
+  matrix[3] = glm::vec4(position, 1.0f);
+  return matrix;
+}
@@ -1,6 +1,7 @@
 #include <glad/glad.h>
 #include <SDL2/SDL.h>
 #include <iostream>
+#include <cstdlib>
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -22,7 +23,27 @@
 
 
 int main(int argc, char* argv[]) {
-    Engine engine = Engine();
+    LaunchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--null-renderer") {
+            options.nullRenderer = true;
+        } else if (arg == "--frames" && i + 1 < argc) {
+            options.frameLimit = std::atoi(argv[++i]);
+        } else if (arg == "--capture" && i + 1 < argc) {
+            options.capturePath = argv[++i];
+        } else if (arg == "--capture-start" && i + 1 < argc) {
+            options.captureStart = std::atoi(argv[++i]);
+        } else if (arg == "--capture-frames" && i + 1 < argc) {
+            options.captureFrames = std::atoi(argv[++i]);
+        } else {
+            std::cout << "Unknown argument " << arg << std::endl;
+        }
+    }
+
+    Engine engine = Engine(options);
 
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
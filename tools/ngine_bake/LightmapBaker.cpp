@@ -0,0 +1,932 @@
+#include "LightmapBaker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <glm/gtc/packing.hpp>
+
+#include "GameObject.h"
+#include "JobSystem.h"
+#include "LightComponent.h"
+#include "Mesh.h"
+#include "Model.h"
+
+namespace {
+
+const float PI = 3.14159265358979f;
+// Triangles per BVH leaf
+const uint32_t LEAF_SIZE = 4;
+// How much of the atlas the first layout attempt aims to fill
+const float TARGET_FILL = 0.6f;
+
+// ---- Geometry ----
+
+struct MeshRef {
+  const Mesh* mesh;
+  const Material* material;
+};
+
+// Models are drawn with each mesh's material, shapes with the object's
+std::vector<MeshRef> MeshesOf(const GameObject& object) {
+  std::vector<MeshRef> meshes;
+  if (object.isModel && object.model) {
+    for (const auto& mesh : object.model->meshes) {
+      meshes.push_back({ mesh.get(), &mesh->material });
+    }
+  } else if (object.mesh) {
+    meshes.push_back({ object.mesh.get(), &object.material });
+  }
+  return meshes;
+}
+
+glm::vec3 VertexVec3(const Mesh& mesh, uint32_t vertex, int offset) {
+  const float* v = &mesh.vertices[static_cast<size_t>(vertex) * mesh.vertexStride + offset];
+  return glm::vec3(v[0], v[1], v[2]);
+}
+
+glm::vec3 Position(const Mesh& mesh, uint32_t vertex) { return VertexVec3(mesh, vertex, 0); }
+glm::vec3 Color(const Mesh& mesh, uint32_t vertex) { return VertexVec3(mesh, vertex, 3); }
+glm::vec3 Normal(const Mesh& mesh, uint32_t vertex) { return VertexVec3(mesh, vertex, 6); }
+
+// ---- Charts ----
+
+// Triangles of one mesh flattened along the same axis, joined by shared
+// vertices
+struct Chart {
+  std::vector<uint32_t> triangles;
+  int axis = 0;
+  glm::vec2 min = glm::vec2(std::numeric_limits<float>::max());
+  glm::vec2 max = glm::vec2(-std::numeric_limits<float>::max());
+  // Size in texels and where it was packed, both set per layout attempt
+  glm::ivec2 size = glm::ivec2(0);
+  glm::ivec2 offset = glm::ivec2(0);
+};
+
+glm::vec2 Project(const glm::vec3& position, int axis) {
+  return axis == 0 ? glm::vec2(position.y, position.z) : axis == 1 ? glm::vec2(position.x, position.z) : glm::vec2(position.x, position.y);
+}
+
+uint32_t FindRoot(std::vector<uint32_t>& parents, uint32_t i) {
+  while (parents[i] != i) {
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+std::vector<Chart> BuildCharts(const Mesh& mesh) {
+  uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+  std::vector<int> sides(triangleCount);
+  for (uint32_t t = 0; t < triangleCount; ++t) {
+    glm::vec3 a = Position(mesh, mesh.indices[t * 3]);
+    glm::vec3 b = Position(mesh, mesh.indices[t * 3 + 1]);
+    glm::vec3 c = Position(mesh, mesh.indices[t * 3 + 2]);
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    glm::vec3 size = glm::abs(normal);
+    int axis = size.x >= size.y && size.x >= size.z ? 0 : size.y >= size.z ? 1 : 2;
+    sides[t] = axis * 2 + (normal[axis] < 0.0f ? 1 : 0);
+  }
+
+  // Join triangles facing the same side through the vertices they share
+  std::vector<uint32_t> parents(triangleCount);
+  std::iota(parents.begin(), parents.end(), 0u);
+  std::unordered_map<uint64_t, uint32_t> firstUse;
+  for (uint32_t t = 0; t < triangleCount; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      uint64_t key = static_cast<uint64_t>(mesh.indices[t * 3 + k]) * 6 + sides[t];
+      auto inserted = firstUse.emplace(key, t);
+      if (!inserted.second) {
+        parents[FindRoot(parents, t)] = FindRoot(parents, inserted.first->second);
+      }
+    }
+  }
+
+  std::vector<Chart> charts;
+  std::unordered_map<uint32_t, size_t> chartOfRoot;
+  for (uint32_t t = 0; t < triangleCount; ++t) {
+    auto inserted = chartOfRoot.emplace(FindRoot(parents, t), charts.size());
+    if (inserted.second) {
+      charts.emplace_back();
+      charts.back().axis = sides[t] / 2;
+    }
+    Chart& chart = charts[inserted.first->second];
+    chart.triangles.push_back(t);
+    for (int k = 0; k < 3; ++k) {
+      glm::vec2 point = Project(Position(mesh, mesh.indices[t * 3 + k]), chart.axis);
+      chart.min = glm::min(chart.min, point);
+      chart.max = glm::max(chart.max, point);
+    }
+  }
+  return charts;
+}
+
+// Shelf packs rectangles into a square, tallest first. False if they don't fit.
+bool ShelfPack(const std::vector<glm::ivec2>& sizes, int side, std::vector<glm::ivec2>& positions) {
+  std::vector<size_t> order(sizes.size());
+  std::iota(order.begin(), order.end(), size_t(0));
+  std::sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) {
+    return sizes[a].y != sizes[b].y ? sizes[a].y > sizes[b].y : sizes[a].x > sizes[b].x;
+  });
+
+  positions.assign(sizes.size(), glm::ivec2(0));
+  int x = 0;
+  int y = 0;
+  int shelfHeight = 0;
+  for (size_t i : order) {
+    if (sizes[i].x > side) {
+      return false;
+    }
+    if (x + sizes[i].x > side) {
+      x = 0;
+      y += shelfHeight;
+      shelfHeight = 0;
+    }
+    if (y + sizes[i].y > side) {
+      return false;
+    }
+    positions[i] = glm::ivec2(x, y);
+    x += sizes[i].x;
+    shelfHeight = std::max(shelfHeight, sizes[i].y);
+  }
+  return true;
+}
+
+// Every placed copy of one mesh or model. Copies share a layout, so they all
+// get the same size square, big enough for the largest.
+struct Group {
+  uint64_t geometry = 0;
+  std::vector<MeshRef> meshes;
+  std::vector<std::vector<Chart>> charts;
+  std::vector<size_t> instances;
+  // Largest world units per object unit across the copies
+  float scale = 0.0f;
+  // Sum of the charts' object-space areas
+  float area = 0.0f;
+  // Side of the square in texels, per layout attempt
+  int side = 0;
+};
+
+// Sizes the group's charts at density texels per world unit and packs them
+// into the smallest square that holds them
+void PackGroup(Group& group, float density, int padding) {
+  std::vector<glm::ivec2> sizes;
+  long long total = 0;
+  for (auto& meshCharts : group.charts) {
+    for (Chart& chart : meshCharts) {
+      glm::vec2 extent = (chart.max - chart.min) * group.scale * density;
+      chart.size = glm::max(glm::ivec2(glm::ceil(extent)), glm::ivec2(1));
+      glm::ivec2 padded = chart.size + 2 * padding;
+      sizes.push_back(padded);
+      total += static_cast<long long>(padded.x) * padded.y;
+    }
+  }
+
+  std::vector<glm::ivec2> positions;
+  int side = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(total)))));
+  while (!ShelfPack(sizes, side, positions)) {
+    side = std::max(side + 1, static_cast<int>(side * 1.05f));
+  }
+  group.side = side;
+
+  size_t next = 0;
+  for (auto& meshCharts : group.charts) {
+    for (Chart& chart : meshCharts) {
+      chart.offset = positions[next++] + padding;
+    }
+  }
+}
+
+// Where a vertex of the chart lands in its group's square, in texels
+glm::vec2 ChartTexel(const Chart& chart, const Group& group, float density, const glm::vec3& position) {
+  return glm::vec2(chart.offset) + (Project(position, chart.axis) - chart.min) * group.scale * density;
+}
+
+// ---- Ray tracing ----
+
+struct Triangle {
+  glm::vec3 v0;
+  glm::vec3 e1;
+  glm::vec3 e2;
+  // Facing the same way as the mesh's vertex normals
+  glm::vec3 normal;
+  glm::vec3 albedo;
+};
+
+struct Node {
+  glm::vec3 min;
+  glm::vec3 max;
+  // Leaves hold count triangles from start; inner nodes have their first
+  // child right after them and the second at start
+  uint32_t start;
+  uint32_t count;
+};
+
+class Bvh {
+public:
+  void Build(std::vector<Triangle> input) {
+    triangles = std::move(input);
+    nodes.clear();
+    nodes.reserve(triangles.size() * 2 / LEAF_SIZE + 1);
+    if (!triangles.empty()) {
+      BuildNode(0, static_cast<uint32_t>(triangles.size()));
+    }
+  }
+
+  const Triangle& GetTriangle(uint32_t index) const { return triangles[index]; }
+
+  float GetExtent() const {
+    return nodes.empty() ? 0.0f : glm::length(nodes[0].max - nodes[0].min);
+  }
+
+  void GetBounds(glm::vec3& min, glm::vec3& max) const {
+    min = nodes.empty() ? glm::vec3(0.0f) : nodes[0].min;
+    max = nodes.empty() ? glm::vec3(0.0f) : nodes[0].max;
+  }
+
+  // Nearest hit within maxDistance, or any hit if anyHit is set
+  bool Trace(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, bool anyHit, float& distance, uint32_t& triangle) const {
+    if (nodes.empty()) {
+      return false;
+    }
+    glm::vec3 inverse = 1.0f / direction;
+    bool found = false;
+    distance = maxDistance;
+
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+      const Node& node = nodes[stack[--top]];
+      if (!HitsBox(node, origin, inverse, distance)) {
+        continue;
+      }
+      if (node.count > 0) {
+        for (uint32_t i = node.start; i < node.start + node.count; ++i) {
+          float t;
+          if (HitsTriangle(triangles[i], origin, direction, t) && t < distance) {
+            distance = t;
+            triangle = i;
+            found = true;
+            if (anyHit) {
+              return true;
+            }
+          }
+        }
+      } else if (top + 2 <= 64) {
+        uint32_t self = static_cast<uint32_t>(&node - nodes.data());
+        stack[top++] = node.start;
+        stack[top++] = self + 1;
+      }
+    }
+    return found;
+  }
+
+private:
+  uint32_t BuildNode(uint32_t start, uint32_t count) {
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(Node());
+
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(-std::numeric_limits<float>::max());
+    glm::vec3 centroidMin = min;
+    glm::vec3 centroidMax = max;
+    for (uint32_t i = start; i < start + count; ++i) {
+      const Triangle& tri = triangles[i];
+      glm::vec3 a = tri.v0;
+      glm::vec3 b = tri.v0 + tri.e1;
+      glm::vec3 c = tri.v0 + tri.e2;
+      min = glm::min(min, glm::min(a, glm::min(b, c)));
+      max = glm::max(max, glm::max(a, glm::max(b, c)));
+      glm::vec3 centroid = (a + b + c) / 3.0f;
+      centroidMin = glm::min(centroidMin, centroid);
+      centroidMax = glm::max(centroidMax, centroid);
+    }
+    nodes[index].min = min;
+    nodes[index].max = max;
+
+    glm::vec3 spread = centroidMax - centroidMin;
+    if (count <= LEAF_SIZE || glm::max(spread.x, glm::max(spread.y, spread.z)) <= 0.0f) {
+      nodes[index].start = start;
+      nodes[index].count = count;
+      return index;
+    }
+
+    // Median split along the widest spread of centroids
+    int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+    uint32_t half = count / 2;
+    std::nth_element(triangles.begin() + start, triangles.begin() + start + half, triangles.begin() + start + count, [axis](const Triangle& a, const Triangle& b) {
+      return (3.0f * a.v0[axis] + a.e1[axis] + a.e2[axis]) < (3.0f * b.v0[axis] + b.e1[axis] + b.e2[axis]);
+    });
+    BuildNode(start, half);
+    uint32_t second = BuildNode(start + half, count - half);
+    nodes[index].start = second;
+    nodes[index].count = 0;
+    return index;
+  }
+
+  static bool HitsBox(const Node& node, const glm::vec3& origin, const glm::vec3& inverse, float maxDistance) {
+    glm::vec3 t0 = (node.min - origin) * inverse;
+    glm::vec3 t1 = (node.max - origin) * inverse;
+    glm::vec3 nearest = glm::min(t0, t1);
+    glm::vec3 farthest = glm::max(t0, t1);
+    float enter = glm::max(glm::max(nearest.x, nearest.y), glm::max(nearest.z, 0.0f));
+    float exit = glm::min(glm::min(farthest.x, farthest.y), glm::min(farthest.z, maxDistance));
+    return enter <= exit;
+  }
+
+  // Möller-Trumbore
+  static bool HitsTriangle(const Triangle& tri, const glm::vec3& origin, const glm::vec3& direction, float& distance) {
+    glm::vec3 p = glm::cross(direction, tri.e2);
+    float det = glm::dot(tri.e1, p);
+    if (std::abs(det) < 1e-12f) {
+      return false;
+    }
+    float inverse = 1.0f / det;
+    glm::vec3 s = origin - tri.v0;
+    float u = glm::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f) {
+      return false;
+    }
+    glm::vec3 q = glm::cross(s, tri.e1);
+    float v = glm::dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f) {
+      return false;
+    }
+    distance = glm::dot(tri.e2, q) * inverse;
+    return distance > 0.0f;
+  }
+
+  std::vector<Triangle> triangles;
+  std::vector<Node> nodes;
+};
+
+// PCG32, seeded per texel so bakes are repeatable
+struct Random {
+  uint64_t state;
+
+  explicit Random(uint64_t seed) : state(seed * 6364136223846793005ull + 1442695040888963407ull) {}
+
+  float Next() {
+    uint64_t old = state;
+    state = old * 6364136223846793005ull + 1442695040888963407ull;
+    uint32_t shifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+    uint32_t rotation = static_cast<uint32_t>(old >> 59u);
+    uint32_t bits = (shifted >> rotation) | (shifted << ((32u - rotation) & 31u));
+    return (bits >> 8) * (1.0f / 16777216.0f);
+  }
+};
+
+glm::vec3 CosineSample(const glm::vec3& normal, Random& random) {
+  // Orthonormal basis around the normal (Duff et al.)
+  float sign = std::copysign(1.0f, normal.z);
+  float a = -1.0f / (sign + normal.z);
+  float b = normal.x * normal.y * a;
+  glm::vec3 tangent(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+  glm::vec3 bitangent(b, sign + normal.y * normal.y * a, -normal.y);
+
+  float phi = 2.0f * PI * random.Next();
+  float r2 = random.Next();
+  float r = std::sqrt(r2);
+  return glm::normalize(tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + normal * std::sqrt(std::max(0.0f, 1.0f - r2)));
+}
+
+struct Scene {
+  Bvh bvh;
+  const std::vector<ShaderLight>* lights;
+  float bias;
+  int samples;
+  int bounces;
+
+  // Diffuse irradiance from the lights, as the scene shader computes it
+  glm::vec3 Direct(const glm::vec3& position, const glm::vec3& normal) const {
+    glm::vec3 total(0.0f);
+    glm::vec3 origin = position + normal * bias;
+    for (const ShaderLight& light : *lights) {
+      glm::vec3 toLight;
+      float distance = std::numeric_limits<float>::infinity();
+      float strength = 1.0f;
+      if (light.type == static_cast<int>(LightType::DIRECTIONAL)) {
+        toLight = -glm::normalize(light.direction);
+      } else {
+        glm::vec3 offset = light.position - position;
+        distance = glm::length(offset);
+        if (distance <= 0.0f) {
+          continue;
+        }
+        toLight = offset / distance;
+        strength = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+        if (light.type == static_cast<int>(LightType::SPOT)) {
+          float theta = glm::dot(toLight, glm::normalize(-light.direction));
+          float epsilon = std::max(light.innerCutoffCos - light.outerCutoffCos, 1e-4f);
+          strength *= glm::clamp((theta - light.outerCutoffCos) / epsilon, 0.0f, 1.0f);
+        }
+      }
+
+      float NdotL = glm::dot(normal, toLight);
+      if (NdotL <= 0.0f || strength <= 0.0f) {
+        continue;
+      }
+      float hitDistance;
+      uint32_t hitTriangle;
+      if (bvh.Trace(origin, toLight, distance - bias, true, hitDistance, hitTriangle)) {
+        continue;
+      }
+      total += light.color * light.intensity * NdotL * strength;
+    }
+    return total;
+  }
+
+  // Irradiance bounced in along one cosine weighted path of up to
+  // pathBounces hits, lit at every one. With that weighting a bounce's
+  // irradiance is just the albedo-scaled irradiance where it lands.
+  glm::vec3 TracePath(const glm::vec3& position, const glm::vec3& normal, int pathBounces, Random& random) const {
+    glm::vec3 total(0.0f);
+    glm::vec3 origin = position + normal * bias;
+    glm::vec3 surface = normal;
+    glm::vec3 throughput(1.0f);
+    for (int b = 0; b < pathBounces; ++b) {
+      glm::vec3 direction = CosineSample(surface, random);
+      float distance;
+      uint32_t index;
+      if (!bvh.Trace(origin, direction, std::numeric_limits<float>::infinity(), false, distance, index)) {
+        break;
+      }
+      const Triangle& hit = bvh.GetTriangle(index);
+      // The inside of something
+      if (glm::dot(hit.normal, direction) >= 0.0f) {
+        break;
+      }
+      glm::vec3 hitPosition = origin + direction * distance;
+      throughput *= hit.albedo;
+      total += throughput * Direct(hitPosition, hit.normal);
+      surface = hit.normal;
+      origin = hitPosition + surface * bias;
+    }
+    return total;
+  }
+
+  glm::vec3 Indirect(const glm::vec3& position, const glm::vec3& normal, Random& random) const {
+    glm::vec3 total(0.0f);
+    for (int s = 0; s < samples; ++s) {
+      total += TracePath(position, normal, bounces, random);
+    }
+    return samples > 0 ? total / static_cast<float>(samples) : total;
+  }
+
+  // Radiance reaching origin from direction, off whatever diffuse surface
+  // the ray meets. False if that's the back of a surface.
+  bool Incoming(const glm::vec3& origin, const glm::vec3& direction, Random& random, glm::vec3& radiance) const {
+    radiance = glm::vec3(0.0f);
+    float distance;
+    uint32_t index;
+    if (bounces <= 0 || !bvh.Trace(origin, direction, std::numeric_limits<float>::infinity(), false, distance, index)) {
+      return true;
+    }
+    const Triangle& hit = bvh.GetTriangle(index);
+    if (glm::dot(hit.normal, direction) >= 0.0f) {
+      return false;
+    }
+    glm::vec3 hitPosition = origin + direction * distance;
+    glm::vec3 irradiance = Direct(hitPosition, hit.normal) + TracePath(hitPosition, hit.normal, bounces - 1, random);
+    radiance = hit.albedo * irradiance / PI;
+    return true;
+  }
+};
+
+// Real spherical harmonics up to L2, in LightProbes' order
+void ShBasis(const glm::vec3& n, float basis[LightProbes::COEFFICIENTS]) {
+  basis[0] = 0.282095f;
+  basis[1] = 0.488603f * n.y;
+  basis[2] = 0.488603f * n.z;
+  basis[3] = 0.488603f * n.x;
+  basis[4] = 1.092548f * n.x * n.y;
+  basis[5] = 1.092548f * n.y * n.z;
+  basis[6] = 0.315392f * (3.0f * n.z * n.z - 1.0f);
+  basis[7] = 1.092548f * n.x * n.z;
+  basis[8] = 0.546274f * (n.x * n.x - n.y * n.y);
+}
+
+glm::vec3 UniformSphereSample(Random& random) {
+  float z = 1.0f - 2.0f * random.Next();
+  float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+  float phi = 2.0f * PI * random.Next();
+  return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+std::vector<Triangle> CollectTriangles(const std::vector<std::shared_ptr<GameObject>>& objects) {
+  std::vector<Triangle> triangles;
+  for (const auto& object : objects) {
+    const glm::mat4& world = object->GetDrawMatrix();
+    const glm::mat3& normalMatrix = object->GetNormalMatrix();
+    for (const MeshRef& ref : MeshesOf(*object)) {
+      const Mesh& mesh = *ref.mesh;
+      for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        glm::vec3 corners[3];
+        glm::vec3 normal(0.0f);
+        glm::vec3 color(0.0f);
+        for (int k = 0; k < 3; ++k) {
+          uint32_t vertex = mesh.indices[i + k];
+          corners[k] = glm::vec3(world * glm::vec4(Position(mesh, vertex), 1.0f));
+          normal += normalMatrix * Normal(mesh, vertex);
+          color += Color(mesh, vertex);
+        }
+
+        Triangle tri;
+        tri.v0 = corners[0];
+        tri.e1 = corners[1] - corners[0];
+        tri.e2 = corners[2] - corners[0];
+        glm::vec3 face = glm::cross(tri.e1, tri.e2);
+        if (glm::dot(face, face) <= 0.0f) {
+          continue;
+        }
+        face = glm::normalize(face);
+        tri.normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : face;
+        // Bounced light is untextured: material colour times vertex colour,
+        // the same as the shader without textures
+        tri.albedo = glm::clamp(ref.material->diffuse * color / 3.0f, glm::vec3(0.0f), glm::vec3(1.0f));
+        triangles.push_back(tri);
+      }
+    }
+  }
+  return triangles;
+}
+
+void BuildScene(Scene& scene, const std::vector<std::shared_ptr<GameObject>>& objects, const std::vector<ShaderLight>& lights, const BakeSettings& settings) {
+  scene.bvh.Build(CollectTriangles(objects));
+  scene.lights = &lights;
+  scene.bias = std::max(scene.bvh.GetExtent() * 1e-4f, 1e-4f);
+  scene.samples = settings.samples;
+  scene.bounces = settings.bounces;
+}
+
+} // namespace
+
+bool LightmapBaker::Bake(const std::vector<std::shared_ptr<GameObject>>& objects, const std::vector<ShaderLight>& lights, const BakeSettings& settings, LightmapData& data) {
+  auto started = std::chrono::steady_clock::now();
+  int size = settings.size;
+  int padding = std::max(settings.padding, 1);
+
+  // Group the objects by what they draw, each mesh in exactly one group
+  std::vector<Group> groups;
+  std::unordered_map<uint64_t, size_t> groupOf;
+  std::unordered_map<uint64_t, uint64_t> ownerOf;
+  std::unordered_set<uint64_t> placed;
+  for (size_t i = 0; i < objects.size(); ++i) {
+    const GameObject& object = *objects[i];
+    uint64_t geometry = Lightmaps::GeometryHash(object);
+    if (!placed.insert(geometry ^ (Lightmaps::PlacementHash(object.GetDrawMatrix()) * 0x9e3779b97f4a7c15ull)).second) {
+      continue;
+    }
+
+    auto found = groupOf.find(geometry);
+    if (found == groupOf.end()) {
+      Group group;
+      group.geometry = geometry;
+      std::unordered_set<uint64_t> seen;
+      bool shared = false;
+      for (const MeshRef& ref : MeshesOf(object)) {
+        if (seen.insert(ref.mesh->contentHash).second) {
+          shared = shared || ownerOf.count(ref.mesh->contentHash) > 0;
+          group.meshes.push_back(ref);
+        }
+      }
+      // A mesh has one layout, so it can't also be part of something else
+      if (shared || group.meshes.empty()) {
+        std::cout << "Skipping an object whose meshes are already lightmapped as part of another" << std::endl;
+        continue;
+      }
+      for (const MeshRef& ref : group.meshes) {
+        ownerOf.emplace(ref.mesh->contentHash, geometry);
+        group.charts.push_back(BuildCharts(*ref.mesh));
+        for (const Chart& chart : group.charts.back()) {
+          glm::vec2 extent = chart.max - chart.min;
+          group.area += std::max(extent.x * extent.y, 1e-6f);
+        }
+      }
+      found = groupOf.emplace(geometry, groups.size()).first;
+      groups.push_back(std::move(group));
+    }
+
+    Group& group = groups[found->second];
+    const glm::mat4& world = object.GetDrawMatrix();
+    float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+    group.scale = std::max(group.scale, scale);
+    group.instances.push_back(i);
+  }
+  if (groups.empty()) {
+    std::cerr << "Nothing to bake" << std::endl;
+    return false;
+  }
+
+  // Pick the density that fills a good part of the atlas, then back off
+  // until every square fits
+  double worldArea = 0.0;
+  for (const Group& group : groups) {
+    worldArea += static_cast<double>(group.area) * group.scale * group.scale * group.instances.size();
+  }
+  float density = static_cast<float>(std::sqrt(size * static_cast<double>(size) * TARGET_FILL / std::max(worldArea, 1e-6)));
+  std::vector<glm::ivec2> squares;
+  std::vector<glm::ivec2> squarePositions;
+  std::vector<std::pair<size_t, size_t>> squareOwners;
+  bool packed = false;
+  for (int attempt = 0; attempt < 40 && !packed; ++attempt, density *= 0.9f) {
+    squares.clear();
+    squareOwners.clear();
+    for (size_t g = 0; g < groups.size(); ++g) {
+      PackGroup(groups[g], density, padding);
+      for (size_t instance : groups[g].instances) {
+        squares.push_back(glm::ivec2(groups[g].side));
+        squareOwners.push_back({ g, instance });
+      }
+    }
+    packed = ShelfPack(squares, size, squarePositions);
+    if (packed) {
+      break;
+    }
+  }
+  if (!packed) {
+    std::cerr << "Can't fit " << squares.size() << " objects in a " << size << "x" << size << " lightmap; use a bigger --size" << std::endl;
+    return false;
+  }
+
+  // Layouts: each chart gets its own copy of the vertices it touches
+  data = LightmapData();
+  data.width = size;
+  data.height = size;
+  std::vector<std::vector<std::vector<glm::vec2>>> texelUVs(groups.size());
+  for (size_t g = 0; g < groups.size(); ++g) {
+    Group& group = groups[g];
+    texelUVs[g].resize(group.meshes.size());
+    for (size_t m = 0; m < group.meshes.size(); ++m) {
+      const Mesh& mesh = *group.meshes[m].mesh;
+      LightmapLayout& layout = data.layouts[mesh.contentHash];
+      layout.indices.assign(mesh.indices.size(), 0);
+      for (const Chart& chart : group.charts[m]) {
+        std::unordered_map<uint32_t, uint32_t> copies;
+        for (uint32_t t : chart.triangles) {
+          for (int k = 0; k < 3; ++k) {
+            uint32_t source = mesh.indices[t * 3 + k];
+            auto inserted = copies.emplace(source, static_cast<uint32_t>(layout.remap.size()));
+            if (inserted.second) {
+              glm::vec2 texel = ChartTexel(chart, group, density, Position(mesh, source));
+              layout.remap.push_back(source);
+              layout.uvs.push_back(texel.x / group.side);
+              layout.uvs.push_back(texel.y / group.side);
+              texelUVs[g][m].push_back(texel);
+            }
+            layout.indices[t * 3 + k] = inserted.first->second;
+          }
+        }
+      }
+    }
+  }
+
+  // Rasterize every placed copy into the atlas: each covered texel gets the
+  // world position and normal it stands for
+  size_t texelCount = static_cast<size_t>(size) * size;
+  std::vector<glm::vec3> positions(texelCount);
+  std::vector<glm::vec3> normals(texelCount);
+  std::vector<uint8_t> covered(texelCount, 0);
+  for (size_t s = 0; s < squares.size(); ++s) {
+    const Group& group = groups[squareOwners[s].first];
+    const GameObject& object = *objects[squareOwners[s].second];
+    glm::vec2 origin(squarePositions[s]);
+    data.instances.push_back({ group.geometry, Lightmaps::PlacementHash(object.GetDrawMatrix()), glm::vec4(glm::vec2(static_cast<float>(group.side) / size), origin / static_cast<float>(size)) });
+
+    const glm::mat4& world = object.GetDrawMatrix();
+    const glm::mat3& normalMatrix = object.GetNormalMatrix();
+    for (size_t m = 0; m < group.meshes.size(); ++m) {
+      const Mesh& mesh = *group.meshes[m].mesh;
+      const LightmapLayout& layout = data.layouts[mesh.contentHash];
+      const std::vector<glm::vec2>& uvs = texelUVs[squareOwners[s].first][m];
+      for (size_t i = 0; i + 2 < layout.indices.size(); i += 3) {
+        glm::vec2 a = origin + uvs[layout.indices[i]];
+        glm::vec2 b = origin + uvs[layout.indices[i + 1]];
+        glm::vec2 c = origin + uvs[layout.indices[i + 2]];
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::abs(area) < 1e-12f) {
+          continue;
+        }
+        uint32_t source[3] = { layout.remap[layout.indices[i]], layout.remap[layout.indices[i + 1]], layout.remap[layout.indices[i + 2]] };
+
+        glm::ivec2 low = glm::max(glm::ivec2(glm::floor(glm::min(a, glm::min(b, c)))), glm::ivec2(0));
+        glm::ivec2 high = glm::min(glm::ivec2(glm::ceil(glm::max(a, glm::max(b, c)))), glm::ivec2(size - 1));
+        for (int y = low.y; y <= high.y; ++y) {
+          for (int x = low.x; x <= high.x; ++x) {
+            glm::vec2 p(x + 0.5f, y + 0.5f);
+            float wa = ((b.x - p.x) * (c.y - p.y) - (b.y - p.y) * (c.x - p.x)) / area;
+            float wb = ((c.x - p.x) * (a.y - p.y) - (c.y - p.y) * (a.x - p.x)) / area;
+            float wc = 1.0f - wa - wb;
+            if (wa < -1e-4f || wb < -1e-4f || wc < -1e-4f) {
+              continue;
+            }
+            glm::vec3 local = Position(mesh, source[0]) * wa + Position(mesh, source[1]) * wb + Position(mesh, source[2]) * wc;
+            glm::vec3 normal = normalMatrix * (Normal(mesh, source[0]) * wa + Normal(mesh, source[1]) * wb + Normal(mesh, source[2]) * wc);
+            if (glm::dot(normal, normal) <= 0.0f) {
+              continue;
+            }
+            size_t texel = static_cast<size_t>(y) * size + x;
+            positions[texel] = glm::vec3(world * glm::vec4(local, 1.0f));
+            normals[texel] = glm::normalize(normal);
+            covered[texel] = 1;
+          }
+        }
+      }
+    }
+  }
+
+  Scene scene;
+  BuildScene(scene, objects, lights, settings);
+  std::cout << "Baking " << data.instances.size() << " objects (" << groups.size() << " distinct) at " << density << " texels per unit with " << lights.size() << " lights on " << (JobSystem::GetWorkerCount() + 1) << " threads" << std::endl;
+
+  // A row of texels per job
+  std::vector<glm::vec3> irradiance(texelCount, glm::vec3(0.0f));
+  std::atomic<int> rowsDone{ 0 };
+  JobSystem::ParallelFor(size, [&](int y) {
+    for (int x = 0; x < size; ++x) {
+      size_t texel = static_cast<size_t>(y) * size + x;
+      if (!covered[texel]) {
+        continue;
+      }
+      Random random(texel + 1);
+      irradiance[texel] = scene.Direct(positions[texel], normals[texel]) + scene.Indirect(positions[texel], normals[texel], random);
+    }
+    int done = ++rowsDone;
+    if (done * 10 / size != (done - 1) * 10 / size) {
+      std::cout << "  " << done * 100 / size << "%" << std::endl;
+    }
+  });
+
+  // Grow the charts into their padding so filtering at the edges only ever
+  // sees the chart's own light
+  std::vector<uint8_t> next = covered;
+  for (int pass = 0; pass < padding; ++pass) {
+    for (int y = 0; y < size; ++y) {
+      for (int x = 0; x < size; ++x) {
+        size_t texel = static_cast<size_t>(y) * size + x;
+        if (covered[texel]) {
+          continue;
+        }
+        glm::vec3 sum(0.0f);
+        int count = 0;
+        for (int dy = -1; dy <= 1; ++dy) {
+          for (int dx = -1; dx <= 1; ++dx) {
+            int nx = x + dx;
+            int ny = y + dy;
+            if (nx < 0 || ny < 0 || nx >= size || ny >= size) {
+              continue;
+            }
+            size_t neighbour = static_cast<size_t>(ny) * size + nx;
+            if (covered[neighbour]) {
+              sum += irradiance[neighbour];
+              ++count;
+            }
+          }
+        }
+        if (count > 0) {
+          irradiance[texel] = sum / static_cast<float>(count);
+          next[texel] = 1;
+        }
+      }
+    }
+    covered = next;
+  }
+
+  data.texels.resize(texelCount * 3);
+  for (size_t texel = 0; texel < texelCount; ++texel) {
+    for (int channel = 0; channel < 3; ++channel) {
+      data.texels[texel * 3 + channel] = glm::packHalf1x16(std::min(irradiance[texel][channel], 65000.0f));
+    }
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  std::cout << "Baked in " << seconds << "s" << std::endl;
+  return true;
+}
+
+bool LightmapBaker::BakeProbes(const std::vector<std::shared_ptr<GameObject>>& objects, const std::vector<ShaderLight>& lights, const BakeSettings& settings, ProbeGridData& grid) {
+  auto started = std::chrono::steady_clock::now();
+  Scene scene;
+  BuildScene(scene, objects, lights, settings);
+  glm::vec3 min;
+  glm::vec3 max;
+  scene.bvh.GetBounds(min, max);
+  glm::vec3 extent = max - min;
+  float longest = std::max(extent.x, std::max(extent.y, extent.z));
+  if (longest <= 0.0f) {
+    std::cerr << "Nothing to place light probes around" << std::endl;
+    return false;
+  }
+
+  // Half a step out from the geometry on every side, so the outermost
+  // probes aren't sitting in a floor or wall
+  grid = ProbeGridData();
+  grid.spacing = settings.probeSpacing > 0.0f ? settings.probeSpacing : longest / 16.0f;
+  for (;;) {
+    grid.counts = glm::ivec3(glm::ceil(extent / grid.spacing)) + 2;
+    if (glm::all(glm::lessThanEqual(grid.counts, glm::ivec3(LightProbes::MAX_PROBES_PER_AXIS)))) {
+      break;
+    }
+    grid.spacing *= 1.1f;
+  }
+  grid.origin = (min + max) * 0.5f - glm::vec3(grid.counts - 1) * grid.spacing * 0.5f;
+
+  // Irradiance is radiance convolved with the cosine lobe, which for SH is
+  // a scale per band (Ramamoorthi and Hanrahan)
+  const float bandScale[LightProbes::COEFFICIENTS] = { PI, 2.0f * PI / 3.0f, 2.0f * PI / 3.0f, 2.0f * PI / 3.0f, PI / 4.0f, PI / 4.0f, PI / 4.0f, PI / 4.0f, PI / 4.0f };
+  const int stride = LightProbes::COEFFICIENTS * 3;
+  size_t probeCount = static_cast<size_t>(grid.counts.x) * grid.counts.y * grid.counts.z;
+  grid.coefficients.assign(probeCount * stride, 0.0f);
+  // Probes that mostly see the backs of surfaces are inside something
+  std::vector<uint8_t> valid(probeCount, 0);
+  int samples = std::max(settings.probeSamples, 1);
+
+  JobSystem::ParallelFor(grid.counts.y * grid.counts.z, [&](int row) {
+    int y = row % grid.counts.y;
+    int z = row / grid.counts.y;
+    for (int x = 0; x < grid.counts.x; ++x) {
+      size_t probe = (static_cast<size_t>(z) * grid.counts.y + y) * grid.counts.x + x;
+      glm::vec3 position = grid.origin + glm::vec3(x, y, z) * grid.spacing;
+      Random random(0x9e3779b97f4a7c15ull ^ (probe + 1));
+      float* coefficients = &grid.coefficients[probe * stride];
+      int inside = 0;
+      for (int s = 0; s < samples; ++s) {
+        glm::vec3 direction = UniformSphereSample(random);
+        glm::vec3 radiance;
+        if (!scene.Incoming(position, direction, random, radiance)) {
+          ++inside;
+          continue;
+        }
+        float basis[LightProbes::COEFFICIENTS];
+        ShBasis(direction, basis);
+        for (int i = 0; i < LightProbes::COEFFICIENTS; ++i) {
+          for (int channel = 0; channel < 3; ++channel) {
+            coefficients[i * 3 + channel] += radiance[channel] * basis[i];
+          }
+        }
+      }
+      for (int i = 0; i < LightProbes::COEFFICIENTS; ++i) {
+        for (int channel = 0; channel < 3; ++channel) {
+          coefficients[i * 3 + channel] *= 4.0f * PI / samples * bandScale[i];
+        }
+      }
+      valid[probe] = inside * 4 <= samples;
+    }
+  });
+
+  // Buried probes take the average of their open neighbours, spreading in
+  // until every probe has something
+  int buried = 0;
+  for (uint8_t v : valid) {
+    buried += v ? 0 : 1;
+  }
+  for (bool changed = true; changed;) {
+    changed = false;
+    std::vector<uint8_t> next = valid;
+    for (int z = 0; z < grid.counts.z; ++z) {
+      for (int y = 0; y < grid.counts.y; ++y) {
+        for (int x = 0; x < grid.counts.x; ++x) {
+          size_t probe = (static_cast<size_t>(z) * grid.counts.y + y) * grid.counts.x + x;
+          if (valid[probe]) {
+            continue;
+          }
+          const glm::ivec3 offsets[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+          std::vector<float> sum(stride, 0.0f);
+          int count = 0;
+          for (const glm::ivec3& offset : offsets) {
+            glm::ivec3 cell = glm::ivec3(x, y, z) + offset;
+            if (glm::any(glm::lessThan(cell, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(cell, grid.counts))) {
+              continue;
+            }
+            size_t neighbour = (static_cast<size_t>(cell.z) * grid.counts.y + cell.y) * grid.counts.x + cell.x;
+            if (valid[neighbour]) {
+              for (int i = 0; i < stride; ++i) {
+                sum[i] += grid.coefficients[neighbour * stride + i];
+              }
+              ++count;
+            }
+          }
+          if (count > 0) {
+            for (int i = 0; i < stride; ++i) {
+              grid.coefficients[probe * stride + i] = sum[i] / count;
+            }
+            next[probe] = 1;
+            changed = true;
+          }
+        }
+      }
+    }
+    valid = next;
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  std::cout << "Baked " << grid.counts.x << "x" << grid.counts.y << "x" << grid.counts.z << " light probes " << grid.spacing << " apart (" << buried << " inside geometry) in " << seconds << "s" << std::endl;
+  return true;
+}
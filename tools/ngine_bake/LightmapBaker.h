@@ -0,0 +1,43 @@
+#ifndef LIGHTMAPBAKER_H
+#define LIGHTMAPBAKER_H
+
+#include <memory>
+#include <vector>
+
+#include "LightProbes.h"
+#include "Lightmaps.h"
+
+class GameObject;
+struct ShaderLight;
+
+struct BakeSettings {
+  // Width and height of the atlas in texels
+  int size = 1024;
+  // Paths traced per texel for bounced light
+  int samples = 64;
+  int bounces = 2;
+  // Empty texels left around every chart, filled in from its edge so
+  // filtering never reaches a neighbour
+  int padding = 2;
+
+  // Distance between light probes; 0 fits 16 along the scene's longest side
+  float probeSpacing = 0.0f;
+  // Rays per probe
+  int probeSamples = 256;
+};
+
+// Bakes lighting for static objects. Each mesh is cut into charts along its
+// dominant axes and flattened; a placed object gets a square of the atlas
+// sized by how big it is in the world. Direct light and diffuse bounces are
+// then path traced against a BVH of every object, a row of texels per job.
+// Probes are traced against the same BVH, a row of probes per job.
+class LightmapBaker {
+public:
+  // objects all occlude and bounce light; only lights are baked in
+  static bool Bake(const std::vector<std::shared_ptr<GameObject>>& objects, const std::vector<ShaderLight>& lights, const BakeSettings& settings, LightmapData& data);
+  // A probe grid over the same objects holding only their bounced light;
+  // moving objects still get direct light from the lights themselves
+  static bool BakeProbes(const std::vector<std::shared_ptr<GameObject>>& objects, const std::vector<ShaderLight>& lights, const BakeSettings& settings, ProbeGridData& grid);
+};
+
+#endif // LIGHTMAPBAKER_H
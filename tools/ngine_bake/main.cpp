@@ -0,0 +1,106 @@
+#include <glad/glad.h>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "FrameCapture.h"
+#include "GameObject.h"
+#include "JobSystem.h"
+#include "LightComponent.h"
+#include "LightmapBaker.h"
+#include "LightProbes.h"
+#include "Lightmaps.h"
+#include "NullGL.h"
+
+// Bakes a lightmap from one frame of a capture recorded with
+// `app --capture FILE`: the frame's static objects are laid out and lit by
+// its lights marked baked, and a grid of light probes is placed around them.
+// Run from the game's folder, like ngine_replay, and copy the results to
+// resources/lightmaps/<scene>.lightmap and <scene>.probes.
+int main(int argc, char* argv[]) {
+    std::string capturePath;
+    std::string outPath;
+    int frame = 0;
+    BakeSettings settings;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--frame" && i + 1 < argc) {
+            frame = std::atoi(argv[++i]);
+        } else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (arg == "--size" && i + 1 < argc) {
+            settings.size = std::atoi(argv[++i]);
+        } else if (arg == "--samples" && i + 1 < argc) {
+            settings.samples = std::atoi(argv[++i]);
+        } else if (arg == "--bounces" && i + 1 < argc) {
+            settings.bounces = std::atoi(argv[++i]);
+        } else if (arg == "--probe-spacing" && i + 1 < argc) {
+            settings.probeSpacing = static_cast<float>(std::atof(argv[++i]));
+        } else if (arg == "--probe-samples" && i + 1 < argc) {
+            settings.probeSamples = std::atoi(argv[++i]);
+        } else if (capturePath.empty() && arg.rfind("--", 0) != 0) {
+            capturePath = arg;
+        } else {
+            std::cout << "Unknown argument " << arg << std::endl;
+        }
+    }
+
+    if (capturePath.empty() || settings.size <= 0 || settings.samples < 0 || settings.bounces < 0) {
+        std::cout << "usage: ngine_bake CAPTURE [--frame N] [--out FILE] [--size 1024] [--samples 64] [--bounces 2] [--probe-spacing S] [--probe-samples 256]" << std::endl;
+        return 1;
+    }
+    if (outPath.empty()) {
+        outPath = capturePath.substr(0, capturePath.find_last_of('.')) + ".lightmap";
+    }
+    std::string probePath = outPath.substr(0, outPath.find_last_of('.')) + ".probes";
+
+    // Meshes still make their buffers as they load, so give them a driver
+    // that doesn't need a window
+    gladLoadGLLoader((GLADloadproc)NullGL::GetProcAddress);
+    JobSystem::Init(0);
+
+    if (!FrameCapture::Load(capturePath)) {
+        return 1;
+    }
+    if (frame < 0 || frame >= FrameCapture::GetFrameCount()) {
+        std::cerr << "The capture has " << FrameCapture::GetFrameCount() << " frames" << std::endl;
+        return 1;
+    }
+    FrameCapture::CreateResources();
+    FramePacket packet;
+    FrameCapture::BuildPacket(frame, packet);
+
+    std::vector<std::shared_ptr<GameObject>> objects;
+    for (const auto& object : packet.objects) {
+        if (object->isStatic) {
+            objects.push_back(object);
+        }
+    }
+    std::vector<ShaderLight> lights;
+    for (const ShaderLight& light : packet.lights) {
+        if (light.baked) {
+            lights.push_back(light);
+        }
+    }
+    if (objects.empty() || lights.empty()) {
+        std::cerr << "Frame " << frame << " has " << objects.size() << " static objects and " << lights.size() << " baked lights; mark some with Model.SetStatic and a light's baked property" << std::endl;
+        return 1;
+    }
+
+    LightmapData data;
+    bool baked = LightmapBaker::Bake(objects, lights, settings, data) && Lightmaps::Save(outPath, data);
+    if (baked) {
+        std::cout << "Wrote " << outPath << std::endl;
+    }
+    ProbeGridData probes;
+    if (baked && LightmapBaker::BakeProbes(objects, lights, settings, probes) && LightProbes::Save(probePath, probes)) {
+        std::cout << "Wrote " << probePath << std::endl;
+    } else {
+        baked = false;
+    }
+
+    packet = FramePacket();
+    FrameCapture::ReleaseResources();
+    JobSystem::Shutdown();
+    return baked ? 0 : 1;
+}
@@ -0,0 +1,39 @@
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+#include "Engine.hpp"
+
+// Replays a capture recorded with `app --capture FILE` and prints frame times.
+// Run from the game's folder, like the engine: shaders, rendering.config and
+// the captured textures are read from there.
+int main(int argc, char* argv[]) {
+    LaunchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--null-renderer") {
+            options.nullRenderer = true;
+        } else if (arg == "--loops" && i + 1 < argc) {
+            options.replayLoops = std::atoi(argv[++i]);
+        } else if (options.replayPath.empty() && arg.rfind("--", 0) != 0) {
+            options.replayPath = arg;
+        } else {
+            std::cout << "Unknown argument " << arg << std::endl;
+        }
+    }
+
+    if (options.replayPath.empty()) {
+        std::cout << "usage: ngine_replay CAPTURE [--loops N] [--headless | --null-renderer]" << std::endl;
+        return 1;
+    }
+
+    Engine engine = Engine(options);
+    engine.ReplayLoop();
+
+    SDL_Quit();
+    return 0;
+}